@@ -0,0 +1,574 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#include "pxview_intern.h"
+#include "aggregate.h"
+
+/* Records are collected in batches of AGGREGATE_BATCH records. For each
+ * batch the group of every record is looked up first, then each
+ * aggregate function decodes its field of all records into an array
+ * and accumulates the array in a tight loop. This keeps the switch over
+ * the field type and function out of the inner loop.
+ */
+
+/* is_null() {{{
+ * NULL values are stored as all zero bytes for every field type.
+ */
+static int is_null(const char *data, int len) {
+	int i;
+	for(i=0; i<len; i++) {
+		if(data[i])
+			return 0;
+	}
+	return 1;
+}
+/* }}} */
+
+/* parse_function() {{{
+ * Parses one function like 'sum(field)' starting at spec. Returns the
+ * position after the function or NULL on error.
+ */
+static const char *parse_function(pxdoc_t *pxdoc, const char *spec, struct aggregate_func *f) {
+	static const struct {
+		const char *name;
+		int function;
+	} functions[] = {
+		{"count", AGG_COUNT},
+		{"sum", AGG_SUM},
+		{"min", AGG_MIN},
+		{"max", AGG_MAX},
+		{"avg", AGG_AVG},
+		{NULL, 0}
+	};
+	const char *ptr = spec, *end;
+	int i, j, len;
+
+	while(isalpha((unsigned char) *ptr))
+		ptr++;
+	len = ptr - spec;
+	f->function = 0;
+	for(i=0; functions[i].name; i++) {
+		if(len != (int) strlen(functions[i].name))
+			continue;
+		for(j=0; j<len && tolower((unsigned char) spec[j]) == functions[i].name[j]; j++)
+			;
+		if(j == len)
+			f->function = functions[i].function;
+	}
+	if(f->function == 0) {
+		fprintf(stderr, _("Unknown aggregate function '%.*s'."), len, spec);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+
+	f->field = -1;
+	f->pxf = NULL;
+	if(*ptr != '(') {
+		if(f->function != AGG_COUNT) {
+			fprintf(stderr, _("Aggregate function '%.*s' needs a field."), len, spec);
+			fprintf(stderr, "\n");
+			return NULL;
+		}
+		return(ptr);
+	}
+
+	ptr++;
+	if(NULL == (end = strchr(ptr, ')'))) {
+		fprintf(stderr, _("Missing ')' after aggregate function '%.*s'."), len, spec);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	if(f->function == AGG_COUNT && end-ptr == 1 && *ptr == '*')
+		return(end+1);
+	if(0 > (f->field = find_field(pxdoc, ptr, end-ptr))) {
+		fprintf(stderr, _("There is no field '%.*s' to aggregate."), (int) (end-ptr), ptr);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	f->pxf = &(PX_get_fields(pxdoc)[f->field]);
+
+	switch(f->pxf->px_ftype) {
+		case pxfShort:
+		case pxfLong:
+		case pxfAutoInc:
+			f->isinteger = 1;
+			break;
+		case pxfNumber:
+		case pxfCurrency:
+		case pxfBCD:
+			f->isinteger = 0;
+			break;
+		case pxfMemoBLOb:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfGraphic:
+		case pxfOLE:
+			if(f->function != AGG_COUNT) {
+				fprintf(stderr, _("Blob field '%s' can only be counted."), f->pxf->px_fname);
+				fprintf(stderr, "\n");
+				return NULL;
+			}
+			break;
+		default:
+			if(f->function == AGG_SUM || f->function == AGG_AVG) {
+				fprintf(stderr, _("Field '%s' is not a number."), f->pxf->px_fname);
+				fprintf(stderr, "\n");
+				return NULL;
+			}
+			break;
+	}
+	return(end+1);
+}
+/* }}} */
+
+/* new_group() {{{
+ * Creates a group for the given key. Groups are allocated in one piece
+ * with their key and min/max values.
+ */
+static struct aggregate_group *new_group(struct aggregate *agg, const char *key) {
+	pxdoc_t *pxdoc = agg->pxdoc;
+	struct aggregate_group *g;
+	size_t size;
+
+	size = sizeof(struct aggregate_group) + (agg->numfuncs-1) * sizeof(struct aggregate_value);
+	if(NULL == (g = pxdoc->malloc(pxdoc, size + agg->keylen + agg->rawsize, _("Allocate memory for group.")))) {
+		return NULL;
+	}
+	memset(g, 0, size + agg->keylen + agg->rawsize);
+	g->keylen = agg->keylen;
+	g->key = (char *) g + size;
+	g->raw = g->key + agg->keylen;
+	memcpy(g->key, key, agg->keylen);
+
+	if(agg->numgroups >= agg->maxgroups) {
+		agg->maxgroups = agg->maxgroups ? 2*agg->maxgroups : 256;
+		if(NULL == (agg->grouplist = pxdoc->realloc(pxdoc, agg->grouplist, agg->maxgroups * sizeof(struct aggregate_group *), _("Allocate memory for groups.")))) {
+			pxdoc->free(pxdoc, g);
+			return NULL;
+		}
+	}
+	agg->grouplist[agg->numgroups++] = g;
+	return(g);
+}
+/* }}} */
+
+/* aggregate_new() {{{
+ * Creates the aggregation for the comma separated list of group fields
+ * and functions. groupby may be NULL if all records form one group.
+ * funcs defaults to 'count'.
+ */
+struct aggregate *aggregate_new(pxdoc_t *pxdoc, const char *groupby, const char *funcs) {
+	struct aggregate *agg;
+	const char *ptr, *end;
+	pxfield_t *pxf;
+	int i;
+
+	if(NULL == (agg = pxdoc->malloc(pxdoc, sizeof(struct aggregate), _("Allocate memory for aggregation.")))) {
+		return NULL;
+	}
+	memset(agg, 0, sizeof(struct aggregate));
+	agg->pxdoc = pxdoc;
+	pxf = PX_get_fields(pxdoc);
+	for(i=0; i<PX_get_num_fields(pxdoc); i++)
+		agg->recordsize += pxf[i].px_flen;
+
+	/* Group fields */
+	if(groupby && *groupby) {
+		if(NULL == (agg->groupfields = pxdoc->malloc(pxdoc, 2 * (strlen(groupby)/2+1) * sizeof(int), _("Allocate memory for group fields.")))) {
+			aggregate_delete(agg);
+			return NULL;
+		}
+		agg->groupoffsets = agg->groupfields + strlen(groupby)/2+1;
+		ptr = groupby;
+		while(*ptr) {
+			if(NULL == (end = strchr(ptr, ',')))
+				end = ptr + strlen(ptr);
+			if(0 > (i = find_field(pxdoc, ptr, end-ptr))) {
+				fprintf(stderr, _("There is no field '%.*s' to group by."), (int) (end-ptr), ptr);
+				fprintf(stderr, "\n");
+				aggregate_delete(agg);
+				return NULL;
+			}
+			switch(pxf[i].px_ftype) {
+				case pxfMemoBLOb:
+				case pxfBLOb:
+				case pxfFmtMemoBLOb:
+				case pxfGraphic:
+				case pxfOLE:
+					fprintf(stderr, _("Records cannot be grouped by blob field '%s'."), pxf[i].px_fname);
+					fprintf(stderr, "\n");
+					aggregate_delete(agg);
+					return NULL;
+			}
+			agg->groupfields[agg->numgroupfields] = i;
+			agg->groupoffsets[agg->numgroupfields] = field_offset(pxdoc, i);
+			agg->numgroupfields++;
+			agg->keylen += pxf[i].px_flen;
+			ptr = (*end == ',') ? end+1 : end;
+		}
+	}
+
+	/* Aggregate functions */
+	if(NULL == funcs || *funcs == '\0')
+		funcs = "count";
+	if(NULL == (agg->funcs = pxdoc->malloc(pxdoc, (strlen(funcs)/2+1) * sizeof(struct aggregate_func), _("Allocate memory for aggregate functions.")))) {
+		aggregate_delete(agg);
+		return NULL;
+	}
+	ptr = funcs;
+	while(*ptr) {
+		struct aggregate_func *f = &(agg->funcs[agg->numfuncs]);
+		memset(f, 0, sizeof(struct aggregate_func));
+		if(NULL == (ptr = parse_function(pxdoc, ptr, f))) {
+			aggregate_delete(agg);
+			return NULL;
+		}
+		if(*ptr != ',' && *ptr != '\0') {
+			fprintf(stderr, _("Aggregate functions must be separated by ','."));
+			fprintf(stderr, "\n");
+			aggregate_delete(agg);
+			return NULL;
+		}
+		if(*ptr == ',')
+			ptr++;
+		if(f->field >= 0)
+			f->offset = field_offset(pxdoc, f->field);
+		if(f->function == AGG_MIN || f->function == AGG_MAX) {
+			f->rawoffset = agg->rawsize;
+			agg->rawsize += f->pxf->px_flen;
+		}
+		agg->numfuncs++;
+	}
+
+	if(NULL == (agg->records = pxdoc->malloc(pxdoc, (size_t) AGGREGATE_BATCH * agg->recordsize, _("Allocate memory for aggregation.")))) {
+		aggregate_delete(agg);
+		return NULL;
+	}
+	if(agg->keylen > 0) {
+		if(NULL == (agg->keybuffer = pxdoc->malloc(pxdoc, agg->keylen, _("Allocate memory for aggregation.")))) {
+			aggregate_delete(agg);
+			return NULL;
+		}
+		if(NULL == (agg->groups = hashtable_new(pxdoc, agg->keylen, 256))) {
+			aggregate_delete(agg);
+			return NULL;
+		}
+	} else {
+		/* Without group fields there is always exactly one group */
+		if(NULL == new_group(agg, "")) {
+			aggregate_delete(agg);
+			return NULL;
+		}
+	}
+	return(agg);
+}
+/* }}} */
+
+/* aggregate_delete() {{{
+ */
+void aggregate_delete(struct aggregate *agg) {
+	pxdoc_t *pxdoc = agg->pxdoc;
+	int i;
+
+	for(i=0; i<agg->numgroups; i++)
+		pxdoc->free(pxdoc, agg->grouplist[i]);
+	if(agg->grouplist)
+		pxdoc->free(pxdoc, agg->grouplist);
+	if(agg->groups)
+		hashtable_delete(agg->groups);
+	if(agg->groupfields)
+		pxdoc->free(pxdoc, agg->groupfields);
+	if(agg->funcs)
+		pxdoc->free(pxdoc, agg->funcs);
+	if(agg->records)
+		pxdoc->free(pxdoc, agg->records);
+	if(agg->keybuffer)
+		pxdoc->free(pxdoc, agg->keybuffer);
+	pxdoc->free(pxdoc, agg);
+}
+/* }}} */
+
+/* decode_column() {{{
+ * Decodes field f of all records in the batch into ivalues or dvalues
+ * and sets isnull for records where the field is NULL.
+ */
+static void decode_column(struct aggregate *agg, struct aggregate_func *f) {
+	pxdoc_t *pxdoc = agg->pxdoc;
+	char *data = agg->records + f->offset;
+	int flen = f->pxf->px_flen;
+	int i;
+
+	switch(f->pxf->px_ftype) {
+		case pxfShort: {
+			short int value;
+			for(i=0; i<agg->numrecords; i++, data+=agg->recordsize) {
+				agg->isnull[i] = (0 >= PX_get_data_short(pxdoc, data, flen, &value));
+				agg->ivalues[i] = agg->isnull[i] ? 0 : value;
+			}
+			break;
+		}
+		case pxfLong:
+		case pxfAutoInc: {
+			long value;
+			for(i=0; i<agg->numrecords; i++, data+=agg->recordsize) {
+				agg->isnull[i] = (0 >= PX_get_data_long(pxdoc, data, flen, &value));
+				agg->ivalues[i] = agg->isnull[i] ? 0 : value;
+			}
+			break;
+		}
+		case pxfNumber:
+		case pxfCurrency: {
+			double value;
+			for(i=0; i<agg->numrecords; i++, data+=agg->recordsize) {
+				agg->isnull[i] = (0 >= PX_get_data_double(pxdoc, data, flen, &value));
+				agg->dvalues[i] = agg->isnull[i] ? 0.0 : value;
+			}
+			break;
+		}
+		case pxfBCD: {
+			char *value, *ptr;
+#ifdef HAVE_LOCALE_H
+			struct lconv *lc = localeconv();
+#endif
+			for(i=0; i<agg->numrecords; i++, data+=agg->recordsize) {
+				agg->dvalues[i] = 0.0;
+				agg->isnull[i] = (0 >= PX_get_data_bcd(pxdoc, (unsigned char *) data, f->pxf->px_fdc, &value));
+				if(!agg->isnull[i]) {
+#ifdef HAVE_LOCALE_H
+					/* strtod() expects the decimal point of the locale */
+					if(NULL != (ptr = strchr(value, '.')))
+						*ptr = lc->decimal_point[0];
+#endif
+					agg->dvalues[i] = strtod(value, &ptr);
+					pxdoc->free(pxdoc, value);
+				}
+			}
+			break;
+		}
+	}
+}
+/* }}} */
+
+/* process_batch() {{{
+ * Accumulates the records of the current batch.
+ */
+static int process_batch(struct aggregate *agg) {
+	struct aggregate_group *g;
+	struct hashtable_entry *e;
+	char *rec;
+	int i, j, k, isnew;
+
+	/* Find the group of each record */
+	for(i=0, rec=agg->records; i<agg->numrecords; i++, rec+=agg->recordsize) {
+		if(agg->keylen == 0) {
+			g = agg->grouplist[0];
+		} else {
+			char *key = agg->keybuffer;
+			for(j=0; j<agg->numgroupfields; j++) {
+				int flen = PX_get_fields(agg->pxdoc)[agg->groupfields[j]].px_flen;
+				memcpy(key, rec + agg->groupoffsets[j], flen);
+				key += flen;
+			}
+			if(NULL != (e = hashtable_lookup(agg->groups, agg->keybuffer))) {
+				g = e->value;
+			} else {
+				if(NULL == (g = new_group(agg, agg->keybuffer)))
+					return -1;
+				if(NULL == (e = hashtable_insert(agg->groups, g->key, &isnew)))
+					return -1;
+				e->value = g;
+			}
+		}
+		g->count++;
+		agg->rowgroups[i] = g;
+	}
+
+	/* Accumulate one function at a time over all records */
+	for(k=0; k<agg->numfuncs; k++) {
+		struct aggregate_func *f = &(agg->funcs[k]);
+		switch(f->function) {
+			case AGG_COUNT:
+				if(f->field < 0)
+					break;
+				rec = agg->records + f->offset;
+				for(i=0; i<agg->numrecords; i++, rec+=agg->recordsize) {
+					if(!is_null(rec, f->pxf->px_flen))
+						agg->rowgroups[i]->values[k].count++;
+				}
+				break;
+			case AGG_SUM:
+			case AGG_AVG:
+				decode_column(agg, f);
+				if(f->isinteger) {
+					for(i=0; i<agg->numrecords; i++) {
+						struct aggregate_value *v = &(agg->rowgroups[i]->values[k]);
+						if(!agg->isnull[i]) {
+							v->count++;
+							v->isum += agg->ivalues[i];
+						}
+					}
+				} else {
+					/* Kahan summation keeps the rounding error small
+					 * even for sums over millions of values.
+					 */
+					for(i=0; i<agg->numrecords; i++) {
+						struct aggregate_value *v = &(agg->rowgroups[i]->values[k]);
+						if(!agg->isnull[i]) {
+							double y = agg->dvalues[i] - v->compensation;
+							double t = v->sum + y;
+							v->compensation = (t - v->sum) - y;
+							v->sum = t;
+							v->count++;
+						}
+					}
+				}
+				break;
+			case AGG_MIN:
+			case AGG_MAX: {
+				int flen = f->pxf->px_flen;
+				rec = agg->records + f->offset;
+				for(i=0; i<agg->numrecords; i++, rec+=agg->recordsize) {
+					struct aggregate_value *v = &(agg->rowgroups[i]->values[k]);
+					char *raw = agg->rowgroups[i]->raw + f->rawoffset;
+					int c;
+					if(is_null(rec, flen))
+						continue;
+					v->count++;
+					if(v->hasminmax) {
+						/* Raw field bytes compare like their values */
+						c = memcmp(rec, raw, flen);
+						if((f->function == AGG_MIN && c >= 0) || (f->function == AGG_MAX && c <= 0))
+							continue;
+					}
+					memcpy(raw, rec, flen);
+					v->hasminmax = 1;
+				}
+				break;
+			}
+		}
+	}
+	agg->numrecords = 0;
+	return 0;
+}
+/* }}} */
+
+/* aggregate_add() {{{
+ * Adds a record. Returns 0 on success and -1 on error.
+ */
+int aggregate_add(struct aggregate *agg, char *data) {
+	memcpy(agg->records + (size_t) agg->numrecords * agg->recordsize, data, agg->recordsize);
+	if(++agg->numrecords >= AGGREGATE_BATCH)
+		return(process_batch(agg));
+	return 0;
+}
+/* }}} */
+
+/* compare_groups() {{{
+ */
+static int compare_groups(const void *a, const void *b) {
+	const struct aggregate_group *ga = *((struct aggregate_group **) a);
+	const struct aggregate_group *gb = *((struct aggregate_group **) b);
+	return(memcmp(ga->key, gb->key, ga->keylen));
+}
+/* }}} */
+
+/* aggregate_output() {{{
+ * Accumulates the remaining records and outputs one csv line for each
+ * group ordered by the group fields. Returns 0 on success and -1 on error.
+ */
+int aggregate_output(struct aggregate *agg, FILE *outfp, struct format_options *fo) {
+	pxdoc_t *pxdoc = agg->pxdoc;
+	struct str_buffer *sb;
+	pxfield_t *pxf = PX_get_fields(pxdoc);
+	int i, j, k, offset;
+
+	if(agg->numrecords > 0 && 0 > process_batch(agg))
+		return -1;
+	if(NULL == (sb = str_buffer_new(pxdoc, 200)))
+		return -1;
+
+	qsort(agg->grouplist, agg->numgroups, sizeof(struct aggregate_group *), compare_groups);
+
+	/* Header with names of group fields and functions */
+	for(j=0; j<agg->numgroupfields; j++) {
+		if(j > 0)
+			str_buffer_append(pxdoc, sb, &fo->delimiter, 1);
+		format_fieldname(pxdoc, sb, &pxf[agg->groupfields[j]], agg->groupfields[j], FORMAT_CSV, fo);
+	}
+	for(k=0; k<agg->numfuncs; k++) {
+		struct aggregate_func *f = &(agg->funcs[k]);
+		static const char *names[] = {"", "count", "sum", "min", "max", "avg"};
+		if(j > 0 || k > 0)
+			str_buffer_append(pxdoc, sb, &fo->delimiter, 1);
+		str_buffer_print(pxdoc, sb, "%s", names[f->function]);
+		if(f->field >= 0) {
+			str_buffer_append(pxdoc, sb, "(", 1);
+			format_fieldname(pxdoc, sb, f->pxf, f->field, FORMAT_CSV, fo);
+			str_buffer_append(pxdoc, sb, ")", 1);
+		}
+	}
+	fprintf(outfp, "%s\n", str_buffer_get(pxdoc, sb));
+
+	for(i=0; i<agg->numgroups; i++) {
+		struct aggregate_group *g = agg->grouplist[i];
+		str_buffer_clear(pxdoc, sb);
+		offset = 0;
+		for(j=0; j<agg->numgroupfields; j++) {
+			pxfield_t *gf = &pxf[agg->groupfields[j]];
+			if(j > 0)
+				str_buffer_append(pxdoc, sb, &fo->delimiter, 1);
+			format_field(pxdoc, sb, gf, g->key + offset, FORMAT_CSV, fo);
+			offset += gf->px_flen;
+		}
+		for(k=0; k<agg->numfuncs; k++) {
+			struct aggregate_func *f = &(agg->funcs[k]);
+			struct aggregate_value *v = &(g->values[k]);
+			if(j > 0 || k > 0)
+				str_buffer_append(pxdoc, sb, &fo->delimiter, 1);
+			switch(f->function) {
+				case AGG_COUNT:
+					str_buffer_print(pxdoc, sb, "%ld", f->field < 0 ? g->count : v->count);
+					break;
+				case AGG_SUM:
+					/* The sum of no values is NULL like in sql */
+					if(v->count == 0)
+						break;
+					if(f->isinteger)
+						str_buffer_print(pxdoc, sb, "%lld", v->isum);
+					else
+						format_double(pxdoc, sb, v->sum);
+					break;
+				case AGG_AVG:
+					if(v->count == 0)
+						break;
+					format_double(pxdoc, sb, (f->isinteger ? (double) v->isum : v->sum) / v->count);
+					break;
+				case AGG_MIN:
+				case AGG_MAX:
+					if(v->hasminmax)
+						format_field(pxdoc, sb, f->pxf, g->raw + f->rawoffset, FORMAT_CSV, fo);
+					break;
+			}
+		}
+		fprintf(outfp, "%s\n", str_buffer_get(pxdoc, sb));
+	}
+	str_buffer_delete(pxdoc, sb);
+	return 0;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
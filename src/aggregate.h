@@ -0,0 +1,73 @@
+#ifndef __AGGREGATE_H__
+#define __AGGREGATE_H__
+
+#include <stdio.h>
+#include "hashtable.h"
+#include "format.h"
+
+#define AGG_COUNT 1
+#define AGG_SUM   2
+#define AGG_MIN   3
+#define AGG_MAX   4
+#define AGG_AVG   5
+
+/* Number of records which are accumulated at once */
+#define AGGREGATE_BATCH 1024
+
+/* Aggregate function over one field or, for count, over all records */
+struct aggregate_func {
+	int function;
+	int field;              /* -1 if count of records */
+	pxfield_t *pxf;
+	int offset;             /* offset of field in record */
+	int isinteger;          /* sum is computed exactly as integer */
+	int rawoffset;          /* offset of min/max value in group */
+};
+
+/* Accumulated values of one function in one group */
+struct aggregate_value {
+	long count;             /* number of values which are not NULL */
+	long long isum;         /* sum of integer fields */
+	double sum;             /* sum of floating point fields */
+	double compensation;    /* lost low order bits of sum */
+	int hasminmax;
+};
+
+struct aggregate_group {
+	long count;             /* number of records */
+	int keylen;
+	char *key;              /* raw bytes of group fields */
+	char *raw;              /* raw bytes of min/max values */
+	struct aggregate_value values[1];
+};
+
+struct aggregate {
+	pxdoc_t *pxdoc;
+	int recordsize;
+	int numgroupfields;
+	int *groupfields;
+	int *groupoffsets;
+	int keylen;
+	int numfuncs;
+	struct aggregate_func *funcs;
+	int rawsize;            /* size of all min/max values of a group */
+	struct hashtable *groups;
+	struct aggregate_group **grouplist;
+	int numgroups;
+	int maxgroups;
+	/* current batch of records */
+	char *records;
+	int numrecords;
+	struct aggregate_group *rowgroups[AGGREGATE_BATCH];
+	long long ivalues[AGGREGATE_BATCH];
+	double dvalues[AGGREGATE_BATCH];
+	char isnull[AGGREGATE_BATCH];
+	char *keybuffer;
+};
+
+struct aggregate *aggregate_new(pxdoc_t *pxdoc, const char *groupby, const char *funcs);
+void aggregate_delete(struct aggregate *agg);
+int aggregate_add(struct aggregate *agg, char *data);
+int aggregate_output(struct aggregate *agg, FILE *outfp, struct format_options *fo);
+
+#endif
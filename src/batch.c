@@ -0,0 +1,460 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+#include "pxview_intern.h"
+#include "batch.h"
+
+/* batch_new() {{{
+ * Creates an empty list of tables.
+ */
+struct batch *batch_new(void) {
+	struct batch *b;
+
+	if(NULL == (b = malloc(sizeof(struct batch)))) {
+		return NULL;
+	}
+	memset(b, 0, sizeof(struct batch));
+	return(b);
+}
+/* }}} */
+
+/* batch_delete() {{{
+ */
+void batch_delete(struct batch *b) {
+	int i;
+
+	for(i=0; i<b->numtables; i++) {
+		free(b->tables[i].name);
+		free(b->tables[i].dbfile);
+		if(b->tables[i].pxfile)
+			free(b->tables[i].pxfile);
+		if(b->tables[i].mbfile)
+			free(b->tables[i].mbfile);
+	}
+	if(b->tables)
+		free(b->tables);
+	free(b);
+}
+/* }}} */
+
+/* batch_is_directory() {{{
+ */
+int batch_is_directory(const char *path) {
+	struct stat st;
+
+	return(0 == stat(path, &st) && S_ISDIR(st.st_mode));
+}
+/* }}} */
+
+/* has_extension() {{{
+ * Checks if filename is stem followed by a dot and the extension,
+ * ignoring case.
+ */
+static int has_extension(const char *filename, const char *stem, const char *extension) {
+	size_t len = strlen(stem);
+	const char *ext = filename + len + 1;
+
+	if(strlen(filename) != len + 1 + strlen(extension) || filename[len] != '.')
+		return 0;
+	for(; *stem; stem++, filename++)
+		if(tolower((unsigned char) *stem) != tolower((unsigned char) *filename))
+			return 0;
+	for(; *extension; extension++, ext++)
+		if(tolower((unsigned char) *extension) != tolower((unsigned char) *ext))
+			return 0;
+	return 1;
+}
+/* }}} */
+
+/* join_path() {{{
+ */
+static char *join_path(const char *dir, const char *filename) {
+	char *path;
+
+	if(NULL == (path = malloc(strlen(dir) + strlen(filename) + 2)))
+		return NULL;
+	if(*dir)
+		sprintf(path, "%s/%s", dir, filename);
+	else
+		strcpy(path, filename);
+	return(path);
+}
+/* }}} */
+
+/* find_companion() {{{
+ * Looks for the file stem.extension in dir, whatever the case of its
+ * name is. Returns the path of the file or NULL if there is none.
+ */
+static char *find_companion(const char *dir, const char *stem, const char *extension) {
+#ifdef HAVE_DIRENT_H
+	DIR *dp;
+	struct dirent *de;
+	char *path = NULL;
+
+	if(NULL == (dp = opendir(*dir ? dir : ".")))
+		return NULL;
+	while(NULL != (de = readdir(dp))) {
+		if(has_extension(de->d_name, stem, extension)) {
+			path = join_path(dir, de->d_name);
+			break;
+		}
+	}
+	closedir(dp);
+	return(path);
+#else
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* batch_find_companion() {{{
+ * Looks for the file with the name of a table and the given extension
+ * in the directory of the table. Returns the path of the file or NULL
+ * if there is none.
+ */
+char *batch_find_companion(const char *dbfile, const char *extension) {
+	const char *ptr = strrchr(dbfile, '/');
+	char *dir, *stem, *path;
+
+	dir = strdup(dbfile);
+	dir[ptr ? ptr - dbfile : 0] = '\0';
+	stem = strdup(ptr ? ptr+1 : dbfile);
+	if(NULL != (ptr = strrchr(stem, '.')))
+		stem[ptr - stem] = '\0';
+	path = find_companion(dir, stem, extension);
+	free(dir);
+	free(stem);
+	return(path);
+}
+/* }}} */
+
+/* add_table() {{{
+ * Adds a table and, if companions is set, the primary index and blob
+ * file next to it. Only tables with companions must have unique names.
+ */
+static int add_table(struct batch *b, const char *dbfile, int companions) {
+	struct batch_table *table;
+	const char *ptr;
+	char *dir, *stem;
+	int i;
+
+	ptr = strrchr(dbfile, '/');
+	dir = strdup(dbfile);
+	dir[ptr ? ptr - dbfile : 0] = '\0';
+	stem = strdup(ptr ? ptr+1 : dbfile);
+	if(NULL != (ptr = strrchr(stem, '.')))
+		stem[ptr - stem] = '\0';
+
+	for(i=0; companions && i<b->numtables; i++) {
+		if(!strcmp(b->tables[i].name, stem)) {
+			fprintf(stderr, _("Table '%s' is given more than once."), stem);
+			fprintf(stderr, "\n");
+			free(dir);
+			free(stem);
+			return -1;
+		}
+	}
+	if(NULL == (table = realloc(b->tables, (b->numtables+1) * sizeof(struct batch_table)))) {
+		fprintf(stderr, _("Could not allocate memory for list of tables."));
+		fprintf(stderr, "\n");
+		free(dir);
+		free(stem);
+		return -1;
+	}
+	b->tables = table;
+	table = &b->tables[b->numtables++];
+	table->name = stem;
+	table->dbfile = strdup(dbfile);
+	table->pxfile = companions ? find_companion(dir, stem, "px") : NULL;
+	table->mbfile = companions ? find_companion(dir, stem, "mb") : NULL;
+	free(dir);
+	return 0;
+}
+/* }}} */
+
+/* compare_tables() {{{
+ */
+static int compare_tables(const void *a, const void *b) {
+	return(strcmp(((const struct batch_table *) a)->dbfile, ((const struct batch_table *) b)->dbfile));
+}
+/* }}} */
+
+/* batch_add() {{{
+ * Adds a DB file or all DB files in a directory. Returns 0 on success
+ * and -1 on error.
+ */
+int batch_add(struct batch *b, const char *path) {
+	struct stat st;
+
+	if(0 != stat(path, &st)) {
+		fprintf(stderr, _("Could not open input file '%s'."), path);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(S_ISDIR(st.st_mode)) {
+#ifdef HAVE_DIRENT_H
+		DIR *dp;
+		struct dirent *de;
+		int first = b->numtables;
+
+		if(NULL == (dp = opendir(path))) {
+			fprintf(stderr, _("Could not open directory '%s'."), path);
+			fprintf(stderr, "\n");
+			return -1;
+		}
+		while(NULL != (de = readdir(dp))) {
+			char *ptr = strrchr(de->d_name, '.');
+			char *dbfile;
+
+			if(NULL == ptr || ptr == de->d_name)
+				continue;
+			if(strlen(ptr) != 3 || tolower((unsigned char) ptr[1]) != 'd' || tolower((unsigned char) ptr[2]) != 'b')
+				continue;
+			dbfile = join_path(path, de->d_name);
+			if(0 > add_table(b, dbfile, 1)) {
+				free(dbfile);
+				closedir(dp);
+				return -1;
+			}
+			free(dbfile);
+		}
+		closedir(dp);
+		/* Directory order is arbitrary */
+		qsort(b->tables + first, b->numtables - first, sizeof(struct batch_table), compare_tables);
+		return 0;
+#else
+		fprintf(stderr, _("Directories cannot be read on this system."));
+		fprintf(stderr, "\n");
+		return -1;
+#endif
+	}
+	return(add_table(b, path, 1));
+}
+/* }}} */
+
+/* is_paradox_file() {{{
+ * Checks if the extension of a file name is the one of a file with a
+ * Paradox header: .DB, .PX, .Xnn or .Ynn.
+ */
+static int is_paradox_file(const char *filename) {
+	const char *ext = strrchr(filename, '.');
+
+	if(NULL == ext || ext == filename)
+		return 0;
+	switch(tolower((unsigned char) ext[1])) {
+		case 'd':
+			return(strlen(ext) == 3 && tolower((unsigned char) ext[2]) == 'b');
+		case 'p':
+			return(strlen(ext) == 3 && tolower((unsigned char) ext[2]) == 'x');
+		case 'x':
+		case 'y':
+			return(strlen(ext) == 4 && isalnum((unsigned char) ext[2]) && isalnum((unsigned char) ext[3]));
+	}
+	return 0;
+}
+/* }}} */
+
+/* add_tree() {{{
+ */
+static int add_tree(struct batch *b, const char *path) {
+#ifdef HAVE_DIRENT_H
+	DIR *dp;
+	struct dirent *de;
+	struct stat st;
+	char *filename;
+	int ret = 0;
+
+	if(NULL == (dp = opendir(path))) {
+		fprintf(stderr, _("Could not open directory '%s'."), path);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	while(0 == ret && NULL != (de = readdir(dp))) {
+		if(!strcmp(de->d_name, ".") || !strcmp(de->d_name, ".."))
+			continue;
+		filename = join_path(path, de->d_name);
+		/* Symbolic links to directories are not followed to avoid loops */
+#ifdef WIN32
+		if(0 == stat(filename, &st) && S_ISDIR(st.st_mode))
+#else
+		if(0 == lstat(filename, &st) && S_ISDIR(st.st_mode))
+#endif
+			ret = add_tree(b, filename);
+		else if(is_paradox_file(de->d_name))
+			ret = add_table(b, filename, 0);
+		free(filename);
+	}
+	closedir(dp);
+	return(ret);
+#else
+	fprintf(stderr, _("Directories cannot be read on this system."));
+	fprintf(stderr, "\n");
+	return -1;
+#endif
+}
+/* }}} */
+
+/* batch_add_tree() {{{
+ * Adds a file or all files with a Paradox header in a directory and
+ * its subdirectories without looking for their primary index and blob
+ * files. Returns 0 on success and -1 on error.
+ */
+int batch_add_tree(struct batch *b, const char *path) {
+	int first = b->numtables;
+
+	if(!batch_is_directory(path))
+		return(add_table(b, path, 0));
+	if(0 > add_tree(b, path))
+		return -1;
+	qsort(b->tables + first, b->numtables - first, sizeof(struct batch_table), compare_tables);
+	return 0;
+}
+/* }}} */
+
+/* batch_num_cpus() {{{
+ * Returns the number of online processors.
+ */
+int batch_num_cpus(void) {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if(n > 0)
+		return((int) n);
+#endif
+	return 1;
+}
+/* }}} */
+
+/* batch_output_file() {{{
+ * Returns the name of the output file dir/name.extension and creates
+ * dir if it does not exist.
+ */
+char *batch_output_file(const char *dir, const char *name, const char *extension) {
+	char *filename;
+
+	if(!batch_is_directory(dir)) {
+#ifdef WIN32
+		mkdir(dir);
+#else
+		mkdir(dir, 0777);
+#endif
+	}
+	if(NULL == (filename = malloc(strlen(dir) + strlen(name) + strlen(extension) + 3)))
+		return NULL;
+	sprintf(filename, "%s/%s.%s", dir, name, extension);
+	return(filename);
+}
+/* }}} */
+
+/* batch_task_first() {{{
+ * Returns the index of the first table of a task if the tables are
+ * split into numtasks tasks of about the same size.
+ */
+int batch_task_first(struct batch *b, int numtasks, int task) {
+	return((int) ((long) task * b->numtables / numtasks));
+}
+/* }}} */
+
+/* batch_fork() {{{
+ * Processes at most jobs tasks at a time, each one in a new process.
+ * The tables are split into numtasks tasks as by batch_task_first().
+ * The processing itself is done by the caller: batch_fork() returns in
+ * the new process with the number of the task, and that process must
+ * exit when done. In the original process it returns -1 when all tasks
+ * have finished; the tables of failed tasks are counted in b->failed.
+ */
+int batch_fork(struct batch *b, int numtasks, int jobs, int verbose) {
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_WAIT_H)
+	pid_t *pids, pid;
+	int next = 0, running = 0, status, i;
+
+	if(NULL == (pids = malloc((numtasks+1) * sizeof(pid_t)))) {
+		fprintf(stderr, _("Could not allocate memory for list of processes."));
+		fprintf(stderr, "\n");
+		b->failed = b->numtables;
+		return -1;
+	}
+	if(jobs < 1)
+		jobs = 1;
+	while(next < numtasks || running > 0) {
+		if(next < numtasks && running < jobs) {
+			if(verbose) {
+				fprintf(stderr, _("Converting %s"), b->tables[batch_task_first(b, numtasks, next)].dbfile);
+				fprintf(stderr, "\n");
+			}
+			/* Buffered output must not be written twice */
+			fflush(stdout);
+			fflush(stderr);
+			if(0 == (pid = fork())) {
+				free(pids);
+				return(next);
+			}
+			if(0 > pid) {
+				fprintf(stderr, _("Could not start conversion of %s: %s"), b->tables[batch_task_first(b, numtasks, next)].dbfile, strerror(errno));
+				fprintf(stderr, "\n");
+				b->failed += batch_task_first(b, numtasks, next+1) - batch_task_first(b, numtasks, next);
+				pids[next++] = 0;
+				continue;
+			}
+			pids[next++] = pid;
+			running++;
+			continue;
+		}
+
+		if(0 > (pid = wait(&status))) {
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		running--;
+		for(i=0; i<next && pids[i] != pid; i++)
+			;
+		if(i < next && (!WIFEXITED(status) || 0 != WEXITSTATUS(status))) {
+			fprintf(stderr, _("Conversion of %s failed."), b->tables[batch_task_first(b, numtasks, i)].dbfile);
+			fprintf(stderr, "\n");
+			b->failed += batch_task_first(b, numtasks, i+1) - batch_task_first(b, numtasks, i);
+		}
+	}
+	free(pids);
+#else
+	fprintf(stderr, _("Tables cannot be converted concurrently on this system."));
+	fprintf(stderr, "\n");
+	b->failed = b->numtables;
+#endif
+	return -1;
+}
+/* }}} */
+
+/* batch_run() {{{
+ * Converts at most jobs tables at a time, each one in a process of its
+ * own. Returns like batch_fork() with the index of the table.
+ */
+int batch_run(struct batch *b, int jobs, int verbose) {
+	return(batch_fork(b, b->numtables, jobs, verbose));
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
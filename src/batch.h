@@ -0,0 +1,40 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+/* Milliseconds a conversion waits for another one writing into the
+ * same sqlite database.
+ */
+#define BATCH_BUSY_TIMEOUT 600000
+
+/* A table to be converted with the primary index and the blob file
+ * found next to it.
+ */
+struct batch_table {
+	char *name;             /* file name without directory and extension */
+	char *dbfile;
+	char *pxfile;           /* NULL if there is no primary index */
+	char *mbfile;           /* NULL if there is no blob file */
+};
+
+/* Tables which are converted concurrently, each one in a process of
+ * its own.
+ */
+struct batch {
+	struct batch_table *tables;
+	int numtables;
+	int failed;             /* number of failed conversions */
+};
+
+struct batch *batch_new(void);
+void batch_delete(struct batch *b);
+int batch_is_directory(const char *path);
+int batch_add(struct batch *b, const char *path);
+int batch_add_tree(struct batch *b, const char *path);
+char *batch_find_companion(const char *dbfile, const char *extension);
+int batch_num_cpus(void);
+char *batch_output_file(const char *dir, const char *name, const char *extension);
+int batch_task_first(struct batch *b, int numtasks, int task);
+int batch_fork(struct batch *b, int numtasks, int jobs, int verbose);
+int batch_run(struct batch *b, int jobs, int verbose);
+
+#endif
@@ -0,0 +1,329 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "blobmap.h"
+#include "blobstream.h"
+
+/* Exporting blobs record by record seeks to a random position of the
+ * blob file for each blob. The blob map collects the references of all
+ * records first and sorts them by their position. The blob file is then
+ * read once from the beginning, block by block, and each block is
+ * checked against the references pointing to it.
+ */
+#define SINGLEHEADERSIZE 9
+#define SUBHEADERSIZE 12
+#define SUBENTRYSIZE 5
+#define SUBENTRIES 64
+
+static const char *status_names[] = {"ok", "missing", "bad", "shared", "overlap", "orphaned"};
+
+/* is_blob() {{{
+ */
+static int is_blob(int type) {
+	switch(type) {
+		case pxfMemoBLOb:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfGraphic:
+		case pxfOLE:
+			return 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* blobmap_new() {{{
+ * Creates an empty map for the blob fields in selectedfields, which may
+ * be NULL for all fields.
+ */
+struct blobmap *blobmap_new(pxdoc_t *pxdoc, char *selectedfields) {
+	struct blobmap *bm;
+
+	if(NULL == (bm = pxdoc->malloc(pxdoc, sizeof(struct blobmap), _("Allocate memory for blob map.")))) {
+		return NULL;
+	}
+	memset(bm, 0, sizeof(struct blobmap));
+	bm->pxdoc = pxdoc;
+	bm->selectedfields = selectedfields;
+	return(bm);
+}
+/* }}} */
+
+/* blobmap_delete() {{{
+ */
+void blobmap_delete(struct blobmap *bm) {
+	if(bm->refs)
+		bm->pxdoc->free(bm->pxdoc, bm->refs);
+	bm->pxdoc->free(bm->pxdoc, bm);
+}
+/* }}} */
+
+/* blobmap_add() {{{
+ * Adds the references to the blob file of a record. Blobs stored in the
+ * record itself are left out. Returns 0 on success and -1 on error.
+ */
+int blobmap_add(struct blobmap *bm, int recno, const char *data) {
+	pxdoc_t *pxdoc = bm->pxdoc;
+	pxfield_t *pxf = PX_get_fields(pxdoc);
+	struct blob_location loc;
+	struct blobmap_ref *ref;
+	int i, offset = 0;
+
+	for(i=0; i<PX_get_num_fields(pxdoc); offset+=pxf[i].px_flen, i++) {
+		if(!is_blob(pxf[i].px_ftype) || (bm->selectedfields && !bm->selectedfields[i]))
+			continue;
+		if(pxf[i].px_flen < MBFILE_POINTERSIZE)
+			continue;
+		mbfile_decode_pointer(&pxf[i], &data[offset], &loc);
+		if(loc.size <= pxf[i].px_flen - MBFILE_POINTERSIZE)
+			continue;
+		if(bm->numrefs == bm->maxrefs) {
+			bm->maxrefs = bm->maxrefs ? 2 * bm->maxrefs : 1024;
+			if(NULL == (bm->refs = pxdoc->realloc(pxdoc, bm->refs, bm->maxrefs * sizeof(struct blobmap_ref), _("Allocate memory for blob map.")))) {
+				return -1;
+			}
+		}
+		ref = &(bm->refs[bm->numrefs++]);
+		ref->blockoffset = loc.blockoffset;
+		ref->index = loc.index;
+		ref->size = loc.size;
+		ref->modnr = loc.modnr;
+		ref->recno = recno;
+		ref->field = i;
+		ref->status = BLOBMAP_OK;
+	}
+	return 0;
+}
+/* }}} */
+
+/* compare_refs() {{{
+ */
+static int compare_refs(const void *a, const void *b) {
+	const struct blobmap_ref *ra = a, *rb = b;
+
+	if(ra->blockoffset != rb->blockoffset)
+		return(ra->blockoffset < rb->blockoffset ? -1 : 1);
+	if(ra->index != rb->index)
+		return(ra->index - rb->index);
+	return(ra->recno - rb->recno);
+}
+/* }}} */
+
+/* output_row() {{{
+ * Outputs a piece of the blob file, the reference to it if there is one
+ * and the file it was written to.
+ */
+static void output_row(struct blobmap *bm, FILE *outfp, struct blobmap_options *options, long blockoffset, int index, long size, int modnr, struct blobmap_ref *ref, int status, const char *filename) {
+	char d = options->delimiter;
+	pxfield_t *pxf = PX_get_fields(bm->pxdoc);
+
+	bm->problems[status]++;
+	fprintf(outfp, "%ld%c%d%c%ld%c%d%c", blockoffset, d, index, d, size, d, modnr, d);
+	if(ref)
+		fprintf(outfp, "%d%c%s%c", ref->recno, d, pxf[ref->field].px_fname, d);
+	else
+		fprintf(outfp, "%c%c", d, d);
+	fprintf(outfp, "%s%c%s\n", status_names[status], d, filename ? filename : "");
+}
+/* }}} */
+
+/* output_ref() {{{
+ * Outputs a reference and writes the blob into a file if requested.
+ * offset is the position of the data in the blob file.
+ */
+static void output_ref(struct blobmap *bm, FILE *outfp, struct blobmap_options *options, struct blob_stream *stream, struct blobmap_ref *ref, long offset) {
+	pxfield_t *pxf = &(PX_get_fields(bm->pxdoc)[ref->field]);
+	struct blob_location loc;
+	char *filename = NULL;
+
+	if(stream && (ref->status == BLOBMAP_OK || ref->status == BLOBMAP_SHARED) &&
+	   pxf->px_ftype != pxfMemoBLOb && pxf->px_ftype != pxfFmtMemoBLOb) {
+		memset(&loc, 0, sizeof(loc));
+		loc.offset = offset;
+		loc.size = ref->size;
+		loc.modnr = ref->modnr;
+		/* Graphics start with a header of 8 bytes */
+		if(pxf->px_ftype == pxfGraphic) {
+			loc.offset += 8;
+			loc.size -= 8;
+		}
+		if(loc.size > 0)
+			filename = blob_stream_file(stream, &loc, options->blobprefix, ref->modnr, options->blobextension, options->store);
+	}
+	output_row(bm, outfp, options, ref->blockoffset, ref->index, ref->size, ref->modnr, ref, ref->status, filename);
+	if(filename)
+		bm->pxdoc->free(bm->pxdoc, filename);
+}
+/* }}} */
+
+/* scan_single() {{{
+ * Checks the references to a block with a single blob.
+ */
+static void scan_single(struct blobmap *bm, FILE *outfp, struct blobmap_options *options, struct blob_stream *stream, long pos, const char *block, struct blobmap_ref *refs, int numrefs) {
+	long size = get_long_le(&block[3]);
+	int modnr = get_short_le(&block[7]);
+	int i, found = 0;
+
+	if(numrefs == 0)
+		output_row(bm, outfp, options, pos, 0xff, size, modnr, NULL, BLOBMAP_ORPHANED, NULL);
+	for(i=0; i<numrefs; i++) {
+		if(refs[i].index != 0xff || refs[i].size != size) {
+			refs[i].status = BLOBMAP_BAD;
+		} else {
+			refs[i].status = found ? BLOBMAP_SHARED : BLOBMAP_OK;
+			found = 1;
+		}
+		output_ref(bm, outfp, options, stream, &refs[i], pos + SINGLEHEADERSIZE);
+	}
+}
+/* }}} */
+
+/* scan_suballocated() {{{
+ * Checks the references to a block with up to 64 small blobs and the
+ * blobs in the block against each other.
+ */
+static void scan_suballocated(struct blobmap *bm, FILE *outfp, struct blobmap_options *options, struct blob_stream *stream, long pos, const char *block, struct blobmap_ref *refs, int numrefs) {
+	long start[SUBENTRIES], len[SUBENTRIES];
+	int overlap[SUBENTRIES];
+	int i, j, k;
+
+	for(i=0; i<SUBENTRIES; i++) {
+		const unsigned char *entry = (const unsigned char *) &block[SUBHEADERSIZE + i * SUBENTRYSIZE];
+		start[i] = entry[0] * 16;
+		len[i] = entry[0] ? ((long) entry[1] - 1) * 16 + entry[4] : 0;
+		overlap[i] = 0;
+	}
+	for(i=0; i<SUBENTRIES; i++) {
+		for(j=0; j<i && len[i] > 0; j++) {
+			if(len[j] > 0 && start[i] < start[j] + len[j] && start[j] < start[i] + len[i])
+				overlap[i] = overlap[j] = 1;
+		}
+	}
+
+	k = 0;
+	for(i=0; i<SUBENTRIES; i++) {
+		const char *entry = &block[SUBHEADERSIZE + i * SUBENTRYSIZE];
+		int found = 0;
+		if(len[i] > 0 && (k == numrefs || refs[k].index != i))
+			output_row(bm, outfp, options, pos, i, len[i], get_short_le(&entry[2]), NULL, overlap[i] ? BLOBMAP_OVERLAP : BLOBMAP_ORPHANED, NULL);
+		for(; k<numrefs && refs[k].index == i; k++) {
+			if(len[i] == 0 || refs[k].size != len[i] ||
+			   start[i] < SUBHEADERSIZE + SUBENTRIES * SUBENTRYSIZE || start[i] + len[i] > MBFILE_BLOCKSIZE)
+				refs[k].status = BLOBMAP_BAD;
+			else if(overlap[i])
+				refs[k].status = BLOBMAP_OVERLAP;
+			else {
+				refs[k].status = found ? BLOBMAP_SHARED : BLOBMAP_OK;
+				found = 1;
+			}
+			output_ref(bm, outfp, options, stream, &refs[k], pos + start[i]);
+		}
+	}
+	/* Indices beyond the table */
+	for(; k<numrefs; k++) {
+		refs[k].status = BLOBMAP_BAD;
+		output_ref(bm, outfp, options, stream, &refs[k], 0);
+	}
+}
+/* }}} */
+
+/* blobmap_scan() {{{
+ * Reads the blob file mb once from the beginning and outputs each
+ * reference and each blob without reference in the order of their
+ * position. The blobs are written into files if options->extract is
+ * set. Returns 0 on success and -1 on error.
+ */
+int blobmap_scan(struct blobmap *bm, struct mbfile *mb, FILE *outfp, struct blobmap_options *options) {
+	pxdoc_t *pxdoc = bm->pxdoc;
+	struct blob_stream *stream = NULL;
+	char *block;
+	char d = options->delimiter;
+	long pos, len, i, first;
+	int type, numchunks;
+
+	qsort(bm->refs, bm->numrefs, sizeof(struct blobmap_ref), compare_refs);
+	if(NULL == (block = pxdoc->malloc(pxdoc, MBFILE_BLOCKSIZE, _("Allocate memory for blob map.")))) {
+		return -1;
+	}
+	if(options->extract && NULL == (stream = blob_stream_new(pxdoc, mb, 0))) {
+		pxdoc->free(pxdoc, block);
+		return -1;
+	}
+#ifdef HAVE_POSIX_FADVISE
+	posix_fadvise(mb->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	fprintf(outfp, "offset%cindex%csize%cmodnr%crecord%cfield%cstatus%cfile\n", d, d, d, d, d, d, d);
+	i = 0;
+	for(pos=0; pos<mb->filesize; pos+=len) {
+		len = mb->filesize - pos < MBFILE_BLOCKSIZE ? mb->filesize - pos : MBFILE_BLOCKSIZE;
+		memset(block, 0, MBFILE_BLOCKSIZE);
+		if(0 > mbfile_read(mb, block, len, pos)) {
+			fprintf(stderr, _("Could not read blob file at offset %ld."), pos);
+			fprintf(stderr, "\n");
+			break;
+		}
+		type = block[0];
+		numchunks = get_short_le(&block[1]);
+		len = (long) (numchunks > 0 ? numchunks : 1) * MBFILE_BLOCKSIZE;
+
+		/* References into the middle of a block */
+		for(; i<bm->numrefs && bm->refs[i].blockoffset < pos; i++) {
+			bm->refs[i].status = BLOBMAP_MISSING;
+			output_ref(bm, outfp, options, NULL, &(bm->refs[i]), 0);
+		}
+		for(first=i; i<bm->numrefs && bm->refs[i].blockoffset == pos; i++)
+			;
+
+		if(pos + len > mb->filesize && type != MBFILE_FREE) {
+			/* Block is cut off */
+			type = -1;
+		}
+		switch(type) {
+			case MBFILE_SINGLE:
+				scan_single(bm, outfp, options, stream, pos, block, &(bm->refs[first]), i-first);
+				break;
+			case MBFILE_SUBALLOCATED:
+				len = MBFILE_BLOCKSIZE;
+				scan_suballocated(bm, outfp, options, stream, pos, block, &(bm->refs[first]), i-first);
+				break;
+			default:
+				/* The header and unknown blocks take one chunk */
+				if(type != MBFILE_FREE)
+					len = MBFILE_BLOCKSIZE;
+				for(; first<i; first++) {
+					bm->refs[first].status = BLOBMAP_BAD;
+					output_ref(bm, outfp, options, NULL, &(bm->refs[first]), 0);
+				}
+				break;
+		}
+	}
+	/* References beyond the end of the blob file */
+	for(; i<bm->numrefs; i++) {
+		bm->refs[i].status = BLOBMAP_MISSING;
+		output_ref(bm, outfp, options, NULL, &(bm->refs[i]), 0);
+	}
+
+	if(stream)
+		blob_stream_delete(stream);
+	pxdoc->free(pxdoc, block);
+	return 0;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,52 @@
+#ifndef __BLOBMAP_H__
+#define __BLOBMAP_H__
+
+#include <stdio.h>
+#include "mbfile.h"
+#include "blobstore.h"
+
+/* State of a blob reference or a piece of the blob file */
+#define BLOBMAP_OK 0
+#define BLOBMAP_MISSING 1      /* no block starts at the offset */
+#define BLOBMAP_BAD 2          /* block does not match the reference */
+#define BLOBMAP_SHARED 3       /* another reference points to the same blob */
+#define BLOBMAP_OVERLAP 4      /* blob overlaps with another one */
+#define BLOBMAP_ORPHANED 5     /* blob in the blob file without reference */
+
+/* Blob field pointing into the blob file */
+struct blobmap_ref {
+	long blockoffset;
+	int index;                 /* index in suballocated block, 255 for single */
+	long size;
+	int modnr;
+	int recno;
+	int field;
+	int status;
+};
+
+struct blobmap_options {
+	char delimiter;
+	int extract;               /* write the blobs into files */
+	const char *blobprefix;
+	const char *blobextension;
+	struct blob_store *store;  /* write the blobs into the store if set */
+};
+
+/* References to the blob file of all records, sorted by their position
+ * in the blob file.
+ */
+struct blobmap {
+	pxdoc_t *pxdoc;
+	char *selectedfields;
+	struct blobmap_ref *refs;
+	long numrefs;
+	long maxrefs;
+	long problems[BLOBMAP_ORPHANED+1];  /* number of pieces in each state */
+};
+
+struct blobmap *blobmap_new(pxdoc_t *pxdoc, char *selectedfields);
+void blobmap_delete(struct blobmap *bm);
+int blobmap_add(struct blobmap *bm, int recno, const char *data);
+int blobmap_scan(struct blobmap *bm, struct mbfile *mb, FILE *outfp, struct blobmap_options *options);
+
+#endif
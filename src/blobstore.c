@@ -0,0 +1,205 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "blobstore.h"
+
+/* make_dir() {{{
+ * Creates a directory unless it exists already. Returns 0 on success.
+ */
+static int make_dir(const char *dir) {
+#ifdef WIN32
+	if(0 == mkdir(dir) || errno == EEXIST)
+#else
+	if(0 == mkdir(dir, 0777) || errno == EEXIST)
+#endif
+		return 0;
+	fprintf(stderr, _("Could not create directory '%s' for blobs."), dir);
+	fprintf(stderr, "\n");
+	return -1;
+}
+/* }}} */
+
+/* blob_store_new() {{{
+ * Creates a store of blobs in directory dir, which is created if it
+ * does not exist. Returns NULL on error.
+ */
+struct blob_store *blob_store_new(pxdoc_t *pxdoc, const char *dir, const char *extension) {
+	struct blob_store *bs;
+
+	if(0 > make_dir(dir))
+		return NULL;
+	if(NULL == (bs = pxdoc->malloc(pxdoc, sizeof(struct blob_store), _("Allocate memory for blob store.")))) {
+		return NULL;
+	}
+	memset(bs, 0, sizeof(struct blob_store));
+	bs->pxdoc = pxdoc;
+	if(NULL == (bs->dir = pxdoc->malloc(pxdoc, strlen(dir)+1, _("Allocate memory for blob store."))) ||
+	   NULL == (bs->extension = pxdoc->malloc(pxdoc, strlen(extension)+1, _("Allocate memory for blob store."))) ||
+	   NULL == (bs->filename = pxdoc->malloc(pxdoc, strlen(dir)+strlen(extension)+24, _("Allocate memory for blob store."))) ||
+	   NULL == (bs->written = hashtable_new(pxdoc, sizeof(px_hash_t), 1024))) {
+		blob_store_delete(bs);
+		return NULL;
+	}
+	strcpy(bs->dir, dir);
+	strcpy(bs->extension, extension);
+	return(bs);
+}
+/* }}} */
+
+/* blob_store_delete() {{{
+ */
+void blob_store_delete(struct blob_store *bs) {
+	pxdoc_t *pxdoc = bs->pxdoc;
+	size_t i;
+
+	if(bs->written) {
+		for(i=0; i<bs->written->size; i++) {
+			if(bs->written->slots[i].key)
+				pxdoc->free(pxdoc, (char *) bs->written->slots[i].key);
+		}
+		hashtable_delete(bs->written);
+	}
+	if(bs->filename)
+		pxdoc->free(pxdoc, bs->filename);
+	if(bs->extension)
+		pxdoc->free(pxdoc, bs->extension);
+	if(bs->dir)
+		pxdoc->free(pxdoc, bs->dir);
+	pxdoc->free(pxdoc, bs);
+}
+/* }}} */
+
+/* blob_store_hash() {{{
+ * Continues hash over len bytes of a blob. The data is hashed in
+ * pieces of BLOBSTORE_CHUNK bytes, so a blob can also be passed in
+ * such pieces. Start with hash 0.
+ */
+px_hash_t blob_store_hash(px_hash_t hash, const char *data, size_t len) {
+	size_t n;
+
+	while(len > 0) {
+		n = len < BLOBSTORE_CHUNK ? len : BLOBSTORE_CHUNK;
+		hash = hash_bytes(data, n, hash);
+		data += n;
+		len -= n;
+	}
+	return(hash);
+}
+/* }}} */
+
+/* blob_store_name() {{{
+ * Returns the name of the file for a blob with the given hash and
+ * size. isnew is set if the blob must be written, because it was
+ * neither stored by this run nor is a file of the same size in the
+ * store. The name is valid until the next call.
+ * Returns NULL on error.
+ */
+const char *blob_store_name(struct blob_store *bs, px_hash_t hash, long size, int *isnew) {
+	pxdoc_t *pxdoc = bs->pxdoc;
+	struct hashtable_entry *e;
+	struct stat st;
+	unsigned int subdir = (unsigned int) (hash >> 56);
+	char *key;
+
+	sprintf(bs->filename, "%s/%02x", bs->dir, subdir);
+	if(!bs->subdirs[subdir]) {
+		if(0 > make_dir(bs->filename))
+			return NULL;
+		bs->subdirs[subdir] = 1;
+	}
+	sprintf(bs->filename, "%s/%02x/%016llx.%s", bs->dir, subdir, (unsigned long long) hash, bs->extension);
+
+	if(NULL == (key = pxdoc->malloc(pxdoc, sizeof(px_hash_t), _("Allocate memory for blob store.")))) {
+		return NULL;
+	}
+	memcpy(key, &hash, sizeof(px_hash_t));
+	if(NULL == (e = hashtable_insert(bs->written, key, isnew))) {
+		pxdoc->free(pxdoc, key);
+		return NULL;
+	}
+	if(!*isnew) {
+		pxdoc->free(pxdoc, key);
+		if(e->value)
+			return(bs->filename);
+	}
+	/* A file of another size is left over from an interrupted run */
+	*isnew = !(0 == stat(bs->filename, &st) && st.st_size == size);
+	e->value = bs;
+	return(bs->filename);
+}
+/* }}} */
+
+/* blob_store_failed() {{{
+ * Records that the blob with the given hash could not be written, so
+ * it is written again when it occurs next.
+ */
+void blob_store_failed(struct blob_store *bs, px_hash_t hash) {
+	struct hashtable_entry *e;
+
+	if(NULL != (e = hashtable_lookup(bs->written, (const char *) &hash)))
+		e->value = NULL;
+}
+/* }}} */
+
+/* blob_store_file() {{{
+ * Writes a blob into the store unless it is there already. Returns the
+ * name of the file, which must be freed with pxdoc->free(), or NULL if
+ * the file could not be written.
+ */
+char *blob_store_file(struct blob_store *bs, const char *data, long size) {
+	pxdoc_t *pxdoc = bs->pxdoc;
+	px_hash_t hash = blob_store_hash(0, data, size);
+	const char *name;
+	char *filename;
+	int isnew, ret;
+	FILE *fp;
+
+	if(NULL == (name = blob_store_name(bs, hash, size, &isnew)))
+		return NULL;
+	if(isnew) {
+		if(NULL == (fp = fopen(name, "wb"))) {
+			fprintf(stderr, _("Could not open file '%s' for blob data"), name);
+			fprintf(stderr, "\n");
+			blob_store_failed(bs, hash);
+			return NULL;
+		}
+		ret = (size > 0 && 1 != fwrite(data, size, 1, fp)) ? -1 : 0;
+		if(0 != fclose(fp))
+			ret = -1;
+		if(ret < 0) {
+			fprintf(stderr, _("Could not write blob data into file '%s'"), name);
+			fprintf(stderr, "\n");
+			unlink(name);
+			blob_store_failed(bs, hash);
+			return NULL;
+		}
+	}
+	if(NULL == (filename = pxdoc->malloc(pxdoc, strlen(name)+1, _("Allocate memory for name of blob file.")))) {
+		return NULL;
+	}
+	strcpy(filename, name);
+	return(filename);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
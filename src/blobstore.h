@@ -0,0 +1,30 @@
+#ifndef __BLOBSTORE_H__
+#define __BLOBSTORE_H__
+
+#include "hash.h"
+#include "hashtable.h"
+
+/* Size of the pieces a blob is hashed in */
+#define BLOBSTORE_CHUNK 65536
+
+/* Directory of blob files named by the hash of their content. Each
+ * distinct blob is written only once, into DIR/HH/HASH.EXT where HH
+ * are the first two digits of the hash.
+ */
+struct blob_store {
+	pxdoc_t *pxdoc;
+	char *dir;
+	char *extension;
+	struct hashtable *written;   /* hashes of blobs stored by this run */
+	char *filename;              /* name of the last blob */
+	unsigned char subdirs[256];  /* set for subdirectories already created */
+};
+
+struct blob_store *blob_store_new(pxdoc_t *pxdoc, const char *dir, const char *extension);
+void blob_store_delete(struct blob_store *bs);
+px_hash_t blob_store_hash(px_hash_t hash, const char *data, size_t len);
+const char *blob_store_name(struct blob_store *bs, px_hash_t hash, long size, int *isnew);
+void blob_store_failed(struct blob_store *bs, px_hash_t hash);
+char *blob_store_file(struct blob_store *bs, const char *data, long size);
+
+#endif
@@ -0,0 +1,188 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "blobstream.h"
+#include "stats.h"
+#include "trace.h"
+
+/* pxlib reads a blob into memory as a whole, which fails for OLE
+ * objects of several hundred megabytes. Blobs above a threshold are
+ * therefore found in the blob file directly and copied to the output
+ * in pieces, so the memory used does not depend on the size of blobs.
+ */
+
+/* blob_stream_new() {{{
+ * Creates a stream for blobs larger than threshold bytes in the blob
+ * file mb. Returns NULL on error.
+ */
+struct blob_stream *blob_stream_new(pxdoc_t *pxdoc, struct mbfile *mb, long threshold) {
+	struct blob_stream *bs;
+
+	if(NULL == (bs = pxdoc->malloc(pxdoc, sizeof(struct blob_stream), _("Allocate memory for blob stream.")))) {
+		return NULL;
+	}
+	if(NULL == (bs->buffer = pxdoc->malloc(pxdoc, BLOBSTREAM_CHUNK, _("Allocate memory for blob stream.")))) {
+		pxdoc->free(pxdoc, bs);
+		return NULL;
+	}
+	bs->pxdoc = pxdoc;
+	bs->mb = mb;
+	bs->threshold = threshold;
+	return(bs);
+}
+/* }}} */
+
+/* blob_stream_delete() {{{
+ * Frees the stream but does not close the blob file.
+ */
+void blob_stream_delete(struct blob_stream *bs) {
+	bs->pxdoc->free(bs->pxdoc, bs->buffer);
+	bs->pxdoc->free(bs->pxdoc, bs);
+}
+/* }}} */
+
+/* blob_stream_locate() {{{
+ * Finds the blob of a field in the blob file. Returns 1 if the blob is
+ * large enough to be copied in pieces and 0 if it is left to pxlib.
+ */
+int blob_stream_locate(struct blob_stream *bs, pxfield_t *pxf, const char *fielddata, struct blob_location *loc) {
+	if(0 >= mbfile_locate(bs->mb, pxf, fielddata, loc))
+		return 0;
+	if(loc->inrecord || loc->size <= bs->threshold)
+		return 0;
+	if(pxview_stats)
+		stats_blob(loc->size);
+	return 1;
+}
+/* }}} */
+
+/* blob_stream_read() {{{
+ * Reads the piece of the blob starting at pos. data is set to the
+ * piece, which is valid until the next call.
+ * Returns the length of the piece, 0 at the end of the blob and -1 on
+ * error.
+ */
+int blob_stream_read(struct blob_stream *bs, struct blob_location *loc, long pos, char **data) {
+	double start = 0.0;
+	long len;
+	int ret;
+
+	if(pos >= loc->size)
+		return 0;
+	len = loc->size - pos < BLOBSTREAM_CHUNK ? loc->size - pos : BLOBSTREAM_CHUNK;
+	if(pxview_tracing)
+		start = trace_now();
+	if(pxview_stats)
+		stats_enter(STATS_BLOB);
+	ret = mbfile_read(bs->mb, bs->buffer, len, loc->offset + pos);
+	if(pxview_stats)
+		stats_leave();
+	if(pxview_tracing)
+		trace_span("read blob piece", "blob", start, len);
+	if(0 > ret) {
+		fprintf(stderr, _("Could not read blob data for %d"), loc->modnr);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	*data = bs->buffer;
+	return((int) len);
+}
+/* }}} */
+
+/* blob_stream_copy() {{{
+ * Copies the blob into outfp and masks each occurrence of c1 with c2
+ * like printmask(). If c1 is 0 the blob is copied unchanged.
+ * Returns 0 or -1 if the blob could not be read.
+ */
+int blob_stream_copy(struct blob_stream *bs, struct blob_location *loc, FILE *outfp, char c1, char c2) {
+	char *piece;
+	long pos;
+	int i, n;
+
+	for(pos=0; 0 < (n = blob_stream_read(bs, loc, pos, &piece)); pos += n) {
+		if(c1 == '\0') {
+			fwrite(piece, 1, n, outfp);
+			continue;
+		}
+		for(i=0; i<n; i++) {
+			if(piece[i] == c1)
+				fputc(c2, outfp);
+			fputc(piece[i], outfp);
+		}
+	}
+	return(n < 0 ? -1 : 0);
+}
+/* }}} */
+
+/* blob_stream_file() {{{
+ * Copies the blob into the file PREFIX_NUMBER.EXTENSION or into the
+ * blob store if store is not NULL. Returns the name of the file, which
+ * must be freed with pxdoc->free(), or NULL on error.
+ */
+char *blob_stream_file(struct blob_stream *bs, struct blob_location *loc, const char *prefix, int number, const char *extension, struct blob_store *store) {
+	pxdoc_t *pxdoc = bs->pxdoc;
+	char *filename, *piece;
+	const char *name;
+	px_hash_t hash = 0;
+	long pos;
+	int n, isnew = 1;
+	FILE *fp;
+
+	if(store) {
+		for(pos=0; 0 < (n = blob_stream_read(bs, loc, pos, &piece)); pos += n)
+			hash = blob_store_hash(hash, piece, n);
+		if(n < 0 || NULL == (name = blob_store_name(store, hash, loc->size, &isnew)))
+			return NULL;
+		if(NULL == (filename = pxdoc->malloc(pxdoc, strlen(name)+1, _("Allocate memory for name of blob file.")))) {
+			return NULL;
+		}
+		strcpy(filename, name);
+	} else {
+		if(NULL == (filename = pxdoc->malloc(pxdoc, strlen(prefix)+strlen(extension)+20, _("Allocate memory for name of blob file.")))) {
+			return NULL;
+		}
+		sprintf(filename, "%s_%d.%s", prefix, number, extension);
+	}
+	if(!isnew)
+		return(filename);
+
+	if(NULL == (fp = fopen(filename, "wb"))) {
+		fprintf(stderr, _("Could not open file '%s' for blob data"), filename);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, filename);
+		return NULL;
+	}
+	for(pos=0; 0 < (n = blob_stream_read(bs, loc, pos, &piece)); pos += n) {
+		if(1 != fwrite(piece, n, 1, fp)) {
+			n = -1;
+			break;
+		}
+	}
+	if(0 != fclose(fp) || n < 0) {
+		fprintf(stderr, _("Could not write blob data into file '%s'"), filename);
+		fprintf(stderr, "\n");
+		remove(filename);
+		if(store)
+			blob_store_failed(store, hash);
+		pxdoc->free(pxdoc, filename);
+		return NULL;
+	}
+	return(filename);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,29 @@
+#ifndef __BLOBSTREAM_H__
+#define __BLOBSTREAM_H__
+
+#include "mbfile.h"
+#include "blobstore.h"
+
+/* Size of the pieces a large blob is copied in */
+#define BLOBSTREAM_CHUNK 65536
+/* Blobs larger than this are copied in pieces by default */
+#define BLOBSTREAM_THRESHOLD (16*1024*1024)
+
+/* Copies large blobs from the blob file in pieces of fixed size
+ * instead of reading them as a whole with pxlib.
+ */
+struct blob_stream {
+	pxdoc_t *pxdoc;
+	struct mbfile *mb;
+	long threshold;         /* smallest size of blob copied in pieces */
+	char *buffer;
+};
+
+struct blob_stream *blob_stream_new(pxdoc_t *pxdoc, struct mbfile *mb, long threshold);
+void blob_stream_delete(struct blob_stream *bs);
+int blob_stream_locate(struct blob_stream *bs, pxfield_t *pxf, const char *fielddata, struct blob_location *loc);
+int blob_stream_read(struct blob_stream *bs, struct blob_location *loc, long pos, char **data);
+int blob_stream_copy(struct blob_stream *bs, struct blob_location *loc, FILE *outfp, char c1, char c2);
+char *blob_stream_file(struct blob_stream *bs, struct blob_location *loc, const char *prefix, int number, const char *extension, struct blob_store *store);
+
+#endif
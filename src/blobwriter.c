@@ -0,0 +1,468 @@
+/* copy_file_range() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "blobwriter.h"
+#include "stats.h"
+#include "trace.h"
+
+/* Writing thousands of blobs one after the other in the record loop
+ * keeps the export waiting for the disk. Blobs are instead put into a
+ * queue of fixed size and written by a pool of threads. A blob which
+ * is stored in the blob file is copied from there by the kernel with
+ * copy_file_range() without being read into memory, otherwise it is
+ * copied in chunks. Only the main thread allocates and frees memory,
+ * so the memory functions of pxdoc need not be thread safe. The
+ * buffers of written blobs are freed when their slot is reused.
+ */
+
+/* write_full() {{{
+ */
+static int write_full(int fd, const char *buf, size_t len) {
+	ssize_t n;
+
+	while(len > 0) {
+		if(0 > (n = write(fd, buf, len))) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+/* }}} */
+
+/* copy_range() {{{
+ * Copies size bytes at offset of the blob file into fd.
+ */
+static int copy_range(struct blob_worker *w, int fd, off_t offset, long size) {
+	int srcfd = w->bw->mb->fd;
+	ssize_t n;
+
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		loff_t in = offset;
+		while(size > 0) {
+			if(0 > (n = copy_file_range(srcfd, &in, fd, NULL, size, 0))) {
+				if(errno == EINTR)
+					continue;
+				/* Not supported between these files, copy by hand */
+				if(in == offset && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+					break;
+				return -1;
+			}
+			if(n == 0)
+				return -1;
+			size -= n;
+		}
+		if(size == 0)
+			return 0;
+	}
+#endif
+	while(size > 0) {
+		size_t len = size < BLOBWRITER_CHUNK ? size : BLOBWRITER_CHUNK;
+		if(0 > (n = pread(srcfd, w->chunk, len, offset))) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(n == 0 || 0 > write_full(fd, w->chunk, n))
+			return -1;
+		offset += n;
+		size -= n;
+	}
+	return 0;
+}
+/* }}} */
+
+/* do_job() {{{
+ * Writes a blob into its file. Returns 0 on success and -1 on error.
+ */
+static int do_job(struct blob_worker *w, struct blob_job *job) {
+	double start = 0.0;
+	int fd, ret;
+
+	if(pxview_tracing)
+		start = trace_now();
+	if(0 > (fd = open(job->filename, O_WRONLY | O_CREAT | O_TRUNC, 0666))) {
+		fprintf(stderr, _("Could not open file '%s' for blob data"), job->filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(job->buffer)
+		ret = write_full(fd, job->buffer, job->size);
+	else
+		ret = copy_range(w, fd, job->offset, job->size);
+	if(0 != close(fd))
+		ret = -1;
+	if(pxview_tracing)
+		trace_span("write blob", "blob", start, job->size);
+	if(ret < 0) {
+		fprintf(stderr, _("Could not write blob data into file '%s'"), job->filename);
+		fprintf(stderr, "\n");
+	}
+	return ret;
+}
+/* }}} */
+
+/* free_job() {{{
+ * Frees the memory of a written blob. Called by the main thread only.
+ */
+static void free_job(struct blob_writer *bw, struct blob_job *job) {
+	pxdoc_t *pxdoc = bw->pxdoc;
+
+	if(job->filename)
+		pxdoc->free(pxdoc, job->filename);
+	if(job->buffer)
+		pxdoc->free(pxdoc, job->buffer);
+	job->filename = NULL;
+	job->buffer = NULL;
+	job->state = BLOBJOB_FREE;
+}
+/* }}} */
+
+#ifdef HAVE_PTHREAD_H
+/* worker_main() {{{
+ * Writes queued blobs until the writer is closed.
+ */
+static void *worker_main(void *arg) {
+	struct blob_worker *w = arg;
+	struct blob_writer *bw = w->bw;
+	struct blob_job *job;
+	int ret;
+
+	trace_thread("blob writer");
+	pthread_mutex_lock(&bw->lock);
+	for(;;) {
+		while(bw->queuecount == 0 && !bw->closing)
+			pthread_cond_wait(&bw->work, &bw->lock);
+		if(bw->queuecount == 0)
+			break;
+		job = &(bw->jobs[bw->queue[bw->queuehead]]);
+		bw->queuehead = (bw->queuehead + 1) % BLOBWRITER_QUEUE;
+		bw->queuecount--;
+		job->state = BLOBJOB_BUSY;
+		pthread_mutex_unlock(&bw->lock);
+
+		ret = do_job(w, job);
+
+		pthread_mutex_lock(&bw->lock);
+		if(ret < 0)
+			bw->failed++;
+		job->state = BLOBJOB_DONE;
+		pthread_cond_broadcast(&bw->done);
+	}
+	pthread_mutex_unlock(&bw->lock);
+	return NULL;
+}
+/* }}} */
+#endif
+
+/* blob_writer_new() {{{
+ * Creates a pool of numworkers threads writing blobs. Blobs are copied
+ * from the blob file mb, which may be NULL. Without threads the blobs
+ * are written right away.
+ */
+struct blob_writer *blob_writer_new(pxdoc_t *pxdoc, struct mbfile *mb, int numworkers) {
+	struct blob_writer *bw;
+	int i;
+
+	if(numworkers <= 0)
+		numworkers = 1;
+#ifndef HAVE_PTHREAD_H
+	numworkers = 1;
+#endif
+	if(NULL == (bw = pxdoc->malloc(pxdoc, sizeof(struct blob_writer), _("Allocate memory for blob writer.")))) {
+		return NULL;
+	}
+	memset(bw, 0, sizeof(struct blob_writer));
+	bw->pxdoc = pxdoc;
+	bw->mb = mb;
+	if(NULL == (bw->workers = pxdoc->malloc(pxdoc, numworkers * sizeof(struct blob_worker), _("Allocate memory for blob writer.")))) {
+		pxdoc->free(pxdoc, bw);
+		return NULL;
+	}
+	memset(bw->workers, 0, numworkers * sizeof(struct blob_worker));
+	if(NULL == (bw->chunk = pxdoc->malloc(pxdoc, BLOBSTORE_CHUNK, _("Allocate memory for blob writer.")))) {
+		pxdoc->free(pxdoc, bw->workers);
+		pxdoc->free(pxdoc, bw);
+		return NULL;
+	}
+	for(i=0; i<numworkers; i++) {
+		bw->workers[i].bw = bw;
+		if(NULL == (bw->workers[i].chunk = pxdoc->malloc(pxdoc, BLOBWRITER_CHUNK, _("Allocate memory for blob writer.")))) {
+			while(--i >= 0)
+				pxdoc->free(pxdoc, bw->workers[i].chunk);
+			pxdoc->free(pxdoc, bw->chunk);
+			pxdoc->free(pxdoc, bw->workers);
+			pxdoc->free(pxdoc, bw);
+			return NULL;
+		}
+	}
+	bw->maxworkers = numworkers;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_init(&bw->lock, NULL);
+	pthread_cond_init(&bw->work, NULL);
+	pthread_cond_init(&bw->done, NULL);
+	for(i=0; i<numworkers; i++) {
+		if(0 != pthread_create(&(bw->workers[i].thread), NULL, worker_main, &(bw->workers[i]))) {
+			fprintf(stderr, _("Could not start thread for writing blobs."));
+			fprintf(stderr, "\n");
+			break;
+		}
+		bw->numworkers++;
+	}
+	if(bw->numworkers == 0) {
+		blob_writer_delete(bw);
+		return NULL;
+	}
+#else
+	bw->numworkers = numworkers;
+#endif
+	return(bw);
+}
+/* }}} */
+
+/* blob_writer_add() {{{
+ * Queues a blob for writing into filename. The data is taken from
+ * buffer if it is not NULL, from the record if the blob is stored
+ * there or else from the blob file. buffer must be allocated with
+ * pxdoc->malloc() and is freed by the writer.
+ * Returns 0 on success and -1 on error.
+ */
+int blob_writer_add(struct blob_writer *bw, const char *filename, struct blob_location *loc, char *buffer) {
+	pxdoc_t *pxdoc = bw->pxdoc;
+	struct blob_job *job = NULL;
+	char *name;
+	int i;
+
+	/* Blobs passed in a buffer were counted when they were read */
+	if(pxview_stats && NULL == buffer)
+		stats_blob(loc->size);
+	if(NULL == buffer && loc->inrecord) {
+		if(NULL == (buffer = pxdoc->malloc(pxdoc, loc->size > 0 ? loc->size : 1, _("Allocate memory for blob data.")))) {
+			return -1;
+		}
+		memcpy(buffer, loc->data, loc->size);
+	}
+	if((NULL == buffer && NULL == bw->mb) ||
+	   NULL == (name = pxdoc->malloc(pxdoc, strlen(filename)+1, _("Allocate memory for name of blob file.")))) {
+		if(buffer)
+			pxdoc->free(pxdoc, buffer);
+		return -1;
+	}
+	strcpy(name, filename);
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&bw->lock);
+	while(NULL == job) {
+		for(i=0; i<BLOBWRITER_QUEUE; i++) {
+			if(bw->jobs[i].state == BLOBJOB_DONE)
+				free_job(bw, &(bw->jobs[i]));
+			if(NULL == job && bw->jobs[i].state == BLOBJOB_FREE)
+				job = &(bw->jobs[i]);
+		}
+		if(NULL == job)
+			pthread_cond_wait(&bw->done, &bw->lock);
+	}
+#else
+	job = &(bw->jobs[0]);
+#endif
+	job->filename = name;
+	job->buffer = buffer;
+	job->offset = loc->offset;
+	job->size = loc->size;
+#ifdef HAVE_PTHREAD_H
+	job->state = BLOBJOB_QUEUED;
+	bw->queue[(bw->queuehead + bw->queuecount) % BLOBWRITER_QUEUE] = job - bw->jobs;
+	bw->queuecount++;
+	pthread_cond_signal(&bw->work);
+	pthread_mutex_unlock(&bw->lock);
+#else
+	if(0 > do_job(&(bw->workers[0]), job))
+		bw->failed++;
+	free_job(bw, job);
+#endif
+	return 0;
+}
+/* }}} */
+
+/* blob_writer_field() {{{
+ * Queues the blob of a field for writing into filename. If the blob
+ * cannot be found in the blob file directly, it is read by pxlib.
+ * Returns 1 if the blob is written, 0 if the field is empty and -1 on
+ * error.
+ */
+int blob_writer_field(struct blob_writer *bw, pxfield_t *pxf, char *fielddata, const char *filename) {
+	pxdoc_t *pxdoc = bw->pxdoc;
+	struct blob_location loc;
+	char *blobdata = NULL;
+	int ret, mod_nr, size;
+
+	if(0 <= (ret = mbfile_locate(bw->mb, pxf, fielddata, &loc))) {
+		if(ret == 0)
+			return 0;
+		return(0 > blob_writer_add(bw, filename, &loc, NULL) ? -1 : 1);
+	}
+
+	if(pxf->px_ftype == pxfGraphic)
+		ret = stats_get_data_graphic(pxdoc, fielddata, pxf->px_flen, &mod_nr, &size, &blobdata);
+	else
+		ret = stats_get_data_blob(pxdoc, fielddata, pxf->px_flen, &mod_nr, &size, &blobdata);
+	if(ret <= 0 || NULL == blobdata) {
+		if(ret > 0) {
+			fprintf(stderr, _("Could not get blob data for %d"), mod_nr);
+			fprintf(stderr, "\n");
+		}
+		return(ret < 0 ? -1 : 0);
+	}
+	memset(&loc, 0, sizeof(loc));
+	loc.size = size;
+	return(0 > blob_writer_add(bw, filename, &loc, blobdata) ? -1 : 1);
+}
+/* }}} */
+
+/* blob_writer_store() {{{
+ * Queues the blob of a field for writing into the blob store bs unless
+ * it is stored already. A blob in the blob file is hashed in pieces
+ * and copied later, so it need not fit into memory. filename is set to
+ * the name of the blob in the store, which is valid until the next call.
+ * Returns 1 if the blob is stored, 0 if the field is empty and -1 on
+ * error.
+ */
+int blob_writer_store(struct blob_writer *bw, struct blob_store *bs, pxfield_t *pxf, char *fielddata, const char **filename) {
+	pxdoc_t *pxdoc = bw->pxdoc;
+	struct blob_location loc;
+	char *blobdata = NULL;
+	px_hash_t hash = 0;
+	int ret, mod_nr, size, isnew;
+	long pos, n;
+
+	if(0 < (ret = mbfile_locate(bw->mb, pxf, fielddata, &loc))) {
+		if(loc.inrecord) {
+			hash = blob_store_hash(0, loc.data, loc.size);
+		} else {
+			for(pos=0; pos<loc.size; pos+=n) {
+				n = loc.size-pos < BLOBSTORE_CHUNK ? loc.size-pos : BLOBSTORE_CHUNK;
+				if(0 > mbfile_read(bw->mb, bw->chunk, n, loc.offset+pos))
+					return -1;
+				hash = blob_store_hash(hash, bw->chunk, n);
+			}
+		}
+	} else if(ret == 0) {
+		return 0;
+	} else {
+		if(pxf->px_ftype == pxfGraphic)
+			ret = stats_get_data_graphic(pxdoc, fielddata, pxf->px_flen, &mod_nr, &size, &blobdata);
+		else
+			ret = stats_get_data_blob(pxdoc, fielddata, pxf->px_flen, &mod_nr, &size, &blobdata);
+		if(ret <= 0 || NULL == blobdata) {
+			if(ret > 0) {
+				fprintf(stderr, _("Could not get blob data for %d"), mod_nr);
+				fprintf(stderr, "\n");
+			}
+			return(ret < 0 ? -1 : 0);
+		}
+		memset(&loc, 0, sizeof(loc));
+		loc.size = size;
+		hash = blob_store_hash(0, blobdata, size);
+	}
+
+	if(NULL == (*filename = blob_store_name(bs, hash, loc.size, &isnew)) || !isnew) {
+		if(blobdata)
+			pxdoc->free(pxdoc, blobdata);
+		return(*filename ? 1 : -1);
+	}
+	return(0 > blob_writer_add(bw, *filename, &loc, blobdata) ? -1 : 1);
+}
+/* }}} */
+
+/* blob_writer_finish() {{{
+ * Waits until all queued blobs are written. Returns 0 if all blobs
+ * could be written and -1 otherwise.
+ */
+int blob_writer_finish(struct blob_writer *bw) {
+	int i;
+
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&bw->lock);
+	for(i=0; i<BLOBWRITER_QUEUE; i++) {
+		while(bw->jobs[i].state == BLOBJOB_QUEUED || bw->jobs[i].state == BLOBJOB_BUSY)
+			pthread_cond_wait(&bw->done, &bw->lock);
+		if(bw->jobs[i].state == BLOBJOB_DONE)
+			free_job(bw, &(bw->jobs[i]));
+	}
+	pthread_mutex_unlock(&bw->lock);
+#else
+	for(i=0; i<BLOBWRITER_QUEUE; i++) {
+		if(bw->jobs[i].state != BLOBJOB_FREE)
+			free_job(bw, &(bw->jobs[i]));
+	}
+#endif
+	return(bw->failed > 0 ? -1 : 0);
+}
+/* }}} */
+
+/* blob_writer_delete() {{{
+ * Writes the remaining blobs, stops the threads and frees the writer.
+ */
+void blob_writer_delete(struct blob_writer *bw) {
+	pxdoc_t *pxdoc = bw->pxdoc;
+	int i;
+
+#ifdef HAVE_PTHREAD_H
+	if(bw->numworkers > 0) {
+		blob_writer_finish(bw);
+		pthread_mutex_lock(&bw->lock);
+		bw->closing = 1;
+		pthread_cond_broadcast(&bw->work);
+		pthread_mutex_unlock(&bw->lock);
+		for(i=0; i<bw->numworkers; i++)
+			pthread_join(bw->workers[i].thread, NULL);
+	}
+	if(bw->maxworkers > 0) {
+		pthread_mutex_destroy(&bw->lock);
+		pthread_cond_destroy(&bw->work);
+		pthread_cond_destroy(&bw->done);
+	}
+#else
+	blob_writer_finish(bw);
+#endif
+	if(bw->workers) {
+		for(i=0; i<bw->maxworkers; i++) {
+			if(bw->workers[i].chunk)
+				pxdoc->free(pxdoc, bw->workers[i].chunk);
+		}
+		pxdoc->free(pxdoc, bw->workers);
+	}
+	pxdoc->free(pxdoc, bw->chunk);
+	pxdoc->free(pxdoc, bw);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
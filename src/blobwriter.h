@@ -0,0 +1,71 @@
+#ifndef __BLOBWRITER_H__
+#define __BLOBWRITER_H__
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include "mbfile.h"
+#include "blobstore.h"
+
+/* Number of blobs waiting to be written */
+#define BLOBWRITER_QUEUE 64
+/* Size of the buffer for copying a blob without copy_file_range() */
+#define BLOBWRITER_CHUNK 65536
+
+#define BLOBJOB_FREE 0
+#define BLOBJOB_QUEUED 1
+#define BLOBJOB_BUSY 2
+#define BLOBJOB_DONE 3
+
+/* Blob to be written into a file of its own */
+struct blob_job {
+	int state;
+	char *filename;
+	char *buffer;           /* data if not copied from the blob file */
+	off_t offset;           /* position of data in blob file */
+	long size;
+};
+
+struct blob_writer;
+
+/* Thread writing blobs */
+struct blob_worker {
+	struct blob_writer *bw;
+	char *chunk;            /* buffer for copying */
+#ifdef HAVE_PTHREAD_H
+	pthread_t thread;
+#endif
+};
+
+/* Pool of threads writing blobs into files while the export goes on.
+ * Blobs are copied from the blob file to the target file without
+ * passing through the export.
+ */
+struct blob_writer {
+	pxdoc_t *pxdoc;
+	struct mbfile *mb;
+	char *chunk;            /* buffer for hashing blobs in the main thread */
+	struct blob_worker *workers;
+	int maxworkers;         /* number of allocated workers */
+	int numworkers;         /* number of running threads */
+	struct blob_job jobs[BLOBWRITER_QUEUE];
+	int queue[BLOBWRITER_QUEUE]; /* queued jobs in order of arrival */
+	int queuehead;
+	int queuecount;
+	int closing;
+	int failed;             /* number of blobs which could not be written */
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_t lock;
+	pthread_cond_t work;
+	pthread_cond_t done;
+#endif
+};
+
+struct blob_writer *blob_writer_new(pxdoc_t *pxdoc, struct mbfile *mb, int numworkers);
+void blob_writer_delete(struct blob_writer *bw);
+int blob_writer_add(struct blob_writer *bw, const char *filename, struct blob_location *loc, char *buffer);
+int blob_writer_field(struct blob_writer *bw, pxfield_t *pxf, char *fielddata, const char *filename);
+int blob_writer_store(struct blob_writer *bw, struct blob_store *bs, pxfield_t *pxf, char *fielddata, const char **filename);
+int blob_writer_finish(struct blob_writer *bw);
+
+#endif
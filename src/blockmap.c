@@ -0,0 +1,166 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "blockmap.h"
+
+/* blockmap_new() {{{
+ * Follows the chain of data blocks of a .DB file and records the
+ * position and number of records of each block. If withhash is set,
+ * the records of each block are read and fingerprinted as well.
+ * The file is read with plain stdio, because pxlib does not give
+ * access to the block headers. Encrypted files are not supported.
+ */
+struct blockmap *blockmap_new(pxdoc_t *pxdoc, FILE *fp, int withhash) {
+	struct blockmap *bm;
+	char *block = NULL;
+	char header[BLOCKHEADERSIZE];
+	float number;
+	int blockno, maxrecords, filetype, fileblocks;
+
+	if(pxdoc->px_head->px_encryption != 0) {
+		fprintf(stderr, _("Data blocks of encrypted files cannot be read directly."));
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	PX_get_value(pxdoc, "filetype", &number);
+	filetype = (int) number;
+	if((filetype != pxfFileTypIndexDB) &&
+	   (filetype != pxfFileTypNonIndexDB)) {
+		fprintf(stderr, _("Data blocks can only be read from DB files."));
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+
+	if(NULL == (bm = pxdoc->malloc(pxdoc, sizeof(struct blockmap), _("Allocate memory for block map.")))) {
+		return NULL;
+	}
+	PX_get_value(pxdoc, "headersize", &number);
+	bm->headersize = (int) number;
+	PX_get_value(pxdoc, "maxtablesize", &number);
+	bm->blocksize = (int) number * 0x400;
+	PX_get_value(pxdoc, "recordsize", &number);
+	bm->recordsize = (int) number;
+	bm->numblocks = 0;
+	bm->numrecords = 0;
+	bm->blocks = NULL;
+
+	/* Just to be save if the header is broken */
+	if(bm->recordsize <= 0 || bm->blocksize <= BLOCKHEADERSIZE) {
+		fprintf(stderr, _("Header contains invalid block or record size."));
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, bm);
+		return NULL;
+	}
+	maxrecords = (bm->blocksize - BLOCKHEADERSIZE) / bm->recordsize;
+	PX_get_value(pxdoc, "numblocks", &number);
+	fileblocks = (int) number;
+	PX_get_value(pxdoc, "firstblock", &number);
+	blockno = (int) number;
+
+	if(fileblocks > 0) {
+		if(NULL == (bm->blocks = pxdoc->malloc(pxdoc, fileblocks * sizeof(struct blockinfo), _("Allocate memory for block map.")))) {
+			pxdoc->free(pxdoc, bm);
+			return NULL;
+		}
+	}
+	if(withhash) {
+		if(NULL == (block = pxdoc->malloc(pxdoc, bm->blocksize, _("Allocate memory for data block.")))) {
+			blockmap_delete(pxdoc, bm);
+			return NULL;
+		}
+	}
+
+	while(blockno > 0 && bm->numblocks < fileblocks) {
+		struct blockinfo *bi = &(bm->blocks[bm->numblocks]);
+		short int adddatasize;
+
+		bi->number = blockno;
+		bi->blockpos = bm->headersize + (long) (blockno-1) * bm->blocksize;
+		if(0 != fseek(fp, bi->blockpos, SEEK_SET) ||
+		   1 != fread(header, BLOCKHEADERSIZE, 1, fp)) {
+			fprintf(stderr, _("Could not read header of data block %d."), blockno);
+			fprintf(stderr, "\n");
+			break;
+		}
+		bi->next = get_short_le(&header[0]);
+		bi->prev = get_short_le(&header[2]);
+		adddatasize = (short int) get_short_le(&header[4]);
+		bi->numrecords = adddatasize / bm->recordsize + 1;
+		if(bi->numrecords < 0)
+			bi->numrecords = 0;
+		if(bi->numrecords > maxrecords)
+			bi->numrecords = maxrecords;
+		bi->firstrecord = bm->numrecords;
+		bi->hash = 0;
+		if(withhash && bi->numrecords > 0) {
+			size_t len = bi->numrecords * bm->recordsize;
+			if(len != fread(block, 1, len, fp)) {
+				fprintf(stderr, _("Could not read data block %d."), blockno);
+				fprintf(stderr, "\n");
+				break;
+			}
+			bi->hash = hash_bytes(block, len, 0);
+		}
+		bm->numrecords += bi->numrecords;
+		bm->numblocks++;
+		blockno = bi->next;
+	}
+
+	if(block)
+		pxdoc->free(pxdoc, block);
+
+	if(blockno > 0) {
+		if(bm->numblocks == fileblocks) {
+			fprintf(stderr, _("Chain of data blocks is longer than the number of blocks in the header."));
+			fprintf(stderr, "\n");
+		}
+		blockmap_delete(pxdoc, bm);
+		return NULL;
+	}
+
+	return(bm);
+}
+/* }}} */
+
+/* blockmap_delete() {{{
+ * Frees the memory occupied by the block map
+ */
+void blockmap_delete(pxdoc_t *pxdoc, struct blockmap *bm) {
+	if(bm->blocks)
+		pxdoc->free(pxdoc, bm->blocks);
+	pxdoc->free(pxdoc, bm);
+}
+/* }}} */
+
+/* blockmap_find_record() {{{
+ * Returns the index of the block which contains the record with
+ * the given number or -1 if there is no such record.
+ */
+int blockmap_find_record(struct blockmap *bm, int recno) {
+	int lo = 0, hi = bm->numblocks-1;
+
+	if(recno < 0 || recno >= bm->numrecords)
+		return -1;
+	while(lo < hi) {
+		int mid = (lo + hi + 1) / 2;
+		if(bm->blocks[mid].firstrecord <= recno)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return(lo);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,33 @@
+#ifndef __BLOCKMAP_H__
+#define __BLOCKMAP_H__
+
+#include "hash.h"
+
+/* Information about a single data block as found in the block chain */
+struct blockinfo {
+	int number;      /* block number in file, starting at 1 */
+	int prev;        /* previous block according to block header */
+	int next;        /* next block according to block header */
+	int numrecords;  /* number of records in use */
+	int firstrecord; /* record number of first record in block */
+	long blockpos;   /* position of block in file */
+	px_hash_t hash;  /* fingerprint of the records in the block */
+};
+
+/* All data blocks of a .DB file in the order of the block chain */
+struct blockmap {
+	struct blockinfo *blocks;
+	int numblocks;
+	int blocksize;
+	int headersize;
+	int recordsize;
+	int numrecords;
+};
+
+#define BLOCKHEADERSIZE 6
+
+struct blockmap *blockmap_new(pxdoc_t *pxdoc, FILE *fp, int withhash);
+void blockmap_delete(pxdoc_t *pxdoc, struct blockmap *bm);
+int blockmap_find_record(struct blockmap *bm, int recno);
+
+#endif
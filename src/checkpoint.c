@@ -0,0 +1,228 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef WIN32
+#include <io.h>
+#endif
+#include "pxview_intern.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "# pxview checkpoint"
+
+/* checkpoint_new() {{{
+ * Creates a checkpoint for an export of a table with the given update
+ * time and number of data blocks. Nothing has been written yet.
+ */
+struct checkpoint *checkpoint_new(pxdoc_t *pxdoc, const char *filename, int updatetime, int numblocks) {
+	struct checkpoint *cp;
+
+	if(NULL == (cp = pxdoc->malloc(pxdoc, sizeof(struct checkpoint), _("Allocate memory for checkpoint.")))) {
+		return NULL;
+	}
+	if(NULL == (cp->filename = pxdoc->malloc(pxdoc, strlen(filename)+1, _("Allocate memory for file name.")))) {
+		pxdoc->free(pxdoc, cp);
+		return NULL;
+	}
+	strcpy(cp->filename, filename);
+	cp->updatetime = updatetime;
+	cp->numblocks = numblocks;
+	cp->doneblocks = 0;
+	cp->offset = 0;
+	cp->lastblock = -1;
+	cp->lastwrite = time(NULL);
+	return(cp);
+}
+/* }}} */
+
+/* checkpoint_delete() {{{
+ */
+void checkpoint_delete(pxdoc_t *pxdoc, struct checkpoint *cp) {
+	pxdoc->free(pxdoc, cp->filename);
+	pxdoc->free(pxdoc, cp);
+}
+/* }}} */
+
+/* checkpoint_read() {{{
+ * Reads the position of an interrupted export from the checkpoint file.
+ * Returns 1 if the export can be resumed, 0 if there is no checkpoint
+ * file and -1 on error or if the input file has changed since the
+ * checkpoint was written.
+ */
+int checkpoint_read(pxdoc_t *pxdoc, struct checkpoint *cp) {
+	FILE *fp;
+	char line[200];
+	int lineno = 0;
+	int updatetime = -1, numblocks = -1, doneblocks = -1;
+	long offset = -1;
+
+	if(NULL == (fp = fopen(cp->filename, "r"))) {
+		if(errno == ENOENT)
+			return 0;
+		fprintf(stderr, _("Could not open checkpoint file '%s'."), cp->filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+
+	while(fgets(line, sizeof(line), fp)) {
+		lineno++;
+		if(lineno == 1) {
+			if(strncmp(line, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC))) {
+				fprintf(stderr, _("File '%s' is not a checkpoint file."), cp->filename);
+				fprintf(stderr, "\n");
+				fclose(fp);
+				return -1;
+			}
+			continue;
+		}
+		if(1 == sscanf(line, "updatetime %d", &updatetime) ||
+		   1 == sscanf(line, "numblocks %d", &numblocks) ||
+		   1 == sscanf(line, "doneblocks %d", &doneblocks) ||
+		   1 == sscanf(line, "offset %ld", &offset))
+			continue;
+		fprintf(stderr, _("Line %d of checkpoint file '%s' is invalid."), lineno, cp->filename);
+		fprintf(stderr, "\n");
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	if(numblocks < 0 || doneblocks < 0 || doneblocks > numblocks || offset < 0) {
+		fprintf(stderr, _("Checkpoint file '%s' is incomplete."), cp->filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(updatetime != cp->updatetime || numblocks != cp->numblocks) {
+		fprintf(stderr, _("Input file has been modified since checkpoint '%s' was written."), cp->filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	cp->doneblocks = doneblocks;
+	cp->offset = offset;
+	return 1;
+}
+/* }}} */
+
+/* checkpoint_write() {{{
+ * Records that the first doneblocks blocks have been written and the
+ * output has a size of offset bytes. The caller must make sure that the
+ * output has been flushed or committed before. Like the block manifest
+ * the checkpoint is written to a temporary file first, so an
+ * interruption never leaves a half written checkpoint behind.
+ */
+int checkpoint_write(pxdoc_t *pxdoc, struct checkpoint *cp, int doneblocks, long offset) {
+	FILE *fp;
+	char *tmpname;
+
+	if(NULL == (tmpname = pxdoc->malloc(pxdoc, strlen(cp->filename)+5, _("Allocate memory for file name.")))) {
+		return -1;
+	}
+	sprintf(tmpname, "%s.tmp", cp->filename);
+	if(NULL == (fp = fopen(tmpname, "w"))) {
+		fprintf(stderr, _("Could not open checkpoint file '%s'."), tmpname);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, tmpname);
+		return -1;
+	}
+	fprintf(fp, "%s\n", CHECKPOINT_MAGIC);
+	fprintf(fp, "updatetime %d\n", cp->updatetime);
+	fprintf(fp, "numblocks %d\n", cp->numblocks);
+	fprintf(fp, "doneblocks %d\n", doneblocks);
+	fprintf(fp, "offset %ld\n", offset);
+	if(0 != fclose(fp) || 0 != rename(tmpname, cp->filename)) {
+		fprintf(stderr, _("Could not write checkpoint file '%s'."), cp->filename);
+		fprintf(stderr, "\n");
+		remove(tmpname);
+		pxdoc->free(pxdoc, tmpname);
+		return -1;
+	}
+	pxdoc->free(pxdoc, tmpname);
+
+	cp->doneblocks = doneblocks;
+	cp->offset = offset;
+	cp->lastwrite = time(NULL);
+	return 0;
+}
+/* }}} */
+
+/* checkpoint_write_file() {{{
+ * Flushes the output file and records its current size as the
+ * position after block doneblocks.
+ */
+int checkpoint_write_file(pxdoc_t *pxdoc, struct checkpoint *cp, int doneblocks, FILE *fp) {
+	if(0 != fflush(fp)) {
+		fprintf(stderr, _("Could not write output file."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return(checkpoint_write(pxdoc, cp, doneblocks, ftell(fp)));
+}
+/* }}} */
+
+/* checkpoint_due() {{{
+ * Must be called for every record before it is output, with the block
+ * curblock the record belongs to. Checks if a new checkpoint shall be
+ * written. This is only the case for the first record of a block,
+ * because the output contains just complete blocks at that point, and
+ * if the last checkpoint is old enough.
+ */
+int checkpoint_due(struct checkpoint *cp, int curblock) {
+	int newblock = (curblock != cp->lastblock);
+
+	cp->lastblock = curblock;
+	if(!newblock || curblock <= cp->doneblocks)
+		return 0;
+	return(time(NULL) - cp->lastwrite >= CHECKPOINT_INTERVAL);
+}
+/* }}} */
+
+/* checkpoint_remove() {{{
+ * Removes the checkpoint file after the export has been completed.
+ */
+void checkpoint_remove(struct checkpoint *cp) {
+	remove(cp->filename);
+}
+/* }}} */
+
+/* truncate_output() {{{
+ * Cuts off everything behind offset, which was written after the last
+ * checkpoint, and positions the file at its new end.
+ */
+int truncate_output(FILE *fp, long offset) {
+	if(0 != fseek(fp, 0, SEEK_END) || ftell(fp) < offset) {
+		fprintf(stderr, _("Output file is shorter than recorded in checkpoint."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+#ifdef WIN32
+	if(0 != _chsize(fileno(fp), offset)) {
+#else
+	if(0 != ftruncate(fileno(fp), offset)) {
+#endif
+		fprintf(stderr, _("Could not truncate output file."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(0 != fseek(fp, offset, SEEK_SET)) {
+		fprintf(stderr, _("Could not truncate output file."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
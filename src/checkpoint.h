@@ -0,0 +1,30 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdio.h>
+#include <time.h>
+
+/* Minimum number of seconds between two checkpoints */
+#define CHECKPOINT_INTERVAL 10
+
+/* Position of an export which can be resumed */
+struct checkpoint {
+	char *filename;
+	int updatetime;         /* update time of input file */
+	int numblocks;          /* number of blocks in block map */
+	int doneblocks;         /* number of blocks completely written */
+	long offset;            /* size of output file after doneblocks */
+	int lastblock;          /* block of the record passed last to checkpoint_due() */
+	time_t lastwrite;       /* time when checkpoint was last written */
+};
+
+struct checkpoint *checkpoint_new(pxdoc_t *pxdoc, const char *filename, int updatetime, int numblocks);
+void checkpoint_delete(pxdoc_t *pxdoc, struct checkpoint *cp);
+int checkpoint_read(pxdoc_t *pxdoc, struct checkpoint *cp);
+int checkpoint_write(pxdoc_t *pxdoc, struct checkpoint *cp, int doneblocks, long offset);
+int checkpoint_write_file(pxdoc_t *pxdoc, struct checkpoint *cp, int doneblocks, FILE *fp);
+int checkpoint_due(struct checkpoint *cp, int curblock);
+void checkpoint_remove(struct checkpoint *cp);
+int truncate_output(FILE *fp, long offset);
+
+#endif
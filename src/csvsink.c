@@ -0,0 +1,469 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pxview.h"
+#include "blobwriter.h"
+#include "sinkblobs.h"
+
+/* Sink writing comma separated values. Index files get four extra
+ * columns with the block information of each record and a last line
+ * with the total number of records.
+ */
+struct csv_sink {
+	struct pxview_sink sink;
+	pxdoc_t *allocdoc;      /* document used for allocating the sink */
+	FILE *outfp;
+	struct pxview_csv_options options;
+	char decimal_point;
+	int isindex;
+	int blob_count;         /* number of the next blob written to file */
+	struct sink_blobs blobs;
+	struct blob_writer *bw; /* writes blobs in the background if set */
+	char *blobname;         /* name of the current blob file */
+	int ireccounter;        /* sum of the count column of an index */
+	const char *data;       /* current record */
+	int isdeleted;
+	int blocknumber;
+	int first;              /* set when first field of record has been output */
+};
+
+/* csv_head_column() {{{
+ * Outputs the name of a column in the head line.
+ */
+static void csv_head_column(struct csv_sink *cs, const char *name, char type, int len) {
+	if(cs->first)
+		fprintf(cs->outfp, "%c", cs->options.delimiter);
+	if(cs->options.delimiter == ',')
+		fprintf(cs->outfp, "%c", cs->options.enclosure);
+	fprintf(cs->outfp, "%s", name);
+	if(type)
+		fprintf(cs->outfp, ",%c,%d", type, len);
+	if(cs->options.delimiter == ',')
+		fprintf(cs->outfp, "%c", cs->options.enclosure);
+	cs->first = 1;
+}
+/* }}} */
+
+/* csv_begin_table() {{{
+ */
+static int csv_begin_table(struct pxview_sink *sink) {
+	struct csv_sink *cs = sink->user;
+	pxfield_t *pxf;
+	float filetype;
+	int i;
+
+	PX_get_value(sink->pxdoc, "filetype", &filetype);
+	cs->isindex = ((int) filetype == pxfFileTypPrimIndex) ||
+	              ((int) filetype == pxfFileTypSecIndex) ||
+	              ((int) filetype == pxfFileTypSecIndexG);
+	if(0 > sink_blobs_open(&cs->blobs, sink->pxdoc, cs->options.blobprefix, cs->options.blobextension,
+	                       cs->options.blobstore, cs->options.blobfile, cs->options.streamthreshold,
+	                       cs->options.blobwriters > 0))
+		return -1;
+	if(cs->options.blobwriters > 0 && NULL == cs->bw) {
+		pxdoc_t *pxdoc = sink->pxdoc;
+		if(NULL == (cs->blobname = pxdoc->malloc(pxdoc, strlen(cs->options.blobprefix)+strlen(cs->options.blobextension)+20, _("Allocate memory for name of blob file.")))) {
+			return -1;
+		}
+		if(NULL == (cs->bw = blob_writer_new(pxdoc, cs->blobs.mb, cs->options.blobwriters))) {
+			return -1;
+		}
+	}
+	if(!cs->options.withhead)
+		return(0);
+
+	cs->first = 0;
+	pxf = sink->fields;
+	for(i=0; i<sink->numfields; i++, pxf++) {
+		char colname[30];
+		if(sink->selectedfields && !sink->selectedfields[i])
+			continue;
+		sprintf(colname, "column%d", i+1);
+		csv_head_column(cs, strlen(pxf->px_fname) ? pxf->px_fname : colname,
+		                field_type_code(pxf->px_ftype),
+		                pxf->px_ftype == pxfBCD ? pxf->px_fdc : pxf->px_flen);
+	}
+	if(cs->isindex) {
+		csv_head_column(cs, "blocknr,S,2", '\0', 0);
+		csv_head_column(cs, "count,S,2", '\0', 0);
+		csv_head_column(cs, "dummy,S,2", '\0', 0);
+		csv_head_column(cs, "thisblocknr,S,2", '\0', 0);
+	}
+	if(cs->options.markdeleted) {
+		if(cs->options.delimiter == ',')
+			fprintf(cs->outfp, "%c", cs->options.enclosure);
+		fprintf(cs->outfp, "%cdeleted,L,1", cs->options.delimiter);
+		if(cs->options.delimiter == ',')
+			fprintf(cs->outfp, "%c", cs->options.enclosure);
+	}
+	fprintf(cs->outfp, "\n");
+	return(0);
+}
+/* }}} */
+
+/* csv_begin_record() {{{
+ */
+static int csv_begin_record(struct pxview_sink *sink, int recno, const char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	struct csv_sink *cs = sink->user;
+
+	cs->data = data;
+	cs->isdeleted = isdeleted;
+	cs->blocknumber = pxdbinfo ? pxdbinfo->number : 0;
+	cs->first = 0;
+	return(0);
+}
+/* }}} */
+
+/* csv_separator() {{{
+ * Outputs the delimiter in front of every field but the first one.
+ */
+static void csv_separator(struct csv_sink *cs) {
+	if(cs->first)
+		fprintf(cs->outfp, "%c", cs->options.delimiter);
+	cs->first = 1;
+}
+/* }}} */
+
+/* csv_field_null() {{{
+ */
+static int csv_field_null(struct pxview_sink *sink, int field, pxfield_t *pxf) {
+	csv_separator(sink->user);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_string() {{{
+ * Outputs a string, which is enclosed if it contains the delimiter, a
+ * line break or the enclosure. The enclosure itself is doubled.
+ */
+static int csv_field_string(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value, int len) {
+	struct csv_sink *cs = sink->user;
+	char delimiter = cs->options.delimiter;
+	char enclosure = cs->options.enclosure;
+	int i, needsenclosure = 0;
+
+	csv_separator(cs);
+	for(i=0; i<len && needsenclosure==0; i++) {
+		if(value[i] == delimiter ||
+		   value[i] == '\n' ||
+		   value[i] == '\r' ||
+		   (enclosure && value[i] == enclosure))
+			needsenclosure = 1;
+	}
+	if(enclosure && needsenclosure) {
+		fputc(enclosure, cs->outfp);
+		for(i=0; i<len; i++) {
+			if(value[i] == enclosure)
+				fputc(enclosure, cs->outfp);
+			fputc(value[i], cs->outfp);
+		}
+		fputc(enclosure, cs->outfp);
+	} else {
+		fwrite(value, 1, len, cs->outfp);
+	}
+	return(0);
+}
+/* }}} */
+
+/* csv_field_long() {{{
+ */
+static int csv_field_long(struct pxview_sink *sink, int field, pxfield_t *pxf, long value) {
+	struct csv_sink *cs = sink->user;
+
+	csv_separator(cs);
+	fprintf(cs->outfp, "%ld", value);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_double() {{{
+ * Outputs a number, which is enclosed if the delimiter is the decimal
+ * point.
+ */
+static int csv_field_double(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct csv_sink *cs = sink->user;
+	char enclosure = cs->options.enclosure;
+
+	csv_separator(cs);
+	if(cs->decimal_point == cs->options.delimiter)
+		fprintf(cs->outfp, "%c%lf%c", enclosure, value, enclosure);
+	else
+		fprintf(cs->outfp, "%lf", value);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_bool() {{{
+ */
+static int csv_field_bool(struct pxview_sink *sink, int field, pxfield_t *pxf, int value) {
+	struct csv_sink *cs = sink->user;
+
+	csv_separator(cs);
+	fprintf(cs->outfp, "%d", value ? 1 : 0);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_timestamp() {{{
+ */
+static int csv_field_timestamp(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct csv_sink *cs = sink->user;
+	const char *format;
+	char *str;
+
+	csv_separator(cs);
+	switch(pxf->px_ftype) {
+		case pxfDate:
+			format = cs->options.date_format;
+			break;
+		case pxfTime:
+			format = cs->options.time_format;
+			break;
+		default:
+			format = cs->options.timestamp_format;
+	}
+	str = PX_timestamp2string(sink->pxdoc, value, format);
+	fprintf(cs->outfp, "%s", str);
+	sink->pxdoc->free(sink->pxdoc, str);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_bcd() {{{
+ */
+static int csv_field_bcd(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value) {
+	struct csv_sink *cs = sink->user;
+	char enclosure = cs->options.enclosure;
+
+	csv_separator(cs);
+	if(cs->decimal_point == cs->options.delimiter)
+		fprintf(cs->outfp, "%c%s%c", enclosure, value, enclosure);
+	else
+		fprintf(cs->outfp, "%s", value);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_blob() {{{
+ * Writes the blob into a file of its own or into the blob store and
+ * outputs the file name.
+ */
+static int csv_field_blob(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int size, int number) {
+	struct csv_sink *cs = sink->user;
+	char *filename;
+
+	csv_separator(cs);
+	if(NULL != (filename = sink_blobs_file(&cs->blobs, data, size, cs->blob_count++))) {
+		fprintf(cs->outfp, "%s", filename);
+		sink->pxdoc->free(sink->pxdoc, filename);
+	}
+	return(0);
+}
+/* }}} */
+
+/* csv_stream_string() {{{
+ * Outputs a large memo in pieces. Since it cannot be checked in advance
+ * whether the memo needs to be enclosed, it is always enclosed.
+ */
+static void csv_stream_string(struct csv_sink *cs, struct blob_location *loc) {
+	char enclosure = cs->options.enclosure;
+
+	if(enclosure)
+		fputc(enclosure, cs->outfp);
+	blob_stream_copy(cs->blobs.stream, loc, cs->outfp, enclosure, enclosure);
+	if(enclosure)
+		fputc(enclosure, cs->outfp);
+}
+/* }}} */
+
+/* csv_field_blobref() {{{
+ * Copies large blobs in pieces and queues other blobs for the blob
+ * writer. Memos not copied in pieces are left to csv_field_string().
+ */
+static int csv_field_blobref(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data) {
+	struct csv_sink *cs = sink->user;
+	struct blob_location loc;
+	const char *filename;
+	char *name;
+	int ret;
+
+	if(sink_blobs_locate(&cs->blobs, pxf, data, &loc)) {
+		csv_separator(cs);
+		if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
+			csv_stream_string(cs, &loc);
+		} else if(NULL != (name = sink_blobs_stream_file(&cs->blobs, &loc, cs->blob_count++))) {
+			fprintf(cs->outfp, "%s", name);
+			sink->pxdoc->free(sink->pxdoc, name);
+		}
+		return(0);
+	}
+	if(NULL == cs->bw || pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb)
+		return(1);
+
+	csv_separator(cs);
+	if(cs->blobs.store) {
+		if(0 < blob_writer_store(cs->bw, cs->blobs.store, pxf, data, &filename))
+			fprintf(cs->outfp, "%s", filename);
+		return(0);
+	}
+	sprintf(cs->blobname, "%s_%d.%s", cs->options.blobprefix, cs->blob_count, cs->options.blobextension);
+	if(0 == (ret = blob_writer_field(cs->bw, pxf, data, cs->blobname)))
+		return(0);
+	cs->blob_count++;
+	if(ret > 0)
+		fprintf(cs->outfp, "%s", cs->blobname);
+	return(0);
+}
+/* }}} */
+
+/* csv_field_bytes() {{{
+ */
+static int csv_field_bytes(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int len) {
+	struct csv_sink *cs = sink->user;
+
+	csv_separator(cs);
+	hex_dump(cs->outfp, (char *) data, len);
+	return(0);
+}
+/* }}} */
+
+/* csv_end_record() {{{
+ * Outputs the block information of an index record and the deletion
+ * flag.
+ */
+static int csv_end_record(struct pxview_sink *sink) {
+	struct csv_sink *cs = sink->user;
+	char delimiter = cs->options.delimiter;
+
+	if(cs->isindex) {
+		pxfield_t *pxf = sink->fields;
+		int i, offset = 0;
+		short int value;
+		for(i=0; i<sink->numfields; i++)
+			offset += pxf[i].px_flen;
+		if(0 < PX_get_data_short(sink->pxdoc, (char *) &cs->data[offset], 2, &value))
+			fprintf(cs->outfp, "%c%d", delimiter, value);
+		offset += 2;
+		if(0 < PX_get_data_short(sink->pxdoc, (char *) &cs->data[offset], 2, &value)) {
+			fprintf(cs->outfp, "%c%d", delimiter, value);
+			cs->ireccounter += value;
+		}
+		offset += 2;
+		if(0 < PX_get_data_short(sink->pxdoc, (char *) &cs->data[offset], 2, &value))
+			fprintf(cs->outfp, "%c%d", delimiter, value);
+		fprintf(cs->outfp, "%c%d", delimiter, cs->blocknumber);
+	}
+	if(cs->options.markdeleted)
+		fprintf(cs->outfp, "%c%d", delimiter, cs->isdeleted);
+	fprintf(cs->outfp, "\n");
+	return(0);
+}
+/* }}} */
+
+/* csv_end_table() {{{
+ * Outputs the sum over all records of an index.
+ */
+static int csv_end_table(struct pxview_sink *sink) {
+	struct csv_sink *cs = sink->user;
+	char delimiter = cs->options.delimiter;
+	int i;
+
+	if(cs->isindex) {
+		for(i=0; i<sink->numfields; i++)
+			fprintf(cs->outfp, "%c", delimiter);
+		fprintf(cs->outfp, "%c%d%c\n", delimiter, cs->ireccounter, delimiter);
+	}
+	if(cs->bw && 0 > blob_writer_finish(cs->bw))
+		return(-1);
+	return(0);
+}
+/* }}} */
+
+/* csv_destroy() {{{
+ */
+static void csv_destroy(struct pxview_sink *sink) {
+	struct csv_sink *cs = sink->user;
+
+	if(cs->bw)
+		blob_writer_delete(cs->bw);
+	sink_blobs_close(&cs->blobs);
+	if(cs->blobname)
+		sink->pxdoc->free(sink->pxdoc, cs->blobname);
+	cs->allocdoc->free(cs->allocdoc, cs);
+}
+/* }}} */
+
+/* pxview_csv_sink_new() {{{
+ * Creates a sink writing comma separated values into outfp. pxdoc is
+ * only used for allocating memory. Returns NULL on failure.
+ */
+struct pxview_sink *pxview_csv_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_csv_options *options) {
+	struct csv_sink *cs;
+#ifdef HAVE_LOCALE_H
+	struct lconv *lc;
+#endif
+
+	if(NULL == (cs = pxdoc->malloc(pxdoc, sizeof(struct csv_sink), _("Allocate memory for csv output.")))) {
+		return NULL;
+	}
+	memset(cs, 0, sizeof(struct csv_sink));
+	cs->allocdoc = pxdoc;
+	cs->outfp = outfp;
+	cs->options = *options;
+	if(!cs->options.blobprefix)
+		cs->options.blobprefix = "blob";
+	if(!cs->options.blobextension)
+		cs->options.blobextension = "blob";
+	if(!cs->options.date_format)
+		cs->options.date_format = "Y-m-d";
+	if(!cs->options.time_format)
+		cs->options.time_format = "H:i:s";
+	if(!cs->options.timestamp_format)
+		cs->options.timestamp_format = "Y-m-d H:i:s";
+#ifdef HAVE_LOCALE_H
+	lc = localeconv();
+	cs->decimal_point = lc->decimal_point[0];
+#else
+	cs->decimal_point = '.';
+#endif
+	cs->blob_count = 1;
+	cs->sink.user = cs;
+	cs->sink.pxdoc = pxdoc;
+	cs->sink.begin_table = csv_begin_table;
+	cs->sink.begin_record = csv_begin_record;
+	cs->sink.field_null = csv_field_null;
+	cs->sink.field_string = csv_field_string;
+	cs->sink.field_long = csv_field_long;
+	cs->sink.field_double = csv_field_double;
+	cs->sink.field_bool = csv_field_bool;
+	cs->sink.field_timestamp = csv_field_timestamp;
+	cs->sink.field_bcd = csv_field_bcd;
+	cs->sink.field_blob = csv_field_blob;
+	if(cs->options.blobwriters > 0 || (cs->options.blobfile && cs->options.streamthreshold > 0))
+		cs->sink.field_blobref = csv_field_blobref;
+	cs->sink.field_bytes = csv_field_bytes;
+	cs->sink.end_record = csv_end_record;
+	cs->sink.end_table = csv_end_table;
+	cs->sink.destroy = csv_destroy;
+	return(&cs->sink);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,251 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "hash.h"
+#include "recordsort.h"
+#include "dedupe.h"
+
+/* The primary key fields are always the first fields of a record, so
+ * the key is just the beginning of the record. If the set of keys of
+ * all records fits into memory, keeping the first record of each key
+ * needs no more than the output pass itself. Otherwise, and for keeping
+ * the last record, the duplicates are determined in a pass before the
+ * output and marked in a bitmap with one bit per record. A set which
+ * does not fit into memory is replaced by sorting the records by key.
+ */
+
+/* record_dedupe_new() {{{
+ * Creates a filter which keeps the first or the last (mode) of all
+ * records whose first primarykeyfields fields are equal. memory is
+ * the maximum size of the set of keys in MB.
+ */
+struct record_dedupe *record_dedupe_new(pxdoc_t *pxdoc, int mode, int primarykeyfields, int memory) {
+	struct record_dedupe *dd;
+	pxfield_t *pxf = PX_get_fields(pxdoc);
+	int i;
+
+	if(NULL == (dd = pxdoc->malloc(pxdoc, sizeof(struct record_dedupe), _("Allocate memory for removing duplicates.")))) {
+		return NULL;
+	}
+	memset(dd, 0, sizeof(struct record_dedupe));
+	dd->pxdoc = pxdoc;
+	dd->mode = mode;
+	dd->memory = memory > 0 ? memory : DEDUPE_MEMORY;
+	for(i=0; i<primarykeyfields; i++)
+		dd->keylen += pxf[i].px_flen;
+	dd->slotsize = sizeof(int) + dd->keylen;
+	return(dd);
+}
+/* }}} */
+
+/* reset() {{{
+ * Frees the set and the bitmap of a previous pass.
+ */
+static void reset(struct record_dedupe *dd) {
+	pxdoc_t *pxdoc = dd->pxdoc;
+
+	if(dd->slots)
+		pxdoc->free(pxdoc, dd->slots);
+	dd->slots = NULL;
+	dd->numslots = 0;
+	if(dd->dropped)
+		pxdoc->free(pxdoc, dd->dropped);
+	dd->dropped = NULL;
+	dd->numdropped = 0;
+}
+/* }}} */
+
+/* record_dedupe_delete() {{{
+ */
+void record_dedupe_delete(struct record_dedupe *dd) {
+	reset(dd);
+	dd->pxdoc->free(dd->pxdoc, dd);
+}
+/* }}} */
+
+/* find_slot() {{{
+ * Returns the slot with the key of the record or the empty slot where
+ * it has to be inserted. Empty slots have the record number -1.
+ */
+static char *find_slot(struct record_dedupe *dd, const char *data) {
+	size_t mask = dd->numslots - 1;
+	size_t i = (size_t) hash_bytes(data, dd->keylen, 0) & mask;
+	int recno;
+
+	for(;;) {
+		char *slot = dd->slots + i * dd->slotsize;
+		memcpy(&recno, slot, sizeof(int));
+		if(recno < 0 || 0 == memcmp(slot + sizeof(int), data, dd->keylen))
+			return(slot);
+		i = (i + 1) & mask;
+	}
+}
+/* }}} */
+
+/* drop() {{{
+ */
+static void drop(struct record_dedupe *dd, int recno, int otherrecno) {
+	fprintf(stderr, _("Record %d has the same primary key as record %d and is not output."), recno, otherrecno);
+	fprintf(stderr, "\n");
+	if(dd->dropped && recno < dd->numrecords)
+		dd->dropped[recno/8] |= 1 << (recno%8);
+	dd->numdropped++;
+}
+/* }}} */
+
+/* add_key() {{{
+ * Puts the key of the record into the set. Returns 0 if the key is new
+ * and 1 if it was already in the set.
+ */
+static int add_key(struct record_dedupe *dd, int recno, const char *data) {
+	char *slot = find_slot(dd, data);
+	int oldrecno;
+
+	memcpy(&oldrecno, slot, sizeof(int));
+	if(oldrecno < 0) {
+		memcpy(slot, &recno, sizeof(int));
+		memcpy(slot + sizeof(int), data, dd->keylen);
+		return 0;
+	}
+	if(dd->mode == DEDUPE_LAST) {
+		drop(dd, oldrecno, recno);
+		memcpy(slot, &recno, sizeof(int));
+	} else {
+		drop(dd, recno, oldrecno);
+	}
+	return 1;
+}
+/* }}} */
+
+/* find_by_sorting() {{{
+ * Sorts the records by key and marks all but the first or the last
+ * record of each key as duplicate.
+ */
+static int find_by_sorting(struct record_dedupe *dd, struct record_iter *iter, char *data) {
+	pxdoc_t *pxdoc = dd->pxdoc;
+	struct record_sort *sort;
+	char *key;
+	int *fields, numfields, i, ret, recno, deleted, keyrecno = -1;
+
+	for(numfields=0, i=0; i<dd->keylen; i+=PX_get_fields(pxdoc)[numfields++].px_flen)
+		;
+	if(NULL == (fields = pxdoc->malloc(pxdoc, numfields * sizeof(int), _("Allocate memory for removing duplicates.")))) {
+		return -1;
+	}
+	for(i=0; i<numfields; i++)
+		fields[i] = i;
+	sort = record_sort_new(pxdoc, fields, numfields, dd->memory);
+	pxdoc->free(pxdoc, fields);
+	if(NULL == sort)
+		return -1;
+	if(NULL == (key = pxdoc->malloc(pxdoc, dd->keylen, _("Allocate memory for removing duplicates.")))) {
+		record_sort_delete(sort);
+		return -1;
+	}
+
+	while(0 != (ret = record_iter_next(iter, &recno, data, &deleted, NULL))) {
+		if(0 > ret) {
+			fprintf(stderr, _("Couldn't get record number %d\n"), recno);
+			continue;
+		}
+		if(0 > record_sort_add(sort, recno, deleted, data)) {
+			record_sort_delete(sort);
+			pxdoc->free(pxdoc, key);
+			return -1;
+		}
+	}
+	if(0 > record_sort_finish(sort)) {
+		record_sort_delete(sort);
+		pxdoc->free(pxdoc, key);
+		return -1;
+	}
+
+	/* Records with equal keys stay in their original order */
+	while(0 < (ret = record_sort_next(sort, &recno, &deleted, data))) {
+		if(keyrecno < 0 || memcmp(key, data, dd->keylen)) {
+			memcpy(key, data, dd->keylen);
+		} else if(dd->mode == DEDUPE_LAST) {
+			drop(dd, keyrecno, recno);
+		} else {
+			drop(dd, recno, keyrecno);
+			continue;
+		}
+		keyrecno = recno;
+	}
+	record_sort_delete(sort);
+	pxdoc->free(pxdoc, key);
+	return(ret);
+}
+/* }}} */
+
+/* record_dedupe_start() {{{
+ * Prepares removing duplicates from the records returned by iter, which
+ * has not been used yet. If needed the records are read once to find
+ * the duplicates. data must be large enough for one record. Returns 0
+ * on success and -1 on error.
+ */
+int record_dedupe_start(struct record_dedupe *dd, struct record_iter *iter, char *data) {
+	pxdoc_t *pxdoc = dd->pxdoc;
+	struct record_iter prepass;
+	int recno, ret;
+
+	reset(dd);
+	dd->numrecords = iter->numrecords;
+	dd->numslots = 16;
+	while(dd->numslots < 2 * (size_t) iter->numrecords)
+		dd->numslots *= 2;
+	if(dd->numslots * dd->slotsize <= (size_t) dd->memory * 1024 * 1024) {
+		if(NULL == (dd->slots = pxdoc->malloc(pxdoc, dd->numslots * dd->slotsize, _("Allocate memory for removing duplicates.")))) {
+			return -1;
+		}
+		memset(dd->slots, 0xff, dd->numslots * dd->slotsize);
+		if(dd->mode == DEDUPE_FIRST)
+			return 0;
+	} else {
+		dd->numslots = 0;
+	}
+
+	if(NULL == (dd->dropped = pxdoc->malloc(pxdoc, dd->numrecords/8+1, _("Allocate memory for removing duplicates.")))) {
+		reset(dd);
+		return -1;
+	}
+	memset(dd->dropped, 0, dd->numrecords/8+1);
+	/* Progress is reported only once the records are output */
+	prepass = *iter;
+	prepass.progress = NULL;
+	if(NULL == dd->slots)
+		return(find_by_sorting(dd, &prepass, data));
+
+	while(0 != (ret = record_iter_next(&prepass, &recno, data, NULL, NULL))) {
+		if(0 < ret)
+			add_key(dd, recno, data);
+	}
+	pxdoc->free(pxdoc, dd->slots);
+	dd->slots = NULL;
+	return 0;
+}
+/* }}} */
+
+/* record_dedupe_keep() {{{
+ * Checks if a record shall be output. Returns 1 if it shall be output
+ * and 0 if it is a duplicate.
+ */
+int record_dedupe_keep(struct record_dedupe *dd, int recno, const char *data) {
+	if(dd->dropped)
+		return(recno >= dd->numrecords || !(dd->dropped[recno/8] & (1 << (recno%8))));
+	return(!add_key(dd, recno, data));
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,35 @@
+#ifndef __DEDUPE_H__
+#define __DEDUPE_H__
+
+#include "recorditer.h"
+
+#define DEDUPE_FIRST 1
+#define DEDUPE_LAST  2
+
+/* Default amount of memory for the set of keys in MB */
+#define DEDUPE_MEMORY 64
+
+/* Drops records whose primary key equals the key of another record.
+ * Either the first or the last of these records is kept.
+ */
+struct record_dedupe {
+	pxdoc_t *pxdoc;
+	int mode;
+	int keylen;             /* length of primary key fields at start of record */
+	int memory;             /* maximum size of the set of keys in MB */
+	/* set of keys, each slot has the record number and the key */
+	char *slots;
+	size_t slotsize;
+	size_t numslots;        /* always a power of 2 */
+	/* records which have been found to be duplicates before */
+	unsigned char *dropped;
+	int numrecords;
+	long numdropped;
+};
+
+struct record_dedupe *record_dedupe_new(pxdoc_t *pxdoc, int mode, int primarykeyfields, int memory);
+void record_dedupe_delete(struct record_dedupe *dd);
+int record_dedupe_start(struct record_dedupe *dd, struct record_iter *iter, char *data);
+int record_dedupe_keep(struct record_dedupe *dd, int recno, const char *data);
+
+#endif
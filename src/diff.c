@@ -0,0 +1,450 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "diff.h"
+#include "blockmap.h"
+#include "recorditer.h"
+#include "hashtable.h"
+#include "json.h"
+
+/* State shared by the functions writing the change events */
+struct diff_state {
+	pxdoc_t *pxdoc;
+	pxdoc_t *olddoc;
+	pxfield_t *fields;
+	int numfields;
+	int numkeyfields;
+	struct str_buffer *sb;
+	FILE *outfp;
+	struct diff_options *opts;
+};
+
+struct block_order {
+	px_hash_t hash;
+	int numrecords;
+	int index;
+};
+
+/* compare_block_order() {{{
+ */
+static int compare_block_order(const void *a, const void *b) {
+	const struct block_order *ba = a, *bb = b;
+	if(ba->hash != bb->hash)
+		return(ba->hash < bb->hash ? -1 : 1);
+	if(ba->numrecords != bb->numrecords)
+		return(ba->numrecords - bb->numrecords);
+	return(ba->index - bb->index);
+}
+/* }}} */
+
+/* sort_blocks() {{{
+ * Returns the blocks of a block map sorted by their fingerprint
+ */
+static struct block_order *sort_blocks(pxdoc_t *pxdoc, struct blockmap *bm) {
+	struct block_order *bo;
+	int i;
+
+	if(NULL == (bo = pxdoc->malloc(pxdoc, (bm->numblocks+1) * sizeof(struct block_order), _("Allocate memory for list of blocks.")))) {
+		return NULL;
+	}
+	for(i=0; i<bm->numblocks; i++) {
+		bo[i].hash = bm->blocks[i].hash;
+		bo[i].numrecords = bm->blocks[i].numrecords;
+		bo[i].index = i;
+	}
+	qsort(bo, bm->numblocks, sizeof(struct block_order), compare_block_order);
+	return(bo);
+}
+/* }}} */
+
+/* match_blocks() {{{
+ * Finds blocks with identical content in both tables. The flags in
+ * oldchanged and newchanged are cleared for those blocks, because
+ * their records need not be compared. Blocks are matched by content,
+ * not by block number, because the block number of records may change.
+ * Returns the number of identical blocks or -1 on error.
+ */
+static int match_blocks(pxdoc_t *pxdoc, struct blockmap *oldbm, char *oldchanged, struct blockmap *newbm, char *newchanged) {
+	struct block_order *oldbo, *newbo;
+	int i = 0, j = 0, identical = 0;
+
+	if(NULL == (oldbo = sort_blocks(pxdoc, oldbm)))
+		return -1;
+	if(NULL == (newbo = sort_blocks(pxdoc, newbm))) {
+		pxdoc->free(pxdoc, oldbo);
+		return -1;
+	}
+	while(i < oldbm->numblocks && j < newbm->numblocks) {
+		if(oldbo[i].hash == newbo[j].hash && oldbo[i].numrecords == newbo[j].numrecords) {
+			oldchanged[oldbo[i].index] = 0;
+			newchanged[newbo[j].index] = 0;
+			identical++;
+			i++;
+			j++;
+		} else if(oldbo[i].hash < newbo[j].hash ||
+		          (oldbo[i].hash == newbo[j].hash && oldbo[i].numrecords < newbo[j].numrecords)) {
+			i++;
+		} else {
+			j++;
+		}
+	}
+	pxdoc->free(pxdoc, oldbo);
+	pxdoc->free(pxdoc, newbo);
+	return(identical);
+}
+/* }}} */
+
+/* is_selected() {{{
+ */
+static int is_selected(struct diff_state *ds, int i) {
+	return(i < ds->numkeyfields || ds->opts->selectedfields == NULL || ds->opts->selectedfields[i]);
+}
+/* }}} */
+
+/* print_fields() {{{
+ * Appends a list of fields and its values. In sql the list looks like
+ * 'name=value' joined by sep, in JSON it is an object. Only fields
+ * from first to last-1 whose flag in mask is set are printed.
+ * datadoc is the document the record was read from. If the list is
+ * the condition of a WHERE clause, NULL values are compared with
+ * 'name IS NULL', because 'name=NULL' never matches.
+ */
+static void print_fields(struct diff_state *ds, pxdoc_t *datadoc, char *data, char *mask, int first, int last, const char *sep, int iswhere) {
+	pxdoc_t *pxdoc = ds->pxdoc;
+	struct str_buffer *sb = ds->sb;
+	int format = ds->opts->format;
+	int i, offset = 0, isfirst = 1;
+	size_t valuepos;
+
+	if(format == FORMAT_JSON)
+		str_buffer_append(pxdoc, sb, "{", 1);
+	for(i=0; i<ds->numfields; i++) {
+		pxfield_t *pxf = &(ds->fields[i]);
+		if(i >= first && i < last && (mask == NULL || mask[i])) {
+			if(!isfirst)
+				str_buffer_append(pxdoc, sb, sep, strlen(sep));
+			format_fieldname(pxdoc, sb, pxf, i, format, ds->opts->fo);
+			str_buffer_append(pxdoc, sb, format == FORMAT_JSON ? ":" : "=", 1);
+			valuepos = str_buffer_len(pxdoc, sb);
+			if(0 > format_field(datadoc, sb, pxf, &data[offset], format, ds->opts->fo)) {
+				fprintf(stderr, _("Error while reading data of field number %d"), i+1);
+				fprintf(stderr, "\n");
+			}
+			/* Strings are quoted, so only a NULL value is output as NULL */
+			if(iswhere && str_buffer_len(pxdoc, sb) == valuepos+4 &&
+			   !strcmp(str_buffer_get(pxdoc, sb)+valuepos, "NULL")) {
+				str_buffer_truncate(pxdoc, sb, valuepos-1);
+				str_buffer_append(pxdoc, sb, " IS NULL", 8);
+			}
+			isfirst = 0;
+		}
+		offset += pxf->px_flen;
+	}
+	if(format == FORMAT_JSON)
+		str_buffer_append(pxdoc, sb, "}", 1);
+}
+/* }}} */
+
+/* print_event() {{{
+ * Outputs an insert, update or delete. olddata is NULL for inserts,
+ * newdata is NULL for deletes.
+ * Returns 0 on success or -1 on error.
+ */
+static int print_event(struct diff_state *ds, char *olddata, char *newdata) {
+	pxdoc_t *pxdoc = ds->pxdoc;
+	struct str_buffer *sb = ds->sb;
+	char *mask = NULL, *op;
+	int i, offset;
+
+	str_buffer_clear(pxdoc, sb);
+	if(olddata && newdata) {
+		/* Only fields whose value has changed are updated */
+		if(NULL == (mask = pxdoc->malloc(pxdoc, ds->numfields, _("Allocate memory for list of changed fields.")))) {
+			return -1;
+		}
+		offset = 0;
+		for(i=0; i<ds->numfields; i++) {
+			int len = ds->fields[i].px_flen;
+			mask[i] = is_selected(ds, i) && memcmp(&olddata[offset], &newdata[offset], len);
+			offset += len;
+		}
+		op = "update";
+		for(i=0; i<ds->numfields && !mask[i]; i++)
+			;
+		/* Nothing to output if only fields have changed which are
+		 * not selected.
+		 */
+		if(i == ds->numfields) {
+			pxdoc->free(pxdoc, mask);
+			return 0;
+		}
+	} else if(newdata) {
+		if(NULL == (mask = pxdoc->malloc(pxdoc, ds->numfields, _("Allocate memory for list of changed fields.")))) {
+			return -1;
+		}
+		for(i=0; i<ds->numfields; i++)
+			mask[i] = is_selected(ds, i);
+		op = "insert";
+	} else {
+		op = "delete";
+	}
+
+	if(ds->opts->format == FORMAT_JSON) {
+		str_buffer_print(pxdoc, sb, "{\"op\":\"%s\",\"table\":", op);
+		str_buffer_print_json(pxdoc, sb, ds->opts->tablename, strlen(ds->opts->tablename));
+		str_buffer_print(pxdoc, sb, ",\"key\":");
+		if(newdata)
+			print_fields(ds, pxdoc, newdata, NULL, 0, ds->numkeyfields, ",", 0);
+		else
+			print_fields(ds, ds->olddoc, olddata, NULL, 0, ds->numkeyfields, ",", 0);
+		if(newdata) {
+			str_buffer_print(pxdoc, sb, ",\"data\":");
+			print_fields(ds, pxdoc, newdata, mask, 0, ds->numfields, ",", 0);
+		}
+		if(olddata && newdata) {
+			str_buffer_print(pxdoc, sb, ",\"old\":");
+			print_fields(ds, ds->olddoc, olddata, mask, 0, ds->numfields, ",", 0);
+		}
+		str_buffer_print(pxdoc, sb, "}\n");
+	} else if(olddata && newdata) {
+		str_buffer_print(pxdoc, sb, "UPDATE %s SET ", ds->opts->tablename);
+		print_fields(ds, pxdoc, newdata, mask, 0, ds->numfields, ", ", 0);
+		str_buffer_print(pxdoc, sb, " WHERE ");
+		print_fields(ds, ds->olddoc, olddata, NULL, 0, ds->numkeyfields, " AND ", 1);
+		str_buffer_print(pxdoc, sb, ";\n");
+	} else if(newdata) {
+		int isfirst = 1;
+		str_buffer_print(pxdoc, sb, "INSERT INTO %s (", ds->opts->tablename);
+		for(i=0; i<ds->numfields; i++) {
+			if(mask[i]) {
+				if(!isfirst)
+					str_buffer_append(pxdoc, sb, ", ", 2);
+				format_fieldname(pxdoc, sb, &(ds->fields[i]), i, FORMAT_SQL, ds->opts->fo);
+				isfirst = 0;
+			}
+		}
+		str_buffer_print(pxdoc, sb, ") VALUES (");
+		isfirst = 1;
+		offset = 0;
+		for(i=0; i<ds->numfields; i++) {
+			if(mask[i]) {
+				if(!isfirst)
+					str_buffer_append(pxdoc, sb, ", ", 2);
+				format_field(pxdoc, sb, &(ds->fields[i]), &newdata[offset], FORMAT_SQL, ds->opts->fo);
+				isfirst = 0;
+			}
+			offset += ds->fields[i].px_flen;
+		}
+		str_buffer_print(pxdoc, sb, ");\n");
+	} else {
+		str_buffer_print(pxdoc, sb, "DELETE FROM %s WHERE ", ds->opts->tablename);
+		print_fields(ds, ds->olddoc, olddata, NULL, 0, ds->numkeyfields, " AND ", 1);
+		str_buffer_print(pxdoc, sb, ";\n");
+	}
+	fwrite(str_buffer_get(pxdoc, sb), str_buffer_len(pxdoc, sb), 1, ds->outfp);
+	if(mask)
+		pxdoc->free(pxdoc, mask);
+	return 0;
+}
+/* }}} */
+
+/* diff_tables() {{{
+ * Outputs the changes which turn the table in olddoc into the table in
+ * newdoc. Records are matched by their primary key. If the table has no
+ * primary key, the complete record is used as a key and changes are
+ * output as a delete followed by an insert.
+ * Blocks which are identical in both tables are skipped. The records of
+ * all remaining blocks of the old table are kept in memory.
+ * Returns 0 on success or -1 on error.
+ */
+int diff_tables(pxdoc_t *olddoc, FILE *oldfp, pxdoc_t *newdoc, FILE *newfp, FILE *outfp, struct diff_options *opts) {
+	struct diff_state ds;
+	struct blockmap *oldbm = NULL, *newbm = NULL;
+	char *oldchanged = NULL, *newchanged = NULL;
+	char *records = NULL, *matched = NULL, *data = NULL;
+	struct hashtable *ht = NULL;
+	struct record_iter iter;
+	pxfield_t *oldfields;
+	float number;
+	int recordsize, keylen, numold, numstored, identical = 0;
+	int numinserted = 0, numupdated = 0, numdeleted = 0;
+	int i, j, ret, result = -1;
+
+	/* Check if both tables have the same structure */
+	ds.pxdoc = newdoc;
+	ds.olddoc = olddoc;
+	ds.fields = PX_get_fields(newdoc);
+	ds.numfields = PX_get_num_fields(newdoc);
+	ds.outfp = outfp;
+	ds.opts = opts;
+	oldfields = PX_get_fields(olddoc);
+	if(ds.numfields != PX_get_num_fields(olddoc)) {
+		fprintf(stderr, _("Both tables must have the same number of fields."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	for(i=0; i<ds.numfields; i++) {
+		if(ds.fields[i].px_ftype != oldfields[i].px_ftype ||
+		   ds.fields[i].px_flen != oldfields[i].px_flen) {
+			fprintf(stderr, _("Field '%s' has a different type in both tables."), ds.fields[i].px_fname);
+			fprintf(stderr, "\n");
+			return -1;
+		}
+	}
+	PX_get_value(newdoc, "recordsize", &number);
+	recordsize = (int) number;
+	PX_get_value(newdoc, "primarykeyfields", &number);
+	ds.numkeyfields = (int) number;
+	if(ds.numkeyfields > ds.numfields)
+		ds.numkeyfields = ds.numfields;
+	if(ds.numkeyfields > 0) {
+		keylen = 0;
+		for(i=0; i<ds.numkeyfields; i++)
+			keylen += ds.fields[i].px_flen;
+	} else {
+		if(opts->verbose) {
+			fprintf(stderr, _("Table has no primary key. Changed records are output as delete and insert."));
+			fprintf(stderr, "\n");
+		}
+		ds.numkeyfields = ds.numfields;
+		keylen = recordsize;
+	}
+
+	if(NULL == (ds.sb = str_buffer_new(newdoc, 256)))
+		return -1;
+	if(NULL == (data = newdoc->malloc(newdoc, recordsize, _("Allocate memory for record."))))
+		goto cleanup;
+
+	/* Skip blocks which are identical in both tables. Encrypted files
+	 * cannot be read directly, so all their records are compared.
+	 */
+	if(olddoc->px_head->px_encryption == 0 && newdoc->px_head->px_encryption == 0) {
+		if(NULL == (oldbm = blockmap_new(olddoc, oldfp, 1)))
+			goto cleanup;
+		if(NULL == (newbm = blockmap_new(newdoc, newfp, 1)))
+			goto cleanup;
+		oldchanged = newdoc->malloc(newdoc, oldbm->numblocks+1, _("Allocate memory for list of blocks."));
+		newchanged = newdoc->malloc(newdoc, newbm->numblocks+1, _("Allocate memory for list of blocks."));
+		if(oldchanged == NULL || newchanged == NULL)
+			goto cleanup;
+		memset(oldchanged, 1, oldbm->numblocks+1);
+		memset(newchanged, 1, newbm->numblocks+1);
+		if(0 > (identical = match_blocks(newdoc, oldbm, oldchanged, newbm, newchanged)))
+			goto cleanup;
+		numold = 0;
+		for(i=0; i<oldbm->numblocks; i++) {
+			if(oldchanged[i])
+				numold += oldbm->blocks[i].numrecords;
+		}
+	} else {
+		numold = PX_get_num_records(olddoc);
+	}
+
+	/* Read all records of changed blocks in the old table */
+	if(NULL == (records = newdoc->malloc(newdoc, (size_t) (numold+1) * recordsize, _("Allocate memory for records of old table."))))
+		goto cleanup;
+	if(NULL == (matched = newdoc->malloc(newdoc, numold+1, _("Allocate memory for records of old table."))))
+		goto cleanup;
+	memset(matched, 0, numold+1);
+	if(NULL == (ht = hashtable_new(newdoc, keylen, numold)))
+		goto cleanup;
+	record_iter_init(&iter, olddoc, PX_get_num_records(olddoc), 0);
+	if(oldbm)
+		record_iter_select_blocks(&iter, oldbm, oldchanged);
+	numstored = 0;
+	while(numstored < numold && 0 != (ret = record_iter_next(&iter, &j, &records[(size_t) numstored * recordsize], NULL, NULL))) {
+		struct hashtable_entry *e;
+		int isnew;
+		if(0 > ret) {
+			fprintf(stderr, _("Couldn't get record number %d\n"), j);
+			continue;
+		}
+		if(NULL == (e = hashtable_insert(ht, &records[(size_t) numstored * recordsize], &isnew)))
+			goto cleanup;
+		if(isnew) {
+			e->value = &records[(size_t) numstored * recordsize];
+			numstored++;
+		} else if(opts->verbose) {
+			fprintf(stderr, _("Record number %d of old table has a duplicate key."), j);
+			fprintf(stderr, "\n");
+		}
+	}
+
+	/* Compare with records of changed blocks in new table */
+	record_iter_init(&iter, newdoc, PX_get_num_records(newdoc), 0);
+	if(newbm)
+		record_iter_select_blocks(&iter, newbm, newchanged);
+	while(0 != (ret = record_iter_next(&iter, &j, data, NULL, NULL))) {
+		struct hashtable_entry *e;
+		if(0 > ret) {
+			fprintf(stderr, _("Couldn't get record number %d\n"), j);
+			continue;
+		}
+		if(NULL == (e = hashtable_lookup(ht, data))) {
+			if(0 > print_event(&ds, NULL, data))
+				goto cleanup;
+			numinserted++;
+		} else {
+			char *olddata = e->value;
+			matched[(olddata - records) / recordsize] = 1;
+			if(memcmp(olddata, data, recordsize)) {
+				if(0 > print_event(&ds, olddata, data))
+					goto cleanup;
+				numupdated++;
+			}
+		}
+	}
+
+	/* Records which were not found in the new table are deleted */
+	for(i=0; i<numstored; i++) {
+		if(!matched[i]) {
+			if(0 > print_event(&ds, &records[(size_t) i * recordsize], NULL))
+				goto cleanup;
+			numdeleted++;
+		}
+	}
+
+	if(opts->verbose) {
+		if(oldbm) {
+			fprintf(stderr, _("%d of %d data blocks are unchanged."), identical, newbm->numblocks);
+			fprintf(stderr, "\n");
+		}
+		fprintf(stderr, _("%d records inserted, %d updated, %d deleted."), numinserted, numupdated, numdeleted);
+		fprintf(stderr, "\n");
+	}
+	result = 0;
+
+cleanup:
+	if(ht)
+		hashtable_delete(ht);
+	if(matched)
+		newdoc->free(newdoc, matched);
+	if(records)
+		newdoc->free(newdoc, records);
+	if(oldchanged)
+		newdoc->free(newdoc, oldchanged);
+	if(newchanged)
+		newdoc->free(newdoc, newchanged);
+	if(oldbm)
+		blockmap_delete(olddoc, oldbm);
+	if(newbm)
+		blockmap_delete(newdoc, newbm);
+	if(data)
+		newdoc->free(newdoc, data);
+	str_buffer_delete(newdoc, ds.sb);
+	return(result);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,17 @@
+#ifndef __DIFF_H__
+#define __DIFF_H__
+
+#include "format.h"
+
+/* Options for comparing two tables */
+struct diff_options {
+	int format;            /* FORMAT_SQL or FORMAT_JSON */
+	char *tablename;
+	char *selectedfields;  /* NULL if all fields are output */
+	struct format_options *fo;
+	int verbose;
+};
+
+int diff_tables(pxdoc_t *olddoc, FILE *oldfp, pxdoc_t *newdoc, FILE *newfp, FILE *outfp, struct diff_options *opts);
+
+#endif
@@ -0,0 +1,288 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "blockmap.h"
+#include "transcode.h"
+#include "encoding.h"
+
+/* The codepage of the alpha fields is guessed from a sample of data
+ * blocks spread over the file. Only the bytes above 127 matter, because
+ * all candidates agree on ASCII. Each of them is counted together with
+ * the kind of its neighbours, and each codepage is scored by how well
+ * the characters it assigns to those bytes fit into their place: a
+ * letter next to letters is likely, a line drawing character or a
+ * control character inside a word is not.
+ */
+
+/* Kinds of characters a byte above 127 is recoded into */
+#define CHAR_LOWER 0
+#define CHAR_UPPER 1
+#define CHAR_SYMBOL 2
+#define CHAR_GRAPHIC 3
+#define CHAR_CONTROL 4
+
+/* Accented letters frequent in the languages the codepages are made for */
+static const unsigned short frequent_letters[] = {
+	0xe4, 0xf6, 0xfc, 0xdf, 0xc4, 0xd6, 0xdc, 0xe9, 0xe8, 0xe0, 0xe7,
+	0xea, 0xe1, 0xed, 0xf3, 0xfa, 0xf1, 0xe5, 0xf8, 0xe6, 0xc9, 0xc5,
+	0xd8, 0x10d, 0x161, 0x17e, 0x159, 0x11b, 0x142, 0x105, 0x119, 0x151,
+	0
+};
+
+/* char_kind() {{{
+ */
+static int char_kind(unsigned int c) {
+	if(c >= 0x80 && c < 0xa0)
+		return CHAR_CONTROL;
+	if(c >= 0x2500 && c < 0x2600)
+		return CHAR_GRAPHIC;
+	if(c >= 0xc0 && c <= 0xff && c != 0xd7 && c != 0xf7)
+		return (c < 0xdf) ? CHAR_UPPER : CHAR_LOWER;
+	if(c >= 0x100 && c < 0x180) {
+		/* Latin Extended-A alternates between upper and lower case, but
+		 * changes its parity at 0x139, 0x14a and 0x179 */
+		if(c == 0x138 || c == 0x149 || c == 0x17f)
+			return CHAR_LOWER;
+		if((c >= 0x139 && c < 0x149) || c >= 0x179)
+			return (c & 1) ? CHAR_UPPER : CHAR_LOWER;
+		return (c == 0x178 || !(c & 1)) ? CHAR_UPPER : CHAR_LOWER;
+	}
+	if(c >= 0x400 && c < 0x460)
+		return (c < 0x430) ? CHAR_UPPER : CHAR_LOWER;
+	return CHAR_SYMBOL;
+}
+/* }}} */
+
+/* is_frequent() {{{
+ */
+static int is_frequent(unsigned int c) {
+	int i;
+
+	for(i=0; frequent_letters[i]; i++)
+		if(frequent_letters[i] == c)
+			return 1;
+	/* Cyrillic letters are all frequent in Cyrillic text */
+	return(c >= 0x410 && c < 0x450);
+}
+/* }}} */
+
+/* char_score() {{{
+ * Scores character c found between characters of the kinds prev and
+ * next.
+ */
+static int char_score(unsigned int c, int prev, int next) {
+	int inword = (prev != ENCODING_CTX_OTHER || next != ENCODING_CTX_OTHER);
+	int between = (prev != ENCODING_CTX_OTHER && next != ENCODING_CTX_OTHER);
+	int ascii = (prev == ENCODING_CTX_LOWER || prev == ENCODING_CTX_UPPER ||
+		next == ENCODING_CTX_LOWER || next == ENCODING_CTX_UPPER);
+
+	/* Cyrillic words consist of Cyrillic letters only */
+	if(c >= 0x400 && c < 0x460 && ascii)
+		return -2;
+	switch(char_kind(c)) {
+		case CHAR_LOWER:
+			return 2 + (inword ? 2 : 0) + is_frequent(c) -
+				(prev == ENCODING_CTX_UPPER && next == ENCODING_CTX_UPPER ? 3 : 0);
+		case CHAR_UPPER:
+			return 2 + (inword ? 2 : 0) + is_frequent(c) -
+				(prev == ENCODING_CTX_LOWER ? 3 : 0);
+		case CHAR_GRAPHIC:
+			return inword ? -3 : -1;
+		case CHAR_CONTROL:
+			return -5;
+		default:
+			return between ? -2 : (inword ? -1 : 0);
+	}
+}
+/* }}} */
+
+/* byte_context() {{{
+ */
+static int byte_context(unsigned char c) {
+	if(c >= 0x80)
+		return ENCODING_CTX_HIGH;
+	if(c >= 'a' && c <= 'z')
+		return ENCODING_CTX_LOWER;
+	if(c >= 'A' && c <= 'Z')
+		return ENCODING_CTX_UPPER;
+	return ENCODING_CTX_OTHER;
+}
+/* }}} */
+
+/* sample_value() {{{
+ * Counts the bytes above 127 of an alpha value.
+ */
+static void sample_value(struct encoding_guess *guess, const unsigned char *data, int len) {
+	int i, prev, next;
+
+	for(i=0; i<len && data[i]; i++) {
+		if(data[i] < 0x80)
+			continue;
+		prev = (i > 0) ? byte_context(data[i-1]) : ENCODING_CTX_OTHER;
+		next = (i+1 < len) ? byte_context(data[i+1]) : ENCODING_CTX_OTHER;
+		guess->counts[data[i]-0x80][prev][next]++;
+		guess->highbytes++;
+	}
+}
+/* }}} */
+
+/* compare_candidates() {{{
+ */
+static int compare_candidates(const void *a, const void *b) {
+	const struct encoding_candidate *ca = a;
+	const struct encoding_candidate *cb = b;
+
+	if(ca->score != cb->score)
+		return (ca->score < cb->score) ? 1 : -1;
+	return(ca->codepage - cb->codepage);
+}
+/* }}} */
+
+/* encoding_detect() {{{
+ * Guesses the codepage of the alpha and memo fields from at most
+ * ENCODING_SAMPLE_BLOCKS data blocks read from fp. Of memo fields only
+ * the part stored in the record is used. Codepages which score the same
+ * as the one in the header do not replace it.
+ * Returns 0 on success and -1 on error.
+ */
+int encoding_detect(pxdoc_t *pxdoc, FILE *fp, struct encoding_guess *guess) {
+	pxfield_t *pxf;
+	char *block;
+	float number;
+	int *offsets, *lengths;
+	int numfields, numalpha, blocksize, headersize, recordsize, fileblocks;
+	int i, j, k, b, prev, next, sampleblocks, numrecords, lastblock;
+
+	memset(guess, 0, sizeof(struct encoding_guess));
+	PX_get_value(pxdoc, "codepage", &number);
+	guess->headercodepage = (int) number;
+
+	if(pxdoc->px_head->px_encryption != 0) {
+		fprintf(stderr, _("Data blocks of encrypted files cannot be read directly."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	PX_get_value(pxdoc, "headersize", &number);
+	headersize = (int) number;
+	PX_get_value(pxdoc, "maxtablesize", &number);
+	blocksize = (int) number * 0x400;
+	PX_get_value(pxdoc, "recordsize", &number);
+	recordsize = (int) number;
+	PX_get_value(pxdoc, "numblocks", &number);
+	fileblocks = (int) number;
+	if(recordsize <= 0 || blocksize <= BLOCKHEADERSIZE) {
+		fprintf(stderr, _("Header contains invalid block or record size."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+
+	/* Offsets and lengths of the alpha fields and memo leaders */
+	numfields = PX_get_num_fields(pxdoc);
+	pxf = PX_get_fields(pxdoc);
+	if(NULL == (offsets = pxdoc->malloc(pxdoc, 2 * numfields * sizeof(int), _("Allocate memory for sample of alpha fields.")))) {
+		return -1;
+	}
+	lengths = offsets + numfields;
+	numalpha = 0;
+	for(i=0, k=0; i<numfields; k+=pxf[i].px_flen, i++) {
+		if(pxf[i].px_ftype == pxfAlpha) {
+			offsets[numalpha] = k;
+			lengths[numalpha++] = pxf[i].px_flen;
+		} else if((pxf[i].px_ftype == pxfMemoBLOb || pxf[i].px_ftype == pxfFmtMemoBLOb) && pxf[i].px_flen > 10) {
+			offsets[numalpha] = k;
+			lengths[numalpha++] = pxf[i].px_flen - 10;
+		}
+	}
+	if(NULL == (block = pxdoc->malloc(pxdoc, blocksize, _("Allocate memory for data block.")))) {
+		pxdoc->free(pxdoc, offsets);
+		return -1;
+	}
+
+	/* Blocks are picked by their position in the file, which keeps
+	 * the sample independent of the length of the block chain. */
+	sampleblocks = (fileblocks < ENCODING_SAMPLE_BLOCKS) ? fileblocks : ENCODING_SAMPLE_BLOCKS;
+	lastblock = 0;
+	for(j=0; numalpha > 0 && j<sampleblocks; j++) {
+		b = 1 + (int) ((long) j * fileblocks / sampleblocks);
+		if(b == lastblock)
+			continue;
+		lastblock = b;
+		if(0 != fseek(fp, headersize + (long) (b-1) * blocksize, SEEK_SET) ||
+		   1 != fread(block, blocksize, 1, fp))
+			break;
+		numrecords = (short int) get_short_le(&block[4]) / recordsize + 1;
+		if(numrecords <= 0)
+			continue;
+		if(numrecords > (blocksize - BLOCKHEADERSIZE) / recordsize)
+			numrecords = (blocksize - BLOCKHEADERSIZE) / recordsize;
+		guess->blocks++;
+		for(i=0; i<numrecords; i++) {
+			const unsigned char *record = (unsigned char *) block + BLOCKHEADERSIZE + i * recordsize;
+			for(k=0; k<numalpha; k++) {
+				sample_value(guess, record + offsets[k], lengths[k]);
+				guess->values++;
+			}
+		}
+	}
+	pxdoc->free(pxdoc, block);
+	pxdoc->free(pxdoc, offsets);
+
+	/* Score each codepage */
+	for(i=0; transcode_codepages[i].codepage; i++)
+		;
+	if(NULL == (guess->candidates = pxdoc->malloc(pxdoc, i * sizeof(struct encoding_candidate), _("Allocate memory for codepage candidates.")))) {
+		return -1;
+	}
+	guess->numcandidates = i;
+	for(i=0; i<guess->numcandidates; i++) {
+		const struct codepage_table *cpt = &transcode_codepages[i];
+		long score = 0;
+
+		for(j=0; j<128; j++) {
+			for(prev=0; prev<4; prev++) {
+				for(next=0; next<4; next++) {
+					if(guess->counts[j][prev][next])
+						score += guess->counts[j][prev][next] * char_score(cpt->chars[j], prev, next);
+				}
+			}
+		}
+		guess->candidates[i].codepage = cpt->codepage;
+		guess->candidates[i].score = score;
+	}
+	qsort(guess->candidates, guess->numcandidates, sizeof(struct encoding_candidate), compare_candidates);
+
+	if(guess->highbytes > 0) {
+		guess->codepage = guess->candidates[0].codepage;
+		for(i=1; i<guess->numcandidates && guess->candidates[i].score == guess->candidates[0].score; i++) {
+			if(guess->candidates[i].codepage == guess->headercodepage)
+				guess->codepage = guess->headercodepage;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* encoding_guess_free() {{{
+ */
+void encoding_guess_free(pxdoc_t *pxdoc, struct encoding_guess *guess) {
+	if(guess->candidates)
+		pxdoc->free(pxdoc, guess->candidates);
+	guess->candidates = NULL;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,37 @@
+#ifndef __ENCODING_H__
+#define __ENCODING_H__
+
+#include <stdio.h>
+
+/* Maximum number of data blocks read for guessing the codepage */
+#define ENCODING_SAMPLE_BLOCKS 64
+
+/* Kind of the character before or after a byte above 127 */
+#define ENCODING_CTX_OTHER 0   /* blank, digit, punctuation or end of value */
+#define ENCODING_CTX_LOWER 1   /* lower case ASCII letter */
+#define ENCODING_CTX_UPPER 2   /* upper case ASCII letter */
+#define ENCODING_CTX_HIGH 3    /* another byte above 127 */
+
+struct encoding_candidate {
+	int codepage;
+	long score;
+};
+
+/* Result of guessing the codepage of the alpha fields of a table */
+struct encoding_guess {
+	int codepage;             /* best codepage, 0 if nothing was found */
+	int headercodepage;       /* codepage in the header of the file */
+	int blocks;               /* number of data blocks read */
+	long values;              /* number of alpha and memo values read */
+	long highbytes;           /* number of bytes above 127 found */
+	struct encoding_candidate *candidates;  /* sorted by score */
+	int numcandidates;
+	/* occurrences of each byte above 127 by its preceding and following
+	 * character */
+	long counts[128][4][4];
+};
+
+int encoding_detect(pxdoc_t *pxdoc, FILE *fp, struct encoding_guess *guess);
+void encoding_guess_free(pxdoc_t *pxdoc, struct encoding_guess *guess);
+
+#endif
@@ -0,0 +1,292 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pxview.h"
+#include "transcode.h"
+#include "stats.h"
+
+/* field_type_code() {{{
+ * Returns the letter used for the type of a field in the head line of
+ * csv and html output, or 0 for an unknown type.
+ */
+char field_type_code(int type) {
+	switch(type) {
+		case pxfAlpha: return('A');
+		case pxfDate: return('D');
+		case pxfShort: return('S');
+		case pxfAutoInc: return('+');
+		case pxfTimestamp: return('@');
+		case pxfLong: return('I');
+		case pxfTime: return('T');
+		case pxfCurrency: return('$');
+		case pxfNumber: return('N');
+		case pxfLogical: return('L');
+		case pxfGraphic: return('G');
+		case pxfBLOb: return('B');
+		case pxfOLE: return('O');
+		case pxfFmtMemoBLOb: return('F');
+		case pxfMemoBLOb: return('M');
+		case pxfBytes: return('Y');
+		case pxfBCD: return('#');
+	}
+	return('\0');
+}
+/* }}} */
+
+/* pxview_export_begin() {{{
+ * Starts the export of the table opened as pxdoc into sink. If
+ * selectedfields is not NULL only fields with a non zero entry in it
+ * are passed to the sink. The fields of the records are those of pxdoc
+ * unless they have been set in the sink before.
+ */
+int pxview_export_begin(struct pxview_sink *sink, pxdoc_t *pxdoc, const char *selectedfields) {
+	sink->pxdoc = pxdoc;
+	if(NULL == sink->fields) {
+		sink->fields = PX_get_fields(pxdoc);
+		sink->numfields = PX_get_num_fields(pxdoc);
+	}
+	sink->selectedfields = selectedfields;
+	if(sink->begin_table)
+		return(sink->begin_table(sink));
+	return(0);
+}
+/* }}} */
+
+/* export_blob() {{{
+ * Passes the value of a blob field to the sink. Memo blobs are passed
+ * as strings. The sink may handle the blob itself in field_blobref.
+ */
+static int export_blob(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data) {
+	pxdoc_t *pxdoc = sink->pxdoc;
+	char *blobdata;
+	int mod_nr, size, ret;
+
+	if(sink->field_blobref && 1 != (ret = sink->field_blobref(sink, field, pxf, data)))
+		return(ret);
+	if(pxf->px_ftype == pxfGraphic)
+		ret = stats_get_data_graphic(pxdoc, data, pxf->px_flen, &mod_nr, &size, &blobdata);
+	else
+		ret = stats_get_data_blob(pxdoc, data, pxf->px_flen, &mod_nr, &size, &blobdata);
+	if(ret <= 0)
+		return(sink->field_null ? sink->field_null(sink, field, pxf) : 0);
+	if(!blobdata) {
+		fprintf(stderr, _("Could not get blob data for %d"), mod_nr);
+		fprintf(stderr, "\n");
+		return(sink->field_null ? sink->field_null(sink, field, pxf) : 0);
+	}
+	if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb)
+		ret = sink->field_string ? sink->field_string(sink, field, pxf, blobdata, size) : 0;
+	else
+		ret = sink->field_blob ? sink->field_blob(sink, field, pxf, blobdata, size, mod_nr) : 0;
+	pxdoc->free(pxdoc, blobdata);
+	return(ret);
+}
+/* }}} */
+
+/* export_field() {{{
+ * Decodes the field at data and passes its value to the sink.
+ */
+static int export_field(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data) {
+	pxdoc_t *pxdoc = sink->pxdoc;
+	int ret;
+
+	switch(pxf->px_ftype) {
+		case pxfAlpha: {
+			char *value;
+			if(0 < (ret = transcode_get_data_alpha(pxdoc, data, pxf->px_flen, &value))) {
+				ret = sink->field_string ? sink->field_string(sink, field, pxf, value, strlen(value)) : 0;
+				pxdoc->free(pxdoc, value);
+				return(ret);
+			} else if(ret < 0) {
+				fprintf(stderr, _("Error while reading data of field number %d"), field+1);
+				fprintf(stderr, "\n");
+			}
+			break;
+		}
+		case pxfDate: {
+			long value;
+			if(0 < PX_get_data_long(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_timestamp ? sink->field_timestamp(sink, field, pxf, (double) value*1000.0*86400.0) : 0);
+			break;
+		}
+		case pxfTime: {
+			long value;
+			if(0 < PX_get_data_long(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_timestamp ? sink->field_timestamp(sink, field, pxf, (double) value) : 0);
+			break;
+		}
+		case pxfTimestamp: {
+			double value;
+			if(0 < PX_get_data_double(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_timestamp ? sink->field_timestamp(sink, field, pxf, value) : 0);
+			break;
+		}
+		case pxfShort: {
+			short int value;
+			if(0 < PX_get_data_short(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_long ? sink->field_long(sink, field, pxf, (long) value) : 0);
+			break;
+		}
+		case pxfAutoInc:
+		case pxfLong: {
+			long value;
+			if(0 < PX_get_data_long(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_long ? sink->field_long(sink, field, pxf, value) : 0);
+			break;
+		}
+		case pxfCurrency:
+		case pxfNumber: {
+			double value;
+			if(0 < PX_get_data_double(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_double ? sink->field_double(sink, field, pxf, value) : 0);
+			break;
+		}
+		case pxfLogical: {
+			char value;
+			if(0 < PX_get_data_byte(pxdoc, data, pxf->px_flen, &value))
+				return(sink->field_bool ? sink->field_bool(sink, field, pxf, value ? 1 : 0) : 0);
+			break;
+		}
+		case pxfGraphic:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfMemoBLOb:
+		case pxfOLE:
+			return(export_blob(sink, field, pxf, data));
+		case pxfBytes:
+			return(sink->field_bytes ? sink->field_bytes(sink, field, pxf, data, pxf->px_flen) : 0);
+		case pxfBCD: {
+			char *value;
+			if(0 < PX_get_data_bcd(pxdoc, (unsigned char *) data, pxf->px_fdc, &value)) {
+				ret = sink->field_bcd ? sink->field_bcd(sink, field, pxf, value) : 0;
+				pxdoc->free(pxdoc, value);
+				return(ret);
+			}
+			break;
+		}
+	}
+	return(sink->field_null ? sink->field_null(sink, field, pxf) : 0);
+}
+/* }}} */
+
+/* pxview_export_record() {{{
+ * Passes the record recno in data to the sink. isdeleted and pxdbinfo
+ * are passed on as returned by PX_get_record2(). pxdbinfo may be NULL.
+ */
+int pxview_export_record(struct pxview_sink *sink, int recno, char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	pxfield_t *pxf;
+	int i, offset = 0;
+
+	if(sink->begin_record && 0 > sink->begin_record(sink, recno, data, isdeleted, pxdbinfo))
+		return(-1);
+	pxf = sink->fields;
+	for(i=0; i<sink->numfields; i++) {
+		if(sink->selectedfields == NULL || sink->selectedfields[i]) {
+			if(0 > export_field(sink, i, pxf, &data[offset]))
+				return(-1);
+		}
+		offset += pxf->px_flen;
+		pxf++;
+	}
+	if(sink->end_record)
+		return(sink->end_record(sink));
+	return(0);
+}
+/* }}} */
+
+/* pxview_export_end() {{{
+ * Finishes the export into sink.
+ */
+int pxview_export_end(struct pxview_sink *sink) {
+	if(sink->end_table)
+		return(sink->end_table(sink));
+	return(0);
+}
+/* }}} */
+
+/* pxview_export() {{{
+ * Exports all records of the table opened as pxdoc into sink. This is
+ * all an application embedding the engine needs to call.
+ */
+int pxview_export(struct pxview_sink *sink, pxdoc_t *pxdoc, const char *selectedfields) {
+	pxdatablockinfo_t pxdbinfo;
+	float recordsize;
+	char *data;
+	int j, isdeleted, numrecords, ret = 0;
+
+	if(0 > pxview_export_begin(sink, pxdoc, selectedfields))
+		return(-1);
+	PX_get_value(pxdoc, "recordsize", &recordsize);
+	if(NULL == (data = pxdoc->malloc(pxdoc, (int) recordsize, _("Allocate memory for record.")))) {
+		return(-1);
+	}
+	numrecords = PX_get_num_records(pxdoc);
+	for(j=0; j<numrecords && ret >= 0; j++) {
+		if(PX_get_record2(pxdoc, j, data, &isdeleted, &pxdbinfo))
+			ret = pxview_export_record(sink, j, data, isdeleted, &pxdbinfo);
+		else {
+			fprintf(stderr, _("Couldn't get record number %d\n"), j);
+		}
+	}
+	pxdoc->free(pxdoc, data);
+	if(ret < 0)
+		return(ret);
+	return(pxview_export_end(sink));
+}
+/* }}} */
+
+/* pxview_sink_delete() {{{
+ * Frees a sink created by one of the pxview_*_sink_new() functions.
+ */
+void pxview_sink_delete(struct pxview_sink *sink) {
+	if(sink->destroy)
+		sink->destroy(sink);
+}
+/* }}} */
+
+/* pxview_blob_file() {{{
+ * Writes the data of a blob into the file PREFIX_NUMBER.EXTENSION.
+ * Returns the name of the file, which must be freed with pxdoc->free(),
+ * or NULL if the file could not be written.
+ */
+char *pxview_blob_file(pxdoc_t *pxdoc, const char *prefix, int number, const char *extension, const char *data, int size) {
+	char *filename;
+	FILE *fp;
+
+	if(NULL == (filename = pxdoc->malloc(pxdoc, strlen(prefix)+strlen(extension)+20, _("Allocate memory for name of blob file.")))) {
+		return NULL;
+	}
+	sprintf(filename, "%s_%d.%s", prefix, number, extension);
+	if(NULL == (fp = fopen(filename, "w"))) {
+		fprintf(stderr, _("Could not open file '%s' for blob data"), filename);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, filename);
+		return NULL;
+	}
+	if(size > 0 && 1 != fwrite(data, size, 1, fp)) {
+		fprintf(stderr, _("Could not write blob data into file '%s'"), filename);
+		fprintf(stderr, "\n");
+		fclose(fp);
+		pxdoc->free(pxdoc, filename);
+		return NULL;
+	}
+	fclose(fp);
+	return(filename);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,342 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#include "pxview_intern.h"
+#include "format.h"
+#include "json.h"
+#include "transcode.h"
+#include "stats.h"
+
+/* print_null() {{{
+ */
+static int print_null(pxdoc_t *pxdoc, struct str_buffer *sb, int format) {
+	if(format == FORMAT_JSON)
+		return(str_buffer_append(pxdoc, sb, "null", 4));
+	if(format == FORMAT_CSV)
+		return 0;
+	return(str_buffer_append(pxdoc, sb, "NULL", 4));
+}
+/* }}} */
+
+/* print_csv_string() {{{
+ * Appends a csv value. Like in csv output of records it is only
+ * enclosed if it contains the delimiter, the enclosure or a line break.
+ */
+static int print_csv_string(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len, struct format_options *fo) {
+	size_t i, start = 0;
+	int needsenclosure = 0;
+
+	for(i=0; i<len; i++) {
+		if(str[i] == fo->delimiter || str[i] == fo->enclosure || str[i] == '\n' || str[i] == '\r')
+			needsenclosure = 1;
+	}
+	if(!needsenclosure || !fo->enclosure)
+		return(str_buffer_append(pxdoc, sb, str, len));
+
+	str_buffer_append(pxdoc, sb, &fo->enclosure, 1);
+	for(i=0; i<len; i++) {
+		if(str[i] == fo->enclosure) {
+			str_buffer_append(pxdoc, sb, &str[start], i-start+1);
+			str_buffer_append(pxdoc, sb, &fo->enclosure, 1);
+			start = i+1;
+		}
+	}
+	str_buffer_append(pxdoc, sb, &str[start], len-start);
+	return(str_buffer_append(pxdoc, sb, &fo->enclosure, 1));
+}
+/* }}} */
+
+/* print_string() {{{
+ * Appends a quoted string. sql strings are quoted with ' which is
+ * doubled if it is part of the string.
+ */
+static int print_string(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len, int format, struct format_options *fo) {
+	size_t i, start = 0;
+
+	if(format == FORMAT_JSON)
+		return(str_buffer_print_json(pxdoc, sb, str, len));
+	if(format == FORMAT_CSV)
+		return(print_csv_string(pxdoc, sb, str, len, fo));
+	if(format == FORMAT_TEXT)
+		return(str_buffer_append(pxdoc, sb, str, len));
+
+	str_buffer_append(pxdoc, sb, "'", 1);
+	for(i=0; i<len; i++) {
+		if(str[i] == '\'') {
+			str_buffer_append(pxdoc, sb, &str[start], i-start+1);
+			str_buffer_append(pxdoc, sb, "'", 1);
+			start = i+1;
+		}
+	}
+	str_buffer_append(pxdoc, sb, &str[start], len-start);
+	return(str_buffer_append(pxdoc, sb, "'", 1));
+}
+/* }}} */
+
+/* print_number() {{{
+ * Appends a number string. The decimal point of the locale is replaced
+ * by a period, because neither sql nor JSON accept anything else.
+ */
+static int print_number(pxdoc_t *pxdoc, struct str_buffer *sb, char *str) {
+#ifdef HAVE_LOCALE_H
+	struct lconv *lc = localeconv();
+	if(lc->decimal_point[0] != '.') {
+		char *ptr = strchr(str, lc->decimal_point[0]);
+		if(ptr)
+			*ptr = '.';
+	}
+#endif
+	return(str_buffer_append(pxdoc, sb, str, strlen(str)));
+}
+/* }}} */
+
+/* format_field() {{{
+ * Appends the value of field pxf in data as a sql or JSON literal, as
+ * a csv value or as plain text.
+ * Blobs are only output if they are memos. Other blobs and fields of
+ * type bytes are output as NULL.
+ * Returns 0 on success and -1 if the field could not be read.
+ */
+int format_field(pxdoc_t *pxdoc, struct str_buffer *sb, pxfield_t *pxf, char *data, int format, struct format_options *fo) {
+	char buffer[100];
+	int ret = 0;
+
+	switch(pxf->px_ftype) {
+		case pxfAlpha: {
+			char *value;
+			if(0 < (ret = transcode_get_data_alpha(pxdoc, data, pxf->px_flen, &value))) {
+				print_string(pxdoc, sb, value, strlen(value), format, fo);
+				pxdoc->free(pxdoc, value);
+			} else if(ret == 0 && !fo->emptystringisnull) {
+				print_string(pxdoc, sb, "", 0, format, fo);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfDate: {
+			long value;
+			if(0 < (ret = PX_get_data_long(pxdoc, data, pxf->px_flen, &value))) {
+				char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, fo->date_format);
+				print_string(pxdoc, sb, str, strlen(str), format, fo);
+				pxdoc->free(pxdoc, str);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfShort: {
+			short int value;
+			if(0 < (ret = PX_get_data_short(pxdoc, data, pxf->px_flen, &value))) {
+				sprintf(buffer, "%d", value);
+				str_buffer_append(pxdoc, sb, buffer, strlen(buffer));
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfAutoInc:
+		case pxfLong: {
+			long value;
+			if(0 < (ret = PX_get_data_long(pxdoc, data, pxf->px_flen, &value))) {
+				sprintf(buffer, "%ld", value);
+				str_buffer_append(pxdoc, sb, buffer, strlen(buffer));
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfTimestamp: {
+			double value;
+			if(0 < (ret = PX_get_data_double(pxdoc, data, pxf->px_flen, &value))) {
+				char *str = PX_timestamp2string(pxdoc, value, fo->timestamp_format);
+				print_string(pxdoc, sb, str, strlen(str), format, fo);
+				pxdoc->free(pxdoc, str);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfTime: {
+			long value;
+			if(0 < (ret = PX_get_data_long(pxdoc, data, pxf->px_flen, &value))) {
+				char *str = PX_timestamp2string(pxdoc, (double) value, fo->time_format);
+				print_string(pxdoc, sb, str, strlen(str), format, fo);
+				pxdoc->free(pxdoc, str);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfCurrency:
+		case pxfNumber: {
+			double value;
+			if(0 < (ret = PX_get_data_double(pxdoc, data, pxf->px_flen, &value))) {
+				sprintf(buffer, "%lf", value);
+				print_number(pxdoc, sb, buffer);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfLogical: {
+			char value;
+			if(0 < (ret = PX_get_data_byte(pxdoc, data, pxf->px_flen, &value))) {
+				if(format == FORMAT_JSON)
+					str_buffer_print(pxdoc, sb, "%s", value ? "true" : "false");
+				else if(format == FORMAT_CSV)
+					str_buffer_print(pxdoc, sb, "%s", value ? "1" : "0");
+				else
+					str_buffer_print(pxdoc, sb, "%s", value ? "TRUE" : "FALSE");
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfMemoBLOb:
+		case pxfFmtMemoBLOb: {
+			char *blobdata;
+			int mod_nr, size;
+			if(0 < (ret = stats_get_data_blob(pxdoc, data, pxf->px_flen, &mod_nr, &size, &blobdata)) && blobdata) {
+				print_string(pxdoc, sb, blobdata, size, format, fo);
+				pxdoc->free(pxdoc, blobdata);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		case pxfBCD: {
+			char *value;
+			if(0 < (ret = PX_get_data_bcd(pxdoc, (unsigned char *) data, pxf->px_fdc, &value))) {
+				print_number(pxdoc, sb, value);
+				pxdoc->free(pxdoc, value);
+			} else {
+				print_null(pxdoc, sb, format);
+			}
+			break;
+		}
+		default:
+			print_null(pxdoc, sb, format);
+			break;
+	}
+	return(ret < 0 ? -1 : 0);
+}
+/* }}} */
+
+/* format_fieldname() {{{
+ * Appends the name of a field. Spaces are replaced by underscores in
+ * sql. Fields without a name are called columnN.
+ */
+int format_fieldname(pxdoc_t *pxdoc, struct str_buffer *sb, pxfield_t *pxf, int fieldno, int format, struct format_options *fo) {
+	char buffer[30];
+	const char *name = pxf->px_fname;
+
+	if(name == NULL || name[0] == '\0') {
+		sprintf(buffer, "column%d", fieldno+1);
+		name = buffer;
+	}
+	if(format == FORMAT_JSON)
+		return(str_buffer_print_json(pxdoc, sb, name, strlen(name)));
+	else if(format == FORMAT_CSV)
+		return(print_csv_string(pxdoc, sb, name, strlen(name), fo));
+	else if(format == FORMAT_TEXT)
+		return(str_buffer_append(pxdoc, sb, name, strlen(name)));
+	else {
+		size_t start = str_buffer_len(pxdoc, sb), i;
+		int ret = str_buffer_append(pxdoc, sb, name, strlen(name));
+		for(i=start; i<sb->cur; i++) {
+			if(sb->buffer[i] == ' ')
+				sb->buffer[i] = '_';
+		}
+		return(ret);
+	}
+}
+/* }}} */
+
+/* format_double() {{{
+ * Appends a floating point number like values of number fields.
+ */
+int format_double(pxdoc_t *pxdoc, struct str_buffer *sb, double value) {
+	char buffer[400];
+
+	sprintf(buffer, "%lf", value);
+	return(print_number(pxdoc, sb, buffer));
+}
+/* }}} */
+
+/* find_field() {{{
+ * Returns the number of the field with the first len chars of name
+ * as its name or -1 if there is no such field. Field names are
+ * compared case insensitive like the --fields option does.
+ */
+int find_field(pxdoc_t *pxdoc, const char *name, int len) {
+	pxfield_t *pxf = PX_get_fields(pxdoc);
+	int i, j;
+
+	for(i=0; i<PX_get_num_fields(pxdoc); i++, pxf++) {
+		for(j=0; j<len; j++) {
+			if(pxf->px_fname[j] == '\0' || tolower((unsigned char) pxf->px_fname[j]) != tolower((unsigned char) name[j]))
+				break;
+		}
+		if(j == len && pxf->px_fname[len] == '\0')
+			return(i);
+	}
+	return -1;
+}
+/* }}} */
+
+/* field_offset() {{{
+ * Returns the offset of a field in the records of the table.
+ */
+int field_offset(pxdoc_t *pxdoc, int field) {
+	pxfield_t *pxf = PX_get_fields(pxdoc);
+	int i, offset = 0;
+
+	for(i=0; i<field; i++)
+		offset += pxf[i].px_flen;
+	return(offset);
+}
+/* }}} */
+
+/* field_type_name() {{{
+ * Returns the name of a field type.
+ */
+const char *field_type_name(int type) {
+	switch(type) {
+		case pxfAlpha: return("alpha");
+		case pxfDate: return("date");
+		case pxfShort: return("short");
+		case pxfLong: return("long");
+		case pxfCurrency: return("currency");
+		case pxfNumber: return("number");
+		case pxfLogical: return("logical");
+		case pxfMemoBLOb: return("memoblob");
+		case pxfBLOb: return("blob");
+		case pxfFmtMemoBLOb: return("fmtmemoblob");
+		case pxfOLE: return("ole");
+		case pxfGraphic: return("graphic");
+		case pxfTime: return("time");
+		case pxfTimestamp: return("timestamp");
+		case pxfAutoInc: return("autoinc");
+		case pxfBCD: return("decimal");
+		case pxfBytes: return("bytes");
+	}
+	return("unknown");
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,28 @@
+#ifndef __FORMAT_H__
+#define __FORMAT_H__
+
+#include "str_buffer.h"
+
+#define FORMAT_SQL  1
+#define FORMAT_JSON 2
+#define FORMAT_CSV  3
+#define FORMAT_TEXT 4
+
+/* Settings which control how field values are formatted */
+struct format_options {
+	char *date_format;
+	char *time_format;
+	char *timestamp_format;
+	int emptystringisnull;
+	char delimiter;         /* only used for csv */
+	char enclosure;
+};
+
+int format_field(pxdoc_t *pxdoc, struct str_buffer *sb, pxfield_t *pxf, char *data, int format, struct format_options *fo);
+int format_fieldname(pxdoc_t *pxdoc, struct str_buffer *sb, pxfield_t *pxf, int fieldno, int format, struct format_options *fo);
+int format_double(pxdoc_t *pxdoc, struct str_buffer *sb, double value);
+int find_field(pxdoc_t *pxdoc, const char *name, int len);
+int field_offset(pxdoc_t *pxdoc, int field);
+const char *field_type_name(int type);
+
+#endif
@@ -0,0 +1,75 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <string.h>
+#include "hash.h"
+
+/* load_le64() {{{
+ * Reads 8 bytes as a little endian number regardless of the
+ * alignment of the pointer. Hashes of the same bytes must be
+ * equal on all architectures, because they are stored in files.
+ */
+static uint64_t load_le64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+#ifdef WORDS_BIGENDIAN
+	v = ((v & 0x00000000000000ffULL) << 56) |
+	    ((v & 0x000000000000ff00ULL) << 40) |
+	    ((v & 0x0000000000ff0000ULL) << 24) |
+	    ((v & 0x00000000ff000000ULL) << 8) |
+	    ((v & 0x000000ff00000000ULL) >> 8) |
+	    ((v & 0x0000ff0000000000ULL) >> 24) |
+	    ((v & 0x00ff000000000000ULL) >> 40) |
+	    ((v & 0xff00000000000000ULL) >> 56);
+#endif
+	return(v);
+}
+/* }}} */
+
+/* hash_bytes() {{{
+ * Calculates a 64 bit hash over len bytes (MurmurHash64A). It processes
+ * 8 bytes per step and is fast enough to fingerprint whole data blocks.
+ */
+px_hash_t hash_bytes(const void *key, size_t len, px_hash_t seed) {
+	const uint64_t m = 0xc6a4a7935bd1e995ULL;
+	const int r = 47;
+	const unsigned char *data = (const unsigned char *) key;
+	const unsigned char *end = data + (len & ~((size_t) 7));
+	uint64_t h = seed ^ (len * m);
+
+	while(data != end) {
+		uint64_t k = load_le64(data);
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+		h ^= k;
+		h *= m;
+		data += 8;
+	}
+
+	switch(len & 7) {
+		case 7: h ^= (uint64_t) data[6] << 48;
+		case 6: h ^= (uint64_t) data[5] << 40;
+		case 5: h ^= (uint64_t) data[4] << 32;
+		case 4: h ^= (uint64_t) data[3] << 24;
+		case 3: h ^= (uint64_t) data[2] << 16;
+		case 2: h ^= (uint64_t) data[1] << 8;
+		case 1: h ^= (uint64_t) data[0];
+			h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+	return(h);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,11 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t px_hash_t;
+
+px_hash_t hash_bytes(const void *key, size_t len, px_hash_t seed);
+
+#endif
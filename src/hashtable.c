@@ -0,0 +1,136 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "hashtable.h"
+
+/* hashtable_new() {{{
+ * Creates a new hash table for keys of keylen bytes. sizehint is
+ * the expected number of entries.
+ */
+struct hashtable *hashtable_new(pxdoc_t *pxdoc, int keylen, size_t sizehint) {
+	struct hashtable *ht;
+	size_t size = 16;
+
+	while(size < 2*sizehint)
+		size *= 2;
+	if(NULL == (ht = pxdoc->malloc(pxdoc, sizeof(struct hashtable), _("Allocate memory for hash table.")))) {
+		return NULL;
+	}
+	if(NULL == (ht->slots = pxdoc->malloc(pxdoc, size * sizeof(struct hashtable_entry), _("Allocate memory for hash table.")))) {
+		pxdoc->free(pxdoc, ht);
+		return NULL;
+	}
+	memset(ht->slots, 0, size * sizeof(struct hashtable_entry));
+	ht->pxdoc = pxdoc;
+	ht->size = size;
+	ht->count = 0;
+	ht->keylen = keylen;
+	return(ht);
+}
+/* }}} */
+
+/* hashtable_delete() {{{
+ * Frees the memory occupied by the hash table but not the keys
+ * and values.
+ */
+void hashtable_delete(struct hashtable *ht) {
+	pxdoc_t *pxdoc = ht->pxdoc;
+	pxdoc->free(pxdoc, ht->slots);
+	pxdoc->free(pxdoc, ht);
+}
+/* }}} */
+
+/* find_slot() {{{
+ * Returns the slot with the given key or the empty slot where it
+ * would have to be inserted.
+ */
+static struct hashtable_entry *find_slot(struct hashtable *ht, const char *key, px_hash_t hash) {
+	size_t mask = ht->size - 1;
+	size_t i = (size_t) hash & mask;
+
+	while(ht->slots[i].key != NULL) {
+		if(ht->slots[i].hash == hash && 0 == memcmp(ht->slots[i].key, key, ht->keylen))
+			break;
+		i = (i + 1) & mask;
+	}
+	return(&(ht->slots[i]));
+}
+/* }}} */
+
+/* grow() {{{
+ * Doubles the number of slots
+ */
+static int grow(struct hashtable *ht) {
+	pxdoc_t *pxdoc = ht->pxdoc;
+	struct hashtable_entry *oldslots = ht->slots;
+	size_t oldsize = ht->size, i;
+
+	if(NULL == (ht->slots = pxdoc->malloc(pxdoc, 2 * oldsize * sizeof(struct hashtable_entry), _("Get more memory for hash table.")))) {
+		ht->slots = oldslots;
+		return -1;
+	}
+	memset(ht->slots, 0, 2 * oldsize * sizeof(struct hashtable_entry));
+	ht->size = 2 * oldsize;
+	for(i=0; i<oldsize; i++) {
+		if(oldslots[i].key != NULL)
+			*find_slot(ht, oldslots[i].key, oldslots[i].hash) = oldslots[i];
+	}
+	pxdoc->free(pxdoc, oldslots);
+	return 0;
+}
+/* }}} */
+
+/* hashtable_lookup() {{{
+ * Returns the entry with the given key or NULL if the key is not
+ * in the table.
+ */
+struct hashtable_entry *hashtable_lookup(struct hashtable *ht, const char *key) {
+	struct hashtable_entry *e;
+	e = find_slot(ht, key, hash_bytes(key, ht->keylen, 0));
+	if(e->key == NULL)
+		return NULL;
+	return(e);
+}
+/* }}} */
+
+/* hashtable_insert() {{{
+ * Returns the entry with the given key. If the key is not in the table
+ * a new entry with a NULL value is created and isnew is set to 1.
+ * Returns NULL if memory is exhausted.
+ */
+struct hashtable_entry *hashtable_insert(struct hashtable *ht, const char *key, int *isnew) {
+	struct hashtable_entry *e;
+	px_hash_t hash;
+
+	if(2 * (ht->count + 1) > ht->size) {
+		if(0 > grow(ht))
+			return NULL;
+	}
+	hash = hash_bytes(key, ht->keylen, 0);
+	e = find_slot(ht, key, hash);
+	if(e->key == NULL) {
+		e->hash = hash;
+		e->key = key;
+		e->value = NULL;
+		ht->count++;
+		if(isnew)
+			*isnew = 1;
+	} else if(isnew) {
+		*isnew = 0;
+	}
+	return(e);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
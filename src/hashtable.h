@@ -0,0 +1,29 @@
+#ifndef __HASHTABLE_H__
+#define __HASHTABLE_H__
+
+#include "hash.h"
+
+/* Slot of a hash table. Empty slots have no key. */
+struct hashtable_entry {
+	px_hash_t hash;
+	const char *key;
+	void *value;
+};
+
+/* Hash table with keys of fixed length. The table does not copy
+ * the keys, they must stay valid as long as the table is used.
+ */
+struct hashtable {
+	pxdoc_t *pxdoc;
+	struct hashtable_entry *slots;
+	size_t size;   /* number of slots, always a power of 2 */
+	size_t count;  /* number of used slots */
+	int keylen;
+};
+
+struct hashtable *hashtable_new(pxdoc_t *pxdoc, int keylen, size_t sizehint);
+void hashtable_delete(struct hashtable *ht);
+struct hashtable_entry *hashtable_lookup(struct hashtable *ht, const char *key);
+struct hashtable_entry *hashtable_insert(struct hashtable *ht, const char *key, int *isnew);
+
+#endif
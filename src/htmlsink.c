@@ -0,0 +1,320 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pxview.h"
+#include "sinkblobs.h"
+
+/* Sink writing an html table with one row for each record. Index files
+ * get three extra columns with the block information of each record.
+ */
+struct html_sink {
+	struct pxview_sink sink;
+	pxdoc_t *allocdoc;      /* document used for allocating the sink */
+	FILE *outfp;
+	struct pxview_html_options options;
+	int isindex;
+	struct sink_blobs blobs;
+	const char *data;       /* current record */
+	int isdeleted;
+};
+
+/* html_begin_table() {{{
+ * Outputs the start of the table and a row with the names and types of
+ * the columns.
+ */
+static int html_begin_table(struct pxview_sink *sink) {
+	struct html_sink *hs = sink->user;
+	FILE *outfp = hs->outfp;
+	pxfield_t *pxf;
+	float filetype;
+	int i;
+
+	PX_get_value(sink->pxdoc, "filetype", &filetype);
+	hs->isindex = ((int) filetype == pxfFileTypPrimIndex) ||
+	              ((int) filetype == pxfFileTypSecIndex) ||
+	              ((int) filetype == pxfFileTypSecIndexG);
+	if(0 > sink_blobs_open(&hs->blobs, sink->pxdoc, hs->options.blobprefix, hs->options.blobextension,
+	                       hs->options.blobstore, hs->options.blobfile, hs->options.streamthreshold, 0))
+		return -1;
+
+	fprintf(outfp, "<table>\n");
+	fprintf(outfp, " <caption>%s</caption>\n", hs->options.tablename);
+	fprintf(outfp, " <tr>\n");
+	pxf = sink->fields;
+	for(i=0; i<sink->numfields; i++, pxf++) {
+		if(sink->selectedfields && !sink->selectedfields[i])
+			continue;
+		fprintf(outfp, "  <th>");
+		if(strlen(pxf->px_fname))
+			fprintf(outfp, "%s", pxf->px_fname);
+		else
+			fprintf(outfp, "column%d", i+1);
+		if(pxf->px_ftype == pxfBCD)
+			fprintf(outfp, ",#,%d,%d", pxf->px_flen*2, pxf->px_fdc);
+		else if(field_type_code(pxf->px_ftype))
+			fprintf(outfp, ",%c,%d", field_type_code(pxf->px_ftype), pxf->px_flen);
+		fprintf(outfp, "</th>\n");
+	}
+	if(hs->options.markdeleted) {
+		fprintf(outfp, "  <th>deleted</th>\n");
+	}
+	fprintf(outfp, " </tr>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_begin_record() {{{
+ */
+static int html_begin_record(struct pxview_sink *sink, int recno, const char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	struct html_sink *hs = sink->user;
+
+	hs->data = data;
+	hs->isdeleted = isdeleted;
+	fprintf(hs->outfp, " <tr valign=\"top\">\n");
+	return(0);
+}
+/* }}} */
+
+/* html_field_null() {{{
+ * Outputs an empty cell. Also used for bytes fields.
+ */
+static int html_field_null(struct pxview_sink *sink, int field, pxfield_t *pxf) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td></td>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_field_string() {{{
+ */
+static int html_field_string(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value, int len) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td>");
+	fwrite(value, 1, len, hs->outfp);
+	fprintf(hs->outfp, "</td>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_field_long() {{{
+ */
+static int html_field_long(struct pxview_sink *sink, int field, pxfield_t *pxf, long value) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td>%ld</td>\n", value);
+	return(0);
+}
+/* }}} */
+
+/* html_field_double() {{{
+ */
+static int html_field_double(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td>%lf</td>\n", value);
+	return(0);
+}
+/* }}} */
+
+/* html_field_bool() {{{
+ */
+static int html_field_bool(struct pxview_sink *sink, int field, pxfield_t *pxf, int value) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td>%d</td>\n", value ? 1 : 0);
+	return(0);
+}
+/* }}} */
+
+/* html_field_timestamp() {{{
+ */
+static int html_field_timestamp(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct html_sink *hs = sink->user;
+	const char *format;
+	char *str;
+
+	switch(pxf->px_ftype) {
+		case pxfDate:
+			format = hs->options.date_format;
+			break;
+		case pxfTime:
+			format = hs->options.time_format;
+			break;
+		default:
+			format = hs->options.timestamp_format;
+	}
+	str = PX_timestamp2string(sink->pxdoc, value, format);
+	fprintf(hs->outfp, "  <td>%s</td>\n", str);
+	sink->pxdoc->free(sink->pxdoc, str);
+	return(0);
+}
+/* }}} */
+
+/* html_field_bcd() {{{
+ */
+static int html_field_bcd(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "  <td>%s</td>\n", value);
+	return(0);
+}
+/* }}} */
+
+/* html_field_blob() {{{
+ * Writes the blob into a file named by its modification number or into
+ * the blob store and outputs the file name.
+ */
+static int html_field_blob(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int size, int number) {
+	struct html_sink *hs = sink->user;
+	char *filename;
+
+	fprintf(hs->outfp, "  <td>");
+	if(NULL != (filename = sink_blobs_file(&hs->blobs, data, size, number))) {
+		fprintf(hs->outfp, "%s", filename);
+		sink->pxdoc->free(sink->pxdoc, filename);
+	}
+	fprintf(hs->outfp, "</td>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_field_blobref() {{{
+ * Copies large blobs in pieces.
+ */
+static int html_field_blobref(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data) {
+	struct html_sink *hs = sink->user;
+	struct blob_location loc;
+	char *filename;
+
+	if(!sink_blobs_locate(&hs->blobs, pxf, data, &loc))
+		return(1);
+	fprintf(hs->outfp, "  <td>");
+	if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
+		blob_stream_copy(hs->blobs.stream, &loc, hs->outfp, '\0', '\0');
+	} else if(NULL != (filename = sink_blobs_stream_file(&hs->blobs, &loc, loc.modnr))) {
+		fprintf(hs->outfp, "%s", filename);
+		sink->pxdoc->free(sink->pxdoc, filename);
+	}
+	fprintf(hs->outfp, "</td>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_field_bytes() {{{
+ */
+static int html_field_bytes(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int len) {
+	return(html_field_null(sink, field, pxf));
+}
+/* }}} */
+
+/* html_end_record() {{{
+ * Outputs the block information of an index record and the deletion
+ * flag.
+ */
+static int html_end_record(struct pxview_sink *sink) {
+	struct html_sink *hs = sink->user;
+
+	if(hs->isindex) {
+		pxfield_t *pxf = sink->fields;
+		int i, offset = 0;
+		short int value;
+		for(i=0; i<sink->numfields; i++)
+			offset += pxf[i].px_flen;
+		for(i=0; i<3; i++, offset += 2) {
+			if(0 < PX_get_data_short(sink->pxdoc, (char *) &hs->data[offset], 2, &value))
+				fprintf(hs->outfp, "  <td>%d</td>\n", value);
+		}
+	}
+	if(hs->options.markdeleted) {
+		fprintf(hs->outfp, "  <td>%d</td>\n", hs->isdeleted);
+	}
+	fprintf(hs->outfp, " <tr>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_end_table() {{{
+ */
+static int html_end_table(struct pxview_sink *sink) {
+	struct html_sink *hs = sink->user;
+
+	fprintf(hs->outfp, "</table>\n");
+	return(0);
+}
+/* }}} */
+
+/* html_destroy() {{{
+ */
+static void html_destroy(struct pxview_sink *sink) {
+	struct html_sink *hs = sink->user;
+
+	sink_blobs_close(&hs->blobs);
+	hs->allocdoc->free(hs->allocdoc, hs);
+}
+/* }}} */
+
+/* pxview_html_sink_new() {{{
+ * Creates a sink writing an html table into outfp. pxdoc is only used
+ * for allocating memory. Returns NULL on failure.
+ */
+struct pxview_sink *pxview_html_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_html_options *options) {
+	struct html_sink *hs;
+
+	if(NULL == (hs = pxdoc->malloc(pxdoc, sizeof(struct html_sink), _("Allocate memory for html output.")))) {
+		return NULL;
+	}
+	memset(hs, 0, sizeof(struct html_sink));
+	hs->allocdoc = pxdoc;
+	hs->outfp = outfp;
+	hs->options = *options;
+	if(!hs->options.tablename)
+		hs->options.tablename = "";
+	if(!hs->options.blobprefix)
+		hs->options.blobprefix = "blob";
+	if(!hs->options.blobextension)
+		hs->options.blobextension = "blob";
+	if(!hs->options.date_format)
+		hs->options.date_format = "Y-m-d";
+	if(!hs->options.time_format)
+		hs->options.time_format = "H:i:s";
+	if(!hs->options.timestamp_format)
+		hs->options.timestamp_format = "Y-m-d H:i:s";
+	hs->sink.user = hs;
+	hs->sink.pxdoc = pxdoc;
+	hs->sink.begin_table = html_begin_table;
+	hs->sink.begin_record = html_begin_record;
+	hs->sink.field_null = html_field_null;
+	hs->sink.field_string = html_field_string;
+	hs->sink.field_long = html_field_long;
+	hs->sink.field_double = html_field_double;
+	hs->sink.field_bool = html_field_bool;
+	hs->sink.field_timestamp = html_field_timestamp;
+	hs->sink.field_bcd = html_field_bcd;
+	hs->sink.field_blob = html_field_blob;
+	if(hs->options.blobfile && hs->options.streamthreshold > 0)
+		hs->sink.field_blobref = html_field_blobref;
+	hs->sink.field_bytes = html_field_bytes;
+	hs->sink.end_record = html_end_record;
+	hs->sink.end_table = html_end_table;
+	hs->sink.destroy = html_destroy;
+	return(&hs->sink);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,177 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "pxview_intern.h"
+#include "json.h"
+#include "inventory.h"
+
+/* The inventory lists one line per file with the values from its
+ * header as a JSON object or a CSV row. Only the header of a file is
+ * read, which pxlib does when opening the file, the data blocks are
+ * never touched.
+ */
+
+/* filetype_name() {{{
+ */
+static const char *filetype_name(int filetype) {
+	switch(filetype) {
+		case pxfFileTypIndexDB: return("indexed-db");
+		case pxfFileTypPrimIndex: return("primary-index");
+		case pxfFileTypNonIndexDB: return("non-indexed-db");
+		case pxfFileTypNonIncSecIndex: return("non-inc-secondary-index");
+		case pxfFileTypSecIndex: return("secondary-index");
+		case pxfFileTypIncSecIndex: return("inc-secondary-index");
+		case pxfFileTypNonIncSecIndexG: return("non-inc-secondary-index-g");
+		case pxfFileTypSecIndexG: return("secondary-index-g");
+		case pxfFileTypIncSecIndexG: return("inc-secondary-index-g");
+	}
+	return("unknown");
+}
+/* }}} */
+
+/* csv_print_string() {{{
+ * Prints a string enclosed in double quotes, doubling quotes within.
+ */
+static void csv_print_string(FILE *outfp, const char *str) {
+	fputc('"', outfp);
+	for(; *str != '\0'; str++) {
+		if(*str == '"')
+			fputc('"', outfp);
+		fputc(*str, outfp);
+	}
+	fputc('"', outfp);
+}
+/* }}} */
+
+/* inventory_header() {{{
+ * Prints the names of the columns of CSV output. JSON lines need no
+ * header.
+ */
+void inventory_header(FILE *outfp, int format) {
+	if(format == FORMAT_CSV)
+		fprintf(outfp, "file,fileversion,filetype,tablename,numrecords,numfields,numblocks,recordsize,primarykeyfields,codepage,encryption,updatetime,fields,error\n");
+}
+/* }}} */
+
+/* inventory_error() {{{
+ * Lists a file which cannot be read with the error.
+ */
+void inventory_error(FILE *outfp, const char *filename, int format, const char *error) {
+	if(format == FORMAT_JSON) {
+		fprintf(outfp, "{\"file\": ");
+		json_print_string(outfp, filename);
+		fprintf(outfp, ", \"error\": ");
+		json_print_string(outfp, error);
+		fprintf(outfp, "}\n");
+	} else {
+		csv_print_string(outfp, filename);
+		fprintf(outfp, ",,,,,,,,,,,,,");
+		csv_print_string(outfp, error);
+		fprintf(outfp, "\n");
+	}
+}
+/* }}} */
+
+/* inventory_file() {{{
+ * Prints the values from the header of a file. A file which cannot be
+ * opened is listed with the error.
+ */
+void inventory_file(FILE *outfp, const char *filename, int format, pxview_errorhandler_t errorhandler) {
+	pxdoc_t *pxdoc;
+	pxhead_t *pxh;
+	pxfield_t *pxf;
+	char *tablename, updatetime[30];
+	float number;
+	int i, numfields;
+	time_t t;
+
+	if(NULL == (pxdoc = PX_new2(errorhandler, NULL, NULL, NULL))) {
+		inventory_error(outfp, filename, format, _("Could not create new paradox instance."));
+		return;
+	}
+	if(0 > PX_open_file(pxdoc, filename)) {
+		inventory_error(outfp, filename, format, _("Could not open input file."));
+		PX_delete(pxdoc);
+		return;
+	}
+	pxh = pxdoc->px_head;
+	numfields = PX_get_num_fields(pxdoc);
+	pxf = PX_get_fields(pxdoc);
+	PX_get_parameter(pxdoc, "tablename", &tablename);
+	t = (time_t) pxh->px_fileupdatetime;
+	updatetime[0] = '\0';
+	if(t > 0)
+		strftime(updatetime, sizeof(updatetime), "%Y-%m-%d %H:%M:%S", localtime(&t));
+
+	if(format == FORMAT_JSON) {
+		fprintf(outfp, "{\"file\": ");
+		json_print_string(outfp, filename);
+		fprintf(outfp, ", \"fileversion\": \"%1.1f\"", (float) pxh->px_fileversion/10.0);
+		fprintf(outfp, ", \"filetype\": \"%s\"", filetype_name(pxh->px_filetype));
+		fprintf(outfp, ", \"tablename\": ");
+		json_print_string(outfp, tablename ? tablename : "");
+		fprintf(outfp, ", \"numrecords\": %d", PX_get_num_records(pxdoc));
+		fprintf(outfp, ", \"numfields\": %d", numfields);
+		PX_get_value(pxdoc, "numblocks", &number);
+		fprintf(outfp, ", \"numblocks\": %d", (int) number);
+		fprintf(outfp, ", \"recordsize\": %d", pxh->px_recordsize);
+		PX_get_value(pxdoc, "primarykeyfields", &number);
+		fprintf(outfp, ", \"primarykeyfields\": %d", (int) number);
+		PX_get_value(pxdoc, "codepage", &number);
+		fprintf(outfp, ", \"codepage\": %d", (int) number);
+		fprintf(outfp, ", \"encryption\": %lu", pxh->px_encryption);
+		fprintf(outfp, ", \"updatetime\": ");
+		if(updatetime[0])
+			json_print_string(outfp, updatetime);
+		else
+			fprintf(outfp, "null");
+		fprintf(outfp, ", \"fields\": [");
+		for(i=0; i<numfields; i++) {
+			fprintf(outfp, "%s{\"name\": ", i ? ", " : "");
+			json_print_string(outfp, pxf[i].px_fname);
+			fprintf(outfp, ", \"type\": \"%s\", \"length\": %d}", field_type_name(pxf[i].px_ftype), pxf[i].px_flen);
+		}
+		fprintf(outfp, "]}\n");
+	} else {
+		csv_print_string(outfp, filename);
+		fprintf(outfp, ",%1.1f,%s,", (float) pxh->px_fileversion/10.0, filetype_name(pxh->px_filetype));
+		csv_print_string(outfp, tablename ? tablename : "");
+		fprintf(outfp, ",%d,%d", PX_get_num_records(pxdoc), numfields);
+		PX_get_value(pxdoc, "numblocks", &number);
+		fprintf(outfp, ",%d,%d", (int) number, pxh->px_recordsize);
+		PX_get_value(pxdoc, "primarykeyfields", &number);
+		fprintf(outfp, ",%d", (int) number);
+		PX_get_value(pxdoc, "codepage", &number);
+		fprintf(outfp, ",%d,%lu,%s,\"", (int) number, pxh->px_encryption, updatetime);
+		/* All fields go into one column as name:type(length) */
+		for(i=0; i<numfields; i++) {
+			const char *ptr;
+			if(i)
+				fputc(';', outfp);
+			for(ptr=pxf[i].px_fname; *ptr; ptr++) {
+				if(*ptr == '"')
+					fputc('"', outfp);
+				fputc(*ptr, outfp);
+			}
+			fprintf(outfp, ":%s(%d)", field_type_name(pxf[i].px_ftype), pxf[i].px_flen);
+		}
+		fprintf(outfp, "\",\n");
+	}
+
+	PX_close(pxdoc);
+	PX_delete(pxdoc);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
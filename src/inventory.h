@@ -0,0 +1,11 @@
+#ifndef __INVENTORY_H__
+#define __INVENTORY_H__
+
+#include <stdio.h>
+#include "format.h"
+
+void inventory_header(FILE *outfp, int format);
+void inventory_error(FILE *outfp, const char *filename, int format, const char *error);
+void inventory_file(FILE *outfp, const char *filename, int format, pxview_errorhandler_t errorhandler);
+
+#endif
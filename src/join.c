@@ -0,0 +1,577 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "format.h"
+#include "join.h"
+
+/* If the records of the smaller table do not fit into the hash table,
+ * the records of both tables are distributed into partitions on disk by
+ * the hash value of their key. Matching records always end up in the
+ * same partition, so the partitions can be joined one after the other.
+ */
+
+/* Seed of the hash which selects the partition. It differs from the
+ * seed of the hash table, otherwise all keys of a partition would
+ * crowd into the same slots.
+ */
+#define JOIN_PARTITION_SEED 0x6a6f696eULL
+
+/* is_blob() {{{
+ */
+static int is_blob(int type) {
+	switch(type) {
+		case pxfMemoBLOb:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfGraphic:
+		case pxfOLE:
+			return 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* parse_condition() {{{
+ * Parses the pair of fields 'field=otherfield' starting at spec and
+ * stores their offsets and lengths as key number k. Returns the position
+ * after the pair or NULL on error.
+ */
+static const char *parse_condition(struct record_join *rj, const char *spec, int k) {
+	pxfield_t *pxf, *otherpxf;
+	const char *end, *eq;
+	int f, otherf;
+
+	if(NULL == (end = strchr(spec, ',')))
+		end = spec + strlen(spec);
+	for(eq=spec; eq<end && *eq != '='; eq++)
+		;
+	if(eq == end) {
+		fprintf(stderr, _("Join condition '%.*s' must have the form FIELD=FIELD."), (int) (end-spec), spec);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	if(0 > (f = find_field(rj->docs[0], spec, eq-spec))) {
+		fprintf(stderr, _("There is no field '%.*s' to join on."), (int) (eq-spec), spec);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	if(0 > (otherf = find_field(rj->docs[1], eq+1, end-eq-1))) {
+		fprintf(stderr, _("There is no field '%.*s' in the joined table."), (int) (end-eq-1), eq+1);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	pxf = &(PX_get_fields(rj->docs[0])[f]);
+	otherpxf = &(PX_get_fields(rj->docs[1])[otherf]);
+	if(is_blob(pxf->px_ftype) || is_blob(otherpxf->px_ftype)) {
+		fprintf(stderr, _("Blob fields cannot be joined."));
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	/* Raw values are only equal if the fields have the same type.
+	 * Alpha fields of different length are padded with zeros.
+	 */
+	if(pxf->px_ftype != otherpxf->px_ftype ||
+	   (pxf->px_ftype != pxfAlpha && pxf->px_flen != otherpxf->px_flen) ||
+	   (pxf->px_ftype == pxfBCD && pxf->px_fdc != otherpxf->px_fdc)) {
+		fprintf(stderr, _("Field '%s' cannot be joined with field '%s' of a different type."), pxf->px_fname, otherpxf->px_fname);
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	rj->keyoffsets[0][k] = field_offset(rj->docs[0], f);
+	rj->keylens[0][k] = pxf->px_flen;
+	rj->keyoffsets[1][k] = field_offset(rj->docs[1], otherf);
+	rj->keylens[1][k] = otherpxf->px_flen;
+	rj->keylen += pxf->px_flen > otherpxf->px_flen ? pxf->px_flen : otherpxf->px_flen;
+	return(*end == ',' ? end+1 : end);
+}
+/* }}} */
+
+/* record_join_new() {{{
+ * Prepares the join of the table pxdoc with otherdoc on the comma
+ * separated list of conditions in on. Each condition has the form
+ * 'field=otherfield'. Joined records consist of all fields of pxdoc
+ * followed by the fields of otherdoc except for blobs, which cannot
+ * be read from the blob file of pxdoc. Fields of otherdoc named like a
+ * field of pxdoc get prefix and '_' prepended. memory is the maximum
+ * size of the hash table in MB.
+ */
+struct record_join *record_join_new(pxdoc_t *pxdoc, pxdoc_t *otherdoc, const char *on, const char *prefix, int memory) {
+	struct record_join *rj;
+	pxfield_t *pxf;
+	const char *ptr;
+	int i, numconditions, offset;
+
+	if(NULL == (rj = pxdoc->malloc(pxdoc, sizeof(struct record_join), _("Allocate memory for join.")))) {
+		return NULL;
+	}
+	memset(rj, 0, sizeof(struct record_join));
+	rj->pxdoc = pxdoc;
+	rj->docs[0] = pxdoc;
+	rj->docs[1] = otherdoc;
+	rj->memory = (size_t) (memory > 0 ? memory : JOIN_MEMORY) * 1024 * 1024;
+
+	/* Key fields */
+	numconditions = 1;
+	for(ptr=on; *ptr; ptr++) {
+		if(*ptr == ',')
+			numconditions++;
+	}
+	if(NULL == (rj->keyoffsets[0] = pxdoc->malloc(pxdoc, 4 * numconditions * sizeof(int), _("Allocate memory for join.")))) {
+		record_join_delete(rj);
+		return NULL;
+	}
+	rj->keylens[0] = rj->keyoffsets[0] + numconditions;
+	rj->keyoffsets[1] = rj->keylens[0] + numconditions;
+	rj->keylens[1] = rj->keyoffsets[1] + numconditions;
+	ptr = on;
+	while(*ptr) {
+		if(NULL == (ptr = parse_condition(rj, ptr, rj->numkeys))) {
+			record_join_delete(rj);
+			return NULL;
+		}
+		rj->numkeys++;
+	}
+	if(rj->numkeys == 0) {
+		fprintf(stderr, _("No fields to join on."));
+		fprintf(stderr, "\n");
+		record_join_delete(rj);
+		return NULL;
+	}
+
+	/* Fields of the joined records */
+	rj->recordsizes[0] = field_offset(pxdoc, PX_get_num_fields(pxdoc));
+	rj->recordsizes[1] = field_offset(otherdoc, PX_get_num_fields(otherdoc));
+	if(NULL == (rj->fields = pxdoc->malloc(pxdoc, (PX_get_num_fields(pxdoc) + PX_get_num_fields(otherdoc)) * sizeof(pxfield_t), _("Allocate memory for join.")))) {
+		record_join_delete(rj);
+		return NULL;
+	}
+	if(NULL == (rj->otheroffsets = pxdoc->malloc(pxdoc, PX_get_num_fields(otherdoc) * sizeof(int), _("Allocate memory for join.")))) {
+		record_join_delete(rj);
+		return NULL;
+	}
+	memcpy(rj->fields, PX_get_fields(pxdoc), PX_get_num_fields(pxdoc) * sizeof(pxfield_t));
+	rj->numfields = PX_get_num_fields(pxdoc);
+	rj->recordsize = rj->recordsizes[0];
+	pxf = PX_get_fields(otherdoc);
+	for(i=0, offset=0; i<PX_get_num_fields(otherdoc); offset+=pxf[i].px_flen, i++) {
+		pxfield_t *f = &(rj->fields[rj->numfields]);
+		const char *name = pxf[i].px_fname;
+
+		if(is_blob(pxf[i].px_ftype))
+			continue;
+		*f = pxf[i];
+		if(0 <= find_field(pxdoc, name, strlen(name))) {
+			if(NULL == (f->px_fname = pxdoc->malloc(pxdoc, strlen(prefix) + strlen(name) + 2, _("Allocate memory for field name.")))) {
+				record_join_delete(rj);
+				return NULL;
+			}
+			sprintf(f->px_fname, "%s_%s", prefix, name);
+		} else {
+			if(NULL == (f->px_fname = pxdoc->malloc(pxdoc, strlen(name) + 1, _("Allocate memory for field name.")))) {
+				record_join_delete(rj);
+				return NULL;
+			}
+			strcpy(f->px_fname, name);
+		}
+		rj->otheroffsets[rj->numotherfields++] = offset;
+		rj->numfields++;
+		rj->recordsize += f->px_flen;
+	}
+	return(rj);
+}
+/* }}} */
+
+/* free_table() {{{
+ * Frees the hash table and the records in it.
+ */
+static void free_table(struct record_join *rj) {
+	pxdoc_t *pxdoc = rj->pxdoc;
+	int i;
+
+	if(rj->table) {
+		hashtable_delete(rj->table);
+		rj->table = NULL;
+	}
+	for(i=0; i<rj->numchunks; i++)
+		pxdoc->free(pxdoc, rj->chunks[i]);
+	if(rj->chunks)
+		pxdoc->free(pxdoc, rj->chunks);
+	rj->chunks = NULL;
+	rj->numchunks = 0;
+	rj->chunkused = 0;
+	rj->match = NULL;
+}
+/* }}} */
+
+/* finish() {{{
+ * Frees everything which was needed while the records were joined.
+ */
+static void finish(struct record_join *rj) {
+	pxdoc_t *pxdoc = rj->pxdoc;
+	int i;
+
+	free_table(rj);
+	/* A sort is deleted by the iterator only after its last record */
+	if(rj->sources[0].sort)
+		record_sort_delete(rj->sources[0].sort);
+	rj->sources[0].sort = NULL;
+	for(i=0; i<rj->numpartitions; i++) {
+		if(rj->partitions[i].build)
+			fclose(rj->partitions[i].build);
+		if(rj->partitions[i].probe)
+			fclose(rj->partitions[i].probe);
+	}
+	if(rj->partitions)
+		pxdoc->free(pxdoc, rj->partitions);
+	rj->partitions = NULL;
+	rj->numpartitions = 0;
+	if(rj->key)
+		pxdoc->free(pxdoc, rj->key);
+	rj->key = NULL;
+	if(rj->probe)
+		pxdoc->free(pxdoc, rj->probe);
+	rj->probe = NULL;
+}
+/* }}} */
+
+/* record_join_delete() {{{
+ */
+void record_join_delete(struct record_join *rj) {
+	pxdoc_t *pxdoc = rj->pxdoc;
+	int i;
+
+	finish(rj);
+	for(i=rj->numfields-rj->numotherfields; i<rj->numfields; i++)
+		pxdoc->free(pxdoc, rj->fields[i].px_fname);
+	if(rj->fields)
+		pxdoc->free(pxdoc, rj->fields);
+	if(rj->otheroffsets)
+		pxdoc->free(pxdoc, rj->otheroffsets);
+	if(rj->keyoffsets[0])
+		pxdoc->free(pxdoc, rj->keyoffsets[0]);
+	pxdoc->free(pxdoc, rj);
+}
+/* }}} */
+
+/* make_key() {{{
+ * Copies the key fields of a record of the given side into key. Returns
+ * 0 if one of the key fields is NULL, because NULL equals no value.
+ */
+static int make_key(struct record_join *rj, int side, const char *record, char *key) {
+	int i, j;
+
+	for(i=0; i<rj->numkeys; i++) {
+		const char *value = record + rj->keyoffsets[side][i];
+		int len = rj->keylens[side][i];
+		int otherlen = rj->keylens[1-side][i];
+
+		for(j=0; j<len && value[j] == '\0'; j++)
+			;
+		if(j == len)
+			return 0;
+		memcpy(key, value, len);
+		if(otherlen > len) {
+			memset(key+len, 0, otherlen-len);
+			len = otherlen;
+		}
+		key += len;
+	}
+	return 1;
+}
+/* }}} */
+
+/* entry_size() {{{
+ * Returns the size of a record of the given side in the hash table.
+ */
+static size_t entry_size(struct record_join *rj, int side) {
+	return((sizeof(struct join_entry) + rj->keylen + rj->recordsizes[side] + 7) & ~((size_t) 7));
+}
+/* }}} */
+
+/* add_entry() {{{
+ * Puts a record of the build side into the hash table. key must have
+ * been set by make_key(). Records with equal keys form a ring whose last
+ * record is stored in the hash table, so they are returned in the order
+ * they were added.
+ */
+static int add_entry(struct record_join *rj, int recno, int isdeleted, const char *record) {
+	pxdoc_t *pxdoc = rj->pxdoc;
+	struct hashtable_entry *he;
+	struct join_entry *e, *last;
+	size_t size = entry_size(rj, rj->buildside);
+	size_t chunksize = size > JOIN_CHUNKSIZE ? size : JOIN_CHUNKSIZE;
+	int isnew;
+
+	if(rj->numchunks == 0 || rj->chunkused + size > chunksize) {
+		if(NULL == (rj->chunks = pxdoc->realloc(pxdoc, rj->chunks, (rj->numchunks+1) * sizeof(char *), _("Allocate memory for join.")))) {
+			rj->numchunks = 0;
+			return -1;
+		}
+		if(NULL == (rj->chunks[rj->numchunks] = pxdoc->malloc(pxdoc, chunksize, _("Allocate memory for join.")))) {
+			return -1;
+		}
+		rj->numchunks++;
+		rj->chunkused = 0;
+	}
+	e = (struct join_entry *) (rj->chunks[rj->numchunks-1] + rj->chunkused);
+	rj->chunkused += size;
+	e->recno = recno;
+	e->isdeleted = isdeleted;
+	e->key = (char *) (e+1);
+	e->record = e->key + rj->keylen;
+	memcpy(e->key, rj->key, rj->keylen);
+	memcpy(e->record, record, rj->recordsizes[rj->buildside]);
+
+	if(NULL == (he = hashtable_insert(rj->table, e->key, &isnew)))
+		return -1;
+	if(isnew) {
+		e->next = e;
+	} else {
+		last = he->value;
+		e->next = last->next;
+		last->next = e;
+	}
+	he->value = e;
+	return 0;
+}
+/* }}} */
+
+/* write_entry() {{{
+ */
+static int write_entry(FILE *fp, int recno, int isdeleted, const char *record, int recordsize) {
+	if(1 != fwrite(&recno, sizeof(int), 1, fp) ||
+	   1 != fwrite(&isdeleted, sizeof(int), 1, fp) ||
+	   1 != fwrite(record, recordsize, 1, fp)) {
+		fprintf(stderr, _("Could not write temporary file for join."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* read_entry() {{{
+ * Returns 1 if a record was read and 0 at the end of the file.
+ */
+static int read_entry(FILE *fp, int *recno, int *isdeleted, char *record, int recordsize) {
+	if(1 != fread(recno, sizeof(int), 1, fp) ||
+	   1 != fread(isdeleted, sizeof(int), 1, fp) ||
+	   1 != fread(record, recordsize, 1, fp))
+		return 0;
+	return 1;
+}
+/* }}} */
+
+/* load_partition() {{{
+ * Puts the records of the build side of partition p into the hash table
+ * and prepares reading the records of the probe side.
+ */
+static int load_partition(struct record_join *rj, int p) {
+	struct join_partition *part = &(rj->partitions[p]);
+	int recno, isdeleted;
+	long size;
+
+	free_table(rj);
+	size = ftell(part->build);
+	if(NULL == (rj->table = hashtable_new(rj->pxdoc, rj->keylen, size / (2*sizeof(int) + rj->recordsizes[rj->buildside]))))
+		return -1;
+	rewind(part->build);
+	while(read_entry(part->build, &recno, &isdeleted, rj->probe, rj->recordsizes[rj->buildside])) {
+		make_key(rj, rj->buildside, rj->probe, rj->key);
+		if(0 > add_entry(rj, recno, isdeleted, rj->probe))
+			return -1;
+	}
+	fclose(part->build);
+	part->build = NULL;
+	rewind(part->probe);
+	return 0;
+}
+/* }}} */
+
+/* record_join_start() {{{
+ * Starts joining the records returned by iter with all records of the
+ * other table. The join takes over iter with all its stages, iter is
+ * reset to an empty iterator. The records of the smaller table are read
+ * into the hash table, or if it would exceed the memory limit, the
+ * records of both tables are distributed into partitions. Returns 0 on
+ * success and -1 on error.
+ */
+int record_join_start(struct record_join *rj, struct record_iter *iter) {
+	pxdoc_t *pxdoc = rj->pxdoc;
+	double sizes[2], needed;
+	int s, side, recno, isdeleted, ret;
+
+	finish(rj);
+	rj->sources[0] = *iter;
+	record_iter_init(iter, iter->pxdoc, 0, iter->presetdeleted);
+	record_iter_init(&(rj->sources[1]), rj->docs[1], PX_get_num_records(rj->docs[1]), 0);
+	for(s=0; s<2; s++)
+		sizes[s] = (double) rj->sources[s].numrecords * entry_size(rj, s);
+	rj->buildside = (sizes[1] <= sizes[0]) ? 1 : 0;
+
+	if(NULL == (rj->key = pxdoc->malloc(pxdoc, rj->keylen, _("Allocate memory for join.")))) {
+		return -1;
+	}
+	if(NULL == (rj->probe = pxdoc->malloc(pxdoc, rj->recordsizes[0] > rj->recordsizes[1] ? rj->recordsizes[0] : rj->recordsizes[1], _("Allocate memory for join.")))) {
+		finish(rj);
+		return -1;
+	}
+
+	/* The slots of the hash table take at most twice the size of an entry */
+	needed = sizes[rj->buildside] + 2.0 * rj->sources[rj->buildside].numrecords * sizeof(struct hashtable_entry);
+	if(needed <= rj->memory) {
+		if(NULL == (rj->table = hashtable_new(pxdoc, rj->keylen, rj->sources[rj->buildside].numrecords))) {
+			finish(rj);
+			return -1;
+		}
+		while(0 != (ret = record_iter_next(&(rj->sources[rj->buildside]), &recno, rj->probe, &isdeleted, NULL))) {
+			if(0 > ret) {
+				fprintf(stderr, _("Couldn't get record number %d\n"), recno);
+				continue;
+			}
+			if(make_key(rj, rj->buildside, rj->probe, rj->key) &&
+			   0 > add_entry(rj, recno, isdeleted, rj->probe)) {
+				finish(rj);
+				return -1;
+			}
+		}
+		return 0;
+	}
+
+	rj->numpartitions = (int) (needed / rj->memory) + 1;
+	if(rj->numpartitions > JOIN_MAXPARTITIONS)
+		rj->numpartitions = JOIN_MAXPARTITIONS;
+	if(NULL == (rj->partitions = pxdoc->malloc(pxdoc, rj->numpartitions * sizeof(struct join_partition), _("Allocate memory for join.")))) {
+		rj->numpartitions = 0;
+		finish(rj);
+		return -1;
+	}
+	memset(rj->partitions, 0, rj->numpartitions * sizeof(struct join_partition));
+	for(s=0; s<rj->numpartitions; s++) {
+		if(NULL == (rj->partitions[s].build = tmpfile()) ||
+		   NULL == (rj->partitions[s].probe = tmpfile())) {
+			fprintf(stderr, _("Could not create temporary file for join."));
+			fprintf(stderr, "\n");
+			finish(rj);
+			return -1;
+		}
+	}
+	for(s=0; s<2; s++) {
+		side = (s == 0) ? rj->buildside : 1-rj->buildside;
+		while(0 != (ret = record_iter_next(&(rj->sources[side]), &recno, rj->probe, &isdeleted, NULL))) {
+			struct join_partition *part;
+			if(0 > ret) {
+				fprintf(stderr, _("Couldn't get record number %d\n"), recno);
+				continue;
+			}
+			if(!make_key(rj, side, rj->probe, rj->key))
+				continue;
+			part = &(rj->partitions[hash_bytes(rj->key, rj->keylen, JOIN_PARTITION_SEED) % rj->numpartitions]);
+			if(0 > write_entry(side == rj->buildside ? part->build : part->probe, recno, isdeleted, rj->probe, rj->recordsizes[side])) {
+				finish(rj);
+				return -1;
+			}
+		}
+	}
+	rj->curpartition = -1;
+	return 0;
+}
+/* }}} */
+
+/* next_probe() {{{
+ * Reads the next record of the probe side whose key is not NULL.
+ * Returns 1 if a record was read, 0 if there are no more records and
+ * -1 on error.
+ */
+static int next_probe(struct record_join *rj) {
+	int side = 1-rj->buildside;
+	int ret;
+
+	for(;;) {
+		if(NULL == rj->partitions) {
+			ret = record_iter_next(&(rj->sources[side]), &(rj->proberecno), rj->probe, &(rj->probedeleted), NULL);
+			if(ret == 0)
+				return 0;
+			if(0 > ret) {
+				fprintf(stderr, _("Couldn't get record number %d\n"), rj->proberecno);
+				continue;
+			}
+		} else if(rj->curpartition < 0 ||
+		          !read_entry(rj->partitions[rj->curpartition].probe, &(rj->proberecno), &(rj->probedeleted), rj->probe, rj->recordsizes[side])) {
+			if(rj->curpartition+1 >= rj->numpartitions)
+				return 0;
+			if(0 > load_partition(rj, ++rj->curpartition))
+				return -1;
+			continue;
+		}
+		if(make_key(rj, side, rj->probe, rj->key))
+			return 1;
+	}
+}
+/* }}} */
+
+/* record_join_next() {{{
+ * Puts the next joined record into data, which must have space for
+ * recordsize bytes. recno and isdeleted are taken from the record of
+ * the output table. Returns 1 if a record was returned, 0 if there are
+ * no more records and -1 on error.
+ */
+int record_join_next(struct record_join *rj, int *recno, char *data, int *isdeleted) {
+	struct hashtable_entry *he;
+	struct join_entry *e;
+	const char *record, *otherrecord;
+	char *ptr;
+	int i, ret, deleted;
+
+	while(NULL == rj->match) {
+		if(NULL == rj->probe)
+			return 0;
+		if(0 >= (ret = next_probe(rj))) {
+			finish(rj);
+			return ret;
+		}
+		if(NULL != (he = hashtable_lookup(rj->table, rj->key))) {
+			rj->lastmatch = he->value;
+			rj->match = rj->lastmatch->next;
+		}
+	}
+
+	e = rj->match;
+	rj->match = (e == rj->lastmatch) ? NULL : e->next;
+	if(rj->buildside == 0) {
+		record = e->record;
+		otherrecord = rj->probe;
+		*recno = e->recno;
+		deleted = e->isdeleted;
+	} else {
+		record = rj->probe;
+		otherrecord = e->record;
+		*recno = rj->proberecno;
+		deleted = rj->probedeleted;
+	}
+	if(isdeleted)
+		*isdeleted = deleted;
+
+	memcpy(data, record, rj->recordsizes[0]);
+	ptr = data + rj->recordsizes[0];
+	for(i=0; i<rj->numotherfields; i++) {
+		int len = rj->fields[rj->numfields-rj->numotherfields+i].px_flen;
+		memcpy(ptr, otherrecord + rj->otheroffsets[i], len);
+		ptr += len;
+	}
+	return 1;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,74 @@
+#ifndef __JOIN_H__
+#define __JOIN_H__
+
+#include <stdio.h>
+#include "hashtable.h"
+#include "recorditer.h"
+
+/* Default amount of memory for the hash table in MB */
+#define JOIN_MEMORY 64
+/* Maximum number of partitions if the hash table does not fit into memory */
+#define JOIN_MAXPARTITIONS 256
+/* Size of the memory chunks the records of the hash table are stored in */
+#define JOIN_CHUNKSIZE (1024*1024)
+
+/* Record in the hash table. Records with equal keys are chained. */
+struct join_entry {
+	struct join_entry *next;
+	int recno;
+	int isdeleted;
+	char *key;
+	char *record;
+};
+
+/* Records of both tables whose keys have the same hash value modulo
+ * the number of partitions, if the hash table does not fit into memory.
+ */
+struct join_partition {
+	FILE *build;
+	FILE *probe;
+};
+
+/* Inner join of the output table (side 0) with another table (side 1)
+ * on one or more pairs of fields with equal values. The records of the
+ * smaller table are put into a hash table and the records of the
+ * larger table are looked up in it.
+ */
+struct record_join {
+	pxdoc_t *pxdoc;
+	pxdoc_t *docs[2];
+	int numkeys;
+	int *keyoffsets[2];     /* offset of each key field in both tables */
+	int *keylens[2];        /* length of each key field in both tables */
+	int keylen;             /* alpha fields are padded to the longer length */
+	int recordsizes[2];
+	int numotherfields;     /* fields of other table in joined records */
+	int *otheroffsets;
+	pxfield_t *fields;      /* fields of joined records */
+	int numfields;
+	int recordsize;         /* size of joined record */
+	size_t memory;          /* maximum size of hash table in bytes */
+	/* state while records are joined */
+	struct record_iter sources[2];
+	int buildside;
+	struct hashtable *table;
+	char **chunks;
+	int numchunks;
+	size_t chunkused;       /* bytes used in last chunk */
+	struct join_partition *partitions;
+	int numpartitions;
+	int curpartition;
+	char *key;
+	char *probe;            /* current record of probe side */
+	int proberecno;
+	int probedeleted;
+	struct join_entry *match;   /* next record matching the probe */
+	struct join_entry *lastmatch;
+};
+
+struct record_join *record_join_new(pxdoc_t *pxdoc, pxdoc_t *otherdoc, const char *on, const char *prefix, int memory);
+void record_join_delete(struct record_join *rj);
+int record_join_start(struct record_join *rj, struct record_iter *iter);
+int record_join_next(struct record_join *rj, int *recno, char *data, int *isdeleted);
+
+#endif
@@ -0,0 +1,85 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "json.h"
+
+/* json_escape() {{{
+ * Returns the escape sequence for c or NULL if c can be output as is.
+ * buf must have space for at least 7 chars.
+ */
+static const char *json_escape(unsigned char c, char *buf) {
+	switch(c) {
+		case '"': return("\\\"");
+		case '\\': return("\\\\");
+		case '\b': return("\\b");
+		case '\f': return("\\f");
+		case '\n': return("\\n");
+		case '\r': return("\\r");
+		case '\t': return("\\t");
+	}
+	if(c < 0x20) {
+		sprintf(buf, "\\u%04x", c);
+		return(buf);
+	}
+	return NULL;
+}
+/* }}} */
+
+/* str_buffer_print_json() {{{
+ * Appends len chars of str as a quoted JSON string to the buffer.
+ * Returns the number of appended chars or -1 on error.
+ */
+int str_buffer_print_json(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len) {
+	char buf[8];
+	const char *esc;
+	size_t i, start = 0;
+	int written = 0;
+
+	if(0 > str_buffer_append(pxdoc, sb, "\"", 1))
+		return -1;
+	for(i=0; i<len; i++) {
+		if(NULL != (esc = json_escape((unsigned char) str[i], buf))) {
+			str_buffer_append(pxdoc, sb, &str[start], i-start);
+			str_buffer_append(pxdoc, sb, esc, strlen(esc));
+			written += i-start + strlen(esc);
+			start = i+1;
+		}
+	}
+	str_buffer_append(pxdoc, sb, &str[start], len-start);
+	if(0 > str_buffer_append(pxdoc, sb, "\"", 1))
+		return -1;
+	return(written + len-start + 2);
+}
+/* }}} */
+
+/* json_print_string() {{{
+ * Prints a null terminated string as a quoted JSON string.
+ */
+void json_print_string(FILE *outfp, const char *str) {
+	char buf[8];
+	const char *esc;
+
+	fputc('"', outfp);
+	while(*str != '\0') {
+		if(NULL != (esc = json_escape((unsigned char) *str, buf)))
+			fputs(esc, outfp);
+		else
+			fputc(*str, outfp);
+		str++;
+	}
+	fputc('"', outfp);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
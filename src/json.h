@@ -0,0 +1,9 @@
+#ifndef __JSON_H__
+#define __JSON_H__
+
+#include "str_buffer.h"
+
+int str_buffer_print_json(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len);
+void json_print_string(FILE *outfp, const char *str);
+
+#endif
@@ -24,14 +24,32 @@
 #ifdef HAVE_REGEX_H
 #include <regex.h>
 #endif
-#ifdef HAVE_GSF
-#include <paradox-gsf.h>
-#else
-#include <paradox.h>
-#endif
 #ifdef HAVE_BASENAME
 #include <libgen.h>
 #endif
+#include "pxview_intern.h"
+#include "blockmap.h"
+#include "recorditer.h"
+#include "manifest.h"
+#include "diff.h"
+#include "checkpoint.h"
+#include "aggregate.h"
+#include "profile.h"
+#include "join.h"
+#include "dedupe.h"
+#include "batch.h"
+#include "inventory.h"
+#include "server.h"
+#include "pxview.h"
+#include "pipeline.h"
+#include "blobstore.h"
+#include "blobstream.h"
+#include "blobmap.h"
+#include "transcode.h"
+#include "encoding.h"
+#include "stats.h"
+#include "progress.h"
+#include "trace.h"
 
 #ifdef MEMORY_DEBUGGING
 #include <paradox-mp.h>
@@ -41,17 +59,6 @@
 #include <sqlite.h>
 #endif
 
-#ifdef ENABLE_NLS
-#define _(String) gettext(String)
-#else
-#define _(String) String
-#endif
-
-/* These are not officially exported by pxlib */
-extern void hex_dump(FILE *outfp, char *p, int len);
-extern long get_long_le(const char *cp);
-extern unsigned short int get_short_le(const char *cp);
-
 /* strrep() {{{
  * Replace a char c1 with c2
  */
@@ -100,144 +107,6 @@ char * str_replace(char *str, char *s1, char *s2) {
 }
 /* }}} */
 
-struct str_buffer {
-	char *buffer;
-	size_t cur;
-	size_t size;
-};
-
-/* str_buffer_new() {{{
- * Create a new string buffer with the given initial size
- */
-struct str_buffer *str_buffer_new(pxdoc_t *pxdoc, size_t size) {
-	struct str_buffer *sb;
-	if(NULL == (sb = pxdoc->malloc(pxdoc, sizeof(struct str_buffer), _("Allocate memory for string buffer"))))
-		return NULL;
-	if(size > 0) {
-		if(NULL == (sb->buffer = pxdoc->malloc(pxdoc, size, _("Allocate memory for string buffer")))) {
-			pxdoc->free(pxdoc, sb);
-			return NULL;
-		}
-		sb->buffer[0] = '\0';
-	} else {
-		sb->buffer = NULL;
-	}
-	sb->size = size;
-	sb->cur = 0;
-	return(sb);
-}
-/* }}} */
-
-/* str_buffer_delete() {{{
- * Frees the memory occupied by the string buffer
- */
-void str_buffer_delete(pxdoc_t *pxdoc, struct str_buffer *sb) {
-	if(sb->buffer)
-		pxdoc->free(pxdoc, sb->buffer);
-	pxdoc->free(pxdoc, sb);
-}
-/* }}} */
-
-#define MSG_BUFSIZE 256
-/* str_buffer_print() {{{
- * print a string at the end of a buffer
- */
-int str_buffer_print(pxdoc_t *pxdoc, struct str_buffer *sb, const char *fmt, ...) {
-	char msg[MSG_BUFSIZE];
-	va_list ap;
-	int written;
-
-	va_start(ap, fmt);
-#ifdef HAVE_VSNPRINTF
-	written = vsnprintf(msg, MSG_BUFSIZE, fmt, ap);
-#else
-	written = vsprintf(msg, fmt, ap);
-#endif
-	if(written >= MSG_BUFSIZE) {
-		fprintf(stderr, _("Fatal Error: Format string is too short"));
-		fprintf(stderr, "\n");
-		return(written);
-	}
-
-	/* Enlarge memory for buffer
-	 * Enlarging it MSG_BUFSIZE ensure that the space is in any case
-	 * sufficient to add the new string.
-	 */
-	if((sb->cur + written + 1) > sb->size) {
-		sb->buffer = pxdoc->realloc(pxdoc, sb->buffer, sb->size+MSG_BUFSIZE, _("Get more memory for string buffer."));
-		sb->size += MSG_BUFSIZE;
-	}
-	strcpy(&(sb->buffer[sb->cur]), msg);
-	sb->cur += written;
-
-	va_end(ap);
-	return(written);
-}
-/* }}} */
-#undef MSG_BUFSIZE
-
-/* str_buffer_get() {{{
- * Returns a pointer to current buffer
- */
-const char *str_buffer_get(pxdoc_t *pxdoc, struct str_buffer *sb) {
-	return(sb->buffer);
-}
-/* }}} */
-
-/* str_buffer_len() {{{
- * Returns len of string buffer
- */
-size_t str_buffer_len(pxdoc_t *pxdoc, struct str_buffer *sb) {
-	return(sb->cur);
-}
-/* }}} */
-
-/* str_buffer_clear() {{{
- * Clears the string buffer but will not free the memory
- */
-void str_buffer_clear(pxdoc_t *pxdoc, struct str_buffer *sb) {
-	sb->cur = 0;
-	sb->buffer[0] = '\0';
-}
-/* }}} */
-
-/* str_buffer_printmask() {{{
- * Prints str to buffer and masks each occurence of c1 with c2.
- * Returns the number of written chars.
- */
-int str_buffer_printmask(pxdoc_t *pxdoc, struct str_buffer *sb, char *str, char c1, char c2 ) {
-	char *ptr, *dst;
-	int len = 0;
-	int c = 0;
-
-	/* Count occurences of c1 */
-	ptr = str;
-	while(*ptr != '\0') {
-		if(*ptr++ == c1)
-			c++;
-	}
-
-	c += sb->cur + strlen(str) + 1;
-	if(c > sb->size) {
-		 sb->buffer = pxdoc->realloc(pxdoc, sb->buffer, c, _("Get more memory for string buffer."));
-		 sb->size += c;
-	}
-	dst = &(sb->buffer[sb->cur]);
-	ptr = str;
-	while(*ptr != '\0') {
-		if(*ptr == c1) {
-			*dst++ = c2;
-			len ++;
-		} 
-		*dst++ = *ptr++;
-		len++;
-	}
-	*dst = '\0';
-	sb->cur += len;
-	return(len);
-}
-/* }}} */
-
 /* printmask() {{{
  * Prints str and masks each occurence of c1 with c2.
  * Returns the number of written chars.
@@ -381,26 +250,117 @@ void set_sql_type(struct sql_type_map *typemap, int pxtype, char *sqltype) {
 }
 /* }}} */
 
-/* get_sql_type() {{{
+/* errorhandler() {{{
  */
-char *get_sql_type(struct sql_type_map *typemap, int pxtype, int len) {
-	static char buffer[200];
-	if(pxtype < 1 || pxtype > pxfBytes) {
-		return NULL;
-	}
-#ifdef HAVE_SNPRINTF
-	snprintf(buffer, 200, typemap[pxtype].sqltype, len);
-#else
-	sprintf(buffer, typemap[pxtype].sqltype, len);
-#endif
-	return(buffer);
+void errorhandler(pxdoc_t *p, int error, const char *str, void *data) {
+	  fprintf(stderr, "PXLib: %s\n", str);
 }
 /* }}} */
 
-/* errorhandler() {{{
+/* Stages every iterator over the records of the input table passes
+ * through. Stages not used by an output are left NULL.
  */
-void errorhandler(pxdoc_t *p, int error, const char *str, void *data) {
-	  fprintf(stderr, "PXLib: %s\n", str);
+struct iter_stages {
+	struct progress *progress;
+	struct blockmap *blockmap;
+	char *changedblocks;        /* only these blocks are visited if set */
+	struct checkpoint *checkpoint; /* blocks already done are skipped */
+	struct record_dedupe *dedupe;
+	struct pipeline *pipeline;
+	int *sortfields;
+	int numsortfields;
+	int sortmemory;
+	struct record_join *join;
+};
+
+/* iter_setup() {{{
+ * Initializes iter and adds the stages. data must be large enough for
+ * a record, because the dedupe and sort stages read all records in
+ * advance. Returns -1 on error and 0 otherwise.
+ */
+int iter_setup(struct record_iter *iter, pxdoc_t *pxdoc, int numrecords, int presetdeleted, struct iter_stages *stages, char *data) {
+	record_iter_init(iter, pxdoc, numrecords, presetdeleted);
+	record_iter_progress(iter, stages->progress);
+	if(stages->changedblocks || stages->checkpoint)
+		record_iter_select_blocks(iter, stages->blockmap, stages->changedblocks);
+	if(stages->checkpoint)
+		record_iter_skip_blocks(iter, stages->checkpoint->doneblocks);
+	if(stages->dedupe && 0 > record_iter_dedupe(iter, stages->dedupe, data))
+		return -1;
+	if(stages->pipeline && 0 > record_iter_pipeline(iter, stages->pipeline))
+		return -1;
+	if(stages->sortfields && 0 > record_iter_sort(iter, stages->sortfields, stages->numsortfields, stages->sortmemory, data))
+		return -1;
+	if(stages->join && 0 > record_iter_join(iter, stages->join))
+		return -1;
+	return 0;
+}
+/* }}} */
+
+/* save_checkpoint() {{{
+ * Lets the sink complete its output and saves that doneblocks blocks
+ * have been exported. The position in outfp is saved with it, unless
+ * outfp is NULL. Returns -1 on error and 0 otherwise.
+ */
+int save_checkpoint(pxdoc_t *pxdoc, struct pxview_sink *sink, struct checkpoint *checkpoint, int doneblocks, FILE *outfp) {
+	if(sink->checkpoint && 0 > sink->checkpoint(sink))
+		return -1;
+	if(outfp)
+		return(checkpoint_write_file(pxdoc, checkpoint, doneblocks, outfp));
+	return(checkpoint_write(pxdoc, checkpoint, doneblocks, 0));
+}
+/* }}} */
+
+/* export_table() {{{
+ * Passes the records of the table through the stages to sink. fields
+ * are the fields of the records, which differ from those of pxdoc for
+ * joined records. A checkpoint is saved behind the head of the output
+ * and whenever it is due before the first record of a data block.
+ * Returns -1 on error and 0 otherwise.
+ */
+int export_table(pxdoc_t *pxdoc, struct pxview_sink *sink, pxfield_t *fields, int numfields, const char *selectedfields, int recordsize, int numrecords, int presetdeleted, struct iter_stages *stages, int resume, FILE *outfp) {
+	struct checkpoint *checkpoint = stages->checkpoint;
+	struct record_iter iter;
+	pxdatablockinfo_t pxdbinfo;
+	char *data;
+	int j, isdeleted, ret;
+
+	if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Allocate memory for record."))) == NULL) {
+		return -1;
+	}
+	if(0 > iter_setup(&iter, pxdoc, numrecords, presetdeleted, stages, data)) {
+		pxdoc->free(pxdoc, data);
+		return -1;
+	}
+	sink->fields = fields;
+	sink->numfields = numfields;
+	if(0 > pxview_export_begin(sink, pxdoc, selectedfields)) {
+		pxdoc->free(pxdoc, data);
+		return -1;
+	}
+	/* Record the end of the head, so a resumed export does not repeat it */
+	if(checkpoint && !resume && 0 > save_checkpoint(pxdoc, sink, checkpoint, 0, outfp)) {
+		pxdoc->free(pxdoc, data);
+		return -1;
+	}
+	while(0 != (ret = record_iter_next(&iter, &j, data, &isdeleted, &pxdbinfo))) {
+		if(checkpoint && checkpoint_due(checkpoint, iter.curblock)) {
+			if(0 > save_checkpoint(pxdoc, sink, checkpoint, iter.curblock, outfp)) {
+				pxdoc->free(pxdoc, data);
+				return -1;
+			}
+		}
+		if(0 < ret) {
+			if(0 > pxview_export_record(sink, j, data, isdeleted, &pxdbinfo)) {
+				pxdoc->free(pxdoc, data);
+				return -1;
+			}
+		} else {
+			fprintf(stderr, _("Couldn't get record number %d\n"), j);
+		}
+	}
+	pxdoc->free(pxdoc, data);
+	return(pxview_export_end(sink));
 }
 /* }}} */
 
@@ -427,7 +387,14 @@ void usage(char *progname) {
 	}
 	printf("\n\n");
 	printf(_("Usage: %s [OPTIONS] FILE"), progname);
-	printf("\n\n");
+	printf("\n");
+	printf(_("       %s [OPTIONS] -o DIRECTORY|DATABASE FILE|DIRECTORY..."), progname);
+	printf("\n");
+	if(!strcmp(progname, "pxview")) {
+		printf(_("       %s [OPTIONS] --diff OLDFILE NEWFILE"), progname);
+		printf("\n");
+	}
+	printf("\n");
 	printf(_("General options:"));
 	printf("\n");
 	printf(_("  -h, --help          this usage information."));
@@ -461,17 +428,35 @@ void usage(char *progname) {
 		printf("\n");
 		printf(_("  -t, --schema        output schema of database."));
 		printf("\n");
-		printf(_("  --mode=MODE         set output mode (info, csv, sql, sqlite, html or schema)."));
+		printf(_("  --mode=MODE         set output mode (info, csv, sql, sqlite, html, schema,\n                      aggregate, profile, inventory or blobmap)."));
+		printf("\n");
+		printf(_("  --diff              output changes between two tables."));
 		printf("\n");
 	}
 	printf(_("  -o, --output-file=FILE output data into file instead of stdout."));
 	printf("\n");
+	printf(_("  --jobs=N            number of tables converted at the same time, if\n                      several are given (default is the number of cores)."));
+	printf("\n");
+	printf(_("  --pipeline=N        read N data blocks ahead and write the output in\n                      separate threads."));
+	printf("\n");
+	printf(_("  --io-depth=N        number of data blocks read at the same time by\n                      --pipeline (default is %d)."), PIPELINE_IODEPTH);
+	printf("\n");
 	printf(_("  --output-deleted    output also records which were deleted."));
 	printf("\n");
 	printf(_("  --fields=REGEX      extended regular expression to select fields."));
 	printf("\n");
 	printf(_("  -r, --recode=ENCODING sets the target encoding."));
 	printf("\n");
+	printf(_("  --stats[=FORMAT]    print time spent in each phase and counters of the\n                      run to stderr as text or json (default text)."));
+	printf("\n");
+	printf(_("  --progress[=FORMAT] report the records read every second as text or json\n                      (default text)."));
+	printf("\n");
+	printf(_("  --progress-fd=FD    write the progress reports to FD instead of stderr."));
+	printf("\n");
+	printf(_("  --trace=FILE        write a trace of the export in Chrome trace format\n                      into FILE."));
+	printf("\n");
+	printf(_("  --detect-encoding   guess the codepage of alpha fields from a sample of\n                      data blocks and use it instead of the one in the header."));
+	printf("\n");
 	printf(_("  -n, --primary-index-file=FILE read primary index from file."));
 	printf("\n");
 	printf(_("  --timestamp-format=FORMAT Set format for timestamps (default Y-m-d H:i:s)."));
@@ -480,6 +465,26 @@ void usage(char *progname) {
 	printf("\n");
 	printf(_("  --date-format=FORMAT Set format for dates (default Y-m-d)."));
 	printf("\n");
+	printf(_("  --incremental=FILE  only output records of data blocks which have changed\n                      since the export which wrote the state FILE."));
+	printf("\n");
+	printf(_("  --checkpoint=FILE   periodically save the position of the export in FILE."));
+	printf("\n");
+	printf(_("  --resume            continue an interrupted export from its checkpoint."));
+	printf("\n");
+	printf(_("  --order-by=FIELDS   output records sorted by the comma separated FIELDS."));
+	printf("\n");
+	printf(_("  --sort-memory=MB    memory used for sorting before temporary files are\n                      written (default is %d)."), SORT_MEMORY);
+	printf("\n");
+	printf(_("  --join=FILE         join the records with the records of table FILE."));
+	printf("\n");
+	printf(_("  --on=FIELD=FIELD    comma separated pairs of fields which must be equal\n                      in both tables."));
+	printf("\n");
+	printf(_("  --join-memory=MB    memory used for the hash table of the join before\n                      temporary files are written (default is %d)."), JOIN_MEMORY);
+	printf("\n");
+	printf(_("  --dedupe=first|last output only the first or last of all records with\n                      the same primary key."));
+	printf("\n");
+	printf(_("  --dedupe-memory=MB  memory used for the primary keys before the records\n                      are sorted to find duplicates (default is %d)."), DEDUPE_MEMORY);
+	printf("\n");
 
 	printf("\n");
 	printf(_("Options to handle blob files:"));
@@ -490,6 +495,12 @@ void usage(char *progname) {
 	printf("\n");
 	printf(_("  --blobextension=EXT extension for all created files with blob data."));
 	printf("\n");
+	printf(_("  --blob-writers=N    write blobs of csv output with N threads, copying\n                      them straight from the blob file."));
+	printf("\n");
+	printf(_("  --blob-store=DIR    write each distinct blob once into DIR, named by\n                      the hash of its content."));
+	printf("\n");
+	printf(_("  --stream-blobs=SIZE copy blobs larger than SIZE bytes in pieces\n                      (default is %d, 0 reads all blobs at once)."), BLOBSTREAM_THRESHOLD);
+	printf("\n");
 
 	if(!strcmp(progname, "px2html") || !strcmp(progname, "pxview")) {
 		printf("\n");
@@ -526,6 +537,52 @@ void usage(char *progname) {
 		printf("\n");
 	}
 
+	if(!strcmp(progname, "pxview")) {
+		printf("\n");
+		printf(_("Options for aggregate output:"));
+		printf("\n");
+		printf(_("  --group-by=FIELDS   compute aggregates for each value of the comma\n                      separated FIELDS."));
+		printf("\n");
+		printf(_("  --aggregate=FUNCS   comma separated list of count, count(FIELD), sum(FIELD),\n                      min(FIELD), max(FIELD) and avg(FIELD) (default is count)."));
+		printf("\n");
+	}
+
+	if(!strcmp(progname, "pxview")) {
+		printf("\n");
+		printf(_("Options for profile output:"));
+		printf("\n");
+		printf(_("  --profile-format=FORMAT output statistics as text or json (default is text)."));
+		printf("\n");
+		printf(_("  --profile-top=N     number of most frequent values of each field (default\n                      is 10)."));
+		printf("\n");
+	}
+
+	if(!strcmp(progname, "pxview")) {
+		printf("\n");
+		printf(_("Options for inventory output:"));
+		printf("\n");
+		printf(_("  --inventory-format=FORMAT output one json object or csv row per file\n                      (default is json)."));
+		printf("\n");
+	}
+
+	if(!strcmp(progname, "pxview")) {
+		printf("\n");
+		printf(_("Options for running as a server:"));
+		printf("\n");
+		printf(_("  --serve=SOCKET      answer export and lookup requests on the unix\n                      domain socket SOCKET."));
+		printf("\n");
+		printf(_("  --serve-cache=N     number of tables kept open (default is %d)."), SERVER_CACHE);
+		printf("\n");
+	}
+
+	if(!strcmp(progname, "pxview")) {
+		printf("\n");
+		printf(_("Options for diff output:"));
+		printf("\n");
+		printf(_("  --diff-format=FORMAT output changes as sql statements or json events\n                      (default is sql)."));
+		printf("\n");
+	}
+
 	if(!strcmp(progname, "px2csv") || !strcmp(progname, "pxview")) {
 		printf("\n");
 		printf(_("Options for csv ouput:"));
@@ -597,7 +654,6 @@ int main(int argc, char *argv[]) {
 	float frecordsize, ffiletype, fprimarykeyfields, ftheonumrecords;
 	int recordsize, filetype, primarykeyfields, theonumrecords;
 	int i, j, c; // general counters
-	int first; // used to indicate if output has started or not
 	int outputcsv = 0;
 	int outputhtml = 0;
 	int outputinfo = 0;
@@ -605,6 +661,12 @@ int main(int argc, char *argv[]) {
 	int outputsqlite = 0;
 	int outputschema = 0;
 	int outputdebug = 0;
+	int outputdiff = 0;
+	int outputaggregate = 0;
+	int outputprofile = 0;
+	int outputblobmap = 0;
+	int blobprefixgiven = 0;
+	int diffformat = FORMAT_SQL;
 	int deletetable = 0;
 	int skipschema = 0;
 	int shortinsert = 0;
@@ -618,6 +680,7 @@ int main(int argc, char *argv[]) {
 	char delimiter = ',';
 	char enclosure = '"';
 	char *inputfile = NULL;
+	char *difffile = NULL;
 	char *outputfile = NULL;
 	char *blobfile = NULL;
 	char *pindexfile = NULL;
@@ -630,8 +693,60 @@ int main(int argc, char *argv[]) {
 	char *timestamp_format = NULL;
 	char *time_format = NULL;
 	char *date_format = NULL;
+	char *incrementalfile = NULL;
+	struct blockmap *blockmap = NULL;
+	struct manifest *manifest = NULL;
+	char *changedblocks = NULL;
+	char *checkpointfile = NULL;
+	int resume = 0;
+	struct checkpoint *checkpoint = NULL;
+	char *orderby = NULL;
+	int sortmemory = SORT_MEMORY;
+	int *sortfields = NULL;
+	int numsortfields = 0;
+	char *groupby = NULL;
+	char *aggregatefuncs = NULL;
+	int profileformat = FORMAT_TEXT;
+	int profiletop = PROFILE_TOPK;
+	char *joinfile = NULL;
+	char *joinon = NULL;
+	int joinmemory = JOIN_MEMORY;
+	pxdoc_t *joindoc = NULL;
+	struct record_join *join = NULL;
+	int dedupemode = 0;
+	int dedupememory = DEDUPE_MEMORY;
+	struct record_dedupe *dedupe = NULL;
+	struct batch *batch = NULL;
+	int jobs = 0;
+	int outputinventory = 0;
+	int inventoryformat = FORMAT_JSON;
+	char *servesocket = NULL;
+	int servecache = SERVER_CACHE;
+	int pipelinedepth = 0;
+	int iodepth = 0;
+	int blobwriters = 0;
+	char *blobstoredir = NULL;
+	struct blob_store *blobstore = NULL;
+	long streamthreshold = BLOBSTREAM_THRESHOLD;
+	struct mbfile *mbfile = NULL;
+	struct pipeline *pipeline = NULL;
+	int detectencoding = 0;
+	struct encoding_guess encguess;
+	int showstats = 0;
+	struct pxview_stats *stats = NULL;
+	int showprogress = 0;
+	int progressfd = 2;
+	struct progress *progress = NULL;
+	char *tracefile = NULL;
+	double tracetime = 0.0;
+	pxfield_t *fields;
+	int numfields;
+	struct record_iter iter;
+	struct iter_stages stages, unordered;
+	int numrecords, presetdeleted;
+	struct pxview_sql_options sqloptions;
+	char *sqltypes[pxfBytes+1];
 	FILE *outfp = NULL;
-	struct lconv *lc;
 
 	/* allocate 1 more struct because the first one is not used */
 	typemap = malloc((pxfBytes+1) * sizeof(struct sql_type_map));
@@ -652,8 +767,6 @@ int main(int argc, char *argv[]) {
 	textdomain (PACKAGE);
 #endif
 
-	lc = localeconv();
-
 	/* Handle program options {{{
 	 */
 #ifdef HAVE_BASENAME
@@ -709,6 +822,36 @@ int main(int argc, char *argv[]) {
 			{"timestamp-format", 1, 0, 17},
 			{"time-format", 1, 0, 18},
 			{"date-format", 1, 0, 19},
+			{"incremental", 1, 0, 20},
+			{"diff", 0, 0, 21},
+			{"diff-format", 1, 0, 22},
+			{"checkpoint", 1, 0, 23},
+			{"resume", 0, 0, 24},
+			{"order-by", 1, 0, 25},
+			{"sort-memory", 1, 0, 26},
+			{"group-by", 1, 0, 27},
+			{"aggregate", 1, 0, 28},
+			{"profile-format", 1, 0, 29},
+			{"profile-top", 1, 0, 30},
+			{"join", 1, 0, 31},
+			{"on", 1, 0, 32},
+			{"join-memory", 1, 0, 33},
+			{"dedupe", 1, 0, 34},
+			{"dedupe-memory", 1, 0, 35},
+			{"jobs", 1, 0, 36},
+			{"inventory-format", 1, 0, 37},
+			{"serve", 1, 0, 38},
+			{"serve-cache", 1, 0, 39},
+			{"pipeline", 1, 0, 40},
+			{"io-depth", 1, 0, 41},
+			{"blob-writers", 1, 0, 42},
+			{"blob-store", 1, 0, 43},
+			{"stream-blobs", 1, 0, 44},
+			{"detect-encoding", 0, 0, 45},
+			{"stats", 2, 0, 46},
+			{"progress", 2, 0, 47},
+			{"progress-fd", 1, 0, 48},
+			{"trace", 1, 0, 49},
 			{0, 0, 0, 0}
 		};
 		c = GETOPT_GETOPT_LONG (argc, argv, "icsxqvtf:b:r:p:o:n:h",
@@ -746,6 +889,14 @@ int main(int argc, char *argv[]) {
 					outputschema = 1;
 				} else if(!strcmp(GETOPT_OPTARG, "debug")) {
 					outputdebug = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "aggregate")) {
+					outputaggregate = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "profile")) {
+					outputprofile = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "inventory")) {
+					outputinventory = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "blobmap")) {
+					outputblobmap = 1;
 				}
 				break;
 			case 5:
@@ -850,6 +1001,151 @@ int main(int argc, char *argv[]) {
 			case 19:
 				date_format = strdup(GETOPT_OPTARG);
 				break;
+			case 20:
+				incrementalfile = strdup(GETOPT_OPTARG);
+				break;
+			case 21:
+				outputdiff = 1;
+				break;
+			case 22:
+				if(!strcmp(GETOPT_OPTARG, "sql")) {
+					diffformat = FORMAT_SQL;
+				} else if(!strcmp(GETOPT_OPTARG, "json")) {
+					diffformat = FORMAT_JSON;
+				} else {
+					fprintf(stderr, _("Unknown format '%s' for --diff-format."), GETOPT_OPTARG);
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 23:
+				checkpointfile = strdup(GETOPT_OPTARG);
+				break;
+			case 24:
+				resume = 1;
+				break;
+			case 25:
+				orderby = strdup(GETOPT_OPTARG);
+				break;
+			case 26:
+				sortmemory = atoi(GETOPT_OPTARG);
+				break;
+			case 27:
+				groupby = strdup(GETOPT_OPTARG);
+				break;
+			case 28:
+				aggregatefuncs = strdup(GETOPT_OPTARG);
+				break;
+			case 29:
+				if(!strcmp(GETOPT_OPTARG, "text")) {
+					profileformat = FORMAT_TEXT;
+				} else if(!strcmp(GETOPT_OPTARG, "json")) {
+					profileformat = FORMAT_JSON;
+				} else {
+					fprintf(stderr, _("Unknown format '%s' for --profile-format."), GETOPT_OPTARG);
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 30:
+				profiletop = atoi(GETOPT_OPTARG);
+				break;
+			case 31:
+				joinfile = strdup(GETOPT_OPTARG);
+				break;
+			case 32:
+				joinon = strdup(GETOPT_OPTARG);
+				break;
+			case 33:
+				joinmemory = atoi(GETOPT_OPTARG);
+				break;
+			case 34:
+				if(!strcmp(GETOPT_OPTARG, "first")) {
+					dedupemode = DEDUPE_FIRST;
+				} else if(!strcmp(GETOPT_OPTARG, "last")) {
+					dedupemode = DEDUPE_LAST;
+				} else {
+					fprintf(stderr, _("Unknown mode '%s' for --dedupe."), GETOPT_OPTARG);
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 35:
+				dedupememory = atoi(GETOPT_OPTARG);
+				break;
+			case 36:
+				jobs = atoi(GETOPT_OPTARG);
+				break;
+			case 37:
+				if(!strcmp(GETOPT_OPTARG, "json")) {
+					inventoryformat = FORMAT_JSON;
+				} else if(!strcmp(GETOPT_OPTARG, "csv")) {
+					inventoryformat = FORMAT_CSV;
+				} else {
+					fprintf(stderr, _("Unknown format '%s' for --inventory-format."), GETOPT_OPTARG);
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 38:
+				servesocket = strdup(GETOPT_OPTARG);
+				break;
+			case 39:
+				servecache = atoi(GETOPT_OPTARG);
+				break;
+			case 40:
+				pipelinedepth = atoi(GETOPT_OPTARG);
+				if(pipelinedepth <= 0)
+					pipelinedepth = PIPELINE_DEPTH;
+				break;
+			case 41:
+				iodepth = atoi(GETOPT_OPTARG);
+				/* Reading several blocks at once implies reading ahead */
+				if(pipelinedepth == 0)
+					pipelinedepth = PIPELINE_DEPTH;
+				break;
+			case 42:
+				blobwriters = atoi(GETOPT_OPTARG);
+				break;
+			case 43:
+				blobstoredir = strdup(GETOPT_OPTARG);
+				break;
+			case 44:
+				streamthreshold = atol(GETOPT_OPTARG);
+				break;
+			case 45:
+				detectencoding = 1;
+				break;
+			case 46:
+				if(GETOPT_OPTARG == NULL || !strcmp(GETOPT_OPTARG, "text")) {
+					showstats = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "json")) {
+					showstats = 2;
+				} else {
+					fprintf(stderr, _("Format of statistics must be 'text' or 'json'."));
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 47:
+				if(GETOPT_OPTARG == NULL || !strcmp(GETOPT_OPTARG, "text")) {
+					showprogress = 1;
+				} else if(!strcmp(GETOPT_OPTARG, "json")) {
+					showprogress = 2;
+				} else {
+					fprintf(stderr, _("Format of progress reports must be 'text' or 'json'."));
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 48:
+				progressfd = atoi(GETOPT_OPTARG);
+				if(showprogress == 0)
+					showprogress = 1;
+				break;
+			case 49:
+				tracefile = strdup(GETOPT_OPTARG);
+				break;
 			case 'r':
 				targetencoding = strdup(GETOPT_OPTARG);
 				break;
@@ -885,11 +1181,53 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
-	if (GETOPT_OPTIND < argc) {
+	if(outputinventory) {
+		/* All files in the given directories and below are listed */
+		if(GETOPT_OPTIND < argc && NULL == (batch = batch_new())) {
+			fprintf(stderr, _("Could not allocate memory for list of tables."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		for(i=GETOPT_OPTIND; i<argc; i++) {
+			if(0 > batch_add_tree(batch, argv[i])) {
+				batch_delete(batch);
+				exit(1);
+			}
+		}
+	} else if(outputdiff) {
+		/* The first file is the old table, the changes lead to the second one */
+		if(GETOPT_OPTIND+1 < argc) {
+			difffile = strdup(argv[GETOPT_OPTIND]);
+			inputfile = strdup(argv[GETOPT_OPTIND+1]);
+		} else {
+			fprintf(stderr, _("You must specify two input files with --diff."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+	} else if (GETOPT_OPTIND+1 < argc || (GETOPT_OPTIND < argc && batch_is_directory(argv[GETOPT_OPTIND]))) {
+		/* Several files or directories with tables are converted in a batch */
+		if(NULL == (batch = batch_new())) {
+			fprintf(stderr, _("Could not allocate memory for list of tables."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		for(i=GETOPT_OPTIND; i<argc; i++) {
+			if(0 > batch_add(batch, argv[i])) {
+				batch_delete(batch);
+				exit(1);
+			}
+		}
+		if(0 == batch->numtables) {
+			fprintf(stderr, _("Could not find any DB files."));
+			fprintf(stderr, "\n");
+			batch_delete(batch);
+			exit(1);
+		}
+	} else if (GETOPT_OPTIND < argc) {
 		inputfile = strdup(argv[GETOPT_OPTIND]);
 	}
 
-	if(!inputfile) {
+	if(!inputfile && !batch && !servesocket) {
 		fprintf(stderr, _("You must at least specify an input file."));
 		fprintf(stderr, "\n");
 		fprintf(stderr, "\n");
@@ -936,7 +1274,7 @@ int main(int argc, char *argv[]) {
 	/* }}} */
 
 	/* if none the output modes is selected then display info */
-	if(outputinfo == 0 && outputcsv == 0 && outputschema == 0 && outputsql == 0 && outputdebug == 0 && outputhtml == 0 && outputsqlite == 0)
+	if(outputinfo == 0 && outputcsv == 0 && outputschema == 0 && outputsql == 0 && outputdebug == 0 && outputhtml == 0 && outputsqlite == 0 && outputdiff == 0 && outputaggregate == 0 && outputprofile == 0 && outputinventory == 0 && outputblobmap == 0)
 		outputinfo = 1;
 
 	/* Set default values for timestamp, time, date format if it was
@@ -949,19 +1287,197 @@ int main(int argc, char *argv[]) {
 	if(NULL == date_format)
 		date_format = "Y-m-d";
 
-	/* Create output file {{{
+	/* Answer requests on a socket {{{
+	 * Tables are opened on request and kept open for later requests.
 	 */
-	if((outputfile == NULL) || !strcmp(outputfile, "-")) {
-		if(outputsqlite) {
-			fprintf(stderr, _("sqlite database cannot be written to stdout."));
+	if(servesocket) {
+		struct server *srv;
+		struct format_options fo;
+
+		fo.date_format = date_format;
+		fo.time_format = time_format;
+		fo.timestamp_format = timestamp_format;
+		fo.emptystringisnull = emptystringisnull;
+		fo.delimiter = delimiter;
+		fo.enclosure = enclosure;
+		if(NULL == (srv = server_new(servesocket, servecache, targetencoding, &fo, errorhandler))) {
+			fprintf(stderr, _("Could not allocate memory for server."));
 			fprintf(stderr, "\n");
 			exit(1);
-		} else {
-			outfp = stdout;
 		}
-	} else {
-		if(!outputsqlite) {
-			outfp = fopen(outputfile, "w");
+		i = server_run(srv);
+		server_delete(srv);
+		free(servesocket);
+		exit(0 > i ? 1 : 0);
+	}
+	/* }}} */
+
+	/* A checkpoint records the position in exactly one output which
+	 * can be cut back to that position.
+	 */
+	if(resume && !checkpointfile) {
+		fprintf(stderr, _("--resume requires --checkpoint."));
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+	if(checkpointfile) {
+		if(outputcsv + outputsql + outputsqlite != 1 || outputinfo || outputschema || outputhtml || outputdebug || outputdiff || outputaggregate || outputprofile || outputblobmap) {
+			fprintf(stderr, _("Checkpoints are only supported for either csv, sql or sqlite output."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		if((outputfile == NULL) || !strcmp(outputfile, "-")) {
+			fprintf(stderr, _("Checkpoints require an output file."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+	}
+
+	/* Output inventory of files {{{
+	 * The files are split into one part per process. Each process writes
+	 * the lines of its part into a temporary file and these are copied
+	 * into the output in the order of the files. Behind each file a
+	 * process saves the length of its output into a second temporary
+	 * file. If a process dies, only the output of the files it has
+	 * completed is copied and the remaining files are listed with an
+	 * error.
+	 */
+	if(outputinventory) {
+		FILE **partfps, **donefps;
+		char buf[8192];
+		size_t len;
+		long end, pos;
+		int numparts, done, failed = 0;
+
+		if((outputfile == NULL) || !strcmp(outputfile, "-")) {
+			outfp = stdout;
+		} else if(NULL == (outfp = fopen(outputfile, "w"))) {
+			fprintf(stderr, _("Could not open output file."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		inventory_header(outfp, inventoryformat);
+
+		numparts = jobs > 0 ? jobs : batch_num_cpus();
+		if(numparts > batch->numtables)
+			numparts = batch->numtables;
+		if(NULL == (partfps = malloc((numparts+1) * sizeof(FILE *))) ||
+		   NULL == (donefps = malloc((numparts+1) * sizeof(FILE *)))) {
+			fprintf(stderr, _("Could not allocate memory for list of processes."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		for(i=0; i<numparts; i++) {
+			if(NULL == (partfps[i] = tmpfile()) ||
+			   NULL == (donefps[i] = tmpfile())) {
+				fprintf(stderr, _("Could not create temporary file."));
+				fprintf(stderr, "\n");
+				exit(1);
+			}
+		}
+		fflush(outfp);
+		if(0 <= (i = batch_fork(batch, numparts, numparts, 0))) {
+			for(j=batch_task_first(batch, numparts, i); j<batch_task_first(batch, numparts, i+1); j++) {
+				inventory_file(partfps[i], batch->tables[j].dbfile, inventoryformat, errorhandler);
+				if(0 != fflush(partfps[i]))
+					exit(1);
+				end = ftell(partfps[i]);
+				if(1 != fwrite(&end, sizeof(long), 1, donefps[i]) || 0 != fflush(donefps[i]))
+					exit(1);
+			}
+			exit(0);
+		}
+
+		for(i=0; i<numparts; i++) {
+			rewind(donefps[i]);
+			for(done=0, end=0; 1 == fread(&pos, sizeof(long), 1, donefps[i]); done++)
+				end = pos;
+			fclose(donefps[i]);
+			rewind(partfps[i]);
+			for(pos=0; pos < end && 0 < (len = fread(buf, 1, end-pos < (long) sizeof(buf) ? end-pos : sizeof(buf), partfps[i])); pos += len)
+				fwrite(buf, 1, len, outfp);
+			fclose(partfps[i]);
+			for(j=batch_task_first(batch, numparts, i)+done; j<batch_task_first(batch, numparts, i+1); j++) {
+				inventory_error(outfp, batch->tables[j].dbfile, inventoryformat, _("Listing of the file was aborted."));
+				failed++;
+			}
+		}
+		free(partfps);
+		free(donefps);
+		if(outfp != stdout)
+			fclose(outfp);
+		if(failed) {
+			fprintf(stderr, _("%d of %d files could not be listed."), failed, batch->numtables);
+			fprintf(stderr, "\n");
+		}
+		batch_delete(batch);
+		exit(failed ? 1 : 0);
+	}
+	/* }}} */
+
+	/* Convert several tables concurrently {{{
+	 * Each table is converted by a process of its own which continues
+	 * below just like the conversion of a single table.
+	 */
+	if(batch) {
+		char *outputdir;
+
+		if(blobfile || pindexfile || tablename || checkpointfile) {
+			fprintf(stderr, _("--blobfile, --primary-index-file, --tablename and --checkpoint cannot be used with several tables."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		if((outputfile == NULL) || !strcmp(outputfile, "-")) {
+			fprintf(stderr, _("Several tables require an output directory or sqlite database."));
+			fprintf(stderr, "\n");
+			exit(1);
+		}
+		i = batch_run(batch, jobs > 0 ? jobs : batch_num_cpus(), verbose);
+		if(0 > i) {
+			if(batch->failed) {
+				fprintf(stderr, _("%d of %d tables could not be converted."), batch->failed, batch->numtables);
+				fprintf(stderr, "\n");
+			}
+			j = batch->failed;
+			batch_delete(batch);
+			exit(j ? 1 : 0);
+		}
+
+		inputfile = strdup(batch->tables[i].dbfile);
+		if(batch->tables[i].pxfile)
+			pindexfile = strdup(batch->tables[i].pxfile);
+		if(batch->tables[i].mbfile)
+			blobfile = strdup(batch->tables[i].mbfile);
+		/* All tables go into the same sqlite database or into a file
+		 * of their own in the output directory.
+		 */
+		if(!outputsqlite) {
+			outputdir = outputfile;
+			outputfile = batch_output_file(outputdir, batch->tables[i].name, outputcsv ? "csv" : outputsql ? "sql" : outputhtml ? "html" : "txt");
+			free(outputdir);
+		}
+	}
+	/* }}} */
+
+	/* Create output file {{{
+	 */
+	if((outputfile == NULL) || !strcmp(outputfile, "-")) {
+		if(outputsqlite) {
+			fprintf(stderr, _("sqlite database cannot be written to stdout."));
+			fprintf(stderr, "\n");
+			exit(1);
+		} else {
+			outfp = stdout;
+		}
+	} else {
+		if(!outputsqlite) {
+			/* The output of an interrupted export is kept and cut back
+			 * to the last checkpoint once the input file is open.
+			 */
+			if(resume)
+				outfp = fopen(outputfile, "r+");
+			if(outfp == NULL)
+				outfp = fopen(outputfile, "w");
 			if(outfp == NULL) {
 				fprintf(stderr, _("Could not open output file."));
 				fprintf(stderr, "\n");
@@ -973,10 +1489,17 @@ int main(int argc, char *argv[]) {
 
 	/* Open input file {{{
 	 */
+	if(showstats && NULL == (stats = stats_new()))
+		exit(1);
+	if(tracefile) {
+		if(0 > trace_start(tracefile))
+			exit(1);
+		tracetime = trace_now();
+	}
 #ifdef MEMORY_DEBUGGING
 	if(NULL == (pxdoc = PX_new2(errorhandler, PX_mp_malloc, PX_mp_realloc, PX_mp_free))) {
 #else
-	if(NULL == (pxdoc = PX_new2(errorhandler, NULL, NULL, NULL))) {
+	if(NULL == (pxdoc = (stats ? PX_new2(errorhandler, stats_malloc, stats_realloc, stats_free) : PX_new2(errorhandler, NULL, NULL, NULL)))) {
 #endif
 		fprintf(stderr, _("Could not create new paradox instance."));
 		fprintf(stderr, "\n");
@@ -1023,14 +1546,15 @@ int main(int argc, char *argv[]) {
 #ifdef HAVE_GSF
 	}
 #endif
-
-	/* Below this point inputfile isn't used anymore. */
-	free(inputfile);
+	if(tracefile)
+		trace_span("open", "open", tracetime, -1);
 	/* }}} */
 
 	/* Open primary index file {{{
 	 */
 	if(pindexfile) {
+		if(tracefile)
+			tracetime = trace_now();
 		pindexdoc = PX_new2(errorhandler, NULL, NULL, NULL);
 		if(0 > PX_open_file(pindexdoc, pindexfile)) {
 			fprintf(stderr, _("Could not open primary index file."));
@@ -1053,6 +1577,8 @@ int main(int argc, char *argv[]) {
 			PX_delete(pxdoc);
 			exit(1);
 		}
+		if(tracefile)
+			trace_span("read primary index", "open", tracetime, -1);
 	}
 	/* }}} */
 
@@ -1067,8 +1593,38 @@ int main(int argc, char *argv[]) {
 	PX_get_value(pxdoc, "theonumrecords", &ftheonumrecords);
 	theonumrecords = (int) ftheonumrecords;
 
+	/* Guess the codepage of the alpha fields {{{
+	 * The guess is only reported in info mode and replaces the codepage
+	 * of the header otherwise.
+	 */
+	memset(&encguess, 0, sizeof(encguess));
+	if(detectencoding &&
+	   (filetype == pxfFileTypIndexDB || filetype == pxfFileTypNonIndexDB)) {
+		FILE *infp;
+		if(NULL == (infp = fopen(inputfile, "rb"))) {
+			fprintf(stderr, _("Could not open input file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(0 > encoding_detect(pxdoc, infp, &encguess)) {
+			fclose(infp);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		fclose(infp);
+		if(!outputinfo && encguess.codepage != 0 && encguess.codepage != encguess.headercodepage) {
+			if(verbose) {
+				fprintf(stderr, _("Using code page %d instead of %d."), encguess.codepage, encguess.headercodepage);
+				fprintf(stderr, "\n");
+			}
+			PX_set_value(pxdoc, "codepage", (float) encguess.codepage);
+		}
+	}
+	/* }}} */
+
 	if(targetencoding != NULL)
-		PX_set_targetencoding(pxdoc, targetencoding);
+		transcode_set_targetencoding(pxdoc, targetencoding);
 
 	/* Set tablename to the one in the header if it wasn't set before */
 	/* FIXME: The memory for tablename must be freed later on, which isn't done yet. */
@@ -1091,6 +1647,7 @@ int main(int argc, char *argv[]) {
 			PX_delete(pxdoc);
 			exit(1);
 		}
+		blobprefixgiven = (NULL != blobprefix);
 		if(!blobprefix)
 			blobprefix = tablename;
 		if(!blobextension)
@@ -1174,6 +1731,18 @@ int main(int argc, char *argv[]) {
 		fprintf(outfp, _("Write protected:         %d\n"), pxh->px_writeprotected);
 		PX_get_value(pxdoc, "codepage", &number);
 		fprintf(outfp, _("Code Page:               %d (0x%X)\n"), (int) number, (int) number);
+		if(detectencoding && encguess.candidates) {
+			if(encguess.codepage == 0) {
+				fprintf(outfp, _("Detected code page:      none, no characters outside of ASCII\n"));
+			} else {
+				fprintf(outfp, _("Detected code page:      %d\n"), encguess.codepage);
+			}
+			if(verbose) {
+				fprintf(outfp, _("Sample:                  %d blocks, %ld values, %ld non-ASCII bytes\n"), encguess.blocks, encguess.values, encguess.highbytes);
+				for(i=0; i<encguess.numcandidates; i++)
+					fprintf(outfp, _("Score of code page %4d: %ld\n"), encguess.candidates[i].codepage, encguess.candidates[i].score);
+			}
+		}
 		fprintf(outfp, _("Encryption:              0x%lX\n"), pxh->px_encryption);
 		time_tm = localtime((time_t *) &(pxh->px_fileupdatetime));
 		fprintf(outfp, _("Update time:             %d.%d.%d %d:%02d:%02d (%d)\n"), time_tm->tm_mday, time_tm->tm_mon+1, time_tm->tm_year+1900, time_tm->tm_hour, time_tm->tm_min, time_tm->tm_sec, pxh->px_fileupdatetime);
@@ -1255,6 +1824,120 @@ int main(int argc, char *argv[]) {
 	}
 	/* }}} */
 
+	/* Drop records with duplicate primary keys {{{
+	 * Must be set up before the join, which has no primary key.
+	 */
+	if(dedupemode) {
+		if(outputdiff || outputdebug) {
+			fprintf(stderr, _("Duplicate records cannot be dropped in this output mode."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(checkpointfile) {
+			fprintf(stderr, _("Output without duplicates cannot be resumed from a checkpoint."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(((filetype != pxfFileTypIndexDB) &&
+		    (filetype != pxfFileTypNonIndexDB)) || 0 == primarykeyfields) {
+			fprintf(stderr, _("Duplicates can only be dropped from DB files with a primary key."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(NULL == (dedupe = record_dedupe_new(pxdoc, dedupemode, primarykeyfields, dedupememory))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+	}
+	/* }}} */
+
+	/* Join records with the records of another table {{{
+	 */
+	fields = PX_get_fields(pxdoc);
+	numfields = PX_get_num_fields(pxdoc);
+	if(joinfile || joinon) {
+		float fjoinfiletype;
+		char *joinname, *ptr;
+
+		if(!joinfile || !joinon) {
+			fprintf(stderr, _("--join and --on must be used together."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(outputdiff || outputaggregate || outputprofile || outputdebug) {
+			fprintf(stderr, _("Joined records can only be output as csv, html, sql or sqlite."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(checkpointfile) {
+			fprintf(stderr, _("Joined output cannot be resumed from a checkpoint."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(orderby) {
+			fprintf(stderr, _("Joined records cannot be sorted."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if((filetype != pxfFileTypIndexDB) &&
+		   (filetype != pxfFileTypNonIndexDB)) {
+			fprintf(stderr, _("Only records of DB files can be joined."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		joindoc = PX_new2(errorhandler, NULL, NULL, NULL);
+		if(0 > PX_open_file(joindoc, joinfile)) {
+			fprintf(stderr, _("Could not open input file."));
+			fprintf(stderr, "\n");
+			PX_delete(joindoc);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		PX_get_value(joindoc, "filetype", &fjoinfiletype);
+		if(((int) fjoinfiletype != pxfFileTypIndexDB) &&
+		   ((int) fjoinfiletype != pxfFileTypNonIndexDB)) {
+			fprintf(stderr, _("Only records of DB files can be joined."));
+			fprintf(stderr, "\n");
+			PX_close(joindoc);
+			PX_delete(joindoc);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(targetencoding != NULL)
+			transcode_set_targetencoding(joindoc, targetencoding);
+
+		/* Fields of the joined table with the name of a field in the
+		 * input table are prefixed by the name of the joined file.
+		 */
+		joinname = strdup((ptr = strrchr(joinfile, '/')) ? ptr+1 : joinfile);
+		if(NULL != (ptr = strrchr(joinname, '.')))
+			*ptr = '\0';
+		strrep(joinname, ' ', '_');
+		join = record_join_new(pxdoc, joindoc, joinon, joinname, joinmemory);
+		free(joinname);
+		if(NULL == join) {
+			PX_close(joindoc);
+			PX_delete(joindoc);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		fields = join->fields;
+		numfields = join->numfields;
+		recordsize = join->recordsize;
+		/* Joined records are not unique by the primary key of the table */
+		primarykeyfields = 0;
+	}
+	/* }}} */
+
 	/* Output Schema {{{
 	 */
 	if(outputschema) {
@@ -1273,8 +1956,8 @@ int main(int argc, char *argv[]) {
 		fprintf(outfp, "Delimiter=%c\n", enclosure);
 		fprintf(outfp, "Separator=%c\n", delimiter);
 		fprintf(outfp, "CharSet=ANSIINTL\n");
-		pxf = PX_get_fields(pxdoc);
-		for(i=0; i<PX_get_num_fields(pxdoc); i++) {
+		pxf = fields;
+		for(i=0; i<numfields; i++) {
 			switch(pxf->px_ftype) {
 				case pxfAlpha:
 				case pxfDate:
@@ -1365,13 +2048,13 @@ int main(int argc, char *argv[]) {
 		}
 #endif
 		/* allocate memory for selected field array */
-		if((selectedfields = (char *) pxdoc->malloc(pxdoc, PX_get_num_fields(pxdoc), _("Could not allocate memory for array of selected fields."))) == NULL) {
+		if((selectedfields = (char *) pxdoc->malloc(pxdoc, numfields, _("Could not allocate memory for array of selected fields."))) == NULL) {
 			PX_close(pxdoc);
 			exit(1);
 		}
-		memset(selectedfields, '\0', PX_get_num_fields(pxdoc));
-		pxf = PX_get_fields(pxdoc);
-		for(i=0; i<PX_get_num_fields(pxdoc); i++) {
+		memset(selectedfields, '\0', numfields);
+		pxf = fields;
+		for(i=0; i<numfields; i++) {
 #ifdef HAVE_REGEX_H
 			if(0 == regexec(&preg, pxf->px_fname, 0, NULL, 0)) {
 #else
@@ -1384,758 +2067,446 @@ int main(int argc, char *argv[]) {
 	}
 	/* }}} */
 
-	/* Output data as comma separated values {{{ */
-	if(outputcsv) {
-		int numrecords, ireccounter = 0;
-		int blob_count = 1; /* used for counting blobs writen to file */
-		int isdeleted, presetdeleted;
-
-		/* Output first line with column names */
-		if(!withouthead) {
-			first = 0;  // set to 1 when first field has been output
-			pxf = PX_get_fields(pxdoc);
-			for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-				if(fieldregex == NULL || selectedfields[i]) {
-					if(first == 1)
-						fprintf(outfp, "%c", delimiter);
-					if(delimiter == ',')
-						fprintf(outfp, "%c", enclosure);
-					if(strlen(pxf->px_fname))
-						fprintf(outfp, "%s", pxf->px_fname);
-					else
-						fprintf(outfp, "column%d", i+1);
-					switch(pxf->px_ftype) {
-						case pxfAlpha:
-							fprintf(outfp, ",A,%d", pxf->px_flen);
-							break;
-						case pxfDate:
-							fprintf(outfp, ",D,%d", pxf->px_flen);
-							break;
-						case pxfShort:
-							fprintf(outfp, ",S,%d", pxf->px_flen);
-							break;
-						case pxfAutoInc:
-							fprintf(outfp, ",+,%d", pxf->px_flen);
-							break;
-						case pxfTimestamp:
-							fprintf(outfp, ",@,%d", pxf->px_flen);
-							break;
-						case pxfLong:
-							fprintf(outfp, ",I,%d", pxf->px_flen);
-							break;
-						case pxfTime:
-							fprintf(outfp, ",T,%d", pxf->px_flen);
-							break;
-						case pxfCurrency:
-							fprintf(outfp, ",$,%d", pxf->px_flen);
-							break;
-						case pxfNumber:
-							fprintf(outfp, ",N,%d", pxf->px_flen);
-							break;
-						case pxfLogical:
-							fprintf(outfp, ",L,%d", pxf->px_flen);
-							break;
-						case pxfGraphic:
-							fprintf(outfp, ",G,%d", pxf->px_flen);
-							break;
-						case pxfBLOb:
-							fprintf(outfp, ",B,%d", pxf->px_flen);
-							break;
-						case pxfOLE:
-							fprintf(outfp, ",O,%d", pxf->px_flen);
-							break;
-						case pxfFmtMemoBLOb:
-							fprintf(outfp, ",F,%d", pxf->px_flen);
-							break;
-						case pxfMemoBLOb:
-							fprintf(outfp, ",M,%d", pxf->px_flen);
-							break;
-						case pxfBytes:
-							fprintf(outfp, ",Y,%d", pxf->px_flen);
-							break;
-						case pxfBCD:
-							fprintf(outfp, ",#,%d", pxf->px_fdc);
-							break;
-					}
-					if(delimiter == ',')
-						fprintf(outfp, "%c", enclosure);
-					first = 1;
-				}
-				pxf++;
-			}
-			if((filetype == pxfFileTypPrimIndex)  ||
-			   (filetype == pxfFileTypSecIndex) ||
-			   (filetype == pxfFileTypSecIndexG)) {
-				fprintf(outfp, "%c", delimiter);
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "blocknr,S,2");
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "%c", delimiter);
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "count,S,2");
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "%c", delimiter);
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "dummy,S,2");
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "%c", delimiter);
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "thisblocknr,S,2");
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-			}
-			if(markdeleted) {
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-				fprintf(outfp, "%cdeleted,L,1", delimiter);
-				if(delimiter == ',')
-					fprintf(outfp, "%c", enclosure);
-			}
-			fprintf(outfp, "\n");
-		}
-
-		/* Allocate memory for record */
-		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Allocate memory for record."))) == NULL) {
-			if(selectedfields)
-				pxdoc->free(pxdoc, selectedfields);
+	/* Check by which fields the records shall be sorted {{{
+	 */
+	if(orderby) {
+		if(checkpointfile) {
+			fprintf(stderr, _("Sorted output cannot be resumed from a checkpoint."));
+			fprintf(stderr, "\n");
 			PX_close(pxdoc);
 			exit(1);
 		}
-
-		if(outputdeleted) {
-			numrecords = theonumrecords;
-			presetdeleted = 1;
-		} else {
-			numrecords = PX_get_num_records(pxdoc);
-			presetdeleted = 0;
-		}
-		/* Output records */
-		for(j=0; j<numrecords; j++) {
-			int offset;
-			pxdatablockinfo_t pxdbinfo;
-			isdeleted = presetdeleted;
-			if(NULL != PX_get_record2(pxdoc, j, data, &isdeleted, &pxdbinfo)) {
-				pxf = PX_get_fields(pxdoc);
-				offset = 0;
-				first = 0;  // set to 1 when first field has been output
-				for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-					if(fieldregex == NULL || selectedfields[i]) {
-						if(first == 1)
-							fprintf(outfp, "%c", delimiter);
-						switch(pxf->px_ftype) {
-							case pxfAlpha: {
-								char *value;
-								int ret;
-								if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-									int i, needsenclosure=0, hasenclosure=0;
-									for(i=0; i<pxf->px_flen && needsenclosure==0&& value[i] != '\0'; i++) {
-										if(value[i] == delimiter ||
-										   value[i] == '\n' ||
-										   value[i] == '\r')
-											needsenclosure = 1;
-										if(value[i] == enclosure)
-											hasenclosure = 1;
-									}
-									if(enclosure && needsenclosure) {
-										fprintf(outfp, "%c", enclosure);
-										if(hasenclosure)
-											printmask(outfp, value, pxf->px_flen, enclosure, enclosure);
-										else
-											fprintf(outfp, "%s", value);
-										fprintf(outfp, "%c", enclosure);
-									} else {
-										if(hasenclosure) {
-											fprintf(outfp, "%c", enclosure);
-											printmask(outfp, value, pxf->px_flen, enclosure, enclosure);
-											fprintf(outfp, "%c", enclosure);
-										} else
-											fprintf(outfp, "%s", value);
-									}
-									pxdoc->free(pxdoc, value);
-								} else if(ret < 0) {
-									fprintf(stderr, "Error while reading data of field number %d", i+1);
-									fprintf(stderr, "\n");
-								}
-								first = 1;
-								break;
-							}
-							case pxfDate: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, date_format);
-									fprintf(outfp, "%s", str);
-									pxdoc->free(pxdoc, str);
-								}
-								first = 1;
-								break;
-								}
-							case pxfShort: {
-								short int value;
-								if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									fprintf(outfp, "%d", value);
-								}
-								first = 1;
-								break;
-								}
-							case pxfAutoInc:
-							case pxfLong: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									fprintf(outfp, "%ld", value);
-								}
-								first = 1;
-								break;
-								}
-							case pxfTimestamp: {
-								double value;
-								if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, value, timestamp_format);
-									fprintf(outfp, "%s", str);
-									pxdoc->free(pxdoc, str);
-								} 
-								first = 1;
-								break;
-								}
-							case pxfTime: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, (double) value, time_format);
-									fprintf(outfp, "%s", str);
-									pxdoc->free(pxdoc, str);
-								}
-								first = 1;
-								break;
-								}
-							case pxfCurrency:
-							case pxfNumber: {
-								double value;
-								if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-#ifdef HAVE_LOCALE_H
-									if(lc->decimal_point[0] == delimiter)
-#else
-									if('.' == delimiter)
-#endif
-										fprintf(outfp, "%c%lf%c", enclosure, value, enclosure);
-									else
-										fprintf(outfp, "%lf", value);
-								} 
-								first = 1;
-								break;
-								} 
-							case pxfLogical: {
-								char value;
-								if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									if(value)
-										fprintf(outfp, "1");
-									else
-										fprintf(outfp, "0");
-								}
-								first = 1;
-								break;
-								}
-							case pxfGraphic:
-							case pxfBLOb:
-							case pxfFmtMemoBLOb:
-							case pxfMemoBLOb:
-							case pxfOLE: {
-								char *blobdata;
-								char filename[200];
-								FILE *fp;
-								int mod_nr, size, ret;
-								if(pxf->px_ftype == pxfGraphic)
-									ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-								else
-									ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-								if(ret > 0) {
-									if(blobdata) {
-										if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
-											int i, needsenclosure=0;
-											for(i=0; i<size && needsenclosure==0; i++)
-												if(blobdata[i] == delimiter ||
-												   blobdata[i] == '\n' ||
-												   blobdata[i] == '\r')
-													needsenclosure = 1;
-											if(enclosure && needsenclosure)
-												fprintf(outfp, "%c", enclosure);
-											for(i=0; i<size; i++) {
-												if(blobdata[i] == enclosure)
-													fputc(enclosure, outfp);
-												fputc(blobdata[i], outfp);
-											}
-											if(enclosure && (strchr(blobdata, delimiter) || strchr(blobdata, '\n') || strchr(blobdata, '\r')))
-												fprintf(outfp, "%c", enclosure);
-										} else {
-											sprintf(filename, "%s_%d.%s", blobprefix, blob_count++, blobextension);
-											fp = fopen(filename, "w");
-											if(fp) {
-												fwrite(blobdata, size, 1, fp);
-												fclose(fp);
-												fprintf(outfp, "%s", filename);
-											} else {
-												fprintf(stderr, "Couldn't open file '%s' for blob data\n", filename);
-											}
-										}
-										pxdoc->free(pxdoc, blobdata);
-									} else {
-										fprintf(stderr, "Couldn't get blob data for %d\n", mod_nr);
-									}
-								}
-
-								first = 1;
-								break;
-							}
-							case pxfBytes:
-								hex_dump(outfp, &data[offset], pxf->px_flen);
-								first = 1;
-								break;
-							case pxfBCD: {
-								char *value;
-						//		hex_dump(outfp, &data[offset], pxf->px_flen);
-								if(0 < PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value)) {
-#ifdef HAVE_LOCALE_H
-									if(lc->decimal_point[0] == delimiter)
-#else
-									if('.' == delimiter)
-#endif
-										fprintf(outfp, "%c%s%c", enclosure, value, enclosure);
-									else
-										fprintf(outfp, "%s", value);
-									pxdoc->free(pxdoc, value);
-								}
-								first = 1;
-								break;
-							}
-							default:
-								break;
-//								fprintf(outfp, "");
-						}
-					}
-					offset += pxf->px_flen;
-					pxf++;
-				}
-				if((filetype == pxfFileTypPrimIndex)  ||
-				   (filetype == pxfFileTypSecIndex) ||
-				   (filetype == pxfFileTypSecIndexG)) {
-					short int value;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "%c", delimiter);
-						fprintf(outfp, "%d", value);
-					}
-					offset += 2;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "%c", delimiter);
-						fprintf(outfp, "%d", value);
-						ireccounter += value;
-					}
-					offset += 2;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "%c", delimiter);
-						fprintf(outfp, "%d", value);
-					}
-					fprintf(outfp, "%c", delimiter);
-					fprintf(outfp, "%d", pxdbinfo.number);
-				}
-				if(markdeleted) {
-					fprintf(outfp, "%c", delimiter);
-					fprintf(outfp, "%d", isdeleted);
-				}
-				fprintf(outfp, "\n");
-			} else {
-				fprintf(stderr, _("Couldn't get record number %d\n"), j);
-			}
+		if((filetype != pxfFileTypIndexDB) &&
+		   (filetype != pxfFileTypNonIndexDB)) {
+			fprintf(stderr, _("Only records of DB files can be sorted."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
 		}
-		/* Print sum over all records */
-		if((filetype == pxfFileTypPrimIndex)  ||
-		   (filetype == pxfFileTypSecIndex) ||
-		   (filetype == pxfFileTypSecIndexG)) {
-			for(i=0; i<PX_get_num_fields(pxdoc); i++)
-				fprintf(outfp, "%c", delimiter);
-			fprintf(outfp, "%c", delimiter);
-			fprintf(outfp, "%d", ireccounter);
-			fprintf(outfp, "%c", delimiter);
-			fprintf(outfp, "\n");
+		if(0 > (numsortfields = record_sort_parse_fields(pxdoc, orderby, &sortfields))) {
+			PX_close(pxdoc);
+			exit(1);
 		}
-		pxdoc->free(pxdoc, data);
 	}
 	/* }}} */
 
-#ifdef HAVE_SQLITE
-	/* Output data into sqlite database {{{
+	/* Output changes between two tables {{{
 	 */
-	if(outputsqlite) {
-		sqlite *sql;
-		struct str_buffer *sbuf;
-		char *sqlerror;
+	if(outputdiff) {
+		pxdoc_t *olddoc;
+		FILE *oldfp, *newfp;
+		struct format_options fo;
+		struct diff_options dopts;
 
 		if((filetype != pxfFileTypIndexDB) && 
 		   (filetype != pxfFileTypNonIndexDB)) {
-			fprintf(stderr, _("SQL output is only reasonable for DB files."));
+			fprintf(stderr, _("Diff output is only reasonable for DB files."));
 			fprintf(stderr, "\n");
 			PX_close(pxdoc);
 			exit(1);
 		}
 
-		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
-			if(selectedfields)
-				pxdoc->free(pxdoc, selectedfields);
+		olddoc = PX_new2(errorhandler, NULL, NULL, NULL);
+		if(0 > PX_open_file(olddoc, difffile)) {
+			fprintf(stderr, _("Could not open input file."));
+			fprintf(stderr, "\n");
+			PX_delete(olddoc);
 			PX_close(pxdoc);
 			exit(1);
 		}
+		if(targetencoding != NULL)
+			transcode_set_targetencoding(olddoc, targetencoding);
 
-		/* Allocate memory for string buffer.
-		 */
-		if((sbuf = str_buffer_new(pxdoc, 20)) == NULL) {
-			if(selectedfields)
-				pxdoc->free(pxdoc, selectedfields);
+		if(NULL == (oldfp = fopen(difffile, "rb")) ||
+		   NULL == (newfp = fopen(inputfile, "rb"))) {
+			fprintf(stderr, _("Could not open input file."));
+			fprintf(stderr, "\n");
+			PX_close(olddoc);
+			PX_delete(olddoc);
 			PX_close(pxdoc);
 			exit(1);
 		}
 
-		if((sql = sqlite_open(outputfile, 0, NULL)) == NULL) {
-			if(selectedfields)
-				pxdoc->free(pxdoc, selectedfields);
+		fo.date_format = date_format;
+		fo.time_format = time_format;
+		fo.timestamp_format = timestamp_format;
+		fo.emptystringisnull = emptystringisnull;
+		fo.delimiter = delimiter;
+		fo.enclosure = enclosure;
+		dopts.format = diffformat;
+		dopts.tablename = tablename;
+		dopts.selectedfields = selectedfields;
+		dopts.fo = &fo;
+		dopts.verbose = verbose;
+		if(0 > diff_tables(olddoc, oldfp, pxdoc, newfp, outfp, &dopts)) {
+			PX_close(olddoc);
+			PX_delete(olddoc);
 			PX_close(pxdoc);
 			exit(1);
 		}
 
-		/* check if existing table shall be delete */
-		if(deletetable) {
-			str_buffer_print(pxdoc, sbuf, "DROP TABLE %s;\n", tablename);
-			if(SQLITE_OK != sqlite_exec(sql, str_buffer_get(pxdoc, sbuf), NULL, NULL, &sqlerror)) {
-				fprintf(stderr, "%s\n", sqlerror);
-				sqlite_close(sql);
-				str_buffer_delete(pxdoc, sbuf);
-				pxdoc->free(pxdoc, data);
-				if(selectedfields)
-					pxdoc->free(pxdoc, selectedfields);
-				PX_close(pxdoc);
-				exit(1);
-			}
-		}
-		/* Output table schema */
-		if(!skipschema) {
-			str_buffer_clear(pxdoc, sbuf);
-			str_buffer_print(pxdoc, sbuf, "CREATE TABLE %s (\n", tablename);
-			first = 0;  // set to 1 when first field has been output
-			pxf = PX_get_fields(pxdoc);
-			for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-				if(fieldregex == NULL ||  selectedfields[i]) {
-					strrep(pxf->px_fname, ' ', '_');
-					if(first == 1)
-						str_buffer_print(pxdoc, sbuf, ",\n");
-					switch(pxf->px_ftype) {
-						case pxfAlpha:
-						case pxfDate:
-						case pxfShort:
-						case pxfLong:
-						case pxfAutoInc:
-						case pxfCurrency:
-						case pxfNumber:
-						case pxfLogical:
-						case pxfTime:
-						case pxfTimestamp:
-						case pxfBytes:
-							str_buffer_print(pxdoc, sbuf, "  `%s` ", pxf->px_fname);
-							str_buffer_print(pxdoc, sbuf, "%s", get_sql_type(typemap, pxf->px_ftype, pxf->px_flen));
-							first = 1;
-							break;
-						case pxfBCD:
-							str_buffer_print(pxdoc, sbuf, "  `%s` ", pxf->px_fname);
-							str_buffer_print(pxdoc, sbuf, "%s", get_sql_type(typemap, pxf->px_ftype, pxf->px_fdc));
-							first = 1;
-							break;
-						case pxfMemoBLOb:
-						case pxfBLOb:
-						case pxfFmtMemoBLOb:
-						case pxfGraphic:
-						case pxfOLE:
-							str_buffer_print(pxdoc, sbuf, "  `%s` ", pxf->px_fname);
-							str_buffer_print(pxdoc, sbuf, "%s", get_sql_type(typemap, pxf->px_ftype, pxf->px_flen));
-							first = 1;
-							break;
-					}
-//					if(i < primarykeyfields)
-//						str_buffer_print(pxdoc, sbuf, " unique");
-				}
-				pxf++;
-			}
-			if(primarykeyfields) {
-				first = 0;  // set to 1 when first field has been output
-				pxf = PX_get_fields(pxdoc);
-				str_buffer_print(pxdoc, sbuf, ",\n  unique(");
-				for(i=0; i<primarykeyfields; i++) {
-					if(fieldregex == NULL ||  selectedfields[i]) {
-						strrep(pxf->px_fname, ' ', '_');
-						if(first == 1)
-							str_buffer_print(pxdoc, sbuf, ",");
-						str_buffer_print(pxdoc, sbuf, "%s", pxf->px_fname);
-						first = 1;
-					}
-					pxf++;
-				}
-				str_buffer_print(pxdoc, sbuf, ")");
-			}
-			str_buffer_print(pxdoc, sbuf, ");");
+		fclose(oldfp);
+		fclose(newfp);
+		transcode_release(olddoc);
+		PX_close(olddoc);
+		PX_delete(olddoc);
+		free(difffile);
+	}
+	/* }}} */
 
-			if(SQLITE_OK != sqlite_exec(sql, str_buffer_get(pxdoc, sbuf), NULL, NULL, &sqlerror)) {
-				sqlite_close(sql);
-				fprintf(stderr, "%s\n", sqlerror);
-				str_buffer_delete(pxdoc, sbuf);
-				pxdoc->free(pxdoc, data);
-				if(selectedfields)
-					pxdoc->free(pxdoc, selectedfields);
-				PX_close(pxdoc);
-				exit(1);
-			}
+	/* Compare data blocks with manifest of last export {{{
+	 */
+	if(incrementalfile) {
+		FILE *infp, *markerfp;
+		char *markerstart, *markerend;
+		int numchanged = 0;
 
-			/* Create the indexes */
-			pxf = PX_get_fields(pxdoc);
-			for(i=0; i<primarykeyfields; i++) {
-				if(fieldregex == NULL ||  selectedfields[i]) {
-					strrep(pxf->px_fname, ' ', '_');
-					str_buffer_clear(pxdoc, sbuf);
-					str_buffer_print(pxdoc, sbuf, "CREATE INDEX %s_%s_index on %s (%s);", tablename, pxf->px_fname, tablename, pxf->px_fname);
-					if(SQLITE_OK != sqlite_exec(sql, str_buffer_get(pxdoc, sbuf), NULL, NULL, &sqlerror)) {
-						sqlite_close(sql);
-						fprintf(stderr, "%s\n", sqlerror);
-						str_buffer_delete(pxdoc, sbuf);
-						pxdoc->free(pxdoc, data);
-						if(selectedfields)
-							pxdoc->free(pxdoc, selectedfields);
-						PX_close(pxdoc);
-						exit(1);
-					}
-				}
-				pxf++;
-			}
+		if(outputdeleted) {
+			fprintf(stderr, _("Deleted records cannot be output in an incremental export."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(usegsf) {
+			fprintf(stderr, _("Incremental export is not possible when reading with gsf."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		if(NULL == (manifest = manifest_read(pxdoc, incrementalfile))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		if(NULL == (infp = fopen(inputfile, "rb"))) {
+			fprintf(stderr, _("Could not open input file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		/* The blocks are always hashed. The update time in the header is
+		 * not reliable, because some programs do not set it and several
+		 * writes within one second leave it unchanged.
+		 */
+		blockmap = blockmap_new(pxdoc, infp, 1);
+		fclose(infp);
+		if(NULL == blockmap) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		if((changedblocks = (char *) pxdoc->malloc(pxdoc, blockmap->numblocks+1, _("Could not allocate memory for array of changed blocks."))) == NULL) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		/* Changed and removed blocks are marked by a comment in sql and
+		 * html output. Other formats have no comments, so the note goes
+		 * to stderr. The same applies when an export is resumed, because
+		 * the comments have already been written.
+		 */
+		if(outputsql && !resume) {
+			markerfp = outfp;
+			markerstart = "-- ";
+			markerend = "";
+		} else if(outputhtml) {
+			markerfp = outfp;
+			markerstart = "<!-- ";
+			markerend = " -->";
+		} else {
+			markerfp = stderr;
+			markerstart = "";
+			markerend = "";
+		}
+
+		for(i=0; i<blockmap->numblocks; i++) {
+			struct blockinfo *bi = &(blockmap->blocks[i]);
+			struct manifest_entry *e = manifest_find(manifest, bi->number);
+			changedblocks[i] = 1;
+			if(e) {
+				e->seen = 1;
+				if(e->numrecords == bi->numrecords && e->hash == bi->hash)
+					changedblocks[i] = 0;
+				if(changedblocks[i]) {
+					fprintf(markerfp, "%s", markerstart);
+					fprintf(markerfp, _("Data block %d with %d records has been changed."), bi->number, e->numrecords);
+					fprintf(markerfp, "%s\n", markerend);
+				}
+			}
+			if(changedblocks[i])
+				numchanged++;
+		}
+		for(i=0; i<manifest->numentries; i++) {
+			if(!manifest->entries[i].seen) {
+				fprintf(markerfp, "%s", markerstart);
+				fprintf(markerfp, _("Data block %d with %d records has been removed."), manifest->entries[i].number, manifest->entries[i].numrecords);
+				fprintf(markerfp, "%s\n", markerend);
+			}
+		}
+		if(verbose) {
+			fprintf(stderr, _("%d of %d data blocks are new or have changed."), numchanged, blockmap->numblocks);
+			fprintf(stderr, "\n");
+			if(numchanged > 0 && manifest->numentries > 0 && manifest->updatetime == pxh->px_fileupdatetime) {
+				fprintf(stderr, _("The update time of the file has not changed since the last export."));
+				fprintf(stderr, "\n");
+			}
+		}
+	}
+	/* }}} */
+
+	/* Continue from checkpoint of interrupted export {{{
+	 */
+	if(checkpointfile) {
+		if(outputdeleted) {
+			fprintf(stderr, _("Deleted records cannot be output when using checkpoints."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(usegsf) {
+			fprintf(stderr, _("Checkpoints are not possible when reading with gsf."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
 		}
 
-		/* Only output data if we have at least one record */
-		if(PX_get_num_records(pxdoc) > 0) {
-			if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
-				if(selectedfields)
-					pxdoc->free(pxdoc, selectedfields);
+		/* Blocks are output in the order of the block map, which is also
+		 * used to count the blocks already written.
+		 */
+		if(NULL == blockmap) {
+			FILE *infp;
+			if(NULL == (infp = fopen(inputfile, "rb"))) {
+				fprintf(stderr, _("Could not open input file."));
+				fprintf(stderr, "\n");
 				PX_close(pxdoc);
 				exit(1);
 			}
+			blockmap = blockmap_new(pxdoc, infp, 0);
+			fclose(infp);
+			if(NULL == blockmap) {
+				PX_close(pxdoc);
+				exit(1);
+			}
+		}
 
-			for(j=0; j<PX_get_num_records(pxdoc); j++) {
-				int offset;
-				str_buffer_clear(pxdoc, sbuf);
-				str_buffer_print(pxdoc, sbuf, "INSERT INTO %s VALUES (", tablename);
-				if(PX_get_record(pxdoc, j, data)) {
-					first = 0;  // set to 1 when first field has been output
-					offset = 0;
-					pxf = PX_get_fields(pxdoc);
-					for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-						if(fieldregex == NULL ||  selectedfields[i]) {
-							if(first == 1)
-								str_buffer_print(pxdoc, sbuf, ",");
-							switch(pxf->px_ftype) {
-								case pxfAlpha: {
-									char *value;
-									int ret;
-									if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-										if(strchr(value, '\'')) {
-											str_buffer_print(pxdoc, sbuf, "'");
-											str_buffer_printmask(pxdoc, sbuf, value, '\'', '\'');
-											str_buffer_print(pxdoc, sbuf, "'");
-										} else
-											str_buffer_print(pxdoc, sbuf, "'%s'", value);
-										pxdoc->free(pxdoc, value);
-									} else if(ret == 0) {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									} else {
-										fprintf(stderr, "Error while reading data of field number %d", i+1);
-										fprintf(stderr, "\n");
-									}
-									first = 1;
-
-									break;
-								}
-								case pxfDate: {
-									long value;
-									if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, date_format);
-										str_buffer_print(pxdoc, sbuf, "%s", str);
-										pxdoc->free(pxdoc, str);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfShort: {
-									short int value;
-									if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										str_buffer_print(pxdoc, sbuf, "%d", value);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfAutoInc:
-								case pxfLong: {
-									long value;
-									if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										str_buffer_print(pxdoc, sbuf, "%ld", value);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfTimestamp: {
-									double value;
-									if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										char *str = PX_timestamp2string(pxdoc, value, "Y-m-d H:i:s");
-										str_buffer_print(pxdoc, sbuf, "'%s'", str);
-										pxdoc->free(pxdoc, str);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfTime: {
-									long value;
-									if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										char *str = PX_timestamp2string(pxdoc, (double) value, time_format);
-										str_buffer_print(pxdoc, sbuf, "%s", str);
-										pxdoc->free(pxdoc, str);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfCurrency:
-								case pxfNumber: {
-									double value;
-									if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										str_buffer_print(pxdoc, sbuf, "%lf", value);
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfLogical: {
-									char value;
-									if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-										if(value)
-											str_buffer_print(pxdoc, sbuf, "1");
-										else
-											str_buffer_print(pxdoc, sbuf, "0");
-									} else {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									}
-									first = 1;
-									break;
-								}
-								case pxfMemoBLOb:
-								case pxfBLOb:
-								case pxfFmtMemoBLOb:
-								case pxfGraphic:
-								case pxfOLE: {
-									char *blobdata;
-									char filename[200];
-									FILE *fp;
-									int mod_nr, size, ret;
-									if(pxf->px_ftype == pxfGraphic)
-										ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-									else
-										ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-									if(ret > 0) {
-										str_buffer_print(pxdoc, sbuf, "'");
-										if(blobdata) {
-											if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
-												int i;
-												for(i=0; i<size; i++) {
-													if(blobdata[i] == '\'')
-
-														str_buffer_print(pxdoc, sbuf, "'");
-													str_buffer_print(pxdoc, sbuf, "%c", blobdata[i]);
-												}
-											} else {
-												sprintf(filename, "%s_%d.%s", blobprefix, mod_nr, blobextension);
-												fp = fopen(filename, "w");
-												if(fp) {
-													fwrite(blobdata, size, 1, fp);
-													fclose(fp);
-													str_buffer_print(pxdoc, sbuf, "%s", filename);
-												} else {
-													fprintf(stderr, _("Could not open file '%s' for blob data"), filename);
-													fprintf(stderr, "\n");
-												}
-											}
-											pxdoc->free(pxdoc, blobdata);
-										} else {
-											fprintf(stderr, _("Could not get blob data for %d"), mod_nr);
-											fprintf(stderr, "\n");
-										}
-										str_buffer_print(pxdoc, sbuf, "'");
-									} else if(ret == 0) {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									} else {
-										str_buffer_print(pxdoc, sbuf, "''");
-										fprintf(stderr, _("Could not get blob data for %d"), mod_nr);
-										fprintf(stderr, "\n");
-									}
-									first = 1;
-
-									break;
-								}
-								case pxfBCD: {
-									char *value;
-									int ret;
-									if(0 < (ret = PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value))) {
-										str_buffer_print(pxdoc, sbuf, "%s", value);
-										pxdoc->free(pxdoc, value);
-									} else if(ret == 0) {
-										str_buffer_print(pxdoc, sbuf, "NULL");
-									} else {
-										fprintf(stderr, "Could not read data of bcd field '%s'\n", pxf->px_fname);
-									}
-									first = 1;
-									break;
-								}
-								default:
-									str_buffer_print(pxdoc, sbuf, "NULL");
-							}
-						}
-						offset += pxf->px_flen;
-						pxf++;
+		if(NULL == (checkpoint = checkpoint_new(pxdoc, checkpointfile, pxh->px_fileupdatetime, blockmap->numblocks))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(resume) {
+			switch(checkpoint_read(pxdoc, checkpoint)) {
+				case 1:
+					if(verbose) {
+						fprintf(stderr, _("Resuming export after %d of %d data blocks."), checkpoint->doneblocks, checkpoint->numblocks);
+						fprintf(stderr, "\n");
 					}
-					str_buffer_print(pxdoc, sbuf, ");\n");
-				} else {
-					fprintf(stderr, _("Couldn't get record number %d\n"), j);
-				}
-
-				if(SQLITE_OK != sqlite_exec(sql, str_buffer_get(pxdoc, sbuf), NULL, NULL, &sqlerror)) {
-					sqlite_close(sql);
-					fprintf(stderr, "%s\n", sqlerror);
-					str_buffer_delete(pxdoc, sbuf);
-					pxdoc->free(pxdoc, data);
-					if(selectedfields)
-						pxdoc->free(pxdoc, selectedfields);
+					break;
+				case 0:
+					/* Nothing to resume, start from the beginning */
+					resume = 0;
+					break;
+				default:
 					PX_close(pxdoc);
 					exit(1);
-				}
 			}
 		}
-		str_buffer_delete(pxdoc, sbuf);
-		pxdoc->free(pxdoc, data);
+		if(outfp && 0 > truncate_output(outfp, checkpoint->offset)) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+	}
+	/* }}} */
+
+	/* Open the store of blobs named by their content {{{
+	 * and the blob file for the blob map. The sinks open their own.
+	 */
+	if(outputblobmap) {
+		if(blobstoredir && NULL == (blobstore = blob_store_new(pxdoc, blobstoredir, blobextension))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(blobfile)
+			mbfile = mbfile_open(pxdoc, blobfile);
+	}
+	/* }}} */
+
+	/* Read data blocks ahead and write output in threads of their own {{{
+	 */
+	if(pipelinedepth > 0) {
+		if(outputdeleted || checkpoint) {
+			fprintf(stderr, _("--pipeline cannot be used together with --output-deleted or --checkpoint."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(NULL == blockmap) {
+			FILE *infp;
+			if(NULL == (infp = fopen(inputfile, "rb"))) {
+				fprintf(stderr, _("Could not open input file."));
+				fprintf(stderr, "\n");
+				PX_close(pxdoc);
+				exit(1);
+			}
+			blockmap = blockmap_new(pxdoc, infp, 0);
+			fclose(infp);
+			if(NULL == blockmap) {
+				PX_close(pxdoc);
+				exit(1);
+			}
+		}
+		if(NULL == (pipeline = pipeline_new(pxdoc, inputfile, blockmap, pipelinedepth, iodepth))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(outfp && NULL == (outfp = pipeline_output(pipeline, outfp))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+	}
+	/* }}} */
+
+	/* Count and time the output {{{
+	 * The file is not positioned anymore, which a checkpoint needs.
+	 */
+	if((stats || tracefile) && outfp && !checkpoint)
+		outfp = stats_output(outfp);
+	if(stats)
+		stats_enter(STATS_CONVERT);
+	/* }}} */
+
+	if(showprogress) {
+		if(NULL == (progress = progress_new(pxdoc, showprogress == 2 ? PROGRESS_JSON : PROGRESS_TEXT, progressfd))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+	}
+
+	/* Stages of the iterators over the records {{{
+	 */
+	memset(&stages, 0, sizeof(stages));
+	stages.progress = progress;
+	stages.blockmap = blockmap;
+	stages.changedblocks = changedblocks;
+	stages.checkpoint = checkpoint;
+	stages.dedupe = dedupe;
+	stages.pipeline = pipeline;
+	stages.sortfields = sortfields;
+	stages.numsortfields = numsortfields;
+	stages.sortmemory = sortmemory;
+	stages.join = join;
+	if(outputdeleted) {
+		numrecords = theonumrecords;
+		presetdeleted = 1;
+	} else {
+		numrecords = PX_get_num_records(pxdoc);
+		presetdeleted = 0;
+	}
+	/* Outputs other than the sinks neither sort nor join records */
+	unordered = stages;
+	unordered.sortfields = NULL;
+	unordered.join = NULL;
+	/* }}} */
+
+	/* Output data as comma separated values {{{ */
+	if(outputcsv) {
+		struct pxview_sink *sink;
+		struct pxview_csv_options csvoptions;
+
+		memset(&csvoptions, 0, sizeof(csvoptions));
+		csvoptions.delimiter = delimiter;
+		csvoptions.enclosure = enclosure;
+		csvoptions.date_format = date_format;
+		csvoptions.time_format = time_format;
+		csvoptions.timestamp_format = timestamp_format;
+		csvoptions.blobprefix = blobprefix;
+		csvoptions.blobextension = blobextension;
+		csvoptions.withhead = !withouthead && !resume;
+		csvoptions.markdeleted = markdeleted;
+		if(blobwriters > 0) {
+			/* Blobs written later would be missing after a resume */
+			if(checkpoint) {
+				fprintf(stderr, _("--blob-writers cannot be used together with --checkpoint."));
+				fprintf(stderr, "\n");
+				PX_close(pxdoc);
+				exit(1);
+			}
+			csvoptions.blobwriters = blobwriters;
+		}
+		csvoptions.blobstore = blobstoredir;
+		csvoptions.blobfile = blobfile;
+		csvoptions.streamthreshold = streamthreshold;
+		if(NULL == (sink = pxview_csv_sink_new(pxdoc, outfp, &csvoptions))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(0 > export_table(pxdoc, sink, fields, numfields, fieldregex ? selectedfields : NULL, recordsize, numrecords, presetdeleted, &stages, resume, outfp)) {
+			pxview_sink_delete(sink);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		pxview_sink_delete(sink);
+	}
+	/* }}} */
 
-		sqlite_close(sql);
+	/* Options of the sql and sqlite output {{{
+	 */
+	if(outputsql || outputsqlite) {
+		if((filetype != pxfFileTypIndexDB) && 
+		   (filetype != pxfFileTypNonIndexDB)) {
+			fprintf(stderr, _("SQL output is only reasonable for DB files."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		for(i=1; i<=pxfBytes; i++)
+			sqltypes[i] = typemap[i].sqltype;
+		memset(&sqloptions, 0, sizeof(sqloptions));
+		sqloptions.tablename = tablename;
+		sqloptions.date_format = date_format;
+		sqloptions.time_format = time_format;
+		/* The format of timestamps cannot be changed in sql */
+		sqloptions.timestamp_format = "Y-m-d H:i:s";
+		sqloptions.blobprefix = blobprefix;
+		sqloptions.blobextension = blobextension;
+		sqloptions.blobfile = blobfile;
+		sqloptions.blobstore = blobstoredir;
+		sqloptions.streamthreshold = streamthreshold;
+		sqloptions.sqltypes = sqltypes;
+		sqloptions.primarykeyfields = primarykeyfields;
+		sqloptions.droptable = deletetable && !resume;
+		sqloptions.withschema = !skipschema && !resume;
+		sqloptions.usecopy = usecopy;
+		sqloptions.shortinsert = shortinsert;
+		sqloptions.emptystringisnull = emptystringisnull;
+		sqloptions.resume = resume;
+	}
+	/* }}} */
+
+#ifdef HAVE_SQLITE
+	/* Output data into sqlite database {{{
+	 */
+	if(outputsqlite) {
+		struct pxview_sink *sink;
+
+		/* The rows between two checkpoints are inserted in one
+		 * transaction, which is rolled back if the export is
+		 * interrupted.
+		 */
+		sqloptions.transactions = (checkpoint != NULL);
+		/* Other tables of a batch may write into the same database */
+		if(batch)
+			sqloptions.busytimeout = BATCH_BUSY_TIMEOUT;
+		if(NULL == (sink = pxview_sqlite_sink_new(pxdoc, outputfile, &sqloptions))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(0 > export_table(pxdoc, sink, fields, numfields, fieldregex ? selectedfields : NULL, recordsize, PX_get_num_records(pxdoc), 0, &stages, resume, NULL)) {
+			pxview_sink_delete(sink);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		pxview_sink_delete(sink);
 	}
 	/* }}} */
 #endif
@@ -2143,842 +2514,232 @@ int main(int argc, char *argv[]) {
 	/* Output data as HTML Table {{{
 	 */
 	if(outputhtml) {
-		int numrecords;
-		int isdeleted, presetdeleted;
+		struct pxview_sink *sink;
+		struct pxview_html_options htmloptions;
+
+		memset(&htmloptions, 0, sizeof(htmloptions));
+		htmloptions.tablename = tablename;
+		htmloptions.date_format = date_format;
+		htmloptions.time_format = time_format;
+		/* The format of timestamps cannot be changed in html */
+		htmloptions.timestamp_format = "Y-m-d H:i:s";
+		htmloptions.blobprefix = blobprefix;
+		htmloptions.blobextension = blobextension;
+		htmloptions.markdeleted = markdeleted;
+		htmloptions.blobfile = blobfile;
+		htmloptions.blobstore = blobstoredir;
+		htmloptions.streamthreshold = streamthreshold;
+		if(NULL == (sink = pxview_html_sink_new(pxdoc, outfp, &htmloptions))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(0 > export_table(pxdoc, sink, fields, numfields, fieldregex ? selectedfields : NULL, recordsize, numrecords, presetdeleted, &stages, resume, outfp)) {
+			pxview_sink_delete(sink);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		pxview_sink_delete(sink);
+	}
+	/* }}} */
 
-		/* Allocate memory for record data */
-		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
-			if(selectedfields)
-				pxdoc->free(pxdoc, selectedfields);
+	/* Output data as sql statements {{{
+	 */
+	if(outputsql) {
+		struct pxview_sink *sink;
+
+		if(NULL == (sink = pxview_sql_sink_new(pxdoc, outfp, &sqloptions))) {
 			PX_close(pxdoc);
 			exit(1);
 		}
+		if(0 > export_table(pxdoc, sink, fields, numfields, fieldregex ? selectedfields : NULL, recordsize, PX_get_num_records(pxdoc), 0, &stages, resume, outfp)) {
+			pxview_sink_delete(sink);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		pxview_sink_delete(sink);
+	}
+	/* }}} */
 
-		if(outputdeleted) {
-			numrecords = theonumrecords;
-			presetdeleted = 1;
-		} else {
-			numrecords = PX_get_num_records(pxdoc);
-			presetdeleted = 0;
+	/* Output aggregates over all records {{{
+	 */
+	if(outputaggregate) {
+		struct aggregate *agg;
+		struct format_options fo;
+		int ret;
+
+		if((filetype != pxfFileTypIndexDB) &&
+		   (filetype != pxfFileTypNonIndexDB)) {
+			fprintf(stderr, _("Aggregates can only be computed for DB files."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
 		}
 
-		fprintf(outfp, "<table>\n");
-		fprintf(outfp, " <caption>%s</caption>\n", tablename);
-		fprintf(outfp, " <tr>\n");
+		if(NULL == (agg = aggregate_new(pxdoc, groupby, aggregatefuncs))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
 
-		/* output field name */
-		pxf = PX_get_fields(pxdoc);
-		for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-			if(fieldregex == NULL ||  selectedfields[i]) {
-				fprintf(outfp, "  <th>");
-				if(strlen(pxf->px_fname))
-					fprintf(outfp, "%s", pxf->px_fname);
-				else
-					fprintf(outfp, "column%d", i+1);
-				switch(pxf->px_ftype) {
-					case pxfAlpha:
-						fprintf(outfp, ",A,%d", pxf->px_flen);
-						break;
-					case pxfDate:
-						fprintf(outfp, ",D,%d", pxf->px_flen);
-						break;
-					case pxfShort:
-						fprintf(outfp, ",S,%d", pxf->px_flen);
-						break;
-					case pxfAutoInc:
-						fprintf(outfp, ",+,%d", pxf->px_flen);
-						break;
-					case pxfTimestamp:
-						fprintf(outfp, ",@,%d", pxf->px_flen);
-						break;
-					case pxfLong:
-						fprintf(outfp, ",I,%d", pxf->px_flen);
-						break;
-					case pxfTime:
-						fprintf(outfp, ",T,%d", pxf->px_flen);
-						break;
-					case pxfCurrency:
-						fprintf(outfp, ",$,%d", pxf->px_flen);
-						break;
-					case pxfNumber:
-						fprintf(outfp, ",N,%d", pxf->px_flen);
-						break;
-					case pxfLogical:
-						fprintf(outfp, ",L,%d", pxf->px_flen);
-						break;
-					case pxfGraphic:
-						fprintf(outfp, ",G,%d", pxf->px_flen);
-						break;
-					case pxfBLOb:
-						fprintf(outfp, ",B,%d", pxf->px_flen);
-						break;
-					case pxfOLE:
-						fprintf(outfp, ",O,%d", pxf->px_flen);
-						break;
-					case pxfFmtMemoBLOb:
-						fprintf(outfp, ",F,%d", pxf->px_flen);
-						break;
-					case pxfMemoBLOb:
-						fprintf(outfp, ",M,%d", pxf->px_flen);
-						break;
-					case pxfBytes:
-						fprintf(outfp, ",Y,%d", pxf->px_flen);
-						break;
-					case pxfBCD:
-						fprintf(outfp, ",#,%d,%d", pxf->px_flen*2, pxf->px_fdc);
-						break;
+		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
+			aggregate_delete(agg);
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		if(0 > iter_setup(&iter, pxdoc, PX_get_num_records(pxdoc), 0, &unordered, data)) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		while(0 != (ret = record_iter_next(&iter, &j, data, NULL, NULL))) {
+			if(0 < ret) {
+				if(0 > aggregate_add(agg, data)) {
+					aggregate_delete(agg);
+					PX_close(pxdoc);
+					exit(1);
 				}
-				fprintf(outfp, "</th>\n");
+			} else {
+				fprintf(stderr, _("Couldn't get record number %d\n"), j);
 			}
-			pxf++;
 		}
-		if(markdeleted) {
-			fprintf(outfp, "  <th>deleted</th>\n");
+
+		fo.date_format = date_format;
+		fo.time_format = time_format;
+		fo.timestamp_format = timestamp_format;
+		fo.emptystringisnull = emptystringisnull;
+		fo.delimiter = delimiter;
+		fo.enclosure = enclosure;
+		if(0 > aggregate_output(agg, outfp, &fo)) {
+			aggregate_delete(agg);
+			PX_close(pxdoc);
+			exit(1);
 		}
-		fprintf(outfp, " </tr>\n");
+		aggregate_delete(agg);
+		pxdoc->free(pxdoc, data);
+	}
+	/* }}} */
 
-		for(j=0; j<numrecords; j++) {
-			int offset;
-			isdeleted = presetdeleted;
-			if(NULL != PX_get_record2(pxdoc, j, data, &isdeleted, NULL)) {
-				pxf = PX_get_fields(pxdoc);
-				offset = 0;
-				fprintf(outfp, " <tr valign=\"top\">\n");
-				for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-					if(fieldregex == NULL || selectedfields[i]) {
-						fprintf(outfp, "  <td>");
-						switch(pxf->px_ftype) {
-							case pxfAlpha: {
-								char *value;
-								int ret;
-								if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-									fprintf(outfp, "%s", value);
-									pxdoc->free(pxdoc, value);
-								} else if(ret < 0) {
-									fprintf(stderr, "Error while reading data of field number %d", i+1);
-									fprintf(stderr, "\n");
-								}
-								break;
-							}
-							case pxfDate: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, date_format);
-									fprintf(outfp, "%s", str);
-									pxdoc->free(pxdoc, str);
-								}
-								break;
-								}
-							case pxfShort: {
-								short int value;
-								if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									fprintf(outfp, "%d", value);
-								}
-								break;
-								}
-							case pxfAutoInc:
-							case pxfLong: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									fprintf(outfp, "%ld", value);
-								}
-								break;
-							}
-							case pxfTime: {
-								long value;
-								if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, (double) value, time_format);
-									fprintf(outfp, "%s", str);
-									pxdoc->free(pxdoc, str);
-								}
-								break;
-							}
-							case pxfCurrency:
-							case pxfNumber: {
-								double value;
-								if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									fprintf(outfp, "%lf", value);
-								} 
-								break;
-							} 
-							case pxfTimestamp: {
-								double value;
-								if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									char *str = PX_timestamp2string(pxdoc, value, "Y-m-d H:i:s");
-									fprintf(outfp, str);
-									pxdoc->free(pxdoc, str);
-								} 
-								break;
-							} 
-							case pxfLogical: {
-								char value;
-								if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-									if(value)
-										fprintf(outfp, "1");
-									else
-										fprintf(outfp, "0");
-								}
-								break;
-							}
-							case pxfGraphic:
-							case pxfBLOb:
-							case pxfFmtMemoBLOb:
-							case pxfMemoBLOb:
-							case pxfOLE: {
-								char *blobdata;
-								char filename[200];
-								FILE *fp;
-								int mod_nr, size, ret;
-								if(pxf->px_ftype == pxfGraphic)
-									ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-								else
-									ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-								if(ret > 0) {
-									if(blobdata) {
-										if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
-											int i;
-											for(i=0; i<size; i++) {
-												fputc(blobdata[i], outfp);
-											}
-										} else {
-											sprintf(filename, "%s_%d.%s", blobprefix, mod_nr, blobextension);
-											fp = fopen(filename, "w");
-											if(fp) {
-												fwrite(blobdata, size, 1, fp);
-												fclose(fp);
-												fprintf(outfp, "%s", filename);
-											} else {
-												fprintf(stderr, "Couldn't open file '%s' for blob data\n", filename);
-											}
-										}
-										pxdoc->free(pxdoc, blobdata);
-									} else {
-										fprintf(stderr, "Couldn't get blob data for %d\n", mod_nr);
-									}
-								}
-								break;
-							}
-							case pxfBCD: {
-								char *value;
-								if(0 < PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value)) {
-									fprintf(outfp, "%s", value);
-									pxdoc->free(pxdoc, value);
-								}
-								first = 1;
-								break;
-							}
-							default:
-								break;
-//								fprintf(outfp, "");
-						}
-						fprintf(outfp, "</td>\n");
-					}
-					offset += pxf->px_flen;
-					pxf++;
-				}
-				if((filetype == pxfFileTypPrimIndex)  ||
-				   (filetype == pxfFileTypSecIndex) ||
-				   (filetype == pxfFileTypSecIndexG)) {
-					short int value;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "  <td>%d</td>\n", value);
-					}
-					offset += 2;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "  <td>%d</td>\n", value);
-					}
-					offset += 2;
-					if(0 < PX_get_data_short(pxdoc, &data[offset], 2, &value)) {
-						fprintf(outfp, "  <td>%d</td>\n", value);
-					}
-				}
-				if(markdeleted) {
-					fprintf(outfp, "  <td>%d</td>\n", isdeleted);
+	/* Output map of the references into the blob file {{{
+	 */
+	if(outputblobmap) {
+		struct blobmap *bm;
+		struct blobmap_options bo;
+		struct iter_stages mapstages;
+		int ret;
+
+		if(NULL == mbfile) {
+			fprintf(stderr, _("A blob map requires a blob file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(NULL == (bm = blobmap_new(pxdoc, selectedfields))) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
+			blobmap_delete(bm);
+			PX_close(pxdoc);
+			exit(1);
+		}
+
+		/* The blobs of duplicate records are in the blob file as well */
+		mapstages = unordered;
+		mapstages.dedupe = NULL;
+		if(0 > iter_setup(&iter, pxdoc, PX_get_num_records(pxdoc), 0, &mapstages, data)) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		while(0 != (ret = record_iter_next(&iter, &j, data, NULL, NULL))) {
+			if(0 < ret) {
+				if(0 > blobmap_add(bm, j, data)) {
+					PX_close(pxdoc);
+					exit(1);
 				}
-				fprintf(outfp, " <tr>\n");
 			} else {
 				fprintf(stderr, _("Couldn't get record number %d\n"), j);
 			}
 		}
-		fprintf(outfp, "</table>\n");
+
+		/* Blobs are only written if asked for */
+		bo.delimiter = delimiter;
+		bo.extract = blobprefixgiven || blobstore;
+		bo.blobprefix = blobprefix;
+		bo.blobextension = blobextension;
+		bo.store = blobstore;
+		if(0 > blobmap_scan(bm, mbfile, outfp, &bo)) {
+			blobmap_delete(bm);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(bm->problems[BLOBMAP_MISSING] || bm->problems[BLOBMAP_BAD] || bm->problems[BLOBMAP_OVERLAP] || bm->problems[BLOBMAP_ORPHANED]) {
+			fprintf(stderr, _("Blob file has %ld missing, %ld bad, %ld overlapping and %ld orphaned blobs."),
+			        bm->problems[BLOBMAP_MISSING], bm->problems[BLOBMAP_BAD], bm->problems[BLOBMAP_OVERLAP], bm->problems[BLOBMAP_ORPHANED]);
+			fprintf(stderr, "\n");
+		}
+		blobmap_delete(bm);
 		pxdoc->free(pxdoc, data);
 	}
 	/* }}} */
 
-	/* Output data as sql statements {{{
+	/* Output statistics of each field {{{
 	 */
-	if(outputsql) {
-		if((filetype != pxfFileTypIndexDB) && 
+	if(outputprofile) {
+		struct profile *prof;
+		struct format_options fo;
+		int ret;
+
+		if((filetype != pxfFileTypIndexDB) &&
 		   (filetype != pxfFileTypNonIndexDB)) {
-			fprintf(stderr, _("SQL output is only reasonable for DB files."));
+			fprintf(stderr, _("Profiles can only be computed for DB files."));
 			fprintf(stderr, "\n");
 			PX_close(pxdoc);
 			exit(1);
 		}
 
-		/* check if existing table shall be delete */
-		if(deletetable) {
-			fprintf(outfp, "DROP TABLE %s;\n", tablename);
-		}
-		/* Output table schema */
-		if(!skipschema) {
-			fprintf(outfp, "CREATE TABLE %s (\n", tablename);
-			first = 0;  // set to 1 when first field has been output
-			pxf = PX_get_fields(pxdoc);
-			for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-				if(fieldregex == NULL ||  selectedfields[i]) {
-					strrep(pxf->px_fname, ' ', '_');
-					if(first == 1)
-						fprintf(outfp, ",\n");
-					switch(pxf->px_ftype) {
-						case pxfAlpha:
-						case pxfDate:
-						case pxfShort:
-						case pxfLong:
-						case pxfAutoInc:
-						case pxfCurrency:
-						case pxfNumber:
-						case pxfLogical:
-						case pxfTime:
-						case pxfTimestamp:
-						case pxfBytes:
-						case pxfMemoBLOb:
-						case pxfBLOb:
-						case pxfFmtMemoBLOb:
-						case pxfGraphic:
-						case pxfOLE:
-							fprintf(outfp, "  `%s` ", pxf->px_fname);
-							fprintf(outfp, "%s", get_sql_type(typemap, pxf->px_ftype, pxf->px_flen));
-							first = 1;
-							break;
-						case pxfBCD:
-							fprintf(outfp, "  `%s` ", pxf->px_fname);
-							fprintf(outfp, "%s", get_sql_type(typemap, pxf->px_ftype, pxf->px_fdc));
-							first = 1;
-							break;
-					}
-//					if(i < primarykeyfields)
-//						fprintf(outfp, " unique");
-				}
-				pxf++;
-			}
-			if(primarykeyfields) {
-				first = 0;  // set to 1 when first field has been output
-				pxf = PX_get_fields(pxdoc);
-				fprintf(outfp, ",\n  unique(");
-				for(i=0; i<primarykeyfields; i++) {
-					if(fieldregex == NULL ||  selectedfields[i]) {
-						strrep(pxf->px_fname, ' ', '_');
-						if(first == 1)
-							fprintf(outfp, ",");
-						fprintf(outfp, "%s", pxf->px_fname);
-						first = 1;
-					}
-					pxf++;
-				}
-				fprintf(outfp, ")");
-			}
-			fprintf(outfp, "\n);\n");
-
-			/* Create the indexes */
-			pxf = PX_get_fields(pxdoc);
-			for(i=0; i<primarykeyfields; i++) {
-				if(fieldregex == NULL ||  selectedfields[i]) {
-					strrep(pxf->px_fname, ' ', '_');
-					fprintf(outfp, "CREATE INDEX %s_%s_index on %s (%s);\n", tablename, pxf->px_fname, tablename, pxf->px_fname);
-				}
-				pxf++;
-			}
+		if(NULL == (prof = profile_new(pxdoc, selectedfields, profiletop))) {
+			PX_close(pxdoc);
+			exit(1);
 		}
 
-		/* Only output data if we have at least one record */
-		if(PX_get_num_records(pxdoc) > 0) {
-			if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
-				if(selectedfields)
-					pxdoc->free(pxdoc, selectedfields);
-				PX_close(pxdoc);
-				exit(1);
-			}
+		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
+			profile_delete(prof);
+			PX_close(pxdoc);
+			exit(1);
+		}
 
-			if(usecopy) {
-				fprintf(outfp, "COPY %s (", tablename);
-				first = 0;  // set to 1 when first field has been output
-				pxf = PX_get_fields(pxdoc);
-				/* output field name */
-				for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-					if(fieldregex == NULL ||  selectedfields[i]) {
-						if(first == 1)
-							fprintf(outfp, ", ");
-						switch(pxf->px_ftype) {
-							case pxfAlpha:
-							case pxfDate:
-							case pxfShort:
-							case pxfLong:
-							case pxfAutoInc:
-							case pxfTime:
-							case pxfCurrency:
-							case pxfNumber:
-							case pxfLogical:
-							case pxfBCD:
-							case pxfTimestamp:
-							case pxfBytes:
-							case pxfMemoBLOb:
-							case pxfBLOb:
-							case pxfFmtMemoBLOb:
-							case pxfGraphic:
-							case pxfOLE:
-								fprintf(outfp, "%s", pxf->px_fname);
-								first = 1;
-								break;
-						}
-					}
-					pxf++;
-				}
-				fprintf(outfp, ") FROM stdin;\n");
-				for(j=0; j<PX_get_num_records(pxdoc); j++) {
-					int offset;
-					if(PX_get_record(pxdoc, j, data)) {
-						first = 0;  // set to 1 when first field has been output
-						offset = 0;
-						pxf = PX_get_fields(pxdoc);
-						for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-							if(fieldregex == NULL ||  selectedfields[i]) {
-								if(first == 1)
-									fprintf(outfp, "\t");
-								switch(pxf->px_ftype) {
-									case pxfAlpha: {
-										char *value;
-										int ret;
-										if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-											if(strchr(value, '\t'))
-												printmask(outfp, value, pxf->px_flen, '\t', '\\');
-											else
-												fprintf(outfp, "%s", value);
-											pxdoc->free(pxdoc, value);
-										} else if(ret == 0) {
-											if(emptystringisnull)
-												fprintf(outfp, "\\N");
-										} else {
-											fprintf(stderr, "Error while reading data of field number %d", i+1);
-											fprintf(stderr, "\n");
-										}
-										first = 1;
-
-										break;
-									}
-									case pxfDate: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, date_format);
-											fprintf(outfp, "%s", str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfShort: {
-										short int value;
-										if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%d", value);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfAutoInc:
-									case pxfLong: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%ld", value);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfTimestamp: {
-										double value;
-										if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, value, "Y-m-d H:i:s");
-											fprintf(outfp, str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfTime: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, (double) value, time_format);
-											fprintf(outfp, "%s", str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfCurrency:
-									case pxfNumber: {
-										double value;
-										if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%lf", value);
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfLogical: {
-										char value;
-										if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											if(value)
-												fprintf(outfp, "TRUE");
-											else
-												fprintf(outfp, "FALSE");
-										} else {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-										break;
-									}
-									case pxfBLOb:
-									case pxfGraphic:
-									case pxfOLE:
-									case pxfMemoBLOb:
-									case pxfFmtMemoBLOb: {
-										char *blobdata;
-										char filename[200];
-										FILE *fp;
-										int mod_nr, size, ret;
-										if(pxf->px_ftype == pxfGraphic)
-											ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-										else
-											ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-										if(ret > 0) {
-											if(blobdata) {
-												if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
-													int i;
-													for(i=0; i<size; i++) {
-														if(blobdata[i] == '\t')
-															fputc('\\', outfp);
-														fputc(blobdata[i], outfp);
-													}
-												} else {
-													sprintf(filename, "%s_%d.%s", blobprefix, mod_nr, blobextension);
-													fp = fopen(filename, "w");
-													if(fp) {
-														fwrite(blobdata, size, 1, fp);
-														fclose(fp);
-														fprintf(outfp, "%s", filename);
-													} else {
-														fprintf(stderr, "Couldn't open file '%s' for blob data\n", filename);
-													}
-												}
-												pxdoc->free(pxdoc, blobdata);
-											} else {
-												fprintf(stderr, "Couldn't get blob data for %d\n", mod_nr);
-											}
-										} else if(ret == 0) {
-											fprintf(outfp, "\\N");
-										}
-										first = 1;
-
-										break;
-									}
-									case pxfBCD: {
-										char *value;
-										int ret;
-										if(0 < (ret = PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value))) {
-											fprintf(outfp, "%s", value);
-											pxdoc->free(pxdoc, value);
-										} else if(ret == 0) {
-											fprintf(outfp, "NULL");
-										} else {
-											fprintf(stderr, "Could not read data of bcd field '%s'\n", pxf->px_fname);
-										}
-										first = 1;
-										break;
-									}
-									case pxfBytes:
-										fprintf(outfp, "\\N");
-										break;
-									default:
-										break;
-//										fprintf(outfp, "");
-								}
-							}
-							offset += pxf->px_flen;
-							pxf++;
-						}
-						fprintf(outfp, "\n");
-					} else {
-						fprintf(stderr, _("Couldn't get record number %d\n"), j);
-					}
-				}
-				fprintf(outfp, "\\.\n");
+		if(0 > iter_setup(&iter, pxdoc, PX_get_num_records(pxdoc), 0, &unordered, data)) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		while(0 != (ret = record_iter_next(&iter, &j, data, NULL, NULL))) {
+			if(0 < ret) {
+				profile_add(prof, data);
 			} else {
-				struct str_buffer *sbuf;
-				if(!shortinsert) {
-					if((sbuf = str_buffer_new(pxdoc, 20)) == NULL) {
-						if(selectedfields)
-							pxdoc->free(pxdoc, selectedfields);
-						PX_close(pxdoc);
-						exit(1);
-					}
-					str_buffer_print(pxdoc, sbuf, "(");
-					first = 0;  // set to 1 when first field has been output
-					pxf = PX_get_fields(pxdoc);
-					/* output field name */
-					for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-						if(fieldregex == NULL ||  selectedfields[i]) {
-							if(first == 1)
-								str_buffer_print(pxdoc, sbuf, ", ");
-							switch(pxf->px_ftype) {
-								case pxfAlpha:
-								case pxfDate:
-								case pxfShort:
-								case pxfLong:
-								case pxfAutoInc:
-								case pxfTime:
-								case pxfCurrency:
-								case pxfNumber:
-								case pxfLogical:
-								case pxfBCD:
-								case pxfTimestamp:
-								case pxfBytes:
-								case pxfMemoBLOb:
-								case pxfFmtMemoBLOb:
-								case pxfBLOb:
-								case pxfGraphic:
-								case pxfOLE:
-									str_buffer_print(pxdoc, sbuf, "%s", pxf->px_fname);
-									first = 1;
-									break;
-							}
-						}
-						pxf++;
-					}
-					str_buffer_print(pxdoc, sbuf, ")");
-				}
-				for(j=0; j<PX_get_num_records(pxdoc); j++) {
-					int offset;
-					if(PX_get_record(pxdoc, j, data)) {
-						first = 0;  // set to 1 when first field has been output
-						offset = 0;
-						if(shortinsert)
-							fprintf(outfp, "insert into %s values (", tablename);
-						else
-							fprintf(outfp, "insert into %s %s values (", tablename, str_buffer_get(pxdoc, sbuf));
-						pxf = PX_get_fields(pxdoc);
-						for(i=0; i<PX_get_num_fields(pxdoc); i++) {
-							if(fieldregex == NULL ||  selectedfields[i]) {
-								if(first == 1)
-									fprintf(outfp, ", ");
-								switch(pxf->px_ftype) {
-									case pxfAlpha: {
-										char *value;
-										int ret;
-										if(0 < (ret = PX_get_data_alpha(pxdoc, &data[offset], pxf->px_flen, &value))) {
-											if(strchr(value, '\'')) {
-												fprintf(outfp, "'");
-												printmask(outfp, value, pxf->px_flen, '\'', '\\');
-												fprintf(outfp, "'");
-											} else
-												fprintf(outfp, "'%s'", value);
-											pxdoc->free(pxdoc, value);
-										} else if(ret == 0) {
-											if(emptystringisnull)
-												fprintf(outfp, "NULL");
-											else
-												fprintf(outfp, "''");
-										} else {
-											fprintf(stderr, "Error while reading data of field number %d", i+1);
-											fprintf(stderr, "\n");
-										}
-										first = 1;
-
-										break;
-									}
-									case pxfDate: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, (double) value*1000.0*86400.0, date_format);
-											fprintf(outfp, "%s", str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfShort: {
-										short int value;
-										if(0 < PX_get_data_short(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%d", value);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfAutoInc:
-									case pxfLong: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%ld", value);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfTimestamp: {
-										double value;
-										if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, value, "Y-m-d H:i:s");
-											fprintf(outfp, "'%s'", str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfTime: {
-										long value;
-										if(0 < PX_get_data_long(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											char *str = PX_timestamp2string(pxdoc, (double) value, time_format);
-											fprintf(outfp, "'%s'", str);
-											pxdoc->free(pxdoc, str);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfCurrency:
-									case pxfNumber: {
-										double value;
-										if(0 < PX_get_data_double(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											fprintf(outfp, "%lf", value);
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfLogical: {
-										char value;
-										if(0 < PX_get_data_byte(pxdoc, &data[offset], pxf->px_flen, &value)) {
-											if(value)
-												fprintf(outfp, "TRUE");
-											else
-												fprintf(outfp, "FALSE");
-										} else {
-											fprintf(outfp, "NULL");
-										}
-										first = 1;
-										break;
-									}
-									case pxfBLOb:
-									case pxfGraphic:
-									case pxfOLE:
-									case pxfMemoBLOb:
-									case pxfFmtMemoBLOb: {
-										char *blobdata;
-										char filename[200];
-										FILE *fp;
-										int mod_nr, size, ret;
-										if(pxf->px_ftype == pxfGraphic)
-											ret = PX_get_data_graphic(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-										else
-											ret = PX_get_data_blob(pxdoc, &data[offset], pxf->px_flen, &mod_nr, &size, &blobdata);
-										if(ret > 0) {
-											fputc('\'', outfp);
-											if(blobdata) {
-												if(pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb) {
-													int i;
-													for(i=0; i<size; i++) {
-														if(blobdata[i] == '\'')
-															fputc('\\', outfp);
-														fputc(blobdata[i], outfp);
-													}
-												} else {
-													sprintf(filename, "%s_%d.%s", blobprefix, mod_nr, blobextension);
-													fp = fopen(filename, "w");
-													if(fp) {
-														fwrite(blobdata, size, 1, fp);
-														fclose(fp);
-														fprintf(outfp, "%s", filename);
-													} else {
-														fprintf(stderr, "Couldn't open file '%s' for blob data\n", filename);
-													}
-												}
-												pxdoc->free(pxdoc, blobdata);
-											} else {
-												fprintf(stderr, "Couldn't get blob data for %d\n", mod_nr);
-											}
-											fputc('\'', outfp);
-										} else if(ret == 0) {
-											fprintf(outfp, "NULL");
-										} else {
-											fprintf(outfp, "''");
-											fprintf(stderr, "Couldn't get blob data for %d\n", mod_nr);
-										}
-										first = 1;
-
-										break;
-									}
-									case pxfBCD: {
-										char *value;
-										int ret;
-										if(0 < (ret = PX_get_data_bcd(pxdoc, (unsigned char*) &data[offset], pxf->px_fdc, &value))) {
-											fprintf(outfp, "%s", value);
-											pxdoc->free(pxdoc, value);
-										} else if(ret == 0) {
-											fprintf(outfp, "NULL");
-										} else {
-											fprintf(stderr, "Could not read data of bcd field '%s'\n", pxf->px_fname);
-										}
-										first = 1;
-										break;
-									}
-									case pxfBytes:
-										fprintf(outfp, "NULL");
-										first = 1;
-										break;
-									default:
-										break;
-//										fprintf(outfp, "");
-								}
-							}
-							offset += pxf->px_flen;
-							pxf++;
-						}
-						fprintf(outfp, ");\n");
-					} else {
-						fprintf(stderr, _("Couldn't get record number %d\n"), j);
-					}
-				}
-				if(!shortinsert)
-					str_buffer_delete(pxdoc, sbuf);
+				fprintf(stderr, _("Couldn't get record number %d\n"), j);
 			}
-			pxdoc->free(pxdoc, data);
 		}
+
+		fo.date_format = date_format;
+		fo.time_format = time_format;
+		fo.timestamp_format = timestamp_format;
+		fo.emptystringisnull = emptystringisnull;
+		fo.delimiter = delimiter;
+		fo.enclosure = enclosure;
+		if(0 > profile_output(prof, outfp, profileformat, &fo)) {
+			profile_delete(prof);
+			PX_close(pxdoc);
+			exit(1);
+		}
+		profile_delete(prof);
+		pxdoc->free(pxdoc, data);
 	}
 	/* }}} */
 
 	/* Output debug {{{
 	 */
 	if(outputdebug) {
-		int numrecords;
-		int isdeleted, presetdeleted;
+		int isdeleted, ret;
+		pxdatablockinfo_t pxdbinfo;
 		if((data = (char *) pxdoc->malloc(pxdoc, recordsize, _("Could not allocate memory for record."))) == NULL) {
 			if(selectedfields)
 				pxdoc->free(pxdoc, selectedfields);
@@ -2986,19 +2747,13 @@ int main(int argc, char *argv[]) {
 			exit(1);
 		}
 
-		if(outputdeleted) {
-			numrecords = theonumrecords;
-			presetdeleted = 1;
-		} else {
-			numrecords = PX_get_num_records(pxdoc);
-			presetdeleted = 0;
+		if(0 > iter_setup(&iter, pxdoc, numrecords, presetdeleted, &unordered, data)) {
+			PX_close(pxdoc);
+			exit(1);
 		}
-
-		for(j=0; j<numrecords; j++) {
+		while(0 != (ret = record_iter_next(&iter, &j, data, &isdeleted, &pxdbinfo))) {
 			int offset;
-			pxdatablockinfo_t pxdbinfo;
-			isdeleted = presetdeleted;
-			if(PX_get_record2(pxdoc, j, data, &isdeleted, &pxdbinfo)) {
+			if(0 < ret) {
 				fprintf(outfp, _("Previous block number according to header: "));
 				fprintf(outfp, "%d\n", pxdbinfo.prev);
 				fprintf(outfp, _("Next block number according to header: "));
@@ -3021,7 +2776,6 @@ int main(int argc, char *argv[]) {
 				}
 				pxf = PX_get_fields(pxdoc);
 				offset = 0;
-				first = 0;  // set to 1 when first field has been output
 				for(i=0; i<PX_get_num_fields(pxdoc); i++) {
 					if(fieldregex == NULL || selectedfields[i]) {
 						fprintf(outfp, "%s: ", pxf->px_fname);
@@ -3053,6 +2807,77 @@ int main(int argc, char *argv[]) {
 	}
 	/* }}} */
 
+	if(stats)
+		stats_leave();
+	if((stats || tracefile) && outfp)
+		outfp = stats_output_end(outfp);
+	if(progress) {
+		progress_finish(progress);
+		progress_delete(pxdoc, progress);
+	}
+
+	/* Wait for the output written by the pipeline {{{
+	 */
+	if(pipeline) {
+		if(0 > pipeline_finish_output(pipeline)) {
+			fprintf(stderr, _("Could not write output file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		outfp = pipeline->outfp;
+		pipeline_delete(pipeline);
+		if(!incrementalfile)
+			blockmap_delete(pxdoc, blockmap);
+	}
+	/* }}} */
+
+	if(blobstore)
+		blob_store_delete(blobstore);
+	if(mbfile)
+		mbfile_close(mbfile);
+
+	/* Remove checkpoint of completed export {{{
+	 */
+	if(checkpoint) {
+		if(outfp && 0 != fflush(outfp)) {
+			fprintf(stderr, _("Could not write output file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		checkpoint_remove(checkpoint);
+		checkpoint_delete(pxdoc, checkpoint);
+		if(!incrementalfile)
+			blockmap_delete(pxdoc, blockmap);
+	}
+	if(checkpointfile)
+		free(checkpointfile);
+	/* }}} */
+
+	/* Write manifest for next incremental export {{{
+	 */
+	if(incrementalfile) {
+		/* Make sure the records are written before they are recorded
+		 * as being exported.
+		 */
+		if(outfp && 0 != fflush(outfp)) {
+			fprintf(stderr, _("Could not write output file."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			exit(1);
+		}
+		if(0 > manifest_write(pxdoc, incrementalfile, blockmap, pxh->px_fileupdatetime)) {
+			PX_close(pxdoc);
+			exit(1);
+		}
+		pxdoc->free(pxdoc, changedblocks);
+		blockmap_delete(pxdoc, blockmap);
+		manifest_delete(pxdoc, manifest);
+		free(incrementalfile);
+	}
+	/* }}} */
+
 	/* FIXME: not to free typemap->sqltype */
 	if(typemap) {
 		free_sql_types(typemap);
@@ -3067,13 +2892,49 @@ int main(int argc, char *argv[]) {
 	if(selectedfields)
 		pxdoc->free(pxdoc, selectedfields);
 
+	if(orderby) {
+		if(sortfields)
+			pxdoc->free(pxdoc, sortfields);
+		free(orderby);
+	}
+	if(join) {
+		record_join_delete(join);
+		transcode_release(joindoc);
+		PX_close(joindoc);
+		PX_delete(joindoc);
+	}
+	if(joinfile)
+		free(joinfile);
+	if(dedupe)
+		record_dedupe_delete(dedupe);
+	if(batch)
+		batch_delete(batch);
+	if(joinon)
+		free(joinon);
+	if(groupby)
+		free(groupby);
+	if(aggregatefuncs)
+		free(aggregatefuncs);
+
 	if(pindexfile) {
 		PX_close(pindexdoc);
 		PX_delete(pindexdoc);
 	}
 
+	encoding_guess_free(pxdoc, &encguess);
+	transcode_release(pxdoc);
 	PX_close(pxdoc);
 	PX_delete(pxdoc);
+	free(inputfile);
+
+	if(stats) {
+		stats_print(stats, stderr, showstats == 2);
+		stats_delete(stats);
+	}
+	if(tracefile) {
+		trace_stop();
+		free(tracefile);
+	}
 
 #ifdef HAVE_GSF
 	if(PX_has_gsf_support() && usegsf) {
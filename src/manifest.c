@@ -0,0 +1,160 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "pxview_intern.h"
+#include "manifest.h"
+
+#define MANIFEST_MAGIC "# pxview block manifest"
+
+/* compare_entries() {{{
+ */
+static int compare_entries(const void *a, const void *b) {
+	const struct manifest_entry *ea = a, *eb = b;
+	return(ea->number - eb->number);
+}
+/* }}} */
+
+/* manifest_read() {{{
+ * Reads the block manifest written by manifest_write(). If the file
+ * does not exist an empty manifest is returned, because this is the
+ * first incremental export. Returns NULL on error.
+ */
+struct manifest *manifest_read(pxdoc_t *pxdoc, const char *filename) {
+	struct manifest *m;
+	FILE *fp;
+	char line[200];
+	int size = 0, lineno = 0;
+
+	if(NULL == (m = pxdoc->malloc(pxdoc, sizeof(struct manifest), _("Allocate memory for block manifest.")))) {
+		return NULL;
+	}
+	m->updatetime = 0;
+	m->numentries = 0;
+	m->entries = NULL;
+
+	if(NULL == (fp = fopen(filename, "r"))) {
+		if(errno == ENOENT)
+			return(m);
+		fprintf(stderr, _("Could not open state file '%s'."), filename);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, m);
+		return NULL;
+	}
+
+	while(fgets(line, sizeof(line), fp)) {
+		struct manifest_entry *e;
+		unsigned long long hash;
+
+		lineno++;
+		if(lineno == 1) {
+			if(strncmp(line, MANIFEST_MAGIC, strlen(MANIFEST_MAGIC))) {
+				fprintf(stderr, _("State file '%s' is not a block manifest."), filename);
+				fprintf(stderr, "\n");
+				fclose(fp);
+				manifest_delete(pxdoc, m);
+				return NULL;
+			}
+			continue;
+		}
+		if(1 == sscanf(line, "updatetime %d", &m->updatetime))
+			continue;
+		if(m->numentries >= size) {
+			struct manifest_entry *entries;
+			size += 256;
+			if(NULL == (entries = pxdoc->realloc(pxdoc, m->entries, size * sizeof(struct manifest_entry), _("Get more memory for block manifest.")))) {
+				fclose(fp);
+				manifest_delete(pxdoc, m);
+				return NULL;
+			}
+			m->entries = entries;
+		}
+		e = &(m->entries[m->numentries]);
+		if(3 != sscanf(line, "%d %d %llx", &e->number, &e->numrecords, &hash)) {
+			fprintf(stderr, _("Line %d of state file '%s' is invalid."), lineno, filename);
+			fprintf(stderr, "\n");
+			fclose(fp);
+			manifest_delete(pxdoc, m);
+			return NULL;
+		}
+		e->hash = (px_hash_t) hash;
+		e->seen = 0;
+		m->numentries++;
+	}
+	fclose(fp);
+
+	qsort(m->entries, m->numentries, sizeof(struct manifest_entry), compare_entries);
+	return(m);
+}
+/* }}} */
+
+/* manifest_write() {{{
+ * Writes the fingerprints of all blocks in the block map. The manifest
+ * is first written into a temporary file which replaces the old state
+ * file once it is complete.
+ */
+int manifest_write(pxdoc_t *pxdoc, const char *filename, struct blockmap *bm, int updatetime) {
+	FILE *fp;
+	char *tmpname;
+	int i;
+
+	if(NULL == (tmpname = pxdoc->malloc(pxdoc, strlen(filename)+5, _("Allocate memory for file name.")))) {
+		return -1;
+	}
+	sprintf(tmpname, "%s.tmp", filename);
+	if(NULL == (fp = fopen(tmpname, "w"))) {
+		fprintf(stderr, _("Could not open state file '%s'."), tmpname);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, tmpname);
+		return -1;
+	}
+	fprintf(fp, "%s\n", MANIFEST_MAGIC);
+	fprintf(fp, "updatetime %d\n", updatetime);
+	for(i=0; i<bm->numblocks; i++) {
+		fprintf(fp, "%d %d %016llx\n", bm->blocks[i].number, bm->blocks[i].numrecords, (unsigned long long) bm->blocks[i].hash);
+	}
+	if(0 != fclose(fp) || 0 != rename(tmpname, filename)) {
+		fprintf(stderr, _("Could not write state file '%s'."), filename);
+		fprintf(stderr, "\n");
+		remove(tmpname);
+		pxdoc->free(pxdoc, tmpname);
+		return -1;
+	}
+	pxdoc->free(pxdoc, tmpname);
+	return 0;
+}
+/* }}} */
+
+/* manifest_delete() {{{
+ * Frees the memory occupied by the manifest
+ */
+void manifest_delete(pxdoc_t *pxdoc, struct manifest *m) {
+	if(m->entries)
+		pxdoc->free(pxdoc, m->entries);
+	pxdoc->free(pxdoc, m);
+}
+/* }}} */
+
+/* manifest_find() {{{
+ * Returns the entry for block with the given number or NULL
+ */
+struct manifest_entry *manifest_find(struct manifest *m, int number) {
+	struct manifest_entry key;
+	if(m->numentries == 0)
+		return NULL;
+	key.number = number;
+	return(bsearch(&key, m->entries, m->numentries, sizeof(struct manifest_entry), compare_entries));
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,26 @@
+#ifndef __MANIFEST_H__
+#define __MANIFEST_H__
+
+#include "blockmap.h"
+
+/* Fingerprint of a data block as recorded by a previous export */
+struct manifest_entry {
+	int number;
+	int numrecords;
+	px_hash_t hash;
+	int seen;        /* set if block still exists */
+};
+
+/* Block manifest stored in the state file of an incremental export */
+struct manifest {
+	int updatetime;  /* px_fileupdatetime at time of export */
+	int numentries;
+	struct manifest_entry *entries;  /* sorted by block number */
+};
+
+struct manifest *manifest_read(pxdoc_t *pxdoc, const char *filename);
+int manifest_write(pxdoc_t *pxdoc, const char *filename, struct blockmap *bm, int updatetime);
+void manifest_delete(pxdoc_t *pxdoc, struct manifest *m);
+struct manifest_entry *manifest_find(struct manifest *m, int number);
+
+#endif
@@ -0,0 +1,175 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "mbfile.h"
+
+/* The last 10 bytes of a blob field point into the blob file. The first
+ * four bytes are the offset of the block with the lowest byte being the
+ * index within a suballocated block, followed by four bytes size and
+ * two bytes modification number. Blobs not larger than the rest of the
+ * field are stored in the record itself.
+ *
+ * A block with a single blob starts with a header of 9 bytes (type,
+ * number of 4k blocks, size of blob, modification number) followed by
+ * the data. A suballocated block starts with a header of 12 bytes
+ * followed by a table of 64 entries of 5 bytes each (offset in units of
+ * 16 bytes, length in units of 16 bytes, modification number, length
+ * modulo 16).
+ */
+#define SINGLEHEADERSIZE 9
+#define SUBHEADERSIZE 12
+#define SUBENTRYSIZE 5
+#define SUBENTRIES 64
+
+/* mbfile_open() {{{
+ * Opens a blob file for reading. Returns NULL on error.
+ */
+struct mbfile *mbfile_open(pxdoc_t *pxdoc, const char *filename) {
+	struct mbfile *mb;
+	struct stat st;
+
+	if(NULL == (mb = pxdoc->malloc(pxdoc, sizeof(struct mbfile), _("Allocate memory for blob file.")))) {
+		return NULL;
+	}
+	mb->pxdoc = pxdoc;
+	if(0 > (mb->fd = open(filename, O_RDONLY))) {
+		fprintf(stderr, _("Could not open blob file '%s'."), filename);
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, mb);
+		return NULL;
+	}
+	if(0 != fstat(mb->fd, &st)) {
+		close(mb->fd);
+		pxdoc->free(pxdoc, mb);
+		return NULL;
+	}
+	mb->filesize = st.st_size;
+	return(mb);
+}
+/* }}} */
+
+/* mbfile_close() {{{
+ */
+void mbfile_close(struct mbfile *mb) {
+	close(mb->fd);
+	mb->pxdoc->free(mb->pxdoc, mb);
+}
+/* }}} */
+
+/* mbfile_read() {{{
+ * Reads len bytes at position pos. Returns 0 on success and -1 if not
+ * all bytes could be read.
+ */
+int mbfile_read(struct mbfile *mb, char *buf, size_t len, off_t pos) {
+	ssize_t n;
+
+	while(len > 0) {
+		if(0 > (n = pread(mb->fd, buf, len, pos))) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(n == 0)
+			return -1;
+		buf += n;
+		len -= n;
+		pos += n;
+	}
+	return 0;
+}
+/* }}} */
+
+/* mbfile_decode_pointer() {{{
+ * Decodes the pointer at the end of a blob field without looking at
+ * the blob file.
+ */
+void mbfile_decode_pointer(pxfield_t *pxf, const char *fielddata, struct blob_location *loc) {
+	const char *ptr = &fielddata[pxf->px_flen - MBFILE_POINTERSIZE];
+	unsigned long offsetindex = (unsigned long) get_long_le(ptr);
+
+	memset(loc, 0, sizeof(struct blob_location));
+	loc->blockoffset = (long) (offsetindex & 0xffffff00UL);
+	loc->index = (int) (offsetindex & 0xff);
+	loc->size = get_long_le(ptr+4);
+	loc->modnr = get_short_le(ptr+8);
+}
+/* }}} */
+
+/* mbfile_locate() {{{
+ * Finds the data of the blob whose field data is passed. mb may be
+ * NULL if there is no blob file. The block header in the blob file is
+ * checked against the pointer.
+ * Returns 1 if the blob was found, 0 if the field is empty and -1 if
+ * the pointer or the blob file is not as expected.
+ */
+int mbfile_locate(struct mbfile *mb, pxfield_t *pxf, const char *fielddata, struct blob_location *loc) {
+	int leader = pxf->px_flen - MBFILE_POINTERSIZE;
+
+	if(leader < 0)
+		return -1;
+	mbfile_decode_pointer(pxf, fielddata, loc);
+	if(loc->size <= 0)
+		return 0;
+	if(loc->size <= leader) {
+		loc->inrecord = 1;
+		loc->data = fielddata;
+	} else if(NULL == mb) {
+		return -1;
+	} else if(loc->index == 0xff) {
+		char head[SINGLEHEADERSIZE];
+		if(0 > mbfile_read(mb, head, SINGLEHEADERSIZE, loc->blockoffset))
+			return -1;
+		if(head[0] != MBFILE_SINGLE || get_long_le(&head[3]) != loc->size)
+			return -1;
+		loc->offset = loc->blockoffset + SINGLEHEADERSIZE;
+	} else {
+		unsigned char entry[SUBENTRYSIZE];
+		char type;
+		long len;
+		if(loc->index >= SUBENTRIES)
+			return -1;
+		if(0 > mbfile_read(mb, &type, 1, loc->blockoffset) ||
+		   type != MBFILE_SUBALLOCATED ||
+		   0 > mbfile_read(mb, (char *) entry, SUBENTRYSIZE, loc->blockoffset + SUBHEADERSIZE + loc->index * SUBENTRYSIZE))
+			return -1;
+		len = ((long) entry[1] - 1) * 16 + entry[4];
+		if(entry[0] == 0 || len != loc->size)
+			return -1;
+		loc->offset = loc->blockoffset + entry[0] * 16;
+	}
+	if(!loc->inrecord && loc->offset + loc->size > mb->filesize)
+		return -1;
+	/* Graphics start with a header of 8 bytes, which pxlib drops */
+	if(pxf->px_ftype == pxfGraphic) {
+		if(loc->size <= 8)
+			return 0;
+		loc->data += 8;
+		loc->offset += 8;
+		loc->size -= 8;
+	}
+	return 1;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,41 @@
+#ifndef __MBFILE_H__
+#define __MBFILE_H__
+
+#include <sys/types.h>
+
+/* Size of the blocks of a blob file */
+#define MBFILE_BLOCKSIZE 4096
+/* Size of the pointer to the blob at the end of a blob field */
+#define MBFILE_POINTERSIZE 10
+
+/* Types of blocks in a blob file */
+#define MBFILE_HEADER 0
+#define MBFILE_SINGLE 2         /* block with a single blob */
+#define MBFILE_SUBALLOCATED 3   /* block with up to 64 small blobs */
+#define MBFILE_FREE 4
+
+/* Where the data of a blob is found */
+struct blob_location {
+	int inrecord;           /* data is stored in the record itself */
+	const char *data;       /* data in the record if inrecord is set */
+	off_t offset;           /* position of data in blob file otherwise */
+	long size;
+	long blockoffset;       /* offset of block as stored in the pointer */
+	int index;              /* index in suballocated block, 255 for single */
+	int modnr;
+};
+
+/* Blob file opened for reading blobs without pxlib */
+struct mbfile {
+	pxdoc_t *pxdoc;
+	int fd;
+	off_t filesize;
+};
+
+struct mbfile *mbfile_open(pxdoc_t *pxdoc, const char *filename);
+void mbfile_close(struct mbfile *mb);
+void mbfile_decode_pointer(pxfield_t *pxf, const char *fielddata, struct blob_location *loc);
+int mbfile_locate(struct mbfile *mb, pxfield_t *pxf, const char *fielddata, struct blob_location *loc);
+int mbfile_read(struct mbfile *mb, char *buf, size_t len, off_t pos);
+
+#endif
@@ -0,0 +1,601 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pipeline.h"
+#include "trace.h"
+
+/* The records are read by pxlib one at a time, which leaves the disk
+ * idle while the previous record is formatted. The reader thread reads
+ * the data blocks in the order of the block map into a fixed number of
+ * buffers, which are handed to the main thread and back through two
+ * bounded queues. Once all buffers are filled the reader waits, so the
+ * memory used does not depend on the size of the table. pxlib itself
+ * is only called from the main thread, as it is not thread safe.
+ *
+ * On storage with a high latency a single outstanding read leaves most
+ * of the bandwidth unused. With io_uring up to iodepth reads of data
+ * blocks are in flight at the same time. They may complete in any
+ * order, but are passed on in the order of the block map. Without
+ * io_uring the kernel is asked to read the next iodepth blocks ahead
+ * while each block is read with pread().
+ *
+ * The output is written into a pipe, which is emptied by the writer
+ * thread. The pipe is the queue between decoding and writing and
+ * blocks the main thread if the output cannot be written fast enough.
+ */
+
+#ifdef HAVE_PTHREAD_H
+/* queue_init() {{{
+ */
+static void queue_init(struct pipeline_queue *q, struct pipeline_block **items, int size) {
+	q->items = items;
+	q->size = size;
+	q->head = 0;
+	q->count = 0;
+	q->closed = 0;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->notempty, NULL);
+	pthread_cond_init(&q->notfull, NULL);
+}
+/* }}} */
+
+/* queue_destroy() {{{
+ */
+static void queue_destroy(struct pipeline_queue *q) {
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->notempty);
+	pthread_cond_destroy(&q->notfull);
+}
+/* }}} */
+
+/* queue_reset() {{{
+ * Empties the queue. Must not be called while another thread uses it.
+ */
+static void queue_reset(struct pipeline_queue *q) {
+	q->head = 0;
+	q->count = 0;
+	q->closed = 0;
+}
+/* }}} */
+
+/* queue_put() {{{
+ * Adds a block to the queue and waits while the queue is full.
+ * Returns -1 if the queue has been closed.
+ */
+static int queue_put(struct pipeline_queue *q, struct pipeline_block *b) {
+	pthread_mutex_lock(&q->lock);
+	while(q->count == q->size && !q->closed)
+		pthread_cond_wait(&q->notfull, &q->lock);
+	if(q->closed) {
+		pthread_mutex_unlock(&q->lock);
+		return -1;
+	}
+	q->items[(q->head + q->count) % q->size] = b;
+	q->count++;
+	pthread_cond_signal(&q->notempty);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+/* }}} */
+
+/* queue_get() {{{
+ * Takes the oldest block from the queue and waits while the queue is
+ * empty. Returns NULL if the queue is empty and has been closed.
+ */
+static struct pipeline_block *queue_get(struct pipeline_queue *q) {
+	struct pipeline_block *b;
+
+	pthread_mutex_lock(&q->lock);
+	while(q->count == 0 && !q->closed)
+		pthread_cond_wait(&q->notempty, &q->lock);
+	if(q->count == 0) {
+		pthread_mutex_unlock(&q->lock);
+		return NULL;
+	}
+	b = q->items[q->head];
+	q->head = (q->head + 1) % q->size;
+	q->count--;
+	pthread_cond_signal(&q->notfull);
+	pthread_mutex_unlock(&q->lock);
+	return(b);
+}
+/* }}} */
+
+/* queue_tryget() {{{
+ * Takes the oldest block from the queue without waiting. Returns NULL
+ * if the queue is empty.
+ */
+static struct pipeline_block *queue_tryget(struct pipeline_queue *q) {
+	struct pipeline_block *b = NULL;
+
+	pthread_mutex_lock(&q->lock);
+	if(q->count > 0) {
+		b = q->items[q->head];
+		q->head = (q->head + 1) % q->size;
+		q->count--;
+		pthread_cond_signal(&q->notfull);
+	}
+	pthread_mutex_unlock(&q->lock);
+	return(b);
+}
+/* }}} */
+
+/* queue_close() {{{
+ * Marks the end of the queue. If discard is set, the blocks still in
+ * the queue are dropped as well.
+ */
+static void queue_close(struct pipeline_queue *q, int discard) {
+	pthread_mutex_lock(&q->lock);
+	q->closed = 1;
+	if(discard)
+		q->count = 0;
+	pthread_cond_broadcast(&q->notempty);
+	pthread_cond_broadcast(&q->notfull);
+	pthread_mutex_unlock(&q->lock);
+}
+/* }}} */
+
+/* next_block() {{{
+ * Returns the index of the first selected block starting at index i.
+ */
+static int next_block(struct pipeline *pl, int i) {
+	while(i < pl->bm->numblocks && pl->selectedblocks && !pl->selectedblocks[i])
+		i++;
+	return(i);
+}
+/* }}} */
+
+/* read_full() {{{
+ * Reads len bytes at pos. Returns 0 on success and -1 on error.
+ */
+static int read_full(int fd, char *buf, size_t len, off_t pos) {
+	ssize_t n;
+
+	while(len > 0) {
+		if(0 > (n = pread(fd, buf, len, pos))) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		if(n == 0)
+			return -1;
+		buf += n;
+		len -= n;
+		pos += n;
+	}
+	return 0;
+}
+/* }}} */
+
+/* block_pos() {{{
+ * Returns the position of the first record of a block in the file.
+ */
+static off_t block_pos(struct pipeline *pl, int i) {
+	return(pl->bm->blocks[i].blockpos + BLOCKHEADERSIZE);
+}
+/* }}} */
+
+/* block_len() {{{
+ * Returns the size of the records in use in a block.
+ */
+static size_t block_len(struct pipeline *pl, int i) {
+	return(pl->bm->blocks[i].numrecords * pl->bm->recordsize);
+}
+/* }}} */
+
+#ifdef HAVE_LIBURING
+/* read_uring() {{{
+ * Reads the blocks with up to iodepth reads in flight. Returns -1 if
+ * io_uring is not available.
+ */
+static int read_uring(struct pipeline *pl, int fd) {
+	struct io_uring ring;
+	struct io_uring_cqe *cqe;
+	struct pipeline_block *b;
+	int i, ret, head = 0, npending = 0, stop = 0;
+
+	if(0 > io_uring_queue_init(pl->iodepth, &ring, 0))
+		return -1;
+	i = next_block(pl, pl->startblock);
+	for(;;) {
+		/* Keep the queue of the device filled. Only wait for an empty
+		 * buffer if no read is in flight, which could free one.
+		 */
+		while(!stop && i < pl->bm->numblocks && npending < pl->iodepth) {
+			struct io_uring_sqe *sqe;
+			if(npending > 0)
+				b = queue_tryget(&pl->empty);
+			else if(NULL == (b = queue_get(&pl->empty)))
+				stop = 1;
+			if(NULL == b)
+				break;
+			if(NULL == (sqe = io_uring_get_sqe(&ring))) {
+				queue_put(&pl->empty, b);
+				break;
+			}
+			b->index = i;
+			b->ok = 0;
+			b->done = 0;
+			if(pxview_tracing)
+				b->submitted = trace_now();
+			io_uring_prep_read(sqe, fd, b->data, block_len(pl, i), block_pos(pl, i));
+			io_uring_sqe_set_data(sqe, b);
+			pl->pending[(head + npending) % pl->depth] = b;
+			npending++;
+			i = next_block(pl, i+1);
+		}
+		if(npending == 0)
+			break;
+		io_uring_submit(&ring);
+		if(0 > (ret = io_uring_wait_cqe(&ring, &cqe))) {
+			if(ret == -EINTR)
+				continue;
+			break;
+		}
+		do {
+			size_t len;
+			b = io_uring_cqe_get_data(cqe);
+			len = block_len(pl, b->index);
+			if(cqe->res >= 0 && (size_t) cqe->res == len)
+				b->ok = 1;
+			else if(cqe->res > 0)
+				b->ok = (0 == read_full(fd, b->data + cqe->res, len - cqe->res, block_pos(pl, b->index) + cqe->res));
+			b->done = 1;
+			if(pxview_tracing)
+				trace_span("read block", "io", b->submitted, pl->bm->blocks[b->index].number);
+			io_uring_cqe_seen(&ring, cqe);
+		} while(0 == io_uring_peek_cqe(&ring, &cqe));
+		/* Blocks are passed on in the order they were requested */
+		while(npending > 0 && pl->pending[head]->done) {
+			b = pl->pending[head];
+			head = (head + 1) % pl->depth;
+			npending--;
+			if(!stop && 0 > queue_put(&pl->filled, b))
+				stop = 1;
+		}
+	}
+	io_uring_queue_exit(&ring);
+	return 0;
+}
+/* }}} */
+#endif
+
+/* read_pread() {{{
+ * Reads the blocks one after the other, while the kernel reads the
+ * next iodepth blocks ahead.
+ */
+static void read_pread(struct pipeline *pl, int fd) {
+	struct pipeline_block *b;
+	int i, ahead, advised = 0;
+
+	i = ahead = next_block(pl, pl->startblock);
+	while(i < pl->bm->numblocks) {
+#ifdef HAVE_POSIX_FADVISE
+		while(ahead < pl->bm->numblocks && advised < pl->iodepth) {
+			posix_fadvise(fd, block_pos(pl, ahead), block_len(pl, ahead), POSIX_FADV_WILLNEED);
+			advised++;
+			ahead = next_block(pl, ahead+1);
+		}
+#endif
+		if(NULL == (b = queue_get(&pl->empty)))
+			break;
+		b->index = i;
+		if(pxview_tracing)
+			b->submitted = trace_now();
+		b->ok = (0 == read_full(fd, b->data, block_len(pl, i), block_pos(pl, i)));
+		b->done = 1;
+		if(pxview_tracing)
+			trace_span("read block", "io", b->submitted, pl->bm->blocks[i].number);
+		if(advised > 0)
+			advised--;
+		if(0 > queue_put(&pl->filled, b))
+			break;
+		i = next_block(pl, i+1);
+	}
+}
+/* }}} */
+
+/* reader_main() {{{
+ * Reads the selected data blocks into empty buffers until all blocks
+ * are read or the pipeline is stopped.
+ */
+static void *reader_main(void *arg) {
+	struct pipeline *pl = arg;
+	int fd;
+
+	trace_thread("reader");
+	if(0 <= (fd = open(pl->inputfile, O_RDONLY))) {
+#ifdef HAVE_LIBURING
+		if(0 > read_uring(pl, fd))
+#endif
+			read_pread(pl, fd);
+		close(fd);
+	}
+	queue_close(&pl->filled, 0);
+	return NULL;
+}
+/* }}} */
+
+/* writer_main() {{{
+ * Copies everything written into the pipe into the output file.
+ */
+static void *writer_main(void *arg) {
+	struct pipeline *pl = arg;
+	double start = 0.0;
+	ssize_t n;
+
+	trace_thread("writer");
+	while(0 != (n = read(pl->pipefd[0], pl->writebuffer, PIPELINE_WRITEBUFFER))) {
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			pl->writeerror = 1;
+			break;
+		}
+		if(pxview_tracing)
+			start = trace_now();
+		if(!pl->writeerror && (size_t) n != fwrite(pl->writebuffer, 1, n, pl->outfp))
+			pl->writeerror = 1;
+		if(pxview_tracing)
+			trace_span("write output", "io", start, (long) n);
+	}
+	close(pl->pipefd[0]);
+	return NULL;
+}
+/* }}} */
+#endif
+
+/* pipeline_new() {{{
+ * Creates a pipeline reading up to depth blocks of bm from inputfile
+ * ahead with up to iodepth reads at the same time. Returns NULL if
+ * threads are not supported or on error.
+ */
+struct pipeline *pipeline_new(pxdoc_t *pxdoc, const char *inputfile, struct blockmap *bm, int depth, int iodepth) {
+#ifdef HAVE_PTHREAD_H
+	struct pipeline *pl;
+	struct pipeline_block **items;
+	int i;
+
+	if(depth <= 0)
+		depth = PIPELINE_DEPTH;
+	if(iodepth <= 0)
+		iodepth = PIPELINE_IODEPTH;
+	if(iodepth > depth)
+		depth = iodepth;
+	if(NULL == (pl = pxdoc->malloc(pxdoc, sizeof(struct pipeline), _("Allocate memory for pipeline.")))) {
+		return NULL;
+	}
+	memset(pl, 0, sizeof(struct pipeline));
+	pl->pxdoc = pxdoc;
+	pl->bm = bm;
+	pl->depth = depth;
+	pl->iodepth = iodepth;
+	if(NULL == (pl->inputfile = pxdoc->malloc(pxdoc, strlen(inputfile)+1, _("Allocate memory for pipeline.")))) {
+		pxdoc->free(pxdoc, pl);
+		return NULL;
+	}
+	strcpy(pl->inputfile, inputfile);
+	if(NULL == (pl->blocks = pxdoc->malloc(pxdoc, depth * sizeof(struct pipeline_block), _("Allocate memory for pipeline.")))) {
+		pxdoc->free(pxdoc, pl->inputfile);
+		pxdoc->free(pxdoc, pl);
+		return NULL;
+	}
+	memset(pl->blocks, 0, depth * sizeof(struct pipeline_block));
+	for(i=0; i<depth; i++) {
+		if(NULL == (pl->blocks[i].data = pxdoc->malloc(pxdoc, bm->blocksize, _("Allocate memory for data block.")))) {
+			pipeline_delete(pl);
+			return NULL;
+		}
+	}
+	/* Each queue can hold all blocks, so the main thread never waits
+	 * when returning a block. The rest is for the reads in flight.
+	 */
+	if(NULL == (items = pxdoc->malloc(pxdoc, 3 * depth * sizeof(struct pipeline_block *), _("Allocate memory for pipeline.")))) {
+		pipeline_delete(pl);
+		return NULL;
+	}
+	queue_init(&pl->empty, items, depth);
+	queue_init(&pl->filled, items+depth, depth);
+	pl->pending = items+2*depth;
+	pl->pipefd[0] = pl->pipefd[1] = -1;
+	return(pl);
+#else
+	fprintf(stderr, _("Threads are not supported on this system."));
+	fprintf(stderr, "\n");
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* pipeline_delete() {{{
+ * Stops the reader thread and frees the pipeline. The output must have
+ * been finished before.
+ */
+void pipeline_delete(struct pipeline *pl) {
+	pxdoc_t *pxdoc = pl->pxdoc;
+	int i;
+
+#ifdef HAVE_PTHREAD_H
+	if(pl->empty.items) {
+		pipeline_stop(pl);
+		queue_destroy(&pl->empty);
+		queue_destroy(&pl->filled);
+		pxdoc->free(pxdoc, pl->empty.items);
+	}
+	if(pl->writebuffer)
+		pxdoc->free(pxdoc, pl->writebuffer);
+#endif
+	for(i=0; i<pl->depth; i++) {
+		if(pl->blocks[i].data)
+			pxdoc->free(pxdoc, pl->blocks[i].data);
+	}
+	pxdoc->free(pxdoc, pl->blocks);
+	pxdoc->free(pxdoc, pl->inputfile);
+	pxdoc->free(pxdoc, pl);
+}
+/* }}} */
+
+/* pipeline_start() {{{
+ * Starts reading the blocks of the block map beginning with startblock
+ * whose flag in selectedblocks is set. If selectedblocks is NULL all
+ * blocks are read. A running reader thread is stopped before.
+ * Returns 0 on success and -1 on error.
+ */
+int pipeline_start(struct pipeline *pl, char *selectedblocks, int startblock) {
+#ifdef HAVE_PTHREAD_H
+	int i;
+
+	pipeline_stop(pl);
+	queue_reset(&pl->empty);
+	queue_reset(&pl->filled);
+	for(i=0; i<pl->depth; i++)
+		queue_put(&pl->empty, &(pl->blocks[i]));
+	pl->cur = NULL;
+	pl->selectedblocks = selectedblocks;
+	pl->startblock = startblock;
+	if(0 != pthread_create(&pl->reader, NULL, reader_main, pl)) {
+		fprintf(stderr, _("Could not start thread for reading data blocks."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	pl->reading = 1;
+	return 0;
+#else
+	return -1;
+#endif
+}
+/* }}} */
+
+/* pipeline_stop() {{{
+ * Stops the reader thread, even if not all blocks have been read.
+ */
+void pipeline_stop(struct pipeline *pl) {
+#ifdef HAVE_PTHREAD_H
+	if(!pl->reading)
+		return;
+	queue_close(&pl->empty, 1);
+	queue_close(&pl->filled, 1);
+	pthread_join(pl->reader, NULL);
+	pl->reading = 0;
+	pl->cur = NULL;
+#endif
+}
+/* }}} */
+
+/* pipeline_get_block() {{{
+ * Returns the records of the block with the given index in the block
+ * map. Blocks must be requested in the order they are read. Blocks
+ * before the requested one are skipped. Returns NULL if the block
+ * could not be read.
+ */
+char *pipeline_get_block(struct pipeline *pl, int index) {
+#ifdef HAVE_PTHREAD_H
+	while(NULL == pl->cur || pl->cur->index != index) {
+		if(pl->cur) {
+			if(pl->cur->index > index)
+				return NULL;
+			queue_put(&pl->empty, pl->cur);
+		}
+		if(pxview_tracing) {
+			double start = trace_now();
+			pl->cur = queue_get(&pl->filled);
+			trace_span("wait for block", "stall", start, index);
+		} else {
+			pl->cur = queue_get(&pl->filled);
+		}
+		if(NULL == pl->cur)
+			return NULL;
+	}
+	if(!pl->cur->ok)
+		return NULL;
+	return(pl->cur->data);
+#else
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* pipeline_output() {{{
+ * Starts the writer thread writing into outfp. Returns the file into
+ * which the output is to be written instead or NULL on error.
+ */
+FILE *pipeline_output(struct pipeline *pl, FILE *outfp) {
+#ifdef HAVE_PTHREAD_H
+	pxdoc_t *pxdoc = pl->pxdoc;
+	FILE *fp;
+
+	if(NULL == (pl->writebuffer = pxdoc->malloc(pxdoc, PIPELINE_WRITEBUFFER, _("Allocate memory for output buffer.")))) {
+		return NULL;
+	}
+	if(0 != pipe(pl->pipefd)) {
+		fprintf(stderr, _("Could not create pipe for output."));
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	if(NULL == (fp = fdopen(pl->pipefd[1], "w"))) {
+		close(pl->pipefd[0]);
+		close(pl->pipefd[1]);
+		return NULL;
+	}
+	pl->outfp = outfp;
+	pl->writeerror = 0;
+	if(0 != pthread_create(&pl->writer, NULL, writer_main, pl)) {
+		fprintf(stderr, _("Could not start thread for writing output."));
+		fprintf(stderr, "\n");
+		fclose(fp);
+		close(pl->pipefd[0]);
+		return NULL;
+	}
+	pl->writing = 1;
+	pl->pipefp = fp;
+	return(fp);
+#else
+	return NULL;
+#endif
+}
+/* }}} */
+
+/* pipeline_finish_output() {{{
+ * Waits until all output has been written into the output file.
+ * Returns 0 on success and -1 if the output could not be written.
+ */
+int pipeline_finish_output(struct pipeline *pl) {
+#ifdef HAVE_PTHREAD_H
+	if(!pl->writing)
+		return 0;
+	if(0 != fclose(pl->pipefp))
+		pl->writeerror = 1;
+	pthread_join(pl->writer, NULL);
+	pl->writing = 0;
+	if(0 != fflush(pl->outfp))
+		pl->writeerror = 1;
+	return(pl->writeerror ? -1 : 0);
+#else
+	return 0;
+#endif
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
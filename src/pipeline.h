@@ -0,0 +1,79 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#include "blockmap.h"
+
+/* Default number of data blocks read ahead */
+#define PIPELINE_DEPTH 16
+/* Default number of reads in flight at the same time */
+#define PIPELINE_IODEPTH 8
+/* Size of the buffer of the writer stage */
+#define PIPELINE_WRITEBUFFER 65536
+
+/* Buffer for one data block */
+struct pipeline_block {
+	int index;              /* index of block in block map */
+	int ok;                 /* set if the block could be read */
+	int done;               /* set when the read has completed */
+	double submitted;       /* time the read was started, for tracing */
+	char *data;             /* records of the block */
+};
+
+#ifdef HAVE_PTHREAD_H
+/* Bounded queue of blocks passed from one stage to the next. Taking a
+ * block from an empty queue and adding one to a full queue waits.
+ */
+struct pipeline_queue {
+	struct pipeline_block **items;
+	int size;
+	int head;
+	int count;
+	int closed;             /* no more blocks will be added */
+	pthread_mutex_t lock;
+	pthread_cond_t notempty;
+	pthread_cond_t notfull;
+};
+#endif
+
+/* Export split into three stages: a reader thread reading data blocks
+ * ahead, the decoding of the records in the main thread and a writer
+ * thread writing the output.
+ */
+struct pipeline {
+	pxdoc_t *pxdoc;
+	char *inputfile;
+	struct blockmap *bm;
+	int depth;              /* number of blocks read ahead */
+	int iodepth;            /* number of reads in flight */
+	struct pipeline_block *blocks;
+	struct pipeline_block *cur; /* block whose records are decoded */
+	FILE *outfp;            /* real output file */
+#ifdef HAVE_PTHREAD_H
+	struct pipeline_queue filled; /* blocks read and not yet decoded */
+	struct pipeline_queue empty;  /* blocks to be read */
+	struct pipeline_block **pending; /* reads in flight in the order of the block map */
+	pthread_t reader;
+	int reading;            /* reader thread is running */
+	char *selectedblocks;   /* blocks to be read by the reader */
+	int startblock;
+	int pipefd[2];
+	FILE *pipefp;           /* write end of the pipe */
+	char *writebuffer;
+	pthread_t writer;
+	int writing;            /* writer thread is running */
+	int writeerror;
+#endif
+};
+
+struct pipeline *pipeline_new(pxdoc_t *pxdoc, const char *inputfile, struct blockmap *bm, int depth, int iodepth);
+void pipeline_delete(struct pipeline *pl);
+int pipeline_start(struct pipeline *pl, char *selectedblocks, int startblock);
+void pipeline_stop(struct pipeline *pl);
+char *pipeline_get_block(struct pipeline *pl, int index);
+FILE *pipeline_output(struct pipeline *pl, FILE *outfp);
+int pipeline_finish_output(struct pipeline *pl);
+
+#endif
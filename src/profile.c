@@ -0,0 +1,578 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#include "pxview_intern.h"
+#include "profile.h"
+
+/* Every field is profiled in one pass over the records with a fixed
+ * amount of memory per field. The number of distinct values is
+ * estimated with HyperLogLog, the most frequent values are found with
+ * the space saving algorithm and the histogram of numeric fields
+ * doubles the width of its bins whenever a value is out of range.
+ */
+
+/* is_blob() {{{
+ * Blob fields only contain a reference to the blob file. Their values
+ * are not profiled.
+ */
+static int is_blob(int type) {
+	switch(type) {
+		case pxfMemoBLOb:
+		case pxfBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfGraphic:
+		case pxfOLE:
+			return 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* is_numeric() {{{
+ */
+static int is_numeric(int type) {
+	switch(type) {
+		case pxfShort:
+		case pxfLong:
+		case pxfAutoInc:
+		case pxfNumber:
+		case pxfCurrency:
+		case pxfBCD:
+			return 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* numeric_value() {{{
+ * Reads the value of a numeric field. Returns 1 if the field has a value
+ * and 0 if it is NULL or cannot be read.
+ */
+static int numeric_value(pxdoc_t *pxdoc, pxfield_t *pxf, char *data, double *value) {
+	switch(pxf->px_ftype) {
+		case pxfShort: {
+			short int v;
+			if(0 >= PX_get_data_short(pxdoc, data, pxf->px_flen, &v))
+				return 0;
+			*value = v;
+			return 1;
+		}
+		case pxfLong:
+		case pxfAutoInc: {
+			long v;
+			if(0 >= PX_get_data_long(pxdoc, data, pxf->px_flen, &v))
+				return 0;
+			*value = v;
+			return 1;
+		}
+		case pxfNumber:
+		case pxfCurrency:
+			return(0 < PX_get_data_double(pxdoc, data, pxf->px_flen, value));
+		case pxfBCD: {
+			char *str, *ptr;
+#ifdef HAVE_LOCALE_H
+			struct lconv *lc = localeconv();
+#endif
+			if(0 >= PX_get_data_bcd(pxdoc, (unsigned char *) data, pxf->px_fdc, &str))
+				return 0;
+#ifdef HAVE_LOCALE_H
+			/* strtod() expects the decimal point of the locale */
+			if(NULL != (ptr = strchr(str, '.')))
+				*ptr = lc->decimal_point[0];
+#endif
+			*value = strtod(str, &ptr);
+			pxdoc->free(pxdoc, str);
+			return 1;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* profile_new() {{{
+ * Creates the statistics for all fields or, if selectedfields is not
+ * NULL, for the selected fields. The topk most frequent values of each
+ * field will be output.
+ */
+struct profile *profile_new(pxdoc_t *pxdoc, char *selectedfields, int topk) {
+	struct profile *prof;
+	pxfield_t *pxf;
+	int i, offset;
+
+	if(NULL == (prof = pxdoc->malloc(pxdoc, sizeof(struct profile), _("Allocate memory for profile.")))) {
+		return NULL;
+	}
+	memset(prof, 0, sizeof(struct profile));
+	prof->pxdoc = pxdoc;
+	prof->topk = topk > 0 ? topk : PROFILE_TOPK;
+	/* More counters than values which are output make the counts of
+	 * the output values more accurate.
+	 */
+	prof->maxcounters = 4 * prof->topk;
+
+	if(NULL == (prof->columns = pxdoc->malloc(pxdoc, PX_get_num_fields(pxdoc) * sizeof(struct column_profile), _("Allocate memory for profile.")))) {
+		pxdoc->free(pxdoc, prof);
+		return NULL;
+	}
+	pxf = PX_get_fields(pxdoc);
+	offset = 0;
+	for(i=0; i<PX_get_num_fields(pxdoc); offset+=pxf[i].px_flen, i++) {
+		struct column_profile *col = &(prof->columns[prof->numcolumns]);
+		int j;
+
+		if(selectedfields && !selectedfields[i])
+			continue;
+		memset(col, 0, sizeof(struct column_profile));
+		col->field = i;
+		col->pxf = &pxf[i];
+		col->offset = offset;
+		col->histogram = is_numeric(pxf[i].px_ftype);
+		prof->numcolumns++;
+		if(is_blob(pxf[i].px_ftype))
+			continue;
+
+		if(NULL == (col->min = pxdoc->malloc(pxdoc, 2 * pxf[i].px_flen, _("Allocate memory for profile.")))) {
+			profile_delete(prof);
+			return NULL;
+		}
+		col->max = col->min + pxf[i].px_flen;
+		if(NULL == (col->registers = pxdoc->malloc(pxdoc, PROFILE_HLL_REGISTERS, _("Allocate memory for profile.")))) {
+			profile_delete(prof);
+			return NULL;
+		}
+		memset(col->registers, 0, PROFILE_HLL_REGISTERS);
+		if(NULL == (col->counters = pxdoc->malloc(pxdoc, prof->maxcounters * (sizeof(struct profile_counter) + pxf[i].px_flen), _("Allocate memory for profile.")))) {
+			profile_delete(prof);
+			return NULL;
+		}
+		for(j=0; j<prof->maxcounters; j++)
+			col->counters[j].value = (char *) (col->counters + prof->maxcounters) + j * pxf[i].px_flen;
+	}
+	return(prof);
+}
+/* }}} */
+
+/* profile_delete() {{{
+ */
+void profile_delete(struct profile *prof) {
+	pxdoc_t *pxdoc = prof->pxdoc;
+	int i;
+
+	for(i=0; i<prof->numcolumns; i++) {
+		struct column_profile *col = &(prof->columns[i]);
+		if(col->min)
+			pxdoc->free(pxdoc, col->min);
+		if(col->registers)
+			pxdoc->free(pxdoc, col->registers);
+		if(col->counters)
+			pxdoc->free(pxdoc, col->counters);
+	}
+	pxdoc->free(pxdoc, prof->columns);
+	pxdoc->free(pxdoc, prof);
+}
+/* }}} */
+
+/* add_distinct() {{{
+ * The first PROFILE_HLL_BITS bits of the hash select a register, which
+ * keeps the maximum position of the first set bit in the remaining bits.
+ */
+static void add_distinct(struct column_profile *col, px_hash_t hash) {
+	int index = (int) (hash >> (64 - PROFILE_HLL_BITS));
+	px_hash_t rest = hash << PROFILE_HLL_BITS;
+	unsigned char rank = 1;
+
+	while(rank <= 64 - PROFILE_HLL_BITS && !(rest & 0x8000000000000000ULL)) {
+		rank++;
+		rest <<= 1;
+	}
+	if(rank > col->registers[index])
+		col->registers[index] = rank;
+}
+/* }}} */
+
+/* estimate_distinct() {{{
+ * Returns the estimated number of distinct values. The standard error
+ * is 1.04/sqrt(PROFILE_HLL_REGISTERS), about 1.6%. Small numbers are
+ * estimated by the number of empty registers, which is more precise.
+ */
+static double estimate_distinct(struct column_profile *col) {
+	double m = PROFILE_HLL_REGISTERS;
+	double sum = 0.0, estimate;
+	int i, zeros = 0;
+
+	for(i=0; i<PROFILE_HLL_REGISTERS; i++) {
+		sum += ldexp(1.0, -col->registers[i]);
+		if(col->registers[i] == 0)
+			zeros++;
+	}
+	estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+	if(estimate <= 2.5 * m && zeros > 0)
+		estimate = m * log(m / zeros);
+	return(estimate);
+}
+/* }}} */
+
+/* add_frequent() {{{
+ * Counts a value in the space saving sketch. If the value has no
+ * counter and all counters are in use, the counter with the smallest
+ * count is taken over. Its count is an upper bound for the number of
+ * occurrences of the new value.
+ */
+static void add_frequent(struct profile *prof, struct column_profile *col, const char *data, px_hash_t hash) {
+	struct profile_counter *c, *min;
+	int flen = col->pxf->px_flen;
+	int i;
+
+	for(i=0, c=col->counters; i<col->numcounters; i++, c++) {
+		if(c->hash == hash && !memcmp(c->value, data, flen)) {
+			c->count++;
+			return;
+		}
+	}
+	if(col->numcounters < prof->maxcounters) {
+		c = &(col->counters[col->numcounters++]);
+		c->count = 1;
+		c->error = 0;
+	} else {
+		min = col->counters;
+		for(i=1, c=col->counters+1; i<col->numcounters; i++, c++) {
+			if(c->count < min->count)
+				min = c;
+		}
+		c = min;
+		c->error = c->count;
+		c->count++;
+	}
+	c->hash = hash;
+	memcpy(c->value, data, flen);
+}
+/* }}} */
+
+/* widen_histogram() {{{
+ * Doubles the width of the bins by merging two neighbouring bins. The
+ * range is extended to the left if left is set, otherwise to the right.
+ */
+static void widen_histogram(struct column_profile *col, int left) {
+	int i;
+
+	if(left) {
+		for(i=PROFILE_BINS-1; i>=PROFILE_BINS/2; i--)
+			col->bins[i] = col->bins[2*i-PROFILE_BINS] + col->bins[2*i-PROFILE_BINS+1];
+		for(i=0; i<PROFILE_BINS/2; i++)
+			col->bins[i] = 0;
+		col->histlow -= PROFILE_BINS * col->histwidth;
+	} else {
+		for(i=0; i<PROFILE_BINS/2; i++)
+			col->bins[i] = col->bins[2*i] + col->bins[2*i+1];
+		for(; i<PROFILE_BINS; i++)
+			col->bins[i] = 0;
+	}
+	col->histwidth *= 2;
+}
+/* }}} */
+
+/* add_histogram() {{{
+ */
+static void add_histogram(struct column_profile *col, double value) {
+	int i;
+
+	/* Infinite values and NaN cannot be put into any bin */
+	if(value - value != 0.0)
+		return;
+	if(col->numvalues++ == 0) {
+		col->histlow = value;
+		col->histwidth = 0.0;
+		col->bins[0] = 1;
+		return;
+	}
+	if(col->histwidth == 0.0) {
+		/* The range is set by the first two different values */
+		if(value > col->histlow) {
+			col->histwidth = (value - col->histlow) / (PROFILE_BINS-1);
+		} else if(value < col->histlow) {
+			col->histwidth = (col->histlow - value) / (PROFILE_BINS-1);
+			col->bins[PROFILE_BINS-1] = col->bins[0];
+			col->bins[0] = 0;
+			col->histlow = value;
+		}
+		if(col->histwidth == 0.0) {
+			col->bins[0]++;
+			return;
+		}
+	}
+	while(col->histwidth < DBL_MAX / (4*PROFILE_BINS)) {
+		if(value < col->histlow)
+			widen_histogram(col, 1);
+		else if(value >= col->histlow + PROFILE_BINS * col->histwidth)
+			widen_histogram(col, 0);
+		else
+			break;
+	}
+	if(value < col->histlow)
+		i = 0;
+	else if(value >= col->histlow + PROFILE_BINS * col->histwidth)
+		i = PROFILE_BINS-1;
+	else
+		i = (int) ((value - col->histlow) / col->histwidth);
+	if(i >= PROFILE_BINS)
+		i = PROFILE_BINS-1;
+	col->bins[i]++;
+}
+/* }}} */
+
+/* is_empty() {{{
+ * Checks if an alpha value consists of blanks only.
+ */
+static int is_empty(const char *data, int len) {
+	int i;
+	for(i=0; i<len && data[i] != '\0'; i++) {
+		if(data[i] != ' ')
+			return 0;
+	}
+	return 1;
+}
+/* }}} */
+
+/* profile_add() {{{
+ * Adds a record to the statistics. Returns 0 on success.
+ */
+int profile_add(struct profile *prof, char *data) {
+	pxdoc_t *pxdoc = prof->pxdoc;
+	int i, j;
+
+	prof->numrecords++;
+	for(i=0; i<prof->numcolumns; i++) {
+		struct column_profile *col = &(prof->columns[i]);
+		char *value = data + col->offset;
+		int flen = col->pxf->px_flen;
+		px_hash_t hash;
+		double d;
+
+		/* NULL values are stored as all zero bytes for every field type */
+		for(j=0; j<flen && value[j] == '\0'; j++)
+			;
+		if(j == flen) {
+			col->nulls++;
+			continue;
+		}
+		if(is_blob(col->pxf->px_ftype))
+			continue;
+
+		if(col->pxf->px_ftype == pxfAlpha) {
+			if(is_empty(value, flen))
+				col->empties++;
+			for(j=0; j<flen && value[j] != '\0'; j++)
+				;
+			col->totallength += j;
+		}
+
+		/* Raw field bytes compare like their values */
+		if(!col->hasminmax) {
+			memcpy(col->min, value, flen);
+			memcpy(col->max, value, flen);
+			col->hasminmax = 1;
+		} else if(0 > memcmp(value, col->min, flen)) {
+			memcpy(col->min, value, flen);
+		} else if(0 < memcmp(value, col->max, flen)) {
+			memcpy(col->max, value, flen);
+		}
+
+		hash = hash_bytes(value, flen, 0);
+		add_distinct(col, hash);
+		add_frequent(prof, col, value, hash);
+
+		if(col->histogram && numeric_value(pxdoc, col->pxf, value, &d))
+			add_histogram(col, d);
+	}
+	return 0;
+}
+/* }}} */
+
+/* compare_counters() {{{
+ * Orders counters by decreasing number of guaranteed occurrences.
+ */
+static int compare_counters(const void *a, const void *b) {
+	const struct profile_counter *ca = (const struct profile_counter *) a;
+	const struct profile_counter *cb = (const struct profile_counter *) b;
+	if(ca->count - ca->error != cb->count - cb->error)
+		return(ca->count - ca->error > cb->count - cb->error ? -1 : 1);
+	if(ca->count != cb->count)
+		return(ca->count > cb->count ? -1 : 1);
+	return(0);
+}
+/* }}} */
+
+/* num_frequent() {{{
+ * Returns the number of counters which are output. A counter which took
+ * over another one and may have counted its value only once says
+ * nothing about the frequency of the value.
+ */
+static int num_frequent(struct profile *prof, struct column_profile *col) {
+	int i;
+	for(i=0; i<col->numcounters && i<prof->topk; i++) {
+		if(col->counters[i].error > 0 && col->counters[i].count - col->counters[i].error <= 1)
+			break;
+	}
+	return(i);
+}
+/* }}} */
+
+/* output_json() {{{
+ */
+static void output_json(struct profile *prof, struct str_buffer *sb, struct column_profile *col, struct format_options *fo) {
+	pxdoc_t *pxdoc = prof->pxdoc;
+	long numvalues = prof->numrecords - col->nulls;
+	int i;
+
+	str_buffer_print(pxdoc, sb, "{\"name\": ");
+	format_fieldname(pxdoc, sb, col->pxf, col->field, FORMAT_JSON, fo);
+	str_buffer_print(pxdoc, sb, ", \"type\": \"%s\", \"nulls\": %ld", field_type_name(col->pxf->px_ftype), col->nulls);
+	if(col->pxf->px_ftype == pxfAlpha) {
+		str_buffer_print(pxdoc, sb, ", \"empty\": %ld, \"avglength\": ", col->empties);
+		if(numvalues > 0)
+			format_double(pxdoc, sb, (double) col->totallength / numvalues);
+		else
+			str_buffer_print(pxdoc, sb, "null");
+	}
+	if(col->registers) {
+		str_buffer_print(pxdoc, sb, ", \"min\": ");
+		if(col->hasminmax)
+			format_field(pxdoc, sb, col->pxf, col->min, FORMAT_JSON, fo);
+		else
+			str_buffer_print(pxdoc, sb, "null");
+		str_buffer_print(pxdoc, sb, ", \"max\": ");
+		if(col->hasminmax)
+			format_field(pxdoc, sb, col->pxf, col->max, FORMAT_JSON, fo);
+		else
+			str_buffer_print(pxdoc, sb, "null");
+		str_buffer_print(pxdoc, sb, ", \"distinct\": %.0f, \"top\": [", estimate_distinct(col));
+		for(i=0; i<num_frequent(prof, col); i++) {
+			struct profile_counter *c = &(col->counters[i]);
+			str_buffer_print(pxdoc, sb, "%s{\"value\": ", i ? ", " : "");
+			format_field(pxdoc, sb, col->pxf, c->value, FORMAT_JSON, fo);
+			str_buffer_print(pxdoc, sb, ", \"count\": %ld, \"error\": %ld}", c->count, c->error);
+		}
+		str_buffer_print(pxdoc, sb, "]");
+	}
+	if(col->histogram) {
+		str_buffer_print(pxdoc, sb, ", \"histogram\": [");
+		for(i=0; i<PROFILE_BINS && col->numvalues > 0; i++) {
+			str_buffer_print(pxdoc, sb, "%s{\"low\": ", i ? ", " : "");
+			format_double(pxdoc, sb, col->histlow + i * col->histwidth);
+			str_buffer_print(pxdoc, sb, ", \"high\": ");
+			format_double(pxdoc, sb, col->histlow + (i+1) * col->histwidth);
+			str_buffer_print(pxdoc, sb, ", \"count\": %ld}", col->bins[i]);
+			/* All values are equal */
+			if(col->histwidth == 0.0)
+				break;
+		}
+		str_buffer_print(pxdoc, sb, "]");
+	}
+	str_buffer_print(pxdoc, sb, "}");
+}
+/* }}} */
+
+/* output_text() {{{
+ */
+static void output_text(struct profile *prof, struct str_buffer *sb, struct column_profile *col, struct format_options *fo) {
+	pxdoc_t *pxdoc = prof->pxdoc;
+	long numvalues = prof->numrecords - col->nulls;
+	int i;
+
+	format_fieldname(pxdoc, sb, col->pxf, col->field, FORMAT_TEXT, fo);
+	str_buffer_print(pxdoc, sb, " (%s)\n", field_type_name(col->pxf->px_ftype));
+	str_buffer_print(pxdoc, sb, _("  Null values:      %ld\n"), col->nulls);
+	if(col->pxf->px_ftype == pxfAlpha) {
+		str_buffer_print(pxdoc, sb, _("  Empty values:     %ld\n"), col->empties);
+		if(numvalues > 0) {
+			str_buffer_print(pxdoc, sb, _("  Average length:   "));
+			format_double(pxdoc, sb, (double) col->totallength / numvalues);
+			str_buffer_print(pxdoc, sb, "\n");
+		}
+	}
+	if(col->registers && col->hasminmax) {
+		str_buffer_print(pxdoc, sb, _("  Minimum:          "));
+		format_field(pxdoc, sb, col->pxf, col->min, FORMAT_TEXT, fo);
+		str_buffer_print(pxdoc, sb, "\n");
+		str_buffer_print(pxdoc, sb, _("  Maximum:          "));
+		format_field(pxdoc, sb, col->pxf, col->max, FORMAT_TEXT, fo);
+		str_buffer_print(pxdoc, sb, "\n");
+		str_buffer_print(pxdoc, sb, _("  Distinct values:  ~%.0f\n"), estimate_distinct(col));
+		str_buffer_print(pxdoc, sb, _("  Frequent values:\n"));
+		for(i=0; i<num_frequent(prof, col); i++) {
+			struct profile_counter *c = &(col->counters[i]);
+			/* Values which took over a counter occurred at least
+			 * count - error times.
+			 */
+			str_buffer_print(pxdoc, sb, "    %s%8ld ", c->error > 0 ? ">=" : "  ", c->count - c->error);
+			format_field(pxdoc, sb, col->pxf, c->value, FORMAT_TEXT, fo);
+			str_buffer_print(pxdoc, sb, "\n");
+		}
+	}
+	if(col->histogram && col->numvalues > 0) {
+		str_buffer_print(pxdoc, sb, _("  Histogram:\n"));
+		for(i=0; i<PROFILE_BINS; i++) {
+			str_buffer_print(pxdoc, sb, "    %8ld [", col->bins[i]);
+			format_double(pxdoc, sb, col->histlow + i * col->histwidth);
+			str_buffer_print(pxdoc, sb, ", ");
+			format_double(pxdoc, sb, col->histlow + (i+1) * col->histwidth);
+			str_buffer_print(pxdoc, sb, col->histwidth == 0.0 ? "]\n" : ")\n");
+			if(col->histwidth == 0.0)
+				break;
+		}
+	}
+}
+/* }}} */
+
+/* profile_output() {{{
+ * Outputs the statistics of all fields as JSON or text. Returns 0 on
+ * success and -1 on error.
+ */
+int profile_output(struct profile *prof, FILE *outfp, int format, struct format_options *fo) {
+	pxdoc_t *pxdoc = prof->pxdoc;
+	struct str_buffer *sb;
+	int i;
+
+	if(NULL == (sb = str_buffer_new(pxdoc, 1000)))
+		return -1;
+
+	if(format == FORMAT_JSON)
+		fprintf(outfp, "{\"records\": %ld, \"fields\": [\n", prof->numrecords);
+	else
+		fprintf(outfp, _("Number of records: %ld\n"), prof->numrecords);
+	for(i=0; i<prof->numcolumns; i++) {
+		struct column_profile *col = &(prof->columns[i]);
+		if(col->counters)
+			qsort(col->counters, col->numcounters, sizeof(struct profile_counter), compare_counters);
+		str_buffer_clear(pxdoc, sb);
+		if(format == FORMAT_JSON) {
+			output_json(prof, sb, col, fo);
+			fprintf(outfp, "%s%s", str_buffer_get(pxdoc, sb), i < prof->numcolumns-1 ? ",\n" : "\n");
+		} else {
+			output_text(prof, sb, col, fo);
+			fprintf(outfp, "\n%s", str_buffer_get(pxdoc, sb));
+		}
+	}
+	if(format == FORMAT_JSON)
+		fprintf(outfp, "]}\n");
+	str_buffer_delete(pxdoc, sb);
+	return 0;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
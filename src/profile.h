@@ -0,0 +1,59 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <stdio.h>
+#include "hash.h"
+#include "format.h"
+
+/* Number of bits of the hash which select a HyperLogLog register */
+#define PROFILE_HLL_BITS 12
+#define PROFILE_HLL_REGISTERS (1 << PROFILE_HLL_BITS)
+/* Number of bins of the histogram of numeric fields */
+#define PROFILE_BINS 16
+/* Default number of most frequent values */
+#define PROFILE_TOPK 10
+
+/* Counter of the space saving sketch for frequent values */
+struct profile_counter {
+	px_hash_t hash;
+	long count;             /* upper bound of occurrences */
+	long error;             /* count may exceed the real number by this */
+	char *value;            /* raw bytes of field */
+};
+
+/* Statistics of one field */
+struct column_profile {
+	int field;
+	pxfield_t *pxf;
+	int offset;             /* offset of field in record */
+	long nulls;
+	long empties;           /* alpha values consisting of blanks only */
+	long long totallength;  /* sum of the lengths of alpha values */
+	int hasminmax;
+	char *min;
+	char *max;
+	unsigned char *registers;   /* HyperLogLog registers */
+	struct profile_counter *counters;
+	int numcounters;
+	int histogram;          /* 0 if field is not numeric */
+	long numvalues;         /* number of values in histogram */
+	double histlow;         /* lower bound of first bin */
+	double histwidth;       /* 0 as long as all values are equal */
+	long bins[PROFILE_BINS];
+};
+
+struct profile {
+	pxdoc_t *pxdoc;
+	long numrecords;
+	int topk;
+	int maxcounters;
+	int numcolumns;
+	struct column_profile *columns;
+};
+
+struct profile *profile_new(pxdoc_t *pxdoc, char *selectedfields, int topk);
+void profile_delete(struct profile *prof);
+int profile_add(struct profile *prof, char *data);
+int profile_output(struct profile *prof, FILE *outfp, int format, struct format_options *fo);
+
+#endif
@@ -0,0 +1,143 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "progress.h"
+
+/* Reports are written as single lines with write(), so they are not
+ * held back by buffering and do not mix with other output to the same
+ * descriptor.
+ */
+
+/* progress_clock() {{{
+ */
+static double progress_clock(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec + tv.tv_usec / 1e6);
+}
+/* }}} */
+
+/* progress_new() {{{
+ * Creates a progress report for the records of pxdoc written to fd in
+ * the given format. Returns NULL on error.
+ */
+struct progress *progress_new(pxdoc_t *pxdoc, int format, int fd) {
+	struct progress *p;
+	float number;
+
+	if(NULL == (p = pxdoc->malloc(pxdoc, sizeof(struct progress), _("Allocate memory for progress report.")))) {
+		return NULL;
+	}
+	memset(p, 0, sizeof(struct progress));
+	p->format = format;
+	p->fd = fd;
+	p->totalrecords = PX_get_num_records(pxdoc);
+	PX_get_value(pxdoc, "numblocks", &number);
+	p->totalblocks = (long) number;
+	p->lastblock = -1;
+	p->countdown = PROGRESS_CHECK;
+	p->start = p->lastreport = progress_clock();
+	return(p);
+}
+/* }}} */
+
+/* progress_delete() {{{
+ */
+void progress_delete(pxdoc_t *pxdoc, struct progress *p) {
+	pxdoc->free(pxdoc, p);
+}
+/* }}} */
+
+/* progress_report() {{{
+ * Writes a report. The rate is the one since the last report, the
+ * estimated time left is based on the rate since the start.
+ */
+static void progress_report(struct progress *p, double now, int done) {
+	char line[512];
+	double elapsed = now - p->start;
+	double rate, eta = -1.0;
+	int len;
+
+	rate = (now > p->lastreport) ? (p->records - p->lastrecords) / (now - p->lastreport) : 0.0;
+	if(!done && elapsed > 0.0 && p->records > 0 && p->records < p->totalrecords)
+		eta = (p->totalrecords - p->records) / (p->records / elapsed);
+	if(done)
+		eta = 0.0;
+
+	if(p->format == PROGRESS_JSON) {
+		len = snprintf(line, sizeof(line), "{\"records\": %ld, \"total_records\": %ld, \"blocks\": %ld, \"total_blocks\": %ld, \"records_per_second\": %.1f, \"elapsed\": %.1f, \"eta\": %.1f, \"done\": %s}\n",
+			p->records, p->totalrecords, p->blocks, p->totalblocks, rate, elapsed, eta, done ? "true" : "false");
+	} else {
+		len = snprintf(line, sizeof(line), _("%ld/%ld records (%.1f%%), %ld/%ld blocks, %.0f records/s, "),
+			p->records, p->totalrecords,
+			p->totalrecords > 0 ? 100.0 * (p->records < p->totalrecords ? p->records : p->totalrecords) / p->totalrecords : 100.0,
+			p->blocks, p->totalblocks, rate);
+		if(done)
+			len += snprintf(line+len, sizeof(line)-len, _("done after %.0f s\n"), elapsed);
+		else if(eta >= 0.0)
+			len += snprintf(line+len, sizeof(line)-len, _("%.0f s left\n"), eta);
+		else
+			len += snprintf(line+len, sizeof(line)-len, _("time left unknown\n"));
+	}
+	if(len > (int) sizeof(line) - 1)
+		len = sizeof(line) - 1;
+	/* A report which cannot be written is lost, the export goes on */
+	if(write(p->fd, line, len) < 0)
+		p->fd = -1;
+	p->lastreport = now;
+	p->lastrecords = p->records;
+}
+/* }}} */
+
+/* progress_record() {{{
+ * Counts a record read from the data block at blockpos. The clock is
+ * only read every PROGRESS_CHECK records.
+ */
+void progress_record(struct progress *p, long blockpos) {
+	double now;
+
+	p->records++;
+	if(blockpos != p->lastblock) {
+		p->blocks++;
+		p->lastblock = blockpos;
+	}
+	if(--p->countdown > 0)
+		return;
+	p->countdown = PROGRESS_CHECK;
+	now = progress_clock();
+	if(p->fd >= 0 && now - p->lastreport >= PROGRESS_INTERVAL)
+		progress_report(p, now, 0);
+}
+/* }}} */
+
+/* progress_finish() {{{
+ * Writes the final report.
+ */
+void progress_finish(struct progress *p) {
+	if(p->fd >= 0)
+		progress_report(p, progress_clock(), 1);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
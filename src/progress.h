@@ -0,0 +1,32 @@
+#ifndef __PROGRESS_H__
+#define __PROGRESS_H__
+
+/* Seconds between two reports */
+#define PROGRESS_INTERVAL 1.0
+/* Number of records after which the clock is checked */
+#define PROGRESS_CHECK 1024
+
+#define PROGRESS_TEXT 0
+#define PROGRESS_JSON 1
+
+/* Reports how many records of a table have been read */
+struct progress {
+	int format;
+	int fd;                 /* file descriptor the reports are written to */
+	long totalrecords;
+	long totalblocks;
+	long records;
+	long blocks;
+	long lastblock;         /* position of last data block read */
+	int countdown;          /* records until the clock is checked */
+	double start;
+	double lastreport;      /* time of last report */
+	long lastrecords;       /* records read at last report */
+};
+
+struct progress *progress_new(pxdoc_t *pxdoc, int format, int fd);
+void progress_delete(pxdoc_t *pxdoc, struct progress *p);
+void progress_record(struct progress *p, long blockpos);
+void progress_finish(struct progress *p);
+
+#endif
@@ -0,0 +1,606 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#ifdef HAVE_GETTEXT
+#include <libintl.h>
+#endif
+#ifdef HAVE_BASENAME
+#include <libgen.h>
+#endif
+#include "pxview_intern.h"
+
+/* pxbench runs pxview in every output mode on tables written by pxgen,
+ * collects the statistics pxview prints with --stats=json and compares
+ * them with a baseline of an earlier run.
+ */
+
+/* Shapes of the generated tables. The options are passed to pxgen.
+ * pxview reads the blob file pxgen writes next to tables with blobs.
+ */
+static struct bench_shape {
+	const char *name;
+	const char *fields;
+	const char *options[3];
+	int hasblobs;
+} bench_shapes[] = {
+	{"narrow", "+,I,A20,D", {NULL}, 0},
+	{"wide", "+,A40,S,I,N,$,L,D,T,@,#,Y16,A80,A10,N,I", {NULL}, 0},
+	{"strings", "+,A255,A255,A100,A40", {"--string-length=short", NULL}, 0},
+	{"latin", "+,A80,A80,A40", {"--codepage=1252", "--non-ascii=0.2", NULL}, 0},
+	{"blobs", "+,A20,M40,B20,F40,O20,G20", {"--blob-size=2000", NULL}, 1},
+	{"deleted", "+,A40,I,N,D", {"--deleted=0.2", "--primary-index", NULL}, 0},
+	{NULL, NULL, {NULL}, 0}
+};
+
+/* Output modes and the options of pxview selecting them */
+static struct bench_mode {
+	const char *name;
+	const char *options[3];
+} bench_modes[] = {
+	{"info", {"--mode=info", NULL}},
+	{"csv", {"--mode=csv", NULL}},
+	{"html", {"--mode=html", NULL}},
+	{"sql", {"--mode=sql", NULL}},
+	{"sql-copy", {"--mode=sql", "--use-copy", NULL}},
+	{"sqlite", {"--mode=sqlite", NULL}},
+	{"schema", {"--mode=schema", NULL}},
+	{NULL, {NULL}}
+};
+
+#define DEFAULT_SIZES "10000,200000"
+#define MAX_ARGS 16
+
+/* Measurement of one table in one mode. The fastest of all repetitions
+ * is kept.
+ */
+struct bench_result {
+	char table[64];
+	char mode[16];
+	double wall;
+	double records_per_second;
+	double mb_per_second;
+	long peak_rss_kb;
+	long mallocs;
+	long records;
+};
+
+/* usage() {{{
+ * Output usage information
+ */
+void usage(char *progname) {
+	printf(_("Version: %s %s http://sourceforge.net/projects/pxlib"), progname, VERSION);
+	printf("\n");
+	printf(_("%s runs pxview in all output modes on generated tables and compares\nthe throughput, memory and allocations with a baseline."), progname);
+	printf("\n\n");
+	printf(_("Usage: %s [OPTIONS]"), progname);
+	printf("\n\n");
+	printf(_("Options:"));
+	printf("\n");
+	printf(_("  -h, --help          this usage information."));
+	printf("\n");
+	printf(_("  --version           show version information."));
+	printf("\n");
+	printf(_("  -v, --verbose       be more verbose."));
+	printf("\n");
+	printf(_("  --pxview=FILE       pxview program to measure (default ./pxview)."));
+	printf("\n");
+	printf(_("  --pxgen=FILE        pxgen program to create tables (default ./pxgen)."));
+	printf("\n");
+	printf(_("  --dir=DIRECTORY     directory of the generated tables (default pxbench.d).\n                      Existing tables are used again."));
+	printf("\n");
+	printf(_("  --sizes=LIST        comma separated numbers of records (default %s)."), DEFAULT_SIZES);
+	printf("\n");
+	printf(_("  --shapes=LIST       tables to run (default all):"));
+	printf(" narrow, wide, strings, latin, blobs, deleted.");
+	printf("\n");
+	printf(_("  --modes=LIST        output modes to run (default all):"));
+	printf(" info, csv, html, sql, sql-copy, sqlite, schema.");
+	printf("\n");
+	printf(_("  --repeat=N          runs of each measurement, the fastest counts (default 3)."));
+	printf("\n");
+	printf(_("  -o, --output=FILE   write the results as json into FILE (default pxbench.json)."));
+	printf("\n");
+	printf(_("  -b, --baseline=FILE compare with the results in FILE. If FILE does not\n                      exist, the results are saved as baseline."));
+	printf("\n");
+	printf(_("  --update-baseline   save the results as baseline after comparing."));
+	printf("\n");
+	printf(_("  --tolerance=PERCENT allowed deviation from the baseline (default 10)."));
+	printf("\n\n");
+	printf(_("The exit status is 1 if a measurement is worse than the baseline by more\nthan the tolerance and 2 if pxgen or pxview failed."));
+	printf("\n\n");
+}
+/* }}} */
+
+/* in_list() {{{
+ * Checks if name is in the comma separated list. An empty list
+ * contains all names.
+ */
+static int in_list(const char *list, const char *name) {
+	size_t len = strlen(name);
+	const char *ptr = list;
+
+	if(NULL == list)
+		return 1;
+	while(NULL != (ptr = strstr(ptr, name))) {
+		if((ptr == list || ptr[-1] == ',') && (ptr[len] == ',' || ptr[len] == '\0'))
+			return 1;
+		ptr += len;
+	}
+	return 0;
+}
+/* }}} */
+
+/* run_program() {{{
+ * Runs a program with the arguments argv. The output goes to /dev/null
+ * and the error output into the file errfile.
+ * Returns the exit status of the program or -1 if it could not be run.
+ */
+static int run_program(char *const argv[], const char *errfile, int verbose) {
+	pid_t pid;
+	int status, fd, i;
+
+	if(verbose) {
+		for(i=0; argv[i]; i++)
+			fprintf(stderr, "%s%s", i ? " " : "", argv[i]);
+		fprintf(stderr, "\n");
+	}
+	if(0 > (pid = fork())) {
+		fprintf(stderr, _("Could not start '%s': %s"), argv[0], strerror(errno));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(pid == 0) {
+		if(0 <= (fd = open("/dev/null", O_WRONLY))) {
+			dup2(fd, 1);
+			close(fd);
+		}
+		if(0 <= (fd = open(errfile, O_WRONLY|O_CREAT|O_TRUNC, 0666))) {
+			dup2(fd, 2);
+			close(fd);
+		}
+		execvp(argv[0], argv);
+		fprintf(stderr, _("Could not start '%s': %s"), argv[0], strerror(errno));
+		fprintf(stderr, "\n");
+		_exit(127);
+	}
+	while(0 > waitpid(pid, &status, 0)) {
+		if(errno != EINTR)
+			return -1;
+	}
+	if(!WIFEXITED(status))
+		return -1;
+	return(WEXITSTATUS(status));
+}
+/* }}} */
+
+/* read_file() {{{
+ * Returns the content of a file ended by 0, which must be freed with
+ * free(), or NULL if it cannot be read.
+ */
+static char *read_file(const char *filename) {
+	FILE *fp;
+	char *buffer = NULL;
+	size_t len = 0, n;
+
+	if(NULL == (fp = fopen(filename, "r")))
+		return NULL;
+	do {
+		buffer = realloc(buffer, len+4097);
+		n = fread(buffer+len, 1, 4096, fp);
+		len += n;
+	} while(n > 0);
+	buffer[len] = '\0';
+	fclose(fp);
+	return(buffer);
+}
+/* }}} */
+
+/* json_number() {{{
+ * Returns the number of key in the json object str or 0 if the key is
+ * missing. Only flat objects as written by pxview and pxbench are
+ * understood.
+ */
+static double json_number(const char *str, const char *key) {
+	char pattern[64];
+	const char *ptr;
+
+	snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+	if(NULL == (ptr = strstr(str, pattern)))
+		return 0.0;
+	return(strtod(ptr+strlen(pattern), NULL));
+}
+/* }}} */
+
+/* json_string() {{{
+ * Copies the string of key in the json object str into value.
+ */
+static void json_string(const char *str, const char *key, char *value, size_t size) {
+	char pattern[64];
+	const char *ptr, *end;
+	size_t len;
+
+	value[0] = '\0';
+	snprintf(pattern, sizeof(pattern), "\"%s\": \"", key);
+	if(NULL == (ptr = strstr(str, pattern)))
+		return;
+	ptr += strlen(pattern);
+	if(NULL == (end = strchr(ptr, '"')))
+		return;
+	len = (size_t) (end-ptr) < size-1 ? (size_t) (end-ptr) : size-1;
+	memcpy(value, ptr, len);
+	value[len] = '\0';
+}
+/* }}} */
+
+/* write_results() {{{
+ * Writes the results into a json file with one result on each line,
+ * which is what load_results() expects. Returns -1 on error.
+ */
+static int write_results(const char *filename, struct bench_result *results, int numresults) {
+	FILE *fp;
+	int i;
+
+	if(NULL == (fp = fopen(filename, "w"))) {
+		fprintf(stderr, _("Could not open output file '%s'."), filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	fprintf(fp, "{\"version\": \"%s\", \"results\": [\n", VERSION);
+	for(i=0; i<numresults; i++) {
+		fprintf(fp, "{\"table\": \"%s\", \"mode\": \"%s\", \"records\": %ld, \"wall\": %.6f, \"records_per_second\": %.1f, \"mb_per_second\": %.3f, \"peak_rss_kb\": %ld, \"mallocs\": %ld}%s\n",
+		        results[i].table, results[i].mode, results[i].records, results[i].wall,
+		        results[i].records_per_second, results[i].mb_per_second,
+		        results[i].peak_rss_kb, results[i].mallocs, i < numresults-1 ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+	if(0 != fclose(fp)) {
+		fprintf(stderr, _("Could not write output file '%s'."), filename);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* load_results() {{{
+ * Reads results written by write_results(). Returns the number of
+ * results or -1 if the file cannot be read.
+ */
+static int load_results(const char *filename, struct bench_result **resultsp) {
+	struct bench_result *results = NULL;
+	char *buffer, *line, *next;
+	int numresults = 0;
+
+	if(NULL == (buffer = read_file(filename)))
+		return -1;
+	for(line=buffer; line && *line; line=next) {
+		if(NULL != (next = strchr(line, '\n')))
+			*next++ = '\0';
+		if(strncmp(line, "{\"table\":", 9))
+			continue;
+		results = realloc(results, (numresults+1) * sizeof(struct bench_result));
+		memset(&results[numresults], 0, sizeof(struct bench_result));
+		json_string(line, "table", results[numresults].table, sizeof(results[numresults].table));
+		json_string(line, "mode", results[numresults].mode, sizeof(results[numresults].mode));
+		results[numresults].records = (long) json_number(line, "records");
+		results[numresults].wall = json_number(line, "wall");
+		results[numresults].records_per_second = json_number(line, "records_per_second");
+		results[numresults].mb_per_second = json_number(line, "mb_per_second");
+		results[numresults].peak_rss_kb = (long) json_number(line, "peak_rss_kb");
+		results[numresults].mallocs = (long) json_number(line, "mallocs");
+		numresults++;
+	}
+	free(buffer);
+	*resultsp = results;
+	return(numresults);
+}
+/* }}} */
+
+/* compare() {{{
+ * Returns the change of value against base in percent, positive if
+ * value is better. Larger values are better if higher is set.
+ */
+static double compare(double value, double base, int higher) {
+	if(base <= 0.0)
+		return 0.0;
+	return(higher ? 100.0 * (value - base) / base : 100.0 * (base - value) / base);
+}
+/* }}} */
+
+/* check_results() {{{
+ * Prints the results with their change against the baseline and
+ * returns the number of regressions beyond tolerance percent.
+ */
+static int check_results(struct bench_result *results, int numresults, struct bench_result *base, int numbase, double tolerance) {
+	int i, j, regressions = 0;
+	double drps, dmbps, drss, dmallocs;
+
+	if(numbase > 0) {
+		printf(_("Changes against the baseline are shown below each result, positive is better."));
+		printf("\n");
+	}
+	printf("%-22s %-9s %12s %9s %10s %10s\n", _("Table"), _("Mode"), _("Records/s"), _("MB/s"), _("RSS kB"), _("Mallocs"));
+	for(i=0; i<numresults; i++) {
+		struct bench_result *r = &results[i];
+
+		printf("%-22s %-9s %12.0f %9.2f %10ld %10ld\n", r->table, r->mode, r->records_per_second, r->mb_per_second, r->peak_rss_kb, r->mallocs);
+		for(j=0; j<numbase; j++) {
+			if(!strcmp(base[j].table, r->table) && !strcmp(base[j].mode, r->mode))
+				break;
+		}
+		if(j == numbase)
+			continue;
+		drps = compare(r->records_per_second, base[j].records_per_second, 1);
+		dmbps = compare(r->mb_per_second, base[j].mb_per_second, 1);
+		drss = compare(r->peak_rss_kb, base[j].peak_rss_kb, 0);
+		dmallocs = compare(r->mallocs, base[j].mallocs, 0);
+		printf("%-22s %-9s %+11.1f%% %+8.1f%% %+9.1f%% %+9.1f%%", "", "", drps, dmbps, drss, dmallocs);
+		if(drps < -tolerance || dmbps < -tolerance || drss < -tolerance || dmallocs < -tolerance) {
+			printf("  %s", _("REGRESSION"));
+			regressions++;
+		}
+		printf("\n");
+	}
+	return(regressions);
+}
+/* }}} */
+
+/* main() {{{
+ */
+int main(int argc, char *argv[]) {
+	char *progname = NULL;
+	char *pxview = "./pxview", *pxgen = "./pxgen", *dir = "pxbench.d";
+	char *sizes = DEFAULT_SIZES, *shapes = NULL, *modes = NULL;
+	char *outputfile = "pxbench.json", *baselinefile = NULL;
+	char tablefile[1024], errfile[1024], sqlitefile[1024], records[32], fields[128];
+	char blobfile[1040], blobprefix[1040];
+	char *args[MAX_ARGS];
+	char *stats, *ptr, *size, *sizelist;
+	struct bench_shape *shape;
+	struct bench_mode *mode;
+	struct bench_result *results = NULL, *base = NULL, r;
+	struct stat st;
+	int numresults = 0, numbase = 0, failures = 0, regressions = 0;
+	int c, i, n, ret, repeat = 3, verbose = 0, updatebaseline = 0;
+	double tolerance = 10.0, recordbytes;
+
+#ifdef ENABLE_NLS
+	setlocale (LC_ALL, "");
+	bindtextdomain (PACKAGE, PACKAGE_LOCALE_DIR);
+	textdomain (PACKAGE);
+#endif
+
+	/* Handle program options {{{
+	 */
+#ifdef HAVE_BASENAME
+	progname = basename(strdup(argv[0]));
+#else
+	progname = strdup(argv[0]);
+#endif
+	while(1) {
+		int option_index = 0;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"verbose", 0, 0, 'v'},
+			{"output", 1, 0, 'o'},
+			{"baseline", 1, 0, 'b'},
+			{"pxview", 1, 0, 1},
+			{"pxgen", 1, 0, 2},
+			{"dir", 1, 0, 3},
+			{"sizes", 1, 0, 4},
+			{"shapes", 1, 0, 5},
+			{"modes", 1, 0, 6},
+			{"repeat", 1, 0, 7},
+			{"tolerance", 1, 0, 8},
+			{"update-baseline", 0, 0, 9},
+			{"version", 0, 0, 10},
+			{0, 0, 0, 0}
+		};
+		c = getopt_long (argc, argv, "hvo:b:",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c) {
+			case 'h':
+				usage(progname);
+				exit(0);
+			case 'v':
+				verbose = 1;
+				break;
+			case 'o':
+				outputfile = strdup(optarg);
+				break;
+			case 'b':
+				baselinefile = strdup(optarg);
+				break;
+			case 1:
+				pxview = strdup(optarg);
+				break;
+			case 2:
+				pxgen = strdup(optarg);
+				break;
+			case 3:
+				dir = strdup(optarg);
+				break;
+			case 4:
+				sizes = strdup(optarg);
+				break;
+			case 5:
+				shapes = strdup(optarg);
+				break;
+			case 6:
+				modes = strdup(optarg);
+				break;
+			case 7:
+				repeat = atoi(optarg);
+				if(repeat < 1)
+					repeat = 1;
+				break;
+			case 8:
+				tolerance = atof(optarg);
+				break;
+			case 9:
+				updatebaseline = 1;
+				break;
+			case 10:
+				fprintf(stdout, "%s\n", VERSION);
+				exit(0);
+				break;
+		}
+	}
+	/* }}} */
+
+	if(0 != mkdir(dir, 0777) && errno != EEXIST) {
+		fprintf(stderr, _("Could not create directory '%s'."), dir);
+		fprintf(stderr, "\n");
+		exit(2);
+	}
+	snprintf(errfile, sizeof(errfile), "%s/stderr.txt", dir);
+	snprintf(sqlitefile, sizeof(sqlitefile), "%s/output.sqlite", dir);
+	snprintf(blobprefix, sizeof(blobprefix), "--blobprefix=%s/blob", dir);
+
+	sizelist = strdup(sizes);
+	for(size=strtok(sizelist, ","); size; size=strtok(NULL, ",")) {
+		snprintf(records, sizeof(records), "%ld", atol(size));
+		for(shape=bench_shapes; shape->name; shape++) {
+			if(!in_list(shapes, shape->name))
+				continue;
+
+			/* Create the table unless an earlier run left it {{{ */
+			snprintf(tablefile, sizeof(tablefile), "%s/%s-%s.db", dir, shape->name, records);
+			snprintf(blobfile, sizeof(blobfile), "--blobfile=%s/%s-%s.MB", dir, shape->name, records);
+			if(0 != stat(tablefile, &st)) {
+				snprintf(fields, sizeof(fields), "--fields=%s", shape->fields);
+				n = 0;
+				args[n++] = pxgen;
+				args[n++] = "-r";
+				args[n++] = records;
+				args[n++] = fields;
+				for(i=0; shape->options[i]; i++)
+					args[n++] = (char *) shape->options[i];
+				args[n++] = tablefile;
+				args[n] = NULL;
+				if(0 != run_program(args, errfile, verbose)) {
+					fprintf(stderr, _("Could not create table '%s', see '%s'."), tablefile, errfile);
+					fprintf(stderr, "\n");
+					unlink(tablefile);
+					failures++;
+					continue;
+				}
+			}
+			/* }}} */
+
+			for(mode=bench_modes; mode->name; mode++) {
+				if(!in_list(modes, mode->name))
+					continue;
+				memset(&r, 0, sizeof(r));
+				snprintf(r.table, sizeof(r.table), "%s-%s", shape->name, records);
+				strcpy(r.mode, mode->name);
+
+				n = 0;
+				args[n++] = pxview;
+				args[n++] = "--stats=json";
+				for(i=0; mode->options[i]; i++)
+					args[n++] = (char *) mode->options[i];
+				if(!strcmp(mode->name, "sqlite")) {
+					args[n++] = "-o";
+					args[n++] = sqlitefile;
+				}
+				if(shape->hasblobs) {
+					args[n++] = blobfile;
+					args[n++] = blobprefix;
+				}
+				args[n++] = tablefile;
+				args[n] = NULL;
+
+				for(i=0; i<repeat; i++) {
+					if(!strcmp(mode->name, "sqlite"))
+						unlink(sqlitefile);
+					ret = run_program(args, errfile, verbose);
+					stats = read_file(errfile);
+					if(ret != 0 || NULL == stats || NULL == (ptr = strstr(stats, "{\"wall\":"))) {
+						if(stats && strstr(stats, "No sqlite support")) {
+							if(verbose) {
+								fprintf(stderr, _("Skipping mode sqlite, because pxview has no sqlite support."));
+								fprintf(stderr, "\n");
+							}
+						} else {
+							fprintf(stderr, _("Running pxview in mode %s on '%s' failed, see '%s'."), mode->name, tablefile, errfile);
+							fprintf(stderr, "\n");
+							failures++;
+						}
+						free(stats);
+						break;
+					}
+					/* keep the fastest run */
+					if(i == 0 || json_number(ptr, "wall") < r.wall) {
+						r.wall = json_number(ptr, "wall");
+						r.records = (long) json_number(ptr, "records");
+						r.records_per_second = json_number(ptr, "records_per_second");
+						recordbytes = json_number(ptr, "bytes_per_second");
+						r.mb_per_second = recordbytes / 1048576.0;
+						r.peak_rss_kb = (long) json_number(ptr, "peak_rss_kb");
+						r.mallocs = (long) json_number(ptr, "mallocs");
+					}
+					free(stats);
+				}
+				if(i < repeat)
+					continue;
+				results = realloc(results, (numresults+1) * sizeof(struct bench_result));
+				results[numresults++] = r;
+			}
+		}
+	}
+	free(sizelist);
+	unlink(sqlitefile);
+
+	if(numresults > 0 && 0 > write_results(outputfile, results, numresults))
+		failures++;
+
+	if(baselinefile && 0 > (numbase = load_results(baselinefile, &base))) {
+		numbase = 0;
+		updatebaseline = 1;
+		printf(_("No baseline in '%s', the results become the baseline."), baselinefile);
+		printf("\n");
+	}
+	regressions = check_results(results, numresults, base, numbase, tolerance);
+	if(regressions > 0) {
+		printf(_("%d measurements are worse than the baseline by more than %.0f%%."), regressions, tolerance);
+		printf("\n");
+	}
+	if(baselinefile && updatebaseline && numresults > 0)
+		write_results(baselinefile, results, numresults);
+
+	free(results);
+	free(base);
+	if(failures > 0)
+		exit(2);
+	exit(regressions > 0 ? 1 : 0);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,825 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#endif
+#ifdef WIN32
+#include "getopt/my_getopt.h"
+#endif
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
+#ifdef HAVE_GETTEXT
+#include <libintl.h>
+#endif
+#ifdef HAVE_BASENAME
+#include <libgen.h>
+#endif
+#include "pxview_intern.h"
+#include "transcode.h"
+
+/* pxgen writes a Paradox table with random content, to have tables of
+ * any size and field mix for benchmarking pxview.
+ */
+
+/* Field types as written in --fields, default length (number of
+ * decimals for BCD) and whether the length can be given.
+ */
+static struct gen_type {
+	char letter;
+	int type;
+	const char *name;
+	int len;
+	int varlen;
+} gen_types[] = {
+	{'A', pxfAlpha, "alpha", 20, 1},
+	{'D', pxfDate, "date", 4, 0},
+	{'S', pxfShort, "short", 2, 0},
+	{'I', pxfLong, "long", 4, 0},
+	{'$', pxfCurrency, "currency", 8, 0},
+	{'N', pxfNumber, "number", 8, 0},
+	{'L', pxfLogical, "logical", 1, 0},
+	{'M', pxfMemoBLOb, "memo", 20, 1},
+	{'B', pxfBLOb, "blob", 20, 1},
+	{'F', pxfFmtMemoBLOb, "fmtmemo", 20, 1},
+	{'O', pxfOLE, "ole", 20, 1},
+	{'G', pxfGraphic, "graphic", 20, 1},
+	{'T', pxfTime, "time", 4, 0},
+	{'@', pxfTimestamp, "timestamp", 8, 0},
+	{'+', pxfAutoInc, "autoinc", 4, 0},
+	{'#', pxfBCD, "bcd", 2, 1},
+	{'Y', pxfBytes, "bytes", 16, 1},
+	{'\0', 0, NULL, 0, 0}
+};
+
+#define DEFAULT_FIELDS "+,A40,S,I,N,$,L,D,T,@,#,Y16,M40,F40,B20,O20,G20"
+
+/* Distribution of the length of alpha fields and memos */
+#define LENGTH_FIXED 0
+#define LENGTH_UNIFORM 1
+#define LENGTH_SHORT 2
+
+/* Day number of 1.1.1990 and 31.12.2029 as stored in date fields */
+#define DATE_FIRST 726468
+#define DATE_LAST 741078
+
+struct generator {
+	unsigned long long state;   /* state of the random generator */
+	int lengthdist;
+	double nulls;
+	double nonascii;
+	long blobsize;
+	unsigned char letters[128]; /* upper half bytes which are letters */
+	int numletters;
+	char *buffer;
+	long buffersize;
+};
+
+/* errorhandler() {{{
+ */
+void errorhandler(pxdoc_t *p, int error, const char *str, void *data) {
+	  fprintf(stderr, "PXLib: %s\n", str);
+}
+/* }}} */
+
+/* usage() {{{
+ * Output usage information
+ */
+void usage(char *progname) {
+	printf(_("Version: %s %s http://sourceforge.net/projects/pxlib"), progname, VERSION);
+	printf("\n");
+	printf(_("%s writes a Paradox table with random records for testing and benchmarking."), progname);
+	printf("\n\n");
+	printf(_("Usage: %s [OPTIONS] FILE"), progname);
+	printf("\n\n");
+	printf(_("Options:"));
+	printf("\n");
+	printf(_("  -h, --help          this usage information."));
+	printf("\n");
+	printf(_("  --version           show version information."));
+	printf("\n");
+	printf(_("  -v, --verbose       be more verbose."));
+	printf("\n");
+	printf(_("  -r, --records=N     number of records (default 10000)."));
+	printf("\n");
+	printf(_("  -f, --fields=LIST   comma separated list of field types. Each type\n                      is a letter out of A D S I $ N L M B F O G T @ + # Y\n                      followed by the length of A, M, B, F, O, G and Y\n                      fields or the number of decimals of # fields.\n                      Default is %s."), DEFAULT_FIELDS);
+	printf("\n");
+	printf(_("  --string-length=DIST distribution of the length of alpha fields\n                      and memos: fixed, uniform (default) or short."));
+	printf("\n");
+	printf(_("  --blob-size=N       average size of blobs in bytes (default 1000)."));
+	printf("\n");
+	printf(_("  --nulls=RATIO       ratio of empty fields (default 0)."));
+	printf("\n");
+	printf(_("  --deleted=RATIO     ratio of records deleted after writing (default 0)."));
+	printf("\n");
+	printf(_("  --block-size=KB     size of data blocks: 1, 2, 4, 8, 16 or 32 KB."));
+	printf("\n");
+	printf(_("  --codepage=N        code page stored in the header."));
+	printf("\n");
+	printf(_("  --non-ascii=RATIO   ratio of letters of the upper half of the code page."));
+	printf("\n");
+	printf(_("  -p, --primary-index make the first field the primary key and write\n                      a primary index file."));
+	printf("\n");
+	printf(_("  --seed=N            start value of the random generator (default 1)."));
+	printf("\n\n");
+	printf(_("The blobs are written into a file with the extension .MB, the primary\nindex into a file with the extension .PX next to FILE."));
+	printf("\n\n");
+}
+/* }}} */
+
+/* gen_random() {{{
+ * Returns a 64 bit random number. The generator is the same on all
+ * platforms, so a seed always creates the same table.
+ */
+static unsigned long long gen_random(struct generator *g) {
+	unsigned long long x = g->state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	g->state = x;
+	return(x * 2685821657736338717ULL);
+}
+/* }}} */
+
+/* gen_range() {{{
+ * Returns a random number between 0 and n-1.
+ */
+static long gen_range(struct generator *g, long n) {
+	return(n > 0 ? (long) (gen_random(g) % (unsigned long long) n) : 0);
+}
+/* }}} */
+
+/* gen_chance() {{{
+ * Returns 1 with the given probability.
+ */
+static int gen_chance(struct generator *g, double ratio) {
+	return(ratio > 0.0 && (double) (gen_random(g) >> 11) / 9007199254740992.0 < ratio);
+}
+/* }}} */
+
+/* gen_length() {{{
+ * Returns the length of a string which may be at most max chars long.
+ */
+static long gen_length(struct generator *g, long max) {
+	double u;
+	long len;
+
+	switch(g->lengthdist) {
+		case LENGTH_FIXED:
+			return(max);
+		case LENGTH_SHORT:
+			/* exponential with a mean of a quarter of the maximum */
+			u = (double) ((gen_random(g) >> 11) + 1) / 9007199254740993.0;
+			len = (long) (-log(u) * max / 4.0);
+			return(len > max ? max : len);
+		default:
+			return(gen_range(g, max+1));
+	}
+}
+/* }}} */
+
+/* gen_letters() {{{
+ * Collects the bytes of the upper half of the code page which are
+ * letters. If the code page is unknown, the Latin-1 letters are taken.
+ */
+static void gen_letters(struct generator *g, int codepage) {
+	const struct codepage_table *cp;
+	unsigned short c;
+	int i;
+
+	g->numletters = 0;
+	for(cp=transcode_codepages; cp->codepage; cp++) {
+		if(cp->codepage == codepage)
+			break;
+	}
+	for(i=0; i<128; i++) {
+		c = cp->codepage ? cp->chars[i] : 128+i;
+		if((c >= 0xC0 && c <= 0x17F && c != 0xD7 && c != 0xF7) ||
+		   (c >= 0x400 && c <= 0x45F))
+			g->letters[g->numletters++] = 128+i;
+	}
+}
+/* }}} */
+
+/* gen_text() {{{
+ * Fills str with len chars of words separated by blanks and ends it
+ * with 0.
+ */
+static void gen_text(struct generator *g, char *str, long len) {
+	long i;
+
+	for(i=0; i<len; i++) {
+		if(i > 0 && str[i-1] != ' ' && 0 == gen_range(g, 7))
+			str[i] = ' ';
+		else if(g->numletters && gen_chance(g, g->nonascii))
+			str[i] = g->letters[gen_range(g, g->numletters)];
+		else
+			str[i] = 'a' + gen_range(g, 26);
+	}
+	str[len] = '\0';
+}
+/* }}} */
+
+/* gen_buffer() {{{
+ * Returns a buffer of at least size bytes for a value.
+ */
+static char *gen_buffer(pxdoc_t *pxdoc, struct generator *g, long size) {
+	if(size+1 > g->buffersize) {
+		if(g->buffer)
+			pxdoc->free(pxdoc, g->buffer);
+		g->buffersize = size+1;
+		if(NULL == (g->buffer = pxdoc->malloc(pxdoc, g->buffersize, _("Allocate memory for field value.")))) {
+			g->buffersize = 0;
+			return NULL;
+		}
+	}
+	return(g->buffer);
+}
+/* }}} */
+
+/* gen_field() {{{
+ * Puts a random value for field pxf into data. key is the number of the
+ * record if the field is the primary key, otherwise -1.
+ * Returns -1 on error.
+ */
+static int gen_field(pxdoc_t *pxdoc, struct generator *g, pxfield_t *pxf, char *data, long key) {
+	char *value;
+	long len;
+
+	if(key < 0 && pxf->px_ftype != pxfAutoInc && gen_chance(g, g->nulls))
+		return 0;
+
+	switch(pxf->px_ftype) {
+		case pxfAlpha:
+			if(NULL == (value = gen_buffer(pxdoc, g, pxf->px_flen)))
+				return -1;
+			if(key >= 0)
+				sprintf(value, "%0*ld", pxf->px_flen, key);
+			else
+				gen_text(g, value, gen_length(g, pxf->px_flen));
+			if(value[0])
+				PX_put_data_alpha(pxdoc, data, pxf->px_flen, value);
+			break;
+		case pxfDate:
+			PX_put_data_long(pxdoc, data, 4, DATE_FIRST + gen_range(g, DATE_LAST-DATE_FIRST+1));
+			break;
+		case pxfShort:
+			PX_put_data_short(pxdoc, data, 2, key >= 0 ? key : gen_range(g, 65535) - 32767);
+			break;
+		case pxfAutoInc:
+		case pxfLong:
+			PX_put_data_long(pxdoc, data, 4, key >= 0 ? key : (int) (gen_random(g) >> 33) - 0x3fffffff);
+			break;
+		case pxfCurrency:
+			PX_put_data_double(pxdoc, data, 8, (double) (gen_range(g, 200000000) - 100000000) / 100.0);
+			break;
+		case pxfNumber:
+			PX_put_data_double(pxdoc, data, 8, ((double) (gen_random(g) >> 11) / 9007199254740992.0 - 0.5) * pow(10.0, gen_range(g, 12)));
+			break;
+		case pxfLogical:
+			PX_put_data_byte(pxdoc, data, 1, gen_range(g, 2));
+			break;
+		case pxfTime:
+			PX_put_data_long(pxdoc, data, 4, gen_range(g, 86400000));
+			break;
+		case pxfTimestamp:
+			PX_put_data_double(pxdoc, data, 8, (double) (DATE_FIRST + gen_range(g, DATE_LAST-DATE_FIRST+1)) * 86400000.0 + (double) gen_range(g, 86400000));
+			break;
+		case pxfBCD: {
+			char number[40], *ptr = number;
+			long digits;
+
+			/* up to 9 digits before the decimal point, but not more
+			 * than fit into the 32 digits of the field
+			 */
+			if(gen_range(g, 2))
+				*ptr++ = '-';
+			digits = 32 - pxf->px_fdc;
+			ptr += sprintf(ptr, "%ld", digits > 0 ? gen_range(g, digits >= 9 ? 1000000000 : (long) pow(10.0, digits)) : 0);
+			if(pxf->px_fdc > 0) {
+				*ptr++ = '.';
+				for(digits=0; digits<pxf->px_fdc; digits++)
+					*ptr++ = '0' + gen_range(g, 10);
+			}
+			*ptr = '\0';
+			PX_put_data_bcd(pxdoc, data, pxf->px_fdc, number);
+			break;
+		}
+		case pxfBytes:
+			if(NULL == (value = gen_buffer(pxdoc, g, pxf->px_flen)))
+				return -1;
+			for(len=0; len<pxf->px_flen; len++)
+				value[len] = (char) gen_random(g);
+			PX_put_data_bytes(pxdoc, data, pxf->px_flen, value);
+			break;
+		case pxfMemoBLOb:
+		case pxfFmtMemoBLOb:
+		case pxfBLOb:
+		case pxfOLE:
+		case pxfGraphic: {
+			double u = (double) ((gen_random(g) >> 11) + 1) / 9007199254740993.0;
+			long i;
+
+			if(pxf->px_ftype == pxfMemoBLOb || pxf->px_ftype == pxfFmtMemoBLOb) {
+				/* memos follow the distribution of strings */
+				len = gen_length(g, 2*g->blobsize);
+			} else {
+				/* exponential, but not larger than ten times the average */
+				len = (long) (-log(u) * g->blobsize);
+				if(len > 10*g->blobsize)
+					len = 10*g->blobsize;
+			}
+			if(len == 0)
+				break;
+			if(NULL == (value = gen_buffer(pxdoc, g, len)))
+				return -1;
+			if(pxf->px_ftype == pxfMemoBLOb || pxf->px_ftype == pxfFmtMemoBLOb) {
+				gen_text(g, value, len);
+			} else {
+				for(i=0; i<len; i++)
+					value[i] = (char) gen_random(g);
+			}
+			if(0 > PX_put_data_blob(pxdoc, data, pxf->px_flen, value, len))
+				return -1;
+			break;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* parse_fields() {{{
+ * Creates the fields of the table from a list like 'A20,I,#2'. The
+ * fields are allocated with pxdoc->malloc(), because pxlib frees them
+ * with the document. Returns the number of fields or -1 on error.
+ */
+static int parse_fields(pxdoc_t *pxdoc, const char *list, pxfield_t **pxfp) {
+	pxfield_t *pxf;
+	struct gen_type *t;
+	const char *ptr;
+	char *end;
+	int numfields, i;
+	long len;
+
+	numfields = 1;
+	for(ptr=list; *ptr; ptr++) {
+		if(*ptr == ',')
+			numfields++;
+	}
+	if(NULL == (pxf = pxdoc->malloc(pxdoc, numfields*sizeof(pxfield_t), _("Allocate memory for field definitions.")))) {
+		return -1;
+	}
+	memset(pxf, 0, numfields*sizeof(pxfield_t));
+
+	ptr = list;
+	for(i=0; i<numfields; i++) {
+		for(t=gen_types; t->letter; t++) {
+			if(t->letter == toupper((unsigned char) *ptr))
+				break;
+		}
+		if(!t->letter) {
+			fprintf(stderr, _("Unknown field type '%c' in list of fields."), *ptr);
+			fprintf(stderr, "\n");
+			goto error;
+		}
+		ptr++;
+		len = t->len;
+		if(*ptr >= '0' && *ptr <= '9') {
+			if(!t->varlen) {
+				fprintf(stderr, _("Field type '%c' does not take a length."), t->letter);
+				fprintf(stderr, "\n");
+				goto error;
+			}
+			len = strtol(ptr, &end, 10);
+			ptr = end;
+		}
+		if(*ptr != ',' && *ptr != '\0') {
+			fprintf(stderr, _("Invalid field definition in list of fields at '%s'."), ptr);
+			fprintf(stderr, "\n");
+			goto error;
+		}
+		if(*ptr == ',')
+			ptr++;
+
+		pxf[i].px_ftype = t->type;
+		switch(t->type) {
+			case pxfAlpha:
+			case pxfBytes:
+				if(len < 1 || len > 255) {
+					fprintf(stderr, _("Length of field type '%c' must be between %d and %d."), t->letter, 1, 255);
+					fprintf(stderr, "\n");
+					goto error;
+				}
+				pxf[i].px_flen = len;
+				break;
+			case pxfBCD:
+				if(len > 32) {
+					fprintf(stderr, _("Length of field type '%c' must be between %d and %d."), t->letter, 0, 32);
+					fprintf(stderr, "\n");
+					goto error;
+				}
+				pxf[i].px_flen = 17;
+				pxf[i].px_fdc = len;
+				break;
+			case pxfMemoBLOb:
+			case pxfFmtMemoBLOb:
+			case pxfBLOb:
+			case pxfOLE:
+			case pxfGraphic:
+				/* the length includes the 10 bytes pointing into the blob file */
+				if(len < 11 || len > 250) {
+					fprintf(stderr, _("Length of field type '%c' must be between %d and %d."), t->letter, 11, 250);
+					fprintf(stderr, "\n");
+					goto error;
+				}
+				pxf[i].px_flen = len;
+				break;
+			default:
+				pxf[i].px_flen = t->len;
+		}
+		if(NULL == (pxf[i].px_fname = pxdoc->malloc(pxdoc, strlen(t->name)+12, _("Allocate memory for field name.")))) {
+			goto error;
+		}
+		sprintf(pxf[i].px_fname, "%s%d", t->name, i+1);
+	}
+	*pxfp = pxf;
+	return(numfields);
+
+error:
+	for(i=0; i<numfields; i++) {
+		if(pxf[i].px_fname)
+			pxdoc->free(pxdoc, pxf[i].px_fname);
+	}
+	pxdoc->free(pxdoc, pxf);
+	return -1;
+}
+/* }}} */
+
+/* companion_file() {{{
+ * Returns the name of filename with its extension replaced by ext.
+ * The name must be freed with free().
+ */
+static char *companion_file(const char *filename, const char *ext) {
+	const char *dot = strrchr(filename, '.');
+	char *name;
+	size_t len;
+
+	if(NULL == dot || strchr(dot, '/'))
+		len = strlen(filename);
+	else
+		len = dot - filename;
+	name = malloc(len+strlen(ext)+1);
+	memcpy(name, filename, len);
+	strcpy(name+len, ext);
+	return(name);
+}
+/* }}} */
+
+/* main() {{{
+ */
+int main(int argc, char *argv[]) {
+	pxdoc_t *pxdoc = NULL, *pxindex = NULL;
+	pxfield_t *pxf = NULL, *pxfi = NULL;
+	struct generator gen;
+	char *progname = NULL;
+	char *filename = NULL;
+	char *fields = DEFAULT_FIELDS;
+	char *data;
+	int c, i, numfields, recordsize, offset;
+	int verbose = 0, primaryindex = 0, blocksize = 0, codepage = 0;
+	long numrecords = 10000, recno, numdeleted;
+	double deleted = 0.0;
+	unsigned long long seed = 1;
+	int hasblobs = 0;
+
+	memset(&gen, 0, sizeof(gen));
+	gen.lengthdist = LENGTH_UNIFORM;
+	gen.blobsize = 1000;
+
+#ifdef ENABLE_NLS
+	setlocale (LC_ALL, "");
+	bindtextdomain (PACKAGE, PACKAGE_LOCALE_DIR);
+	textdomain (PACKAGE);
+#endif
+
+	/* Handle program options {{{
+	 */
+#ifdef HAVE_BASENAME
+	progname = basename(strdup(argv[0]));
+#else
+	progname = strdup(argv[0]);
+#endif
+	while(1) {
+#ifdef WIN32
+#define GETOPT_GETOPT_LONG my_getopt_long
+#define GETOPT_OPTARG my_optarg
+#define GETOPT_OPTIND my_optind
+#else
+#define GETOPT_GETOPT_LONG getopt_long
+#define GETOPT_OPTARG optarg
+#define GETOPT_OPTIND optind
+#endif
+		int option_index = 0;
+		static struct option long_options[] = {
+			{"help", 0, 0, 'h'},
+			{"verbose", 0, 0, 'v'},
+			{"records", 1, 0, 'r'},
+			{"fields", 1, 0, 'f'},
+			{"primary-index", 0, 0, 'p'},
+			{"string-length", 1, 0, 1},
+			{"blob-size", 1, 0, 2},
+			{"nulls", 1, 0, 3},
+			{"deleted", 1, 0, 4},
+			{"block-size", 1, 0, 5},
+			{"codepage", 1, 0, 6},
+			{"non-ascii", 1, 0, 7},
+			{"seed", 1, 0, 8},
+			{"version", 0, 0, 9},
+			{0, 0, 0, 0}
+		};
+		c = GETOPT_GETOPT_LONG (argc, argv, "hvr:f:p",
+				long_options, &option_index);
+		if (c == -1)
+			break;
+		switch (c) {
+			case 'h':
+				usage(progname);
+				exit(0);
+			case 'v':
+				verbose = 1;
+				break;
+			case 'r':
+				numrecords = atol(GETOPT_OPTARG);
+				break;
+			case 'f':
+				fields = strdup(GETOPT_OPTARG);
+				break;
+			case 'p':
+				primaryindex = 1;
+				break;
+			case 1:
+				if(!strcmp(GETOPT_OPTARG, "fixed")) {
+					gen.lengthdist = LENGTH_FIXED;
+				} else if(!strcmp(GETOPT_OPTARG, "uniform")) {
+					gen.lengthdist = LENGTH_UNIFORM;
+				} else if(!strcmp(GETOPT_OPTARG, "short")) {
+					gen.lengthdist = LENGTH_SHORT;
+				} else {
+					fprintf(stderr, _("Unknown distribution '%s' for --string-length."), GETOPT_OPTARG);
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 2:
+				gen.blobsize = atol(GETOPT_OPTARG);
+				break;
+			case 3:
+				gen.nulls = atof(GETOPT_OPTARG);
+				break;
+			case 4:
+				deleted = atof(GETOPT_OPTARG);
+				break;
+			case 5:
+				blocksize = atoi(GETOPT_OPTARG);
+				if(blocksize != 1 && blocksize != 2 && blocksize != 4 &&
+				   blocksize != 8 && blocksize != 16 && blocksize != 32) {
+					fprintf(stderr, _("Block size must be 1, 2, 4, 8, 16 or 32."));
+					fprintf(stderr, "\n");
+					exit(1);
+				}
+				break;
+			case 6:
+				codepage = atoi(GETOPT_OPTARG);
+				break;
+			case 7:
+				gen.nonascii = atof(GETOPT_OPTARG);
+				break;
+			case 8:
+				seed = strtoull(GETOPT_OPTARG, NULL, 10);
+				break;
+			case 9:
+				fprintf(stdout, "%s\n", VERSION);
+				exit(0);
+				break;
+		}
+	}
+
+	if (GETOPT_OPTIND < argc) {
+		filename = strdup(argv[GETOPT_OPTIND]);
+	}
+	if(!filename) {
+		fprintf(stderr, _("You must at least specify a filename."));
+		fprintf(stderr, "\n");
+		fprintf(stderr, "\n");
+		usage(progname);
+		exit(1);
+	}
+	if(numrecords < 0) {
+		fprintf(stderr, _("Number of records must not be negative."));
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+	if(gen.blobsize < 1) {
+		fprintf(stderr, _("Size of blobs must be at least 1."));
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+	/* }}} */
+
+	/* The state of the generator must never be 0 */
+	gen.state = seed ^ 0x9E3779B97F4A7C15ULL;
+	if(gen.state == 0)
+		gen.state = 1;
+	gen_letters(&gen, codepage);
+
+	if(NULL == (pxdoc = PX_new2(errorhandler, NULL, NULL, NULL))) {
+		fprintf(stderr, _("Could not create new paradox instance."));
+		fprintf(stderr, "\n");
+		exit(1);
+	}
+
+	if(0 > (numfields = parse_fields(pxdoc, fields, &pxf))) {
+		PX_delete(pxdoc);
+		exit(1);
+	}
+	if(primaryindex) {
+		if(pxf[0].px_ftype != pxfAutoInc && pxf[0].px_ftype != pxfLong &&
+		   pxf[0].px_ftype != pxfShort && pxf[0].px_ftype != pxfAlpha) {
+			fprintf(stderr, _("The primary key must be of type +, I, S or A."));
+			fprintf(stderr, "\n");
+			PX_delete(pxdoc);
+			exit(1);
+		}
+		if(pxf[0].px_ftype == pxfShort && numrecords > 32767) {
+			fprintf(stderr, _("A primary key of type S allows at most 32767 records."));
+			fprintf(stderr, "\n");
+			PX_delete(pxdoc);
+			exit(1);
+		}
+		if(pxf[0].px_ftype == pxfAlpha && numrecords >= pow(10.0, pxf[0].px_flen)) {
+			fprintf(stderr, _("A primary key of type A%d is too short for %ld records."), pxf[0].px_flen, numrecords);
+			fprintf(stderr, "\n");
+			PX_delete(pxdoc);
+			exit(1);
+		}
+	}
+	for(i=0; i<numfields; i++) {
+		switch(pxf[i].px_ftype) {
+			case pxfMemoBLOb:
+			case pxfFmtMemoBLOb:
+			case pxfBLOb:
+			case pxfOLE:
+			case pxfGraphic:
+				hasblobs = 1;
+				break;
+		}
+	}
+
+	if(0 > PX_create_file(pxdoc, pxf, numfields, filename, primaryindex ? pxfFileTypIndexDB : pxfFileTypNonIndexDB)) {
+		fprintf(stderr, _("Could not create file '%s'."), filename);
+		fprintf(stderr, "\n");
+		PX_delete(pxdoc);
+		exit(1);
+	}
+	if(primaryindex)
+		PX_set_value(pxdoc, "numprimkeys", 1);
+	if(codepage)
+		PX_set_value(pxdoc, "codepage", codepage);
+	if(blocksize && 0 > PX_set_value(pxdoc, "maxtablesize", blocksize)) {
+		fprintf(stderr, _("pxlib does not support setting the block size, using its default."));
+		fprintf(stderr, "\n");
+	}
+
+	if(hasblobs) {
+		char *mbname = companion_file(filename, ".MB");
+
+		if(0 > PX_set_blob_file(pxdoc, mbname)) {
+			fprintf(stderr, _("Could not create blob file '%s'."), mbname);
+			fprintf(stderr, "\n");
+			free(mbname);
+			PX_close(pxdoc);
+			PX_delete(pxdoc);
+			exit(1);
+		}
+		free(mbname);
+	}
+
+	/* Write the records {{{
+	 */
+	recordsize = PX_get_recordsize(pxdoc);
+	if(NULL == (data = pxdoc->malloc(pxdoc, recordsize, _("Allocate memory for record.")))) {
+		PX_close(pxdoc);
+		PX_delete(pxdoc);
+		exit(1);
+	}
+	for(recno=0; recno<numrecords; recno++) {
+		memset(data, 0, recordsize);
+		offset = 0;
+		for(i=0; i<numfields; i++) {
+			long key = -1;
+
+			/* keys and autoincrements ascend with the record number */
+			if((primaryindex && i == 0) || pxf[i].px_ftype == pxfAutoInc)
+				key = recno+1;
+			if(0 > gen_field(pxdoc, &gen, &pxf[i], data+offset, key)) {
+				fprintf(stderr, _("Could not create value of field '%s'."), pxf[i].px_fname);
+				fprintf(stderr, "\n");
+				PX_close(pxdoc);
+				PX_delete(pxdoc);
+				exit(1);
+			}
+			offset += pxf[i].px_flen;
+		}
+		if(0 > PX_put_record(pxdoc, data)) {
+			fprintf(stderr, _("Could not write record number %ld."), recno);
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			PX_delete(pxdoc);
+			exit(1);
+		}
+	}
+	pxdoc->free(pxdoc, data);
+	/* }}} */
+
+	/* Delete records from the end, so the number of the records still
+	 * to be deleted does not change.
+	 */
+	numdeleted = 0;
+	if(deleted > 0.0) {
+		for(recno=numrecords-1; recno>=0; recno--) {
+			if(gen_chance(&gen, deleted)) {
+				if(0 > PX_delete_record(pxdoc, recno)) {
+					fprintf(stderr, _("Could not delete record number %ld."), recno);
+					fprintf(stderr, "\n");
+					break;
+				}
+				numdeleted++;
+			}
+		}
+	}
+
+	if(primaryindex) {
+		char *pxname = companion_file(filename, ".PX");
+
+		/* key followed by the block number and the number of records */
+		if(NULL == (pxindex = PX_new2(errorhandler, NULL, NULL, NULL)) ||
+		   NULL == (pxfi = pxindex->malloc(pxindex, 3*sizeof(pxfield_t), _("Allocate memory for field definitions.")))) {
+			fprintf(stderr, _("Could not create new paradox instance."));
+			fprintf(stderr, "\n");
+			PX_close(pxdoc);
+			PX_delete(pxdoc);
+			exit(1);
+		}
+		pxfi[0].px_ftype = pxf[0].px_ftype;
+		pxfi[0].px_flen = pxf[0].px_flen;
+		pxfi[0].px_fdc = 0;
+		pxfi[0].px_fname = pxindex->malloc(pxindex, strlen(pxf[0].px_fname)+1, _("Allocate memory for field name."));
+		strcpy(pxfi[0].px_fname, pxf[0].px_fname);
+		pxfi[1].px_ftype = pxfShort;
+		pxfi[1].px_flen = 2;
+		pxfi[1].px_fname = pxindex->malloc(pxindex, 6, _("Allocate memory for field name."));
+		strcpy(pxfi[1].px_fname, "block");
+		pxfi[2].px_ftype = pxfShort;
+		pxfi[2].px_flen = 2;
+		pxfi[2].px_fname = pxindex->malloc(pxindex, 6, _("Allocate memory for field name."));
+		strcpy(pxfi[2].px_fname, "count");
+		if(0 > PX_create_file(pxindex, pxfi, 3, pxname, pxfFileTypPrimIndex) ||
+		   0 > PX_write_primary_index(pxdoc, pxindex)) {
+			fprintf(stderr, _("Could not write primary index '%s'."), pxname);
+			fprintf(stderr, "\n");
+		}
+		PX_close(pxindex);
+		PX_delete(pxindex);
+		free(pxname);
+	}
+
+	if(verbose) {
+		fprintf(stderr, _("Wrote %ld records with %d fields of %d bytes, %ld of them deleted."), numrecords, numfields, recordsize, numdeleted);
+		fprintf(stderr, "\n");
+	}
+
+	if(gen.buffer)
+		pxdoc->free(pxdoc, gen.buffer);
+	PX_close(pxdoc);
+	PX_delete(pxdoc);
+	free(filename);
+
+	exit(0);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
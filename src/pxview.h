@@ -0,0 +1,141 @@
+#ifndef __PXVIEW_H__
+#define __PXVIEW_H__
+
+/* Public interface of libpxview, the export engine of pxview.
+ *
+ * The engine decodes each field of a record once and passes the value
+ * to a sink, which turns it into output. pxview writes its csv, html,
+ * sql and sqlite output through the sinks below, so an application
+ * embedding the engine gets the same decoding of all field types
+ * pxview uses.
+ */
+
+#include <stdio.h>
+#include <paradox.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Receives the values of the records of a table. Each callback may be
+ * NULL, and a callback returning a value less than 0 stops the export.
+ * For each selected field of a record exactly one of the field_*
+ * callbacks is called, field_null if the field has no value.
+ */
+struct pxview_sink {
+	void *user;                  /* private data of the sink */
+	pxdoc_t *pxdoc;              /* set by pxview_export_begin() */
+	pxfield_t *fields;           /* NULL for the fields of pxdoc */
+	int numfields;
+	const char *selectedfields;  /* NULL selects all fields */
+
+	int (*begin_table)(struct pxview_sink *sink);
+	int (*begin_record)(struct pxview_sink *sink, int recno, const char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo);
+	int (*field_null)(struct pxview_sink *sink, int field, pxfield_t *pxf);
+	/* Alpha fields and memo blobs. value is not always terminated by 0 */
+	int (*field_string)(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value, int len);
+	/* Short, long and autoincrement fields */
+	int (*field_long)(struct pxview_sink *sink, int field, pxfield_t *pxf, long value);
+	/* Number and currency fields */
+	int (*field_double)(struct pxview_sink *sink, int field, pxfield_t *pxf, double value);
+	int (*field_bool)(struct pxview_sink *sink, int field, pxfield_t *pxf, int value);
+	/* Date, time and timestamp fields in milliseconds as expected by
+	 * PX_timestamp2string()
+	 */
+	int (*field_timestamp)(struct pxview_sink *sink, int field, pxfield_t *pxf, double value);
+	/* BCD fields as decimal number */
+	int (*field_bcd)(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value);
+	/* Binary, graphic and OLE blobs. number is the modification number
+	 * of the blob in the blob file.
+	 */
+	int (*field_blob)(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int size, int number);
+	/* Blobs before they are read. If set, it is called first with the
+	 * data of the field, which points into the blob file, so the sink
+	 * can copy the blob itself. Returning 1 leaves the blob to
+	 * field_blob or field_string.
+	 */
+	int (*field_blobref)(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data);
+	/* Bytes fields as stored in the record */
+	int (*field_bytes)(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int len);
+	int (*end_record)(struct pxview_sink *sink);
+	/* Called between two records before the position of the export is
+	 * saved, so the output up to there is complete once it has been
+	 * saved. The sqlite sink commits its transaction here.
+	 */
+	int (*checkpoint)(struct pxview_sink *sink);
+	int (*end_table)(struct pxview_sink *sink);
+	void (*destroy)(struct pxview_sink *sink);
+};
+
+/* Options of the sink writing comma separated values */
+struct pxview_csv_options {
+	char delimiter;
+	char enclosure;
+	const char *date_format;
+	const char *time_format;
+	const char *timestamp_format;
+	const char *blobprefix;      /* blobs are written into PREFIX_n.EXT */
+	const char *blobextension;
+	int withhead;                /* output line with column names */
+	int markdeleted;             /* output column with deletion flag */
+	const char *blobfile;        /* blob file copied from by blobwriters */
+	int blobwriters;             /* number of threads writing blobs, 0 for none */
+	const char *blobstore;       /* directory with blobs named by their content */
+	long streamthreshold;        /* larger blobs are copied from blobfile in pieces, 0 for none */
+};
+
+/* Options of the sink writing an html table */
+struct pxview_html_options {
+	const char *tablename;       /* caption of the table */
+	const char *date_format;
+	const char *time_format;
+	const char *timestamp_format;
+	const char *blobprefix;      /* blobs are written into PREFIX_n.EXT */
+	const char *blobextension;
+	int markdeleted;             /* output column with deletion flag */
+	const char *blobfile;        /* blob file large blobs are copied from */
+	const char *blobstore;       /* directory with blobs named by their content */
+	long streamthreshold;        /* larger blobs are copied from blobfile in pieces, 0 for none */
+};
+
+/* Options of the sinks writing sql statements or into an sqlite database */
+struct pxview_sql_options {
+	const char *tablename;
+	const char *date_format;
+	const char *time_format;
+	const char *timestamp_format;
+	const char *blobprefix;      /* blobs are written into PREFIX_n.EXT */
+	const char *blobextension;
+	const char *blobfile;        /* blob file large blobs are copied from */
+	const char *blobstore;       /* directory with blobs named by their content */
+	long streamthreshold;        /* larger blobs are copied from blobfile in pieces, 0 for none */
+	char **sqltypes;             /* column type of each field type as format taking the length */
+	int primarykeyfields;        /* number of fields in the primary key */
+	int droptable;               /* drop an existing table first */
+	int withschema;              /* create the table and the indexes of the primary key */
+	int usecopy;                 /* COPY FROM stdin instead of INSERT, not for sqlite */
+	int shortinsert;             /* INSERT without the names of the columns */
+	int emptystringisnull;       /* empty alpha fields are NULL instead of '' */
+	int resume;                  /* continue an export, the COPY statement has been written */
+	int transactions;            /* sqlite only: insert the records between two checkpoints in one transaction */
+	int busytimeout;             /* sqlite only: milliseconds to wait for a locked database, 0 for none */
+};
+
+int pxview_export_begin(struct pxview_sink *sink, pxdoc_t *pxdoc, const char *selectedfields);
+int pxview_export_record(struct pxview_sink *sink, int recno, char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo);
+int pxview_export_end(struct pxview_sink *sink);
+int pxview_export(struct pxview_sink *sink, pxdoc_t *pxdoc, const char *selectedfields);
+void pxview_sink_delete(struct pxview_sink *sink);
+char *pxview_blob_file(pxdoc_t *pxdoc, const char *prefix, int number, const char *extension, const char *data, int size);
+
+struct pxview_sink *pxview_csv_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_csv_options *options);
+struct pxview_sink *pxview_html_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_html_options *options);
+struct pxview_sink *pxview_sql_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_sql_options *options);
+/* Only available if pxview has been built with sqlite */
+struct pxview_sink *pxview_sqlite_sink_new(pxdoc_t *pxdoc, const char *filename, const struct pxview_sql_options *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
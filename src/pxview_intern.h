@@ -0,0 +1,27 @@
+#ifndef __PXVIEW_INTERN_H__
+#define __PXVIEW_INTERN_H__
+
+#ifdef HAVE_GSF
+#include <paradox-gsf.h>
+#else
+#include <paradox.h>
+#endif
+
+#ifdef ENABLE_NLS
+#define _(String) gettext(String)
+#else
+#define _(String) String
+#endif
+
+/* Handler for errors of pxlib as passed to PX_new2() */
+typedef void (*pxview_errorhandler_t)(pxdoc_t *p, int error, const char *str, void *data);
+
+/* Letter of a field type in the head line of csv and html output */
+char field_type_code(int type);
+
+/* These are not officially exported by pxlib */
+extern void hex_dump(FILE *outfp, char *p, int len);
+extern long get_long_le(const char *cp);
+extern unsigned short int get_short_le(const char *cp);
+
+#endif
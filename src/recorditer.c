@@ -0,0 +1,292 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "recorditer.h"
+#include "join.h"
+#include "dedupe.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "progress.h"
+#include "trace.h"
+
+/* record_iter_init() {{{
+ * Initializes an iterator over the first numrecords records.
+ * presetdeleted is passed to PX_get_record2() for each record.
+ */
+void record_iter_init(struct record_iter *iter, pxdoc_t *pxdoc, int numrecords, int presetdeleted) {
+	memset(iter, 0, sizeof(struct record_iter));
+	iter->pxdoc = pxdoc;
+	iter->numrecords = numrecords;
+	iter->presetdeleted = presetdeleted;
+	iter->recno = 0;
+	iter->bm = NULL;
+	iter->selectedblocks = NULL;
+	iter->curblock = 0;
+	iter->sort = NULL;
+	iter->join = NULL;
+	iter->dedupe = NULL;
+	iter->pipeline = NULL;
+	iter->progress = NULL;
+	iter->traceblock = 0;
+}
+/* }}} */
+
+/* record_iter_select_blocks() {{{
+ * Restricts the iterator to the records of those blocks in the
+ * block map whose flag in selectedblocks is set. If selectedblocks
+ * is NULL all blocks are visited in the order of the block map.
+ */
+void record_iter_select_blocks(struct record_iter *iter, struct blockmap *bm, char *selectedblocks) {
+	iter->bm = bm;
+	iter->selectedblocks = selectedblocks;
+	iter->curblock = 0;
+}
+/* }}} */
+
+/* record_iter_skip_blocks() {{{
+ * Continues the iteration with block number startblock of the block
+ * map, e.g. when an interrupted export is resumed.
+ */
+void record_iter_skip_blocks(struct record_iter *iter, int startblock) {
+	iter->curblock = startblock;
+}
+/* }}} */
+
+/* trace_block() {{{
+ * Records the time spent on the records of a data block, from reading
+ * its first record until reading the first record of the next block.
+ * number is 0 after the last record.
+ */
+static void trace_block(struct record_iter *iter, int number) {
+	if(number == iter->traceblock)
+		return;
+	if(iter->traceblock > 0)
+		trace_span("records of block", "convert", iter->tracestart, iter->traceblock);
+	iter->traceblock = number;
+	iter->tracestart = trace_now();
+}
+/* }}} */
+
+/* read_physical() {{{
+ * Reads the next record in the order of the data blocks.
+ */
+static int read_physical(struct record_iter *iter, int *recno, char *data, int *isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	pxdatablockinfo_t info;
+	int deleted;
+
+	if(iter->bm) {
+		struct blockmap *bm = iter->bm;
+		while(iter->curblock < bm->numblocks) {
+			struct blockinfo *bi = &(bm->blocks[iter->curblock]);
+			if((NULL == iter->selectedblocks || iter->selectedblocks[iter->curblock]) &&
+			   iter->recno < bi->firstrecord + bi->numrecords) {
+				if(iter->recno < bi->firstrecord)
+					iter->recno = bi->firstrecord;
+				break;
+			}
+			iter->curblock++;
+		}
+		if(iter->curblock >= bm->numblocks)
+			return 0;
+	} else if(iter->recno >= iter->numrecords) {
+		return 0;
+	}
+
+	*recno = iter->recno++;
+	if(iter->pipeline) {
+		struct blockmap *bm = iter->bm;
+		struct blockinfo *bi = &(bm->blocks[iter->curblock]);
+		char *block;
+		if(NULL == (block = pipeline_get_block(iter->pipeline, iter->curblock)))
+			return -1;
+		memcpy(data, &block[(*recno - bi->firstrecord) * bm->recordsize], bm->recordsize);
+		if(isdeleted)
+			*isdeleted = 0;
+		if(pxdbinfo) {
+			pxdbinfo->blockpos = bi->blockpos;
+			pxdbinfo->recordpos = bi->blockpos + BLOCKHEADERSIZE + (*recno - bi->firstrecord) * bm->recordsize;
+			pxdbinfo->size = bm->recordsize;
+			pxdbinfo->recno = *recno - bi->firstrecord;
+			pxdbinfo->numrecords = bi->numrecords;
+			pxdbinfo->prev = bi->prev;
+			pxdbinfo->next = bi->next;
+			pxdbinfo->number = bi->number;
+		}
+		if(pxview_stats)
+			stats_record(bm->recordsize, bi->blockpos);
+		if(iter->progress)
+			progress_record(iter->progress, bi->blockpos);
+		if(pxview_tracing)
+			trace_block(iter, bi->number);
+		return 1;
+	}
+	deleted = iter->presetdeleted;
+	if((pxview_stats || iter->progress || pxview_tracing) && NULL == pxdbinfo)
+		pxdbinfo = &info;
+	if(NULL == PX_get_record2(iter->pxdoc, *recno, data, &deleted, pxdbinfo))
+		return -1;
+	if(isdeleted)
+		*isdeleted = deleted;
+	if(pxview_stats)
+		stats_record(iter->pxdoc->px_head->px_recordsize, pxdbinfo->blockpos);
+	if(iter->progress)
+		progress_record(iter->progress, pxdbinfo->blockpos);
+	if(pxview_tracing)
+		trace_block(iter, pxdbinfo->number);
+	return 1;
+}
+/* }}} */
+
+/* next_physical() {{{
+ * Reads the next record in the order of the data blocks which is not
+ * a duplicate.
+ */
+static int next_physical(struct record_iter *iter, int *recno, char *data, int *isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	int ret;
+
+	if(pxview_stats)
+		stats_enter(STATS_READ);
+	while(0 < (ret = read_physical(iter, recno, data, isdeleted, pxdbinfo))) {
+		if(NULL == iter->dedupe || record_dedupe_keep(iter->dedupe, *recno, data))
+			break;
+	}
+	if(pxview_stats)
+		stats_leave();
+	if(pxview_tracing && ret == 0)
+		trace_block(iter, 0);
+	return ret;
+}
+/* }}} */
+
+/* record_iter_progress() {{{
+ * Reports the records read from the data blocks to progress, which
+ * may be NULL.
+ */
+void record_iter_progress(struct record_iter *iter, struct progress *progress) {
+	iter->progress = progress;
+}
+/* }}} */
+
+/* record_iter_pipeline() {{{
+ * Reads the data blocks through the pipeline instead of pxlib. Must be
+ * called after records have been deduplicated and before they are
+ * sorted or joined. Deleted records are not returned. Returns 0 on
+ * success and -1 on error.
+ */
+int record_iter_pipeline(struct record_iter *iter, struct pipeline *pipeline) {
+	if(NULL == iter->bm) {
+		iter->bm = pipeline->bm;
+		iter->selectedblocks = NULL;
+	}
+	if(iter->bm != pipeline->bm)
+		return -1;
+	if(0 > pipeline_start(pipeline, iter->selectedblocks, iter->curblock))
+		return -1;
+	iter->pipeline = pipeline;
+	return 0;
+}
+/* }}} */
+
+/* record_iter_next() {{{
+ * Reads the next record into data and sets recno to its number.
+ * isdeleted and pxdbinfo may be NULL. pxdbinfo is not set if the
+ * records are sorted or joined.
+ * Returns 1 if a record was read, 0 if there are no more records
+ * and -1 if the record could not be read.
+ */
+int record_iter_next(struct record_iter *iter, int *recno, char *data, int *isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	int deleted, ret;
+
+	if(NULL != iter->join) {
+		if(0 == (ret = record_join_next(iter->join, recno, data, isdeleted)))
+			iter->join = NULL;
+		return ret;
+	}
+	if(NULL == iter->sort)
+		return(next_physical(iter, recno, data, isdeleted, pxdbinfo));
+
+	if(0 >= (ret = record_sort_next(iter->sort, recno, &deleted, data))) {
+		/* The sort is not needed anymore once all records are returned */
+		if(ret == 0) {
+			record_sort_delete(iter->sort);
+			iter->sort = NULL;
+		}
+		return ret;
+	}
+	if(isdeleted)
+		*isdeleted = deleted;
+	return 1;
+}
+/* }}} */
+
+/* record_iter_sort() {{{
+ * Reads all remaining records and sorts them by the given fields.
+ * Afterwards the iterator returns them in sorted order. Records which
+ * cannot be read are reported and skipped. data must be large enough
+ * for one record. Returns 0 on success and -1 on error.
+ */
+int record_iter_sort(struct record_iter *iter, int *fields, int numfields, int memory, char *data) {
+	struct record_sort *sort;
+	int recno, deleted, ret;
+
+	if(NULL == (sort = record_sort_new(iter->pxdoc, fields, numfields, memory)))
+		return -1;
+	while(0 != (ret = next_physical(iter, &recno, data, &deleted, NULL))) {
+		if(0 > ret) {
+			fprintf(stderr, _("Couldn't get record number %d\n"), recno);
+			continue;
+		}
+		if(0 > record_sort_add(sort, recno, deleted, data)) {
+			record_sort_delete(sort);
+			return -1;
+		}
+	}
+	if(0 > record_sort_finish(sort)) {
+		record_sort_delete(sort);
+		return -1;
+	}
+	iter->sort = sort;
+	return 0;
+}
+/* }}} */
+
+/* record_iter_join() {{{
+ * Joins the remaining records with the records of another table.
+ * Afterwards the iterator returns the joined records, which have the
+ * size of join->recordsize. The stages added so far are moved into the
+ * join, which reads the records of iter through them. The join is not
+ * freed by the iterator. Returns 0 on success and -1 on error.
+ */
+int record_iter_join(struct record_iter *iter, struct record_join *join) {
+	if(0 > record_join_start(join, iter))
+		return -1;
+	iter->join = join;
+	return 0;
+}
+/* }}} */
+
+/* record_iter_dedupe() {{{
+ * Skips records whose primary key equals the key of another record.
+ * Must be called before the records are sorted or joined. data must
+ * be large enough for one record. Returns 0 on success and -1 on error.
+ */
+int record_iter_dedupe(struct record_iter *iter, struct record_dedupe *dedupe, char *data) {
+	if(0 > record_dedupe_start(dedupe, iter, data))
+		return -1;
+	iter->dedupe = dedupe;
+	return 0;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
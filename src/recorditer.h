@@ -0,0 +1,40 @@
+#ifndef __RECORDITER_H__
+#define __RECORDITER_H__
+
+#include "blockmap.h"
+#include "recordsort.h"
+
+struct record_join;
+struct record_dedupe;
+struct pipeline;
+struct progress;
+
+/* Iterates over the records which are to be output */
+struct record_iter {
+	pxdoc_t *pxdoc;
+	int numrecords;         /* number of records to visit */
+	int presetdeleted;      /* initial value of the deleted flag */
+	int recno;              /* number of next record */
+	struct blockmap *bm;    /* block map if only some blocks are visited */
+	char *selectedblocks;   /* one flag for each block in the block map */
+	int curblock;           /* index of block of last record in block map */
+	struct record_sort *sort; /* records are returned in sorted order */
+	struct record_join *join; /* records are joined with another table */
+	struct record_dedupe *dedupe; /* records with duplicate keys are skipped */
+	struct pipeline *pipeline; /* data blocks are read ahead */
+	struct progress *progress; /* records read are reported */
+	int traceblock;         /* number of block whose records are traced */
+	double tracestart;      /* time the first record of traceblock was read */
+};
+
+void record_iter_init(struct record_iter *iter, pxdoc_t *pxdoc, int numrecords, int presetdeleted);
+void record_iter_select_blocks(struct record_iter *iter, struct blockmap *bm, char *selectedblocks);
+void record_iter_skip_blocks(struct record_iter *iter, int startblock);
+int record_iter_sort(struct record_iter *iter, int *fields, int numfields, int memory, char *data);
+int record_iter_join(struct record_iter *iter, struct record_join *join);
+int record_iter_dedupe(struct record_iter *iter, struct record_dedupe *dedupe, char *data);
+int record_iter_pipeline(struct record_iter *iter, struct pipeline *pipeline);
+void record_iter_progress(struct record_iter *iter, struct progress *progress);
+int record_iter_next(struct record_iter *iter, int *recno, char *data, int *isdeleted, pxdatablockinfo_t *pxdbinfo);
+
+#endif
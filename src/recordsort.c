@@ -0,0 +1,489 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pxview_intern.h"
+#include "recordsort.h"
+#include "format.h"
+
+/* Except for blobs the fields of a record are stored in a way that
+ * comparing their raw bytes yields the order of their values. Numbers
+ * are big endian with the sign bit inverted, NULL values are all zero
+ * and therefore come first, alpha fields compare by their byte values in
+ * the code page of the file. The sort key is just the concatenation of
+ * the sort fields.
+ */
+
+/* record_sort_parse_fields() {{{
+ * Converts the comma separated list of field names in spec into an
+ * array of field numbers. Returns the number of fields or -1 on error.
+ */
+int record_sort_parse_fields(pxdoc_t *pxdoc, const char *spec, int **fields) {
+	pxfield_t *pxf;
+	const char *start, *end;
+	int numfields = 0, i;
+
+	if(NULL == (*fields = pxdoc->malloc(pxdoc, (strlen(spec)/2+1) * sizeof(int), _("Allocate memory for sort fields.")))) {
+		return -1;
+	}
+	start = spec;
+	while(*start) {
+		end = strchr(start, ',');
+		if(NULL == end)
+			end = start + strlen(start);
+		if(0 > (i = find_field(pxdoc, start, end-start))) {
+			fprintf(stderr, _("There is no field '%.*s' to sort by."), (int) (end-start), start);
+			fprintf(stderr, "\n");
+			pxdoc->free(pxdoc, *fields);
+			return -1;
+		}
+		pxf = &(PX_get_fields(pxdoc)[i]);
+		switch(pxf->px_ftype) {
+			case pxfMemoBLOb:
+			case pxfBLOb:
+			case pxfFmtMemoBLOb:
+			case pxfGraphic:
+			case pxfOLE:
+				fprintf(stderr, _("Records cannot be sorted by blob field '%s'."), pxf->px_fname);
+				fprintf(stderr, "\n");
+				pxdoc->free(pxdoc, *fields);
+				return -1;
+		}
+		(*fields)[numfields++] = i;
+		start = (*end == ',') ? end+1 : end;
+	}
+	if(numfields == 0) {
+		fprintf(stderr, _("No fields given to sort by."));
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, *fields);
+		return -1;
+	}
+	return(numfields);
+}
+/* }}} */
+
+/* record_sort_new() {{{
+ * Creates a sort of records by the given fields which keeps at most
+ * memory megabytes of records in memory.
+ */
+struct record_sort *record_sort_new(pxdoc_t *pxdoc, int *fields, int numfields, int memory) {
+	struct record_sort *rs;
+	pxfield_t *pxf;
+	int i, j, offset;
+
+	if(NULL == (rs = pxdoc->malloc(pxdoc, sizeof(struct record_sort), _("Allocate memory for sorting records.")))) {
+		return NULL;
+	}
+	memset(rs, 0, sizeof(struct record_sort));
+	rs->pxdoc = pxdoc;
+	rs->numkeys = numfields;
+	rs->keyoffsets = pxdoc->malloc(pxdoc, numfields * sizeof(int), _("Allocate memory for sorting records."));
+	rs->keylens = pxdoc->malloc(pxdoc, numfields * sizeof(int), _("Allocate memory for sorting records."));
+	if(NULL == rs->keyoffsets || NULL == rs->keylens) {
+		record_sort_delete(rs);
+		return NULL;
+	}
+
+	pxf = PX_get_fields(pxdoc);
+	rs->recordsize = 0;
+	for(i=0; i<PX_get_num_fields(pxdoc); i++)
+		rs->recordsize += pxf[i].px_flen;
+	rs->keylen = 0;
+	for(j=0; j<numfields; j++) {
+		offset = 0;
+		for(i=0; i<fields[j]; i++)
+			offset += pxf[i].px_flen;
+		rs->keyoffsets[j] = offset;
+		rs->keylens[j] = pxf[fields[j]].px_flen;
+		rs->keylen += rs->keylens[j];
+	}
+	rs->entrysize = rs->keylen + 2*sizeof(int) + rs->recordsize;
+
+	/* The sorted pointers need twice the space for merging */
+	rs->maxbuffered = (int) (((size_t) memory * 1024 * 1024) / (rs->entrysize + 2*sizeof(char *)));
+	if(rs->maxbuffered < 2)
+		rs->maxbuffered = 2;
+	rs->buffer = pxdoc->malloc(pxdoc, (size_t) rs->maxbuffered * rs->entrysize, _("Allocate memory for sorting records."));
+	rs->sorted = pxdoc->malloc(pxdoc, (size_t) rs->maxbuffered * 2 * sizeof(char *), _("Allocate memory for sorting records."));
+	if(NULL == rs->buffer || NULL == rs->sorted) {
+		record_sort_delete(rs);
+		return NULL;
+	}
+	return(rs);
+}
+/* }}} */
+
+/* free_run() {{{
+ */
+static void free_run(pxdoc_t *pxdoc, struct sort_run *run) {
+	if(run->fp)
+		fclose(run->fp);
+	if(run->entry)
+		pxdoc->free(pxdoc, run->entry);
+	pxdoc->free(pxdoc, run);
+}
+/* }}} */
+
+/* record_sort_delete() {{{
+ * Frees all memory and removes the temporary files.
+ */
+void record_sort_delete(struct record_sort *rs) {
+	pxdoc_t *pxdoc = rs->pxdoc;
+	int i;
+
+	if(rs->runs) {
+		for(i=0; i<rs->numruns; i++)
+			free_run(pxdoc, rs->runs[i]);
+		pxdoc->free(pxdoc, rs->runs);
+	}
+	if(rs->heap)
+		pxdoc->free(pxdoc, rs->heap);
+	if(rs->buffer)
+		pxdoc->free(pxdoc, rs->buffer);
+	if(rs->sorted)
+		pxdoc->free(pxdoc, rs->sorted);
+	if(rs->keyoffsets)
+		pxdoc->free(pxdoc, rs->keyoffsets);
+	if(rs->keylens)
+		pxdoc->free(pxdoc, rs->keylens);
+	pxdoc->free(pxdoc, rs);
+}
+/* }}} */
+
+/* sort_buffer() {{{
+ * Sorts the pointers to the buffered entries by their key. This is a
+ * bottom up merge sort, because records with equal keys shall keep
+ * their physical order.
+ */
+static void sort_buffer(struct record_sort *rs) {
+	char **src = rs->sorted, **dst = rs->sorted + rs->maxbuffered, **tmp;
+	int n = rs->numbuffered, width, i;
+
+	for(i=0; i<n; i++)
+		src[i] = rs->buffer + (size_t) i * rs->entrysize;
+	for(width=1; width<n; width*=2) {
+		for(i=0; i<n; i+=2*width) {
+			int l = i, mid = (i+width < n) ? i+width : n;
+			int r = mid, hi = (i+2*width < n) ? i+2*width : n;
+			int k = i;
+			while(l < mid && r < hi) {
+				if(memcmp(src[r], src[l], rs->keylen) < 0)
+					dst[k++] = src[r++];
+				else
+					dst[k++] = src[l++];
+			}
+			while(l < mid)
+				dst[k++] = src[l++];
+			while(r < hi)
+				dst[k++] = src[r++];
+		}
+		tmp = src; src = dst; dst = tmp;
+	}
+	if(src != rs->sorted)
+		memcpy(rs->sorted, src, n * sizeof(char *));
+}
+/* }}} */
+
+/* new_run() {{{
+ * Creates an empty run in a temporary file.
+ */
+static struct sort_run *new_run(struct record_sort *rs) {
+	pxdoc_t *pxdoc = rs->pxdoc;
+	struct sort_run *run;
+
+	if(NULL == (run = pxdoc->malloc(pxdoc, sizeof(struct sort_run), _("Allocate memory for sorting records.")))) {
+		return NULL;
+	}
+	run->index = 0;
+	if(NULL == (run->entry = pxdoc->malloc(pxdoc, rs->entrysize, _("Allocate memory for sorting records.")))) {
+		pxdoc->free(pxdoc, run);
+		return NULL;
+	}
+	if(NULL == (run->fp = tmpfile())) {
+		fprintf(stderr, _("Could not create temporary file for sorting."));
+		fprintf(stderr, "\n");
+		pxdoc->free(pxdoc, run->entry);
+		pxdoc->free(pxdoc, run);
+		return NULL;
+	}
+	return(run);
+}
+/* }}} */
+
+/* add_run() {{{
+ */
+static int add_run(struct record_sort *rs, struct sort_run *run) {
+	if(NULL == (rs->runs = rs->pxdoc->realloc(rs->pxdoc, rs->runs, (rs->numruns+1) * sizeof(struct sort_run *), _("Allocate memory for sorting records.")))) {
+		return -1;
+	}
+	rs->runs[rs->numruns++] = run;
+	return 0;
+}
+/* }}} */
+
+/* spill_buffer() {{{
+ * Writes the buffered entries as a new sorted run.
+ */
+static int spill_buffer(struct record_sort *rs) {
+	struct sort_run *run;
+	int i;
+
+	sort_buffer(rs);
+	if(NULL == (run = new_run(rs)))
+		return -1;
+	for(i=0; i<rs->numbuffered; i++) {
+		if(1 != fwrite(rs->sorted[i], rs->entrysize, 1, run->fp)) {
+			fprintf(stderr, _("Could not write temporary file for sorting."));
+			fprintf(stderr, "\n");
+			free_run(rs->pxdoc, run);
+			return -1;
+		}
+	}
+	rs->numbuffered = 0;
+	return(add_run(rs, run));
+}
+/* }}} */
+
+/* record_sort_add() {{{
+ * Adds a record. Returns 0 on success and -1 on error.
+ */
+int record_sort_add(struct record_sort *rs, int recno, int isdeleted, const char *data) {
+	char *entry, *p;
+	int i;
+
+	if(rs->numbuffered >= rs->maxbuffered) {
+		if(0 > spill_buffer(rs))
+			return -1;
+	}
+	entry = rs->buffer + (size_t) rs->numbuffered * rs->entrysize;
+	p = entry;
+	for(i=0; i<rs->numkeys; i++) {
+		memcpy(p, &data[rs->keyoffsets[i]], rs->keylens[i]);
+		p += rs->keylens[i];
+	}
+	memcpy(p, &recno, sizeof(int));
+	p += sizeof(int);
+	memcpy(p, &isdeleted, sizeof(int));
+	p += sizeof(int);
+	memcpy(p, data, rs->recordsize);
+	rs->numbuffered++;
+	return 0;
+}
+/* }}} */
+
+/* read_run() {{{
+ * Reads the next entry of a run. Returns 1 on success, 0 at the end
+ * of the run and -1 on error.
+ */
+static int read_run(struct record_sort *rs, struct sort_run *run) {
+	if(1 == fread(run->entry, rs->entrysize, 1, run->fp))
+		return 1;
+	if(ferror(run->fp)) {
+		fprintf(stderr, _("Could not read temporary file for sorting."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* run_less() {{{
+ * Orders runs by their current entry. Runs created earlier win on equal
+ * keys, so the sort remains stable.
+ */
+static int run_less(struct record_sort *rs, struct sort_run *a, struct sort_run *b) {
+	int c = memcmp(a->entry, b->entry, rs->keylen);
+	if(c != 0)
+		return(c < 0);
+	return(a->index < b->index);
+}
+/* }}} */
+
+/* heap_down() {{{
+ */
+static void heap_down(struct record_sort *rs, struct sort_run **heap, int size, int i) {
+	struct sort_run *run = heap[i];
+	int child;
+
+	while((child = 2*i+1) < size) {
+		if(child+1 < size && run_less(rs, heap[child+1], heap[child]))
+			child++;
+		if(!run_less(rs, heap[child], run))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = run;
+}
+/* }}} */
+
+/* heap_init() {{{
+ * Reads the first entry of each run and builds a heap of all runs
+ * which are not empty. Returns the size of the heap or -1 on error.
+ */
+static int heap_init(struct record_sort *rs, struct sort_run **runs, int numruns, struct sort_run **heap) {
+	int i, size = 0, ret;
+
+	for(i=0; i<numruns; i++) {
+		runs[i]->index = i;
+		rewind(runs[i]->fp);
+		if(0 > (ret = read_run(rs, runs[i])))
+			return -1;
+		if(ret)
+			heap[size++] = runs[i];
+	}
+	for(i=size/2-1; i>=0; i--)
+		heap_down(rs, heap, size, i);
+	return(size);
+}
+/* }}} */
+
+/* heap_advance() {{{
+ * Moves the run on top of the heap to its next entry. Returns the new
+ * size of the heap or -1 on error.
+ */
+static int heap_advance(struct record_sort *rs, struct sort_run **heap, int size) {
+	int ret;
+
+	if(0 > (ret = read_run(rs, heap[0])))
+		return -1;
+	if(ret == 0) {
+		heap[0] = heap[--size];
+	}
+	if(size > 0)
+		heap_down(rs, heap, size, 0);
+	return(size);
+}
+/* }}} */
+
+/* merge_runs() {{{
+ * Merges numruns runs into a new run and frees the merged runs.
+ */
+static struct sort_run *merge_runs(struct record_sort *rs, struct sort_run **runs, int numruns) {
+	pxdoc_t *pxdoc = rs->pxdoc;
+	struct sort_run *run, **heap;
+	int size, i;
+
+	if(NULL == (heap = pxdoc->malloc(pxdoc, numruns * sizeof(struct sort_run *), _("Allocate memory for sorting records.")))) {
+		return NULL;
+	}
+	if(NULL == (run = new_run(rs))) {
+		pxdoc->free(pxdoc, heap);
+		return NULL;
+	}
+	size = heap_init(rs, runs, numruns, heap);
+	while(size > 0) {
+		if(1 != fwrite(heap[0]->entry, rs->entrysize, 1, run->fp)) {
+			fprintf(stderr, _("Could not write temporary file for sorting."));
+			fprintf(stderr, "\n");
+			size = -1;
+			break;
+		}
+		size = heap_advance(rs, heap, size);
+	}
+	pxdoc->free(pxdoc, heap);
+	if(size < 0) {
+		free_run(pxdoc, run);
+		return NULL;
+	}
+	for(i=0; i<numruns; i++)
+		free_run(pxdoc, runs[i]);
+	return(run);
+}
+/* }}} */
+
+/* record_sort_finish() {{{
+ * Must be called after the last record has been added. If all records
+ * fit into memory they are just sorted. Otherwise the last run is
+ * written and the runs are merged until at most SORT_MAXMERGE remain,
+ * which are merged while the records are read.
+ */
+int record_sort_finish(struct record_sort *rs) {
+	pxdoc_t *pxdoc = rs->pxdoc;
+	int i, j, n, numruns;
+
+	if(rs->numruns == 0) {
+		sort_buffer(rs);
+		rs->nextbuffered = 0;
+		return 0;
+	}
+
+	if(rs->numbuffered > 0 && 0 > spill_buffer(rs))
+		return -1;
+	pxdoc->free(pxdoc, rs->buffer);
+	rs->buffer = NULL;
+	pxdoc->free(pxdoc, rs->sorted);
+	rs->sorted = NULL;
+
+	while(rs->numruns > SORT_MAXMERGE) {
+		numruns = 0;
+		for(i=0; i<rs->numruns; i+=SORT_MAXMERGE) {
+			n = (rs->numruns - i < SORT_MAXMERGE) ? rs->numruns - i : SORT_MAXMERGE;
+			if(n > 1) {
+				struct sort_run *run;
+				if(NULL == (run = merge_runs(rs, &rs->runs[i], n))) {
+					/* Runs which are already merged must not be freed twice */
+					for(j=i; j<rs->numruns; j++)
+						rs->runs[numruns++] = rs->runs[j];
+					rs->numruns = numruns;
+					return -1;
+				}
+				rs->runs[numruns++] = run;
+			} else {
+				rs->runs[numruns++] = rs->runs[i];
+			}
+		}
+		rs->numruns = numruns;
+	}
+
+	if(NULL == (rs->heap = pxdoc->malloc(pxdoc, rs->numruns * sizeof(struct sort_run *), _("Allocate memory for sorting records.")))) {
+		return -1;
+	}
+	if(0 > (rs->heapsize = heap_init(rs, rs->runs, rs->numruns, rs->heap)))
+		return -1;
+	return 0;
+}
+/* }}} */
+
+/* record_sort_next() {{{
+ * Returns the next record in sorted order. Returns 1 if a record was
+ * returned, 0 if there are no more records and -1 on error.
+ */
+int record_sort_next(struct record_sort *rs, int *recno, int *isdeleted, char *data) {
+	char *entry;
+
+	if(rs->numruns == 0) {
+		if(rs->nextbuffered >= rs->numbuffered)
+			return 0;
+		entry = rs->sorted[rs->nextbuffered++];
+	} else {
+		if(rs->heapsize <= 0)
+			return 0;
+		entry = rs->heap[0]->entry;
+	}
+
+	entry += rs->keylen;
+	memcpy(recno, entry, sizeof(int));
+	entry += sizeof(int);
+	memcpy(isdeleted, entry, sizeof(int));
+	entry += sizeof(int);
+	memcpy(data, entry, rs->recordsize);
+
+	if(rs->numruns > 0) {
+		if(0 > (rs->heapsize = heap_advance(rs, rs->heap, rs->heapsize)))
+			return -1;
+	}
+	return 1;
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
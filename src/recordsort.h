@@ -0,0 +1,44 @@
+#ifndef __RECORDSORT_H__
+#define __RECORDSORT_H__
+
+#include <stdio.h>
+
+/* Default amount of memory for records before a run is written */
+#define SORT_MEMORY 64
+/* Maximum number of runs merged at once */
+#define SORT_MAXMERGE 64
+
+struct sort_run {
+	FILE *fp;
+	char *entry;            /* current entry of run */
+	int index;              /* position of run in list of runs */
+};
+
+/* External merge sort of records by the raw bytes of some fields */
+struct record_sort {
+	pxdoc_t *pxdoc;
+	int recordsize;
+	int numkeys;
+	int *keyoffsets;        /* offset of each sort field in record */
+	int *keylens;           /* length of each sort field */
+	int keylen;             /* sum of keylens */
+	int entrysize;          /* key, record number, deleted flag, record */
+	char *buffer;           /* entries not yet written into a run */
+	char **sorted;          /* pointers into buffer in sorted order */
+	int maxbuffered;
+	int numbuffered;
+	int nextbuffered;       /* next entry returned if nothing was spilled */
+	struct sort_run **runs; /* runs on disk */
+	int numruns;
+	struct sort_run **heap; /* runs ordered by their current entry */
+	int heapsize;
+};
+
+int record_sort_parse_fields(pxdoc_t *pxdoc, const char *spec, int **fields);
+struct record_sort *record_sort_new(pxdoc_t *pxdoc, int *fields, int numfields, int memory);
+void record_sort_delete(struct record_sort *rs);
+int record_sort_add(struct record_sort *rs, int recno, int isdeleted, const char *data);
+int record_sort_finish(struct record_sort *rs);
+int record_sort_next(struct record_sort *rs, int *recno, int *isdeleted, char *data);
+
+#endif
@@ -0,0 +1,664 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <poll.h>
+#endif
+#include "pxview_intern.h"
+#include "str_buffer.h"
+#include "recorditer.h"
+#include "batch.h"
+#include "server.h"
+#include "transcode.h"
+
+/* Requests are single lines whose arguments are separated by tabs:
+ *
+ *   EXPORT<tab>FILE
+ *   LOOKUP<tab>FILE<tab>FIELD<tab>VALUE
+ *   SHUTDOWN
+ *
+ * Each one is answered by the line 'ERROR <text>' or by pieces of one
+ * JSON object per record and line. Every piece is sent as a line
+ * 'OK <n>' followed by n bytes, and the line 'OK 0' ends the answer, so
+ * a table is exported without keeping all of it in memory.
+ * A connection may send any number of requests. The server reads from
+ * all connections at the same time and answers complete requests one
+ * after the other. Lookups compare the value with the field as it is
+ * output in text mode and use an index of the field which is built on
+ * the first lookup.
+ */
+
+/* server_new() {{{
+ * Creates a server which will listen on socketpath and keep at most
+ * maxtables tables open.
+ */
+struct server *server_new(const char *socketpath, int maxtables, char *targetencoding, struct format_options *fo, pxview_errorhandler_t errorhandler) {
+	struct server *srv;
+
+	if(NULL == (srv = malloc(sizeof(struct server)))) {
+		return NULL;
+	}
+	memset(srv, 0, sizeof(struct server));
+	srv->fd = -1;
+	srv->socketpath = strdup(socketpath);
+	srv->targetencoding = targetencoding;
+	srv->fo = fo;
+	srv->errorhandler = errorhandler;
+	srv->maxtables = maxtables > 0 ? maxtables : SERVER_CACHE;
+	if(NULL == (srv->tables = malloc(srv->maxtables * sizeof(struct server_table)))) {
+		free(srv->socketpath);
+		free(srv);
+		return NULL;
+	}
+	return(srv);
+}
+/* }}} */
+
+/* close_table() {{{
+ */
+static void close_table(struct server_table *t) {
+	pxdoc_t *pxdoc = t->pxdoc;
+	int i;
+
+	if(t->indexes) {
+		for(i=0; i<t->numfields; i++) {
+			if(t->indexes[i]) {
+				pxdoc->free(pxdoc, t->indexes[i]->entries);
+				pxdoc->free(pxdoc, t->indexes[i]);
+			}
+		}
+		pxdoc->free(pxdoc, t->indexes);
+	}
+	if(t->offsets)
+		pxdoc->free(pxdoc, t->offsets);
+	if(t->data)
+		pxdoc->free(pxdoc, t->data);
+	/* The blob file belongs to the document and is closed with it */
+	transcode_release(pxdoc);
+	PX_close(pxdoc);
+	PX_delete(pxdoc);
+	if(t->pindexdoc) {
+		PX_close(t->pindexdoc);
+		PX_delete(t->pindexdoc);
+	}
+	free(t->filename);
+}
+/* }}} */
+
+/* server_delete() {{{
+ */
+void server_delete(struct server *srv) {
+	int i;
+
+	for(i=0; i<srv->numtables; i++)
+		close_table(&srv->tables[i]);
+	free(srv->tables);
+	if(srv->clients)
+		free(srv->clients);
+	free(srv->socketpath);
+	free(srv);
+}
+/* }}} */
+
+/* open_table() {{{
+ * Opens a table with its primary index and blob file and prepares
+ * everything which does not depend on the request. Returns 0 on
+ * success and -1 on error.
+ */
+static int open_table(struct server *srv, struct server_table *t, const char *filename, time_t mtime) {
+	pxdoc_t *pxdoc;
+	char *companion;
+	int i;
+
+	memset(t, 0, sizeof(struct server_table));
+	if(NULL == (pxdoc = PX_new2(srv->errorhandler, NULL, NULL, NULL))) {
+		return -1;
+	}
+	if(0 > PX_open_file(pxdoc, filename)) {
+		PX_delete(pxdoc);
+		return -1;
+	}
+	t->pxdoc = pxdoc;
+	if(srv->targetencoding != NULL)
+		transcode_set_targetencoding(pxdoc, srv->targetencoding);
+
+	if(NULL != (companion = batch_find_companion(filename, "px"))) {
+		if(NULL != (t->pindexdoc = PX_new2(srv->errorhandler, NULL, NULL, NULL))) {
+			if(0 > PX_open_file(t->pindexdoc, companion) ||
+			   0 > PX_read_primary_index(t->pindexdoc) ||
+			   0 > PX_add_primary_index(pxdoc, t->pindexdoc)) {
+				/* The table can still be read without its index */
+				PX_close(t->pindexdoc);
+				PX_delete(t->pindexdoc);
+				t->pindexdoc = NULL;
+			}
+		}
+		free(companion);
+	}
+	if(NULL != (companion = batch_find_companion(filename, "mb"))) {
+		if(NULL != (t->pxblob = PX_new_blob(pxdoc)) &&
+		   0 > PX_open_blob_file(t->pxblob, companion)) {
+			PX_delete_blob(t->pxblob);
+			t->pxblob = NULL;
+		}
+		free(companion);
+	}
+
+	t->fields = PX_get_fields(pxdoc);
+	t->numfields = PX_get_num_fields(pxdoc);
+	t->filename = strdup(filename);
+	if(NULL == (t->offsets = pxdoc->malloc(pxdoc, (t->numfields+1) * sizeof(int), _("Allocate memory for field offsets."))) ||
+	   NULL == (t->data = pxdoc->malloc(pxdoc, PX_get_recordsize(pxdoc), _("Allocate memory for record."))) ||
+	   NULL == (t->indexes = pxdoc->malloc(pxdoc, (t->numfields+1) * sizeof(struct server_index *), _("Allocate memory for indexes.")))) {
+		close_table(t);
+		return -1;
+	}
+	memset(t->indexes, 0, (t->numfields+1) * sizeof(struct server_index *));
+	t->offsets[0] = 0;
+	for(i=0; i<t->numfields; i++)
+		t->offsets[i+1] = t->offsets[i] + t->fields[i].px_flen;
+	t->mtime = mtime;
+	return 0;
+}
+/* }}} */
+
+/* get_table() {{{
+ * Returns the table from the cache or opens it, replacing the least
+ * recently used table if the cache is full. A table whose file has been
+ * modified since it was opened is opened again. Returns NULL if the
+ * table cannot be opened.
+ */
+static struct server_table *get_table(struct server *srv, const char *filename) {
+	struct server_table *t = NULL;
+	struct stat st;
+	int i;
+
+	if(0 != stat(filename, &st))
+		return NULL;
+	for(i=0; i<srv->numtables; i++) {
+		if(!strcmp(srv->tables[i].filename, filename)) {
+			t = &srv->tables[i];
+			break;
+		}
+	}
+	if(t && t->mtime != st.st_mtime) {
+		close_table(t);
+		*t = srv->tables[--srv->numtables];
+		t = NULL;
+	}
+	if(NULL == t) {
+		if(srv->numtables == srv->maxtables) {
+			struct server_table *lru = &srv->tables[0];
+			for(i=1; i<srv->numtables; i++) {
+				if(srv->tables[i].lastused < lru->lastused)
+					lru = &srv->tables[i];
+			}
+			close_table(lru);
+			*lru = srv->tables[--srv->numtables];
+		}
+		t = &srv->tables[srv->numtables];
+		if(0 > open_table(srv, t, filename, st.st_mtime))
+			return NULL;
+		srv->numtables++;
+	}
+	t->lastused = srv->clock;
+	return(t);
+}
+/* }}} */
+
+/* format_value() {{{
+ * Replaces the content of sb by the value of a field in text mode.
+ */
+static void format_value(struct server *srv, struct server_table *t, struct str_buffer *sb, int field) {
+	str_buffer_clear(t->pxdoc, sb);
+	format_field(t->pxdoc, sb, &t->fields[field], t->data + t->offsets[field], FORMAT_TEXT, srv->fo);
+}
+/* }}} */
+
+/* compare_entries() {{{
+ */
+static int compare_entries(const void *a, const void *b) {
+	const struct server_index_entry *ea = a, *eb = b;
+
+	if(ea->hash != eb->hash)
+		return(ea->hash < eb->hash ? -1 : 1);
+	return(ea->recno - eb->recno);
+}
+/* }}} */
+
+/* build_index() {{{
+ * Reads all records once and sorts them by the hash of the value of
+ * the field.
+ */
+static struct server_index *build_index(struct server *srv, struct server_table *t, int field) {
+	pxdoc_t *pxdoc = t->pxdoc;
+	struct server_index *idx;
+	struct str_buffer *sb;
+	struct record_iter iter;
+	int ret, recno, numrecords = PX_get_num_records(pxdoc);
+
+	if(NULL == (sb = str_buffer_new(pxdoc, 100)))
+		return NULL;
+	if(NULL == (idx = pxdoc->malloc(pxdoc, sizeof(struct server_index), _("Allocate memory for index.")))) {
+		str_buffer_delete(pxdoc, sb);
+		return NULL;
+	}
+	if(NULL == (idx->entries = pxdoc->malloc(pxdoc, (numrecords+1) * sizeof(struct server_index_entry), _("Allocate memory for index.")))) {
+		pxdoc->free(pxdoc, idx);
+		str_buffer_delete(pxdoc, sb);
+		return NULL;
+	}
+	idx->numentries = 0;
+	record_iter_init(&iter, pxdoc, numrecords, 0);
+	while(0 != (ret = record_iter_next(&iter, &recno, t->data, NULL, NULL))) {
+		if(0 > ret || idx->numentries >= numrecords)
+			continue;
+		format_value(srv, t, sb, field);
+		idx->entries[idx->numentries].hash = hash_bytes(str_buffer_get(pxdoc, sb), str_buffer_len(pxdoc, sb), 0);
+		idx->entries[idx->numentries].recno = recno;
+		idx->numentries++;
+	}
+	qsort(idx->entries, idx->numentries, sizeof(struct server_index_entry), compare_entries);
+	str_buffer_delete(pxdoc, sb);
+	return(idx);
+}
+/* }}} */
+
+/* print_record() {{{
+ * Appends the record in t->data as a JSON object on a line of its own.
+ */
+static void print_record(struct server *srv, struct server_table *t, struct str_buffer *sb) {
+	int i;
+
+	str_buffer_append(t->pxdoc, sb, "{", 1);
+	for(i=0; i<t->numfields; i++) {
+		if(i)
+			str_buffer_append(t->pxdoc, sb, ", ", 2);
+		format_fieldname(t->pxdoc, sb, &t->fields[i], i, FORMAT_JSON, srv->fo);
+		str_buffer_append(t->pxdoc, sb, ": ", 2);
+		format_field(t->pxdoc, sb, &t->fields[i], t->data + t->offsets[i], FORMAT_JSON, srv->fo);
+	}
+	str_buffer_append(t->pxdoc, sb, "}\n", 2);
+}
+/* }}} */
+
+/* lookup_table() {{{
+ * Appends all records whose field has the given value. Returns -1 if
+ * the index cannot be built.
+ */
+static int lookup_table(struct server *srv, struct server_table *t, int field, const char *value, struct str_buffer *sb) {
+	pxdoc_t *pxdoc = t->pxdoc;
+	struct server_index *idx;
+	struct str_buffer *vsb;
+	px_hash_t hash = hash_bytes(value, strlen(value), 0);
+	int lo, hi, mid;
+
+	if(NULL == t->indexes[field] && NULL == (t->indexes[field] = build_index(srv, t, field)))
+		return -1;
+	idx = t->indexes[field];
+	if(NULL == (vsb = str_buffer_new(pxdoc, 100)))
+		return -1;
+
+	/* First entry with the hash */
+	lo = 0;
+	hi = idx->numentries;
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(idx->entries[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	/* Entries with equal hashes are compared by value */
+	for(; lo < idx->numentries && idx->entries[lo].hash == hash; lo++) {
+		if(NULL == PX_get_record(pxdoc, idx->entries[lo].recno, t->data))
+			continue;
+		format_value(srv, t, vsb, field);
+		if(str_buffer_len(pxdoc, vsb) == strlen(value) && 0 == memcmp(str_buffer_get(pxdoc, vsb), value, strlen(value)))
+			print_record(srv, t, sb);
+	}
+	str_buffer_delete(pxdoc, vsb);
+	return 0;
+}
+/* }}} */
+
+/* write_all() {{{
+ */
+static int write_all(int fd, const char *buf, size_t len) {
+	ssize_t n;
+
+	while(len > 0) {
+		if(0 > (n = write(fd, buf, len))) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+/* }}} */
+
+/* send_chunk() {{{
+ * Sends the content of sb as one piece of an answer and empties sb.
+ * Nothing is sent if sb is empty, because an empty piece ends the
+ * answer. Returns -1 if the connection is broken.
+ */
+static int send_chunk(int fd, pxdoc_t *pxdoc, struct str_buffer *sb) {
+	char header[40];
+	size_t len = str_buffer_len(pxdoc, sb);
+
+	if(len == 0)
+		return 0;
+	sprintf(header, "OK %lu\n", (unsigned long) len);
+	if(0 > write_all(fd, header, strlen(header)) ||
+	   0 > write_all(fd, str_buffer_get(pxdoc, sb), len))
+		return -1;
+	str_buffer_clear(pxdoc, sb);
+	return 0;
+}
+/* }}} */
+
+/* export_table() {{{
+ * Sends all records, each time SERVER_CHUNK bytes have been collected.
+ * Returns -1 if the connection is broken.
+ */
+static int export_table(struct server *srv, struct server_table *t, struct str_buffer *sb, int fd) {
+	struct record_iter iter;
+	int ret, recno;
+
+	record_iter_init(&iter, t->pxdoc, PX_get_num_records(t->pxdoc), 0);
+	while(0 != (ret = record_iter_next(&iter, &recno, t->data, NULL, NULL))) {
+		if(0 < ret)
+			print_record(srv, t, sb);
+		if(str_buffer_len(t->pxdoc, sb) >= SERVER_CHUNK && 0 > send_chunk(fd, t->pxdoc, sb))
+			return -1;
+	}
+	return(send_chunk(fd, t->pxdoc, sb));
+}
+/* }}} */
+
+/* reply_error() {{{
+ */
+static int reply_error(int fd, const char *error) {
+	char buf[SERVER_MAXREQUEST];
+
+	snprintf(buf, sizeof(buf), "ERROR %s\n", error);
+	return(write_all(fd, buf, strlen(buf)));
+}
+/* }}} */
+
+/* handle_request() {{{
+ * Answers a single request. Returns -1 if the connection is broken.
+ */
+static int handle_request(struct server *srv, int fd, char *line) {
+	struct server_table *t;
+	struct str_buffer *sb;
+	char *args[4];
+	int numargs = 0, field = -1, ret;
+
+	args[numargs++] = line;
+	while(numargs < 4 && NULL != (line = strchr(line, '\t'))) {
+		*line++ = '\0';
+		args[numargs++] = line;
+	}
+
+	srv->clock++;
+	if(!strcmp(args[0], "SHUTDOWN") && numargs == 1) {
+		srv->shutdown = 1;
+		return(write_all(fd, "OK 0\n", 5));
+	}
+	if(!(!strcmp(args[0], "EXPORT") && numargs == 2) &&
+	   !(!strcmp(args[0], "LOOKUP") && numargs == 4))
+		return(reply_error(fd, _("Unknown request.")));
+
+	if(NULL == (t = get_table(srv, args[1])))
+		return(reply_error(fd, _("Could not open input file.")));
+	if(numargs == 4 && 0 > (field = find_field(t->pxdoc, args[2], strlen(args[2]))))
+		return(reply_error(fd, _("Unknown field.")));
+	if(NULL == (sb = str_buffer_new(t->pxdoc, 1000)))
+		return(reply_error(fd, _("Could not allocate memory for output.")));
+
+	if(field < 0) {
+		ret = export_table(srv, t, sb, fd);
+	} else if(0 > lookup_table(srv, t, field, args[3], sb)) {
+		str_buffer_delete(t->pxdoc, sb);
+		return(reply_error(fd, _("Could not build index.")));
+	} else {
+		ret = send_chunk(fd, t->pxdoc, sb);
+	}
+	if(0 == ret)
+		ret = write_all(fd, "OK 0\n", 5);
+	str_buffer_delete(t->pxdoc, sb);
+	return(ret);
+}
+/* }}} */
+
+/* read_requests() {{{
+ * Reads from a client and answers each complete request line. Returns
+ * -1 if the connection shall be closed.
+ */
+static int read_requests(struct server *srv, struct server_client *c) {
+	ssize_t n;
+	char *line, *end;
+	size_t len;
+
+	if(0 >= (n = read(c->fd, c->request + c->len, sizeof(c->request) - c->len))) {
+		return((n < 0 && errno == EINTR) ? 0 : -1);
+	}
+	c->len += n;
+	c->lastactive = time(NULL);
+
+	line = c->request;
+	while(!srv->shutdown && NULL != (end = memchr(line, '\n', c->len - (line - c->request)))) {
+		*end = '\0';
+		len = end - line;
+		if(len > 0 && line[len-1] == '\r')
+			line[len-1] = '\0';
+		if(0 > handle_request(srv, c->fd, line))
+			return -1;
+		line = end + 1;
+	}
+	c->len -= line - c->request;
+	memmove(c->request, line, c->len);
+	if(c->len == sizeof(c->request)) {
+		reply_error(c->fd, _("Request is too long."));
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* add_client() {{{
+ * Accepts a new connection. Writes to the client fail if it does not
+ * read for SERVER_TIMEOUT seconds, so it cannot block the server.
+ */
+static void add_client(struct server *srv) {
+	struct server_client *c;
+	struct timeval tv;
+	int fd;
+
+	if(0 > (fd = accept(srv->fd, NULL, NULL))) {
+		if(errno != EINTR && errno != EAGAIN) {
+			fprintf(stderr, _("Could not accept connection: %s"), strerror(errno));
+			fprintf(stderr, "\n");
+		}
+		return;
+	}
+	tv.tv_sec = SERVER_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+	c = &srv->clients[srv->numclients++];
+	c->fd = fd;
+	c->len = 0;
+	c->lastactive = time(NULL);
+}
+/* }}} */
+
+/* remove_stale_socket() {{{
+ * Removes a socket left over by a server which is not running anymore.
+ * Anything else at the path is kept. Returns 0 if the path is free and
+ * -1 otherwise.
+ */
+static int remove_stale_socket(const char *path, struct sockaddr_un *addr) {
+	struct stat st;
+	int fd, ret;
+
+	if(0 != lstat(path, &st)) {
+		if(errno == ENOENT)
+			return 0;
+		fprintf(stderr, _("Could not listen on socket %s: %s"), path, strerror(errno));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(!S_ISSOCK(st.st_mode)) {
+		fprintf(stderr, _("'%s' exists and is not a socket."), path);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(0 > (fd = socket(AF_UNIX, SOCK_STREAM, 0))) {
+		fprintf(stderr, _("Could not create socket: %s"), strerror(errno));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	ret = connect(fd, (struct sockaddr *) addr, sizeof(*addr));
+	close(fd);
+	if(0 == ret || errno != ECONNREFUSED) {
+		fprintf(stderr, _("Another server is listening on socket %s."), path);
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(0 != unlink(path)) {
+		fprintf(stderr, _("Could not listen on socket %s: %s"), path, strerror(errno));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* server_run() {{{
+ * Listens on the socket and answers requests until a client asks the
+ * server to shut down. Returns 0 on shutdown and -1 if the socket cannot
+ * be created.
+ */
+int server_run(struct server *srv) {
+#ifdef HAVE_SYS_UN_H
+	struct sockaddr_un addr;
+	struct pollfd *fds;
+	time_t now;
+	int i, n, numfds;
+
+	if(strlen(srv->socketpath) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, _("Socket name is too long."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, srv->socketpath);
+	if(0 > remove_stale_socket(srv->socketpath, &addr))
+		return -1;
+	if(NULL == (srv->clients = malloc(SERVER_MAXCLIENTS * sizeof(struct server_client))) ||
+	   NULL == (fds = malloc((SERVER_MAXCLIENTS+1) * sizeof(struct pollfd)))) {
+		fprintf(stderr, _("Could not allocate memory for connections."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	if(0 > (srv->fd = socket(AF_UNIX, SOCK_STREAM, 0))) {
+		fprintf(stderr, _("Could not create socket: %s"), strerror(errno));
+		fprintf(stderr, "\n");
+		free(fds);
+		return -1;
+	}
+	if(0 > bind(srv->fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	   0 > listen(srv->fd, 16)) {
+		fprintf(stderr, _("Could not listen on socket %s: %s"), srv->socketpath, strerror(errno));
+		fprintf(stderr, "\n");
+		close(srv->fd);
+		free(fds);
+		return -1;
+	}
+#ifdef SIGPIPE
+	/* Clients closing the connection early must not stop the server */
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	while(!srv->shutdown) {
+		/* New connections wait in the backlog while all slots are used */
+		numfds = 0;
+		for(i=0; i<srv->numclients; i++) {
+			fds[numfds].fd = srv->clients[i].fd;
+			fds[numfds].events = POLLIN;
+			fds[numfds++].revents = 0;
+		}
+		if(srv->numclients < SERVER_MAXCLIENTS) {
+			fds[numfds].fd = srv->fd;
+			fds[numfds].events = POLLIN;
+			fds[numfds++].revents = 0;
+		}
+		if(0 > (n = poll(fds, numfds, 1000))) {
+			if(errno == EINTR)
+				continue;
+			fprintf(stderr, _("Could not wait for requests: %s"), strerror(errno));
+			fprintf(stderr, "\n");
+			break;
+		}
+
+		/* Clients are removed from the end, so the remaining ones keep
+		 * their index in fds.
+		 */
+		now = time(NULL);
+		for(i=srv->numclients-1; i>=0; i--) {
+			struct server_client *c = &srv->clients[i];
+
+			if(!srv->shutdown && (fds[i].revents & (POLLIN|POLLHUP|POLLERR))) {
+				if(0 == read_requests(srv, c))
+					continue;
+			} else if(now - c->lastactive < SERVER_TIMEOUT) {
+				continue;
+			}
+			close(c->fd);
+			*c = srv->clients[--srv->numclients];
+			fds[i] = fds[srv->numclients];
+		}
+		if(n > 0 && !srv->shutdown && numfds > 0 && fds[numfds-1].fd == srv->fd && (fds[numfds-1].revents & POLLIN))
+			add_client(srv);
+	}
+	for(i=0; i<srv->numclients; i++)
+		close(srv->clients[i].fd);
+	srv->numclients = 0;
+	free(fds);
+	close(srv->fd);
+	unlink(srv->socketpath);
+	return(srv->shutdown ? 0 : -1);
+#else
+	fprintf(stderr, _("Unix domain sockets are not supported on this system."));
+	fprintf(stderr, "\n");
+	return -1;
+#endif
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,78 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include <time.h>
+#include "hash.h"
+#include "format.h"
+
+/* Default number of tables kept open */
+#define SERVER_CACHE 16
+/* Maximum length of a request line */
+#define SERVER_MAXREQUEST 4096
+/* Maximum number of connections served at the same time */
+#define SERVER_MAXCLIENTS 64
+/* Seconds after which an idle connection is closed and a blocked write
+ * to a client fails
+ */
+#define SERVER_TIMEOUT 60
+/* Size of the pieces an answer is sent in */
+#define SERVER_CHUNK 65536
+
+/* Hash of the value of a field in a record */
+struct server_index_entry {
+	px_hash_t hash;
+	int recno;
+};
+
+/* Records of a table sorted by the hash of the value of one field */
+struct server_index {
+	struct server_index_entry *entries;
+	int numentries;
+};
+
+/* Open table in the cache together with everything needed to answer
+ * requests without reading the header again.
+ */
+struct server_table {
+	char *filename;
+	time_t mtime;           /* modification time of file when opened */
+	pxdoc_t *pxdoc;
+	pxdoc_t *pindexdoc;     /* primary index found next to the table */
+	pxblob_t *pxblob;       /* blob file found next to the table */
+	pxfield_t *fields;
+	int numfields;
+	int *offsets;           /* offset of each field in a record */
+	char *data;             /* one record */
+	struct server_index **indexes; /* built on first lookup of a field */
+	unsigned long lastused;
+};
+
+/* Connection of a client and its request read so far */
+struct server_client {
+	int fd;
+	char request[SERVER_MAXREQUEST];
+	size_t len;
+	time_t lastactive;
+};
+
+/* Daemon answering requests on a unix domain socket */
+struct server {
+	char *socketpath;
+	int fd;
+	char *targetencoding;
+	struct format_options *fo;
+	pxview_errorhandler_t errorhandler;
+	struct server_table *tables;
+	int numtables;
+	int maxtables;
+	struct server_client *clients;
+	int numclients;
+	unsigned long clock;    /* incremented with each request */
+	int shutdown;
+};
+
+struct server *server_new(const char *socketpath, int maxtables, char *targetencoding, struct format_options *fo, pxview_errorhandler_t errorhandler);
+void server_delete(struct server *srv);
+int server_run(struct server *srv);
+
+#endif
@@ -0,0 +1,94 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pxview.h"
+#include "sinkblobs.h"
+
+/* sink_blobs_open() {{{
+ * Opens the blob store in storedir and the blob file for copying blobs
+ * larger than streamthreshold, if they are given. If needfile is set
+ * the blob file is opened even without a threshold. A blob file which
+ * cannot be opened is not an error, pxlib reads all blobs then.
+ * Returns -1 on error and 0 otherwise.
+ */
+int sink_blobs_open(struct sink_blobs *sb, pxdoc_t *pxdoc, const char *prefix, const char *extension, const char *storedir, const char *blobfile, long streamthreshold, int needfile) {
+	sb->pxdoc = pxdoc;
+	sb->prefix = prefix;
+	sb->extension = extension;
+	if(storedir && NULL == sb->store) {
+		if(NULL == (sb->store = blob_store_new(pxdoc, storedir, extension))) {
+			return -1;
+		}
+	}
+	if(blobfile && NULL == sb->mb && (streamthreshold > 0 || needfile))
+		sb->mb = mbfile_open(pxdoc, blobfile);
+	if(sb->mb && streamthreshold > 0 && NULL == sb->stream) {
+		if(NULL == (sb->stream = blob_stream_new(pxdoc, sb->mb, streamthreshold))) {
+			return -1;
+		}
+	}
+	return 0;
+}
+/* }}} */
+
+/* sink_blobs_close() {{{
+ */
+void sink_blobs_close(struct sink_blobs *sb) {
+	if(sb->stream)
+		blob_stream_delete(sb->stream);
+	if(sb->mb)
+		mbfile_close(sb->mb);
+	if(sb->store)
+		blob_store_delete(sb->store);
+	sb->stream = NULL;
+	sb->mb = NULL;
+	sb->store = NULL;
+}
+/* }}} */
+
+/* sink_blobs_file() {{{
+ * Writes a blob read by pxlib into the store or into the file
+ * PREFIX_NUMBER.EXT. Returns the name of the file, which must be freed
+ * with pxdoc->free(), or NULL on error.
+ */
+char *sink_blobs_file(struct sink_blobs *sb, const char *data, int size, int number) {
+	if(sb->store)
+		return(blob_store_file(sb->store, data, size));
+	return(pxview_blob_file(sb->pxdoc, sb->prefix, number, sb->extension, data, size));
+}
+/* }}} */
+
+/* sink_blobs_locate() {{{
+ * Returns 1 if the blob of the field is copied in pieces and sets loc
+ * to its position in the blob file, and 0 if it is left to pxlib.
+ */
+int sink_blobs_locate(struct sink_blobs *sb, pxfield_t *pxf, const char *fielddata, struct blob_location *loc) {
+	if(NULL == sb->stream)
+		return 0;
+	return(blob_stream_locate(sb->stream, pxf, fielddata, loc));
+}
+/* }}} */
+
+/* sink_blobs_stream_file() {{{
+ * Like sink_blobs_file() for a blob found by sink_blobs_locate().
+ */
+char *sink_blobs_stream_file(struct sink_blobs *sb, struct blob_location *loc, int number) {
+	return(blob_stream_file(sb->stream, loc, sb->prefix, number, sb->extension, sb->store));
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,27 @@
+#ifndef __SINKBLOBS_H__
+#define __SINKBLOBS_H__
+
+#include "mbfile.h"
+#include "blobstore.h"
+#include "blobstream.h"
+
+/* Where the sinks put binary blobs. Each blob is written into a file
+ * PREFIX_n.EXT or into a store of blobs named by their content. Blobs
+ * above a threshold are copied from the blob file in pieces.
+ */
+struct sink_blobs {
+	pxdoc_t *pxdoc;
+	const char *prefix;
+	const char *extension;
+	struct mbfile *mb;          /* blob file opened by the sink */
+	struct blob_store *store;   /* stores each distinct blob once if set */
+	struct blob_stream *stream; /* copies large blobs in pieces if set */
+};
+
+int sink_blobs_open(struct sink_blobs *sb, pxdoc_t *pxdoc, const char *prefix, const char *extension, const char *storedir, const char *blobfile, long streamthreshold, int needfile);
+void sink_blobs_close(struct sink_blobs *sb);
+char *sink_blobs_file(struct sink_blobs *sb, const char *data, int size, int number);
+int sink_blobs_locate(struct sink_blobs *sb, pxfield_t *pxf, const char *fielddata, struct blob_location *loc);
+char *sink_blobs_stream_file(struct sink_blobs *sb, struct blob_location *loc, int number);
+
+#endif
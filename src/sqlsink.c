@@ -0,0 +1,680 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_STDARG_H
+#include <stdarg.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "pxview.h"
+#include "str_buffer.h"
+#include "sinkblobs.h"
+
+#ifdef HAVE_SQLITE
+#include <sqlite.h>
+#endif
+
+/* Kinds of statements written by the sink */
+#define SQL_INSERT 1
+#define SQL_COPY 2
+#define SQL_SQLITE 3
+
+/* Sink writing sql statements which create the table and insert the
+ * records. The same statements are executed in an sqlite database,
+ * where each statement is collected in a buffer first.
+ */
+struct sql_sink {
+	struct pxview_sink sink;
+	pxdoc_t *allocdoc;      /* document used for allocating the sink */
+	FILE *outfp;            /* NULL for sqlite */
+#ifdef HAVE_SQLITE
+	sqlite *db;
+#endif
+	struct pxview_sql_options options;
+	int mode;               /* one of SQL_INSERT, SQL_COPY or SQL_SQLITE */
+	struct sink_blobs blobs;
+	struct str_buffer *sbuf;    /* statement executed in sqlite */
+	struct str_buffer *columns; /* names of the columns separated by ", " */
+	int hasrecords;         /* set if there are records to be copied */
+	int first;              /* set when first field of record has been output */
+	int error;              /* set if the statement could not be built */
+};
+
+/* sql_write() {{{
+ * Outputs len chars of str as part of the current statement.
+ */
+static void sql_write(struct sql_sink *ss, const char *str, int len) {
+	if(len <= 0)
+		return;
+	if(ss->outfp)
+		fwrite(str, 1, len, ss->outfp);
+	else if(0 > str_buffer_append(ss->allocdoc, ss->sbuf, str, len))
+		ss->error = 1;
+}
+/* }}} */
+
+#define MSG_BUFSIZE 256
+/* sql_print() {{{
+ * Like sql_write() for a formatted string.
+ */
+static void sql_print(struct sql_sink *ss, const char *fmt, ...) {
+	char msg[MSG_BUFSIZE];
+	va_list ap;
+	int written;
+
+	va_start(ap, fmt);
+#ifdef HAVE_VSNPRINTF
+	written = vsnprintf(msg, MSG_BUFSIZE, fmt, ap);
+#else
+	written = vsprintf(msg, fmt, ap);
+#endif
+	va_end(ap);
+	if(written >= MSG_BUFSIZE) {
+		fprintf(stderr, _("Fatal Error: Format string is too short"));
+		fprintf(stderr, "\n");
+		ss->error = 1;
+		return;
+	}
+	sql_write(ss, msg, written);
+}
+/* }}} */
+#undef MSG_BUFSIZE
+
+/* sql_write_mask() {{{
+ * Outputs len chars of str and masks each occurence of c1 with c2.
+ */
+static void sql_write_mask(struct sql_sink *ss, const char *str, int len, char c1, char c2) {
+	int i, start = 0;
+
+	for(i=0; i<len; i++) {
+		if(str[i] == c1) {
+			sql_write(ss, &str[start], i-start);
+			sql_write(ss, &c2, 1);
+			start = i;
+		}
+	}
+	sql_write(ss, &str[start], len-start);
+}
+/* }}} */
+
+/* sql_exec() {{{
+ * Finishes a statement. In sqlite it is executed now.
+ * Returns -1 on error and 0 otherwise.
+ */
+static int sql_exec(struct sql_sink *ss) {
+	if(ss->error) {
+		ss->error = 0;
+		if(ss->sbuf)
+			str_buffer_clear(ss->allocdoc, ss->sbuf);
+		return -1;
+	}
+#ifdef HAVE_SQLITE
+	if(ss->mode == SQL_SQLITE) {
+		char *sqlerror;
+		int ret;
+		ret = sqlite_exec(ss->db, str_buffer_get(ss->allocdoc, ss->sbuf), NULL, NULL, &sqlerror);
+		str_buffer_clear(ss->allocdoc, ss->sbuf);
+		if(SQLITE_OK != ret) {
+			fprintf(stderr, "%s\n", sqlerror);
+			return -1;
+		}
+	}
+#endif
+	return 0;
+}
+/* }}} */
+
+/* sql_column_name() {{{
+ * Replaces blanks in the name of a field by underscores.
+ */
+static void sql_column_name(pxfield_t *pxf) {
+	char *ptr;
+
+	for(ptr=pxf->px_fname; *ptr != '\0'; ptr++) {
+		if(*ptr == ' ')
+			*ptr = '_';
+	}
+}
+/* }}} */
+
+/* sql_quote() {{{
+ * Outputs a quote around values which are not copied.
+ */
+static void sql_quote(struct sql_sink *ss) {
+	if(ss->mode != SQL_COPY)
+		sql_write(ss, "'", 1);
+}
+/* }}} */
+
+/* sql_schema() {{{
+ * Outputs the statements dropping and creating the table and the
+ * indexes of the primary key. Blanks in the names of fields are
+ * replaced by underscores.
+ */
+static int sql_schema(struct sql_sink *ss) {
+	struct pxview_sink *sink = &ss->sink;
+	const char *tablename = ss->options.tablename;
+	pxfield_t *pxf;
+	int i, first;
+
+	if(ss->options.droptable) {
+		sql_print(ss, "DROP TABLE %s;\n", tablename);
+		if(0 > sql_exec(ss))
+			return -1;
+	}
+	if(!ss->options.withschema)
+		return 0;
+
+	sql_print(ss, "CREATE TABLE %s (\n", tablename);
+	first = 0;  // set to 1 when first field has been output
+	pxf = sink->fields;
+	for(i=0; i<sink->numfields; i++, pxf++) {
+		if(sink->selectedfields && !sink->selectedfields[i])
+			continue;
+		if(pxf->px_ftype < 1 || pxf->px_ftype > pxfBytes || !field_type_code(pxf->px_ftype))
+			continue;
+		sql_column_name(pxf);
+		if(first == 1)
+			sql_print(ss, ",\n");
+		sql_print(ss, "  `%s` ", pxf->px_fname);
+		sql_print(ss, ss->options.sqltypes[(int) pxf->px_ftype], pxf->px_ftype == pxfBCD ? pxf->px_fdc : pxf->px_flen);
+		first = 1;
+	}
+	if(ss->options.primarykeyfields) {
+		first = 0;  // set to 1 when first field has been output
+		pxf = sink->fields;
+		sql_print(ss, ",\n  unique(");
+		for(i=0; i<ss->options.primarykeyfields; i++, pxf++) {
+			if(sink->selectedfields && !sink->selectedfields[i])
+				continue;
+			sql_column_name(pxf);
+			if(first == 1)
+				sql_print(ss, ",");
+			sql_print(ss, "%s", pxf->px_fname);
+			first = 1;
+		}
+		sql_print(ss, ")");
+	}
+	sql_print(ss, "\n);\n");
+	if(0 > sql_exec(ss))
+		return -1;
+
+	pxf = sink->fields;
+	for(i=0; i<ss->options.primarykeyfields; i++, pxf++) {
+		if(sink->selectedfields && !sink->selectedfields[i])
+			continue;
+		sql_column_name(pxf);
+		sql_print(ss, "CREATE INDEX %s_%s_index on %s (%s);\n", tablename, pxf->px_fname, tablename, pxf->px_fname);
+		if(0 > sql_exec(ss))
+			return -1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* sql_column_names() {{{
+ * Collects the names of the selected columns separated by ", ".
+ * Returns -1 on error and 0 otherwise.
+ */
+static int sql_column_names(struct sql_sink *ss) {
+	struct pxview_sink *sink = &ss->sink;
+	pxfield_t *pxf;
+	int i, first = 0;
+
+	if(NULL == (ss->columns = str_buffer_new(ss->allocdoc, 20))) {
+		return -1;
+	}
+	pxf = sink->fields;
+	for(i=0; i<sink->numfields; i++, pxf++) {
+		if(sink->selectedfields && !sink->selectedfields[i])
+			continue;
+		if(!field_type_code(pxf->px_ftype))
+			continue;
+		if(first == 1)
+			str_buffer_append(ss->allocdoc, ss->columns, ", ", 2);
+		if(0 > str_buffer_append(ss->allocdoc, ss->columns, pxf->px_fname, strlen(pxf->px_fname)))
+			return -1;
+		first = 1;
+	}
+	return 0;
+}
+/* }}} */
+
+/* sql_begin_table() {{{
+ * Outputs the schema and the statement the records are copied or
+ * inserted with.
+ */
+static int sql_begin_table(struct pxview_sink *sink) {
+	struct sql_sink *ss = sink->user;
+
+	if(0 > sink_blobs_open(&ss->blobs, sink->pxdoc, ss->options.blobprefix, ss->options.blobextension,
+	                       ss->options.blobstore, ss->options.blobfile, ss->options.streamthreshold, 0))
+		return -1;
+	if(0 > sql_schema(ss))
+		return -1;
+
+	/* The names are collected once and output with each INSERT */
+	if(ss->mode == SQL_COPY || (ss->mode == SQL_INSERT && !ss->options.shortinsert)) {
+		if(0 > sql_column_names(ss))
+			return -1;
+	}
+	/* Only output data if we have at least one record */
+	ss->hasrecords = PX_get_num_records(sink->pxdoc) > 0;
+	if(ss->mode == SQL_COPY && ss->hasrecords && !ss->options.resume) {
+		sql_print(ss, "COPY %s (", ss->options.tablename);
+		sql_write(ss, str_buffer_get(ss->allocdoc, ss->columns), str_buffer_len(ss->allocdoc, ss->columns));
+		sql_print(ss, ") FROM stdin;\n");
+	}
+	if(ss->options.transactions) {
+		sql_print(ss, "BEGIN;");
+		return(sql_exec(ss));
+	}
+	return(0);
+}
+/* }}} */
+
+/* sql_begin_record() {{{
+ */
+static int sql_begin_record(struct pxview_sink *sink, int recno, const char *data, int isdeleted, pxdatablockinfo_t *pxdbinfo) {
+	struct sql_sink *ss = sink->user;
+
+	ss->first = 0;
+	switch(ss->mode) {
+		case SQL_INSERT:
+			if(ss->options.shortinsert)
+				sql_print(ss, "insert into %s values (", ss->options.tablename);
+			else {
+				sql_print(ss, "insert into %s (", ss->options.tablename);
+				sql_write(ss, str_buffer_get(ss->allocdoc, ss->columns), str_buffer_len(ss->allocdoc, ss->columns));
+				sql_print(ss, ") values (");
+			}
+			break;
+		case SQL_SQLITE:
+			sql_print(ss, "INSERT INTO %s VALUES (", ss->options.tablename);
+			break;
+	}
+	return(0);
+}
+/* }}} */
+
+/* sql_separator() {{{
+ * Outputs the separator in front of every value but the first one.
+ */
+static void sql_separator(struct sql_sink *ss) {
+	if(ss->first) {
+		switch(ss->mode) {
+			case SQL_INSERT:
+				sql_write(ss, ", ", 2);
+				break;
+			case SQL_COPY:
+				sql_write(ss, "\t", 1);
+				break;
+			case SQL_SQLITE:
+				sql_write(ss, ",", 1);
+				break;
+		}
+	}
+	ss->first = 1;
+}
+/* }}} */
+
+/* sql_field_null() {{{
+ * Outputs NULL. Empty alpha fields are empty strings unless
+ * emptystringisnull is set, but always NULL in sqlite.
+ */
+static int sql_field_null(struct pxview_sink *sink, int field, pxfield_t *pxf) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	if(pxf->px_ftype == pxfAlpha && !ss->options.emptystringisnull && ss->mode != SQL_SQLITE) {
+		if(ss->mode == SQL_INSERT)
+			sql_write(ss, "''", 2);
+	} else if(ss->mode == SQL_COPY) {
+		sql_write(ss, "\\N", 2);
+	} else {
+		sql_write(ss, "NULL", 4);
+	}
+	return(0);
+}
+/* }}} */
+
+/* sql_field_string() {{{
+ * Outputs a quoted string. Quotes are masked with a backslash, in
+ * sqlite by doubling them. Copied strings are not quoted but tabs are
+ * masked.
+ */
+static int sql_field_string(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value, int len) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	switch(ss->mode) {
+		case SQL_INSERT:
+			sql_write(ss, "'", 1);
+			sql_write_mask(ss, value, len, '\'', '\\');
+			sql_write(ss, "'", 1);
+			break;
+		case SQL_COPY:
+			sql_write_mask(ss, value, len, '\t', '\\');
+			break;
+		case SQL_SQLITE:
+			sql_write(ss, "'", 1);
+			sql_write_mask(ss, value, len, '\'', '\'');
+			sql_write(ss, "'", 1);
+			break;
+	}
+	return(0);
+}
+/* }}} */
+
+/* sql_field_long() {{{
+ */
+static int sql_field_long(struct pxview_sink *sink, int field, pxfield_t *pxf, long value) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	sql_print(ss, "%ld", value);
+	return(0);
+}
+/* }}} */
+
+/* sql_field_double() {{{
+ */
+static int sql_field_double(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	sql_print(ss, "%lf", value);
+	return(0);
+}
+/* }}} */
+
+/* sql_field_bool() {{{
+ * sqlite has no boolean type and stores 1 and 0.
+ */
+static int sql_field_bool(struct pxview_sink *sink, int field, pxfield_t *pxf, int value) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	if(ss->mode == SQL_SQLITE)
+		sql_print(ss, "%d", value ? 1 : 0);
+	else
+		sql_print(ss, "%s", value ? "TRUE" : "FALSE");
+	return(0);
+}
+/* }}} */
+
+/* sql_field_timestamp() {{{
+ * Dates are not quoted, because the format may produce a number. Times
+ * are quoted in INSERT statements and timestamps also in sqlite.
+ */
+static int sql_field_timestamp(struct pxview_sink *sink, int field, pxfield_t *pxf, double value) {
+	struct sql_sink *ss = sink->user;
+	const char *format;
+	char *str;
+	int quote;
+
+	sql_separator(ss);
+	switch(pxf->px_ftype) {
+		case pxfDate:
+			format = ss->options.date_format;
+			quote = 0;
+			break;
+		case pxfTime:
+			format = ss->options.time_format;
+			quote = (ss->mode == SQL_INSERT);
+			break;
+		default:
+			format = ss->options.timestamp_format;
+			quote = (ss->mode != SQL_COPY);
+	}
+	str = PX_timestamp2string(sink->pxdoc, value, format);
+	if(quote)
+		sql_quote(ss);
+	sql_write(ss, str, strlen(str));
+	if(quote)
+		sql_quote(ss);
+	sink->pxdoc->free(sink->pxdoc, str);
+	return(0);
+}
+/* }}} */
+
+/* sql_field_bcd() {{{
+ */
+static int sql_field_bcd(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *value) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	sql_write(ss, value, strlen(value));
+	return(0);
+}
+/* }}} */
+
+/* sql_field_blob() {{{
+ * Writes the blob into a file named by its modification number or into
+ * the blob store and outputs the file name.
+ */
+static int sql_field_blob(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int size, int number) {
+	struct sql_sink *ss = sink->user;
+	char *filename;
+
+	sql_separator(ss);
+	sql_quote(ss);
+	if(NULL != (filename = sink_blobs_file(&ss->blobs, data, size, number))) {
+		sql_write(ss, filename, strlen(filename));
+		sink->pxdoc->free(sink->pxdoc, filename);
+	}
+	sql_quote(ss);
+	return(0);
+}
+/* }}} */
+
+/* sql_field_blobref() {{{
+ * Copies large blobs in pieces. Memos still end up in the statement
+ * in sqlite, so they are left to sql_field_string() there.
+ */
+static int sql_field_blobref(struct pxview_sink *sink, int field, pxfield_t *pxf, char *data) {
+	struct sql_sink *ss = sink->user;
+	struct blob_location loc;
+	char *filename;
+	int ismemo = (pxf->px_ftype == pxfFmtMemoBLOb || pxf->px_ftype == pxfMemoBLOb);
+
+	if((ismemo && ss->mode == SQL_SQLITE) || !sink_blobs_locate(&ss->blobs, pxf, data, &loc))
+		return(1);
+	sql_separator(ss);
+	sql_quote(ss);
+	if(ismemo) {
+		blob_stream_copy(ss->blobs.stream, &loc, ss->outfp, ss->mode == SQL_COPY ? '\t' : '\'', '\\');
+	} else if(NULL != (filename = sink_blobs_stream_file(&ss->blobs, &loc, loc.modnr))) {
+		sql_write(ss, filename, strlen(filename));
+		sink->pxdoc->free(sink->pxdoc, filename);
+	}
+	sql_quote(ss);
+	return(0);
+}
+/* }}} */
+
+/* sql_field_bytes() {{{
+ */
+static int sql_field_bytes(struct pxview_sink *sink, int field, pxfield_t *pxf, const char *data, int len) {
+	struct sql_sink *ss = sink->user;
+
+	sql_separator(ss);
+	if(ss->mode == SQL_COPY)
+		sql_write(ss, "\\N", 2);
+	else
+		sql_write(ss, "NULL", 4);
+	return(0);
+}
+/* }}} */
+
+/* sql_end_record() {{{
+ */
+static int sql_end_record(struct pxview_sink *sink) {
+	struct sql_sink *ss = sink->user;
+
+	if(ss->mode == SQL_COPY)
+		sql_write(ss, "\n", 1);
+	else
+		sql_write(ss, ");\n", 3);
+	return(sql_exec(ss));
+}
+/* }}} */
+
+/* sql_checkpoint() {{{
+ * Commits the records inserted since the last checkpoint.
+ */
+static int sql_checkpoint(struct pxview_sink *sink) {
+	struct sql_sink *ss = sink->user;
+
+	if(!ss->options.transactions)
+		return(0);
+	sql_print(ss, "COMMIT;");
+	if(0 > sql_exec(ss))
+		return -1;
+	sql_print(ss, "BEGIN;");
+	return(sql_exec(ss));
+}
+/* }}} */
+
+/* sql_end_table() {{{
+ */
+static int sql_end_table(struct pxview_sink *sink) {
+	struct sql_sink *ss = sink->user;
+
+	if(ss->mode == SQL_COPY && ss->hasrecords)
+		sql_print(ss, "\\.\n");
+	if(ss->options.transactions) {
+		sql_print(ss, "COMMIT;");
+		return(sql_exec(ss));
+	}
+	return(0);
+}
+/* }}} */
+
+/* sql_destroy() {{{
+ */
+static void sql_destroy(struct pxview_sink *sink) {
+	struct sql_sink *ss = sink->user;
+
+	sink_blobs_close(&ss->blobs);
+	if(ss->columns)
+		str_buffer_delete(ss->allocdoc, ss->columns);
+	if(ss->sbuf)
+		str_buffer_delete(ss->allocdoc, ss->sbuf);
+#ifdef HAVE_SQLITE
+	if(ss->db)
+		sqlite_close(ss->db);
+#endif
+	ss->allocdoc->free(ss->allocdoc, ss);
+}
+/* }}} */
+
+/* sql_sink_new() {{{
+ * Creates the sink for all kinds of statements.
+ */
+static struct sql_sink *sql_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_sql_options *options, int mode) {
+	struct sql_sink *ss;
+
+	if(NULL == (ss = pxdoc->malloc(pxdoc, sizeof(struct sql_sink), _("Allocate memory for sql output.")))) {
+		return NULL;
+	}
+	memset(ss, 0, sizeof(struct sql_sink));
+	ss->allocdoc = pxdoc;
+	ss->outfp = outfp;
+	ss->options = *options;
+	ss->mode = mode;
+	if(mode != SQL_SQLITE)
+		ss->options.transactions = 0;
+	if(!ss->options.tablename)
+		ss->options.tablename = "";
+	if(!ss->options.blobprefix)
+		ss->options.blobprefix = "blob";
+	if(!ss->options.blobextension)
+		ss->options.blobextension = "blob";
+	if(!ss->options.date_format)
+		ss->options.date_format = "Y-m-d";
+	if(!ss->options.time_format)
+		ss->options.time_format = "H:i:s";
+	if(!ss->options.timestamp_format)
+		ss->options.timestamp_format = "Y-m-d H:i:s";
+	ss->sink.user = ss;
+	ss->sink.pxdoc = pxdoc;
+	ss->sink.begin_table = sql_begin_table;
+	ss->sink.begin_record = sql_begin_record;
+	ss->sink.field_null = sql_field_null;
+	ss->sink.field_string = sql_field_string;
+	ss->sink.field_long = sql_field_long;
+	ss->sink.field_double = sql_field_double;
+	ss->sink.field_bool = sql_field_bool;
+	ss->sink.field_timestamp = sql_field_timestamp;
+	ss->sink.field_bcd = sql_field_bcd;
+	ss->sink.field_blob = sql_field_blob;
+	if(ss->options.blobfile && ss->options.streamthreshold > 0)
+		ss->sink.field_blobref = sql_field_blobref;
+	ss->sink.field_bytes = sql_field_bytes;
+	ss->sink.end_record = sql_end_record;
+	ss->sink.checkpoint = sql_checkpoint;
+	ss->sink.end_table = sql_end_table;
+	ss->sink.destroy = sql_destroy;
+	return(ss);
+}
+/* }}} */
+
+/* pxview_sql_sink_new() {{{
+ * Creates a sink writing sql statements into outfp. pxdoc is only used
+ * for allocating memory. Returns NULL on failure.
+ */
+struct pxview_sink *pxview_sql_sink_new(pxdoc_t *pxdoc, FILE *outfp, const struct pxview_sql_options *options) {
+	struct sql_sink *ss;
+
+	if(NULL == (ss = sql_sink_new(pxdoc, outfp, options, options->usecopy ? SQL_COPY : SQL_INSERT))) {
+		return NULL;
+	}
+	return(&ss->sink);
+}
+/* }}} */
+
+#ifdef HAVE_SQLITE
+/* pxview_sqlite_sink_new() {{{
+ * Creates a sink inserting the records into the sqlite database in
+ * filename. pxdoc is only used for allocating memory. Returns NULL on
+ * failure.
+ */
+struct pxview_sink *pxview_sqlite_sink_new(pxdoc_t *pxdoc, const char *filename, const struct pxview_sql_options *options) {
+	struct sql_sink *ss;
+	char *sqlerror = NULL;
+
+	if(NULL == (ss = sql_sink_new(pxdoc, NULL, options, SQL_SQLITE))) {
+		return NULL;
+	}
+	if(NULL == (ss->sbuf = str_buffer_new(pxdoc, 20))) {
+		sql_destroy(&ss->sink);
+		return NULL;
+	}
+	if(NULL == (ss->db = sqlite_open(filename, 0, &sqlerror))) {
+		if(sqlerror)
+			fprintf(stderr, "%s\n", sqlerror);
+		sql_destroy(&ss->sink);
+		return NULL;
+	}
+	/* Other tables may be written into the same database */
+	if(ss->options.busytimeout > 0)
+		sqlite_busy_timeout(ss->db, ss->options.busytimeout);
+	return(&ss->sink);
+}
+/* }}} */
+#endif
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
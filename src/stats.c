@@ -0,0 +1,349 @@
+/* fopencookie() */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "stats.h"
+#include "trace.h"
+
+/* The counters are updated at the places where pxview already calls
+ * pxlib or writes the output, so there is no overhead beyond checking
+ * pxview_stats if they are not collected. Time is measured when a
+ * phase is entered or left, not for each field value, except for
+ * recoding and blobs.
+ */
+
+struct pxview_stats *pxview_stats = NULL;
+
+/* File wrapped by stats_output() */
+static FILE *wrappedfp = NULL;
+
+static const char *phase_names[STATS_PHASES] = {
+	"other", "read", "convert", "recode", "blob", "write"
+};
+
+/* stats_clock() {{{
+ * Returns the time in seconds.
+ */
+static double stats_clock(void) {
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec + ts.tv_nsec / 1e9);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec + tv.tv_usec / 1e6);
+#endif
+}
+/* }}} */
+
+/* charge_phase() {{{
+ * Adds the time since the last change of phase to the current phase.
+ */
+static void charge_phase(struct pxview_stats *st) {
+	double now = stats_clock();
+
+	st->wall[st->stack[st->depth]] += now - st->last;
+	st->last = now;
+}
+/* }}} */
+
+/* stats_new() {{{
+ * Creates the counters and makes them the ones collected.
+ */
+struct pxview_stats *stats_new(void) {
+	struct pxview_stats *st;
+
+	if(NULL == (st = malloc(sizeof(struct pxview_stats)))) {
+		fprintf(stderr, _("Could not allocate memory for statistics."));
+		fprintf(stderr, "\n");
+		return NULL;
+	}
+	memset(st, 0, sizeof(struct pxview_stats));
+	st->start = st->last = stats_clock();
+	st->stack[0] = STATS_OTHER;
+	st->lastblock = -1;
+	pxview_stats = st;
+	return(st);
+}
+/* }}} */
+
+/* stats_delete() {{{
+ */
+void stats_delete(struct pxview_stats *st) {
+	if(pxview_stats == st)
+		pxview_stats = NULL;
+	free(st);
+}
+/* }}} */
+
+/* stats_enter() {{{
+ * Starts phase until stats_leave() is called.
+ */
+void stats_enter(int phase) {
+	struct pxview_stats *st = pxview_stats;
+
+	charge_phase(st);
+	st->calls[phase]++;
+	/* Phases nested too deeply are counted for the outer one */
+	if(st->depth+1 < STATS_DEPTH)
+		st->stack[++st->depth] = phase;
+}
+/* }}} */
+
+/* stats_leave() {{{
+ * Returns to the phase stats_enter() was called in.
+ */
+void stats_leave(void) {
+	struct pxview_stats *st = pxview_stats;
+
+	charge_phase(st);
+	if(st->depth > 0)
+		st->depth--;
+}
+/* }}} */
+
+/* stats_record() {{{
+ * Counts a record of size bytes read from the data block at blockpos.
+ */
+void stats_record(int size, long blockpos) {
+	struct pxview_stats *st = pxview_stats;
+
+	st->records++;
+	st->recordbytes += size;
+	if(blockpos != st->lastblock) {
+		st->blocks++;
+		st->lastblock = blockpos;
+	}
+}
+/* }}} */
+
+/* stats_blob() {{{
+ * Counts a blob of size bytes read.
+ */
+void stats_blob(long size) {
+	pxview_stats->blobs++;
+	pxview_stats->blobbytes += size;
+}
+/* }}} */
+
+#ifdef HAVE_FOPENCOOKIE
+/* output_write() {{{
+ */
+static ssize_t output_write(void *cookie, const char *buf, size_t size) {
+	FILE *fp = cookie;
+	double start = 0.0;
+	size_t n;
+
+	if(pxview_tracing)
+		start = trace_now();
+	if(pxview_stats)
+		stats_enter(STATS_WRITE);
+	n = fwrite(buf, 1, size, fp);
+	if(pxview_stats) {
+		pxview_stats->outputbytes += n;
+		stats_leave();
+	}
+	if(pxview_tracing)
+		trace_span("write output", "io", start, (long) n);
+	return((n == 0 && size > 0) ? -1 : (ssize_t) n);
+}
+/* }}} */
+
+/* output_close() {{{
+ * The wrapped file is left open.
+ */
+static int output_close(void *cookie) {
+	return(fflush((FILE *) cookie));
+}
+/* }}} */
+#endif
+
+/* stats_output() {{{
+ * Returns a file which counts and times or traces the output written
+ * into it before passing it on to fp. The file cannot be positioned. It must be
+ * ended with stats_output_end(). fp is returned itself if the output
+ * cannot be counted on this platform.
+ */
+FILE *stats_output(FILE *fp) {
+#ifdef HAVE_FOPENCOOKIE
+	cookie_io_functions_t io;
+	FILE *statsfp;
+
+	memset(&io, 0, sizeof(io));
+	io.write = output_write;
+	io.close = output_close;
+	if(NULL == (statsfp = fopencookie(fp, "w", io)))
+		return(fp);
+	/* All buffering is done by the new file, so each write of it
+	 * reaches the system. */
+	setvbuf(statsfp, NULL, _IOFBF, STATS_OUTPUTBUFFER);
+	setvbuf(fp, NULL, _IONBF, 0);
+	wrappedfp = fp;
+	return(statsfp);
+#else
+	return(fp);
+#endif
+}
+/* }}} */
+
+/* stats_output_end() {{{
+ * Flushes and closes a file returned by stats_output() and returns the
+ * file it wrapped.
+ */
+FILE *stats_output_end(FILE *fp) {
+	FILE *outfp = wrappedfp;
+
+	if(NULL == outfp)
+		return(fp);
+	fclose(fp);
+	wrappedfp = NULL;
+	return(outfp);
+}
+/* }}} */
+
+/* stats_malloc() {{{
+ * Allocators for PX_new2() counting their calls.
+ */
+void *stats_malloc(pxdoc_t *p, size_t size, const char *caller) {
+	if(pxview_stats)
+		pxview_stats->mallocs++;
+	return(malloc(size));
+}
+
+void *stats_realloc(pxdoc_t *p, void *mem, size_t size, const char *caller) {
+	if(pxview_stats)
+		pxview_stats->reallocs++;
+	return(realloc(mem, size));
+}
+
+void stats_free(pxdoc_t *p, void *mem) {
+	if(pxview_stats)
+		pxview_stats->frees++;
+	free(mem);
+}
+/* }}} */
+
+/* stats_get_data_blob() {{{
+ * Work like PX_get_data_blob() and PX_get_data_graphic() but count
+ * and trace the blob.
+ */
+int stats_get_data_blob(pxdoc_t *pxdoc, char *data, int len, int *mod, int *blobsize, char **value) {
+	double start = 0.0;
+	int ret;
+
+	if(NULL == pxview_stats && !pxview_tracing)
+		return(PX_get_data_blob(pxdoc, data, len, mod, blobsize, value));
+	if(pxview_tracing)
+		start = trace_now();
+	if(pxview_stats)
+		stats_enter(STATS_BLOB);
+	ret = PX_get_data_blob(pxdoc, data, len, mod, blobsize, value);
+	if(pxview_stats) {
+		if(ret > 0 && *value)
+			stats_blob(*blobsize);
+		stats_leave();
+	}
+	if(pxview_tracing)
+		trace_span("read blob", "blob", start, ret > 0 ? *blobsize : -1);
+	return(ret);
+}
+
+int stats_get_data_graphic(pxdoc_t *pxdoc, char *data, int len, int *mod, int *blobsize, char **value) {
+	double start = 0.0;
+	int ret;
+
+	if(NULL == pxview_stats && !pxview_tracing)
+		return(PX_get_data_graphic(pxdoc, data, len, mod, blobsize, value));
+	if(pxview_tracing)
+		start = trace_now();
+	if(pxview_stats)
+		stats_enter(STATS_BLOB);
+	ret = PX_get_data_graphic(pxdoc, data, len, mod, blobsize, value);
+	if(pxview_stats) {
+		if(ret > 0 && *value)
+			stats_blob(*blobsize);
+		stats_leave();
+	}
+	if(pxview_tracing)
+		trace_span("read blob", "blob", start, ret > 0 ? *blobsize : -1);
+	return(ret);
+}
+/* }}} */
+
+/* stats_print() {{{
+ * Outputs the counters as text or as a JSON object.
+ */
+void stats_print(struct pxview_stats *st, FILE *fp, int json) {
+	double wall, user = 0.0, sys = 0.0;
+	long maxrss = 0;
+	int i;
+#ifdef HAVE_SYS_RESOURCE_H
+	struct rusage ru;
+
+	if(0 == getrusage(RUSAGE_SELF, &ru)) {
+		user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+		sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+		maxrss = ru.ru_maxrss;
+	}
+#endif
+
+	charge_phase(st);
+	wall = st->last - st->start;
+	if(wall <= 0.0)
+		wall = 1e-9;
+
+	if(json) {
+		fprintf(fp, "{\"wall\": %.6f, \"cpu_user\": %.6f, \"cpu_system\": %.6f, \"peak_rss_kb\": %ld,\n", wall, user, sys, maxrss);
+		fprintf(fp, " \"records\": %ld, \"record_bytes\": %lld, \"records_per_second\": %.1f, \"bytes_per_second\": %.1f,\n", st->records, st->recordbytes, st->records / wall, st->recordbytes / wall);
+		fprintf(fp, " \"blocks\": %ld, \"blobs\": %ld, \"blob_bytes\": %lld, \"output_bytes\": %lld,\n", st->blocks, st->blobs, st->blobbytes, st->outputbytes);
+		fprintf(fp, " \"mallocs\": %ld, \"reallocs\": %ld, \"frees\": %ld,\n", st->mallocs, st->reallocs, st->frees);
+		fprintf(fp, " \"phases\": {");
+		for(i=0; i<STATS_PHASES; i++)
+			fprintf(fp, "%s\"%s\": {\"wall\": %.6f, \"calls\": %ld}", i ? ", " : "", phase_names[i], st->wall[i], st->calls[i]);
+		fprintf(fp, "}}\n");
+		return;
+	}
+
+	fprintf(fp, _("Wall time:           %.3f s\n"), wall);
+	fprintf(fp, _("CPU time:            %.3f s user, %.3f s system\n"), user, sys);
+	fprintf(fp, _("Peak memory:         %ld kB\n"), maxrss);
+	fprintf(fp, _("Records read:        %ld (%.0f records/s)\n"), st->records, st->records / wall);
+	fprintf(fp, _("Bytes read:          %lld (%.2f MB/s)\n"), st->recordbytes, st->recordbytes / wall / 1048576.0);
+	fprintf(fp, _("Data blocks read:    %ld\n"), st->blocks);
+	fprintf(fp, _("Blobs read:          %ld (%lld bytes)\n"), st->blobs, st->blobbytes);
+	fprintf(fp, _("Output written:      %lld bytes (%.2f MB/s)\n"), st->outputbytes, st->outputbytes / wall / 1048576.0);
+	fprintf(fp, _("Allocations:         %ld malloc, %ld realloc, %ld free\n"), st->mallocs, st->reallocs, st->frees);
+	fprintf(fp, _("Phase         Time (s)  Share       Calls\n"));
+	for(i=0; i<STATS_PHASES; i++)
+		fprintf(fp, "%-12s %9.3f %5.1f%% %11ld\n", phase_names[i], st->wall[i], 100.0 * st->wall[i] / wall, st->calls[i]);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,63 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+
+/* Phases the run time is divided into. Time spent in a phase entered
+ * from within another one is only counted for the inner phase.
+ */
+#define STATS_OTHER 0      /* opening the table and everything else */
+#define STATS_READ 1       /* reading records from the data blocks */
+#define STATS_CONVERT 2    /* decoding and formatting field values */
+#define STATS_RECODE 3     /* recoding alpha fields */
+#define STATS_BLOB 4       /* reading blobs */
+#define STATS_WRITE 5      /* writing the output */
+#define STATS_PHASES 6
+
+/* Maximum nesting of phases */
+#define STATS_DEPTH 8
+
+/* Size of the buffer of the output file */
+#define STATS_OUTPUTBUFFER 65536
+
+/* Counters of a run of pxview. They are only updated by the main
+ * thread.
+ */
+struct pxview_stats {
+	double start;
+	double last;               /* time of last change of phase */
+	double wall[STATS_PHASES];
+	long calls[STATS_PHASES];
+	int stack[STATS_DEPTH];    /* phases entered */
+	int depth;
+	long records;
+	long long recordbytes;
+	long blocks;
+	long lastblock;            /* position of last data block read */
+	long blobs;
+	long long blobbytes;
+	long mallocs;
+	long reallocs;
+	long frees;
+	long long outputbytes;
+};
+
+/* Counters of this run, NULL if they are not collected */
+extern struct pxview_stats *pxview_stats;
+
+struct pxview_stats *stats_new(void);
+void stats_delete(struct pxview_stats *st);
+void stats_enter(int phase);
+void stats_leave(void);
+void stats_record(int size, long blockpos);
+void stats_blob(long size);
+FILE *stats_output(FILE *fp);
+FILE *stats_output_end(FILE *fp);
+void *stats_malloc(pxdoc_t *p, size_t size, const char *caller);
+void *stats_realloc(pxdoc_t *p, void *mem, size_t size, const char *caller);
+void stats_free(pxdoc_t *p, void *mem);
+int stats_get_data_blob(pxdoc_t *pxdoc, char *data, int len, int *mod, int *blobsize, char **value);
+int stats_get_data_graphic(pxdoc_t *pxdoc, char *data, int len, int *mod, int *blobsize, char **value);
+void stats_print(struct pxview_stats *st, FILE *fp, int json);
+
+#endif
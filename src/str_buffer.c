@@ -0,0 +1,185 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_STDARG_H
+#include <stdarg.h>
+#endif
+#include "pxview_intern.h"
+#include "str_buffer.h"
+
+/* str_buffer_new() {{{
+ * Create a new string buffer with the given initial size
+ */
+struct str_buffer *str_buffer_new(pxdoc_t *pxdoc, size_t size) {
+	struct str_buffer *sb;
+	if(NULL == (sb = pxdoc->malloc(pxdoc, sizeof(struct str_buffer), _("Allocate memory for string buffer"))))
+		return NULL;
+	if(size > 0) {
+		if(NULL == (sb->buffer = pxdoc->malloc(pxdoc, size, _("Allocate memory for string buffer")))) {
+			pxdoc->free(pxdoc, sb);
+			return NULL;
+		}
+		sb->buffer[0] = '\0';
+	} else {
+		sb->buffer = NULL;
+	}
+	sb->size = size;
+	sb->cur = 0;
+	return(sb);
+}
+/* }}} */
+
+/* str_buffer_delete() {{{
+ * Frees the memory occupied by the string buffer
+ */
+void str_buffer_delete(pxdoc_t *pxdoc, struct str_buffer *sb) {
+	if(sb->buffer)
+		pxdoc->free(pxdoc, sb->buffer);
+	pxdoc->free(pxdoc, sb);
+}
+/* }}} */
+
+#define MSG_BUFSIZE 256
+/* str_buffer_print() {{{
+ * print a string at the end of a buffer
+ */
+int str_buffer_print(pxdoc_t *pxdoc, struct str_buffer *sb, const char *fmt, ...) {
+	char msg[MSG_BUFSIZE];
+	va_list ap;
+	int written;
+
+	va_start(ap, fmt);
+#ifdef HAVE_VSNPRINTF
+	written = vsnprintf(msg, MSG_BUFSIZE, fmt, ap);
+#else
+	written = vsprintf(msg, fmt, ap);
+#endif
+	if(written >= MSG_BUFSIZE) {
+		fprintf(stderr, _("Fatal Error: Format string is too short"));
+		fprintf(stderr, "\n");
+		return(written);
+	}
+
+	/* Enlarge memory for buffer
+	 * Enlarging it MSG_BUFSIZE ensure that the space is in any case
+	 * sufficient to add the new string.
+	 */
+	if((sb->cur + written + 1) > sb->size) {
+		sb->buffer = pxdoc->realloc(pxdoc, sb->buffer, sb->size+MSG_BUFSIZE, _("Get more memory for string buffer."));
+		sb->size += MSG_BUFSIZE;
+	}
+	strcpy(&(sb->buffer[sb->cur]), msg);
+	sb->cur += written;
+
+	va_end(ap);
+	return(written);
+}
+/* }}} */
+#undef MSG_BUFSIZE
+
+/* str_buffer_get() {{{
+ * Returns a pointer to current buffer
+ */
+const char *str_buffer_get(pxdoc_t *pxdoc, struct str_buffer *sb) {
+	return(sb->buffer);
+}
+/* }}} */
+
+/* str_buffer_len() {{{
+ * Returns len of string buffer
+ */
+size_t str_buffer_len(pxdoc_t *pxdoc, struct str_buffer *sb) {
+	return(sb->cur);
+}
+/* }}} */
+
+/* str_buffer_clear() {{{
+ * Clears the string buffer but will not free the memory
+ */
+void str_buffer_clear(pxdoc_t *pxdoc, struct str_buffer *sb) {
+	sb->cur = 0;
+	sb->buffer[0] = '\0';
+}
+/* }}} */
+
+/* str_buffer_truncate() {{{
+ * Shortens the string in the buffer to len chars. len must not be
+ * larger than the current length.
+ */
+void str_buffer_truncate(pxdoc_t *pxdoc, struct str_buffer *sb, size_t len) {
+	sb->cur = len;
+	sb->buffer[len] = '\0';
+}
+/* }}} */
+
+/* str_buffer_printmask() {{{
+ * Prints str to buffer and masks each occurence of c1 with c2.
+ * Returns the number of written chars.
+ */
+int str_buffer_printmask(pxdoc_t *pxdoc, struct str_buffer *sb, char *str, char c1, char c2 ) {
+	char *ptr, *dst;
+	int len = 0;
+	int c = 0;
+
+	/* Count occurences of c1 */
+	ptr = str;
+	while(*ptr != '\0') {
+		if(*ptr++ == c1)
+			c++;
+	}
+
+	c += sb->cur + strlen(str) + 1;
+	if(c > sb->size) {
+		 sb->buffer = pxdoc->realloc(pxdoc, sb->buffer, c, _("Get more memory for string buffer."));
+		 sb->size += c;
+	}
+	dst = &(sb->buffer[sb->cur]);
+	ptr = str;
+	while(*ptr != '\0') {
+		if(*ptr == c1) {
+			*dst++ = c2;
+			len ++;
+		} 
+		*dst++ = *ptr++;
+		len++;
+	}
+	*dst = '\0';
+	sb->cur += len;
+	return(len);
+}
+/* }}} */
+
+/* str_buffer_append() {{{
+ * Appends len chars of str to the buffer. Unlike str_buffer_print()
+ * the length of the string is not limited.
+ * Returns the number of appended chars or -1 on error.
+ */
+int str_buffer_append(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len) {
+	if((sb->cur + len + 1) > sb->size) {
+		size_t newsize = 2 * sb->size;
+		char *newbuffer;
+		if(newsize < sb->cur + len + 1)
+			newsize = sb->cur + len + 1;
+		if(NULL == (newbuffer = pxdoc->realloc(pxdoc, sb->buffer, newsize, _("Get more memory for string buffer."))))
+			return -1;
+		sb->buffer = newbuffer;
+		sb->size = newsize;
+	}
+	memcpy(&(sb->buffer[sb->cur]), str, len);
+	sb->cur += len;
+	sb->buffer[sb->cur] = '\0';
+	return(len);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
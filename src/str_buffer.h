@@ -0,0 +1,20 @@
+#ifndef __STR_BUFFER_H__
+#define __STR_BUFFER_H__
+
+struct str_buffer {
+	char *buffer;
+	size_t cur;
+	size_t size;
+};
+
+struct str_buffer *str_buffer_new(pxdoc_t *pxdoc, size_t size);
+void str_buffer_delete(pxdoc_t *pxdoc, struct str_buffer *sb);
+int str_buffer_print(pxdoc_t *pxdoc, struct str_buffer *sb, const char *fmt, ...);
+const char *str_buffer_get(pxdoc_t *pxdoc, struct str_buffer *sb);
+size_t str_buffer_len(pxdoc_t *pxdoc, struct str_buffer *sb);
+void str_buffer_clear(pxdoc_t *pxdoc, struct str_buffer *sb);
+void str_buffer_truncate(pxdoc_t *pxdoc, struct str_buffer *sb, size_t len);
+int str_buffer_printmask(pxdoc_t *pxdoc, struct str_buffer *sb, char *str, char c1, char c2 );
+int str_buffer_append(pxdoc_t *pxdoc, struct str_buffer *sb, const char *str, size_t len);
+
+#endif
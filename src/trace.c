@@ -0,0 +1,229 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TIME_H
+#include <sys/time.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef ENABLE_NLS
+#include <libintl.h>
+#endif
+#include "pxview_intern.h"
+#include "trace.h"
+
+/* Spans of time are recorded into a ring buffer of each thread and
+ * written in the trace event format of Chrome when tracing stops, which
+ * must be after all other threads have ended. The trace can be viewed
+ * with chrome://tracing or Perfetto.
+ */
+
+int pxview_tracing = 0;
+
+static char *tracefile = NULL;
+static double tracestart;
+static struct trace_buffer *buffers = NULL;
+static int numbuffers = 0;
+#ifdef HAVE_PTHREAD_H
+static pthread_mutex_t bufferlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t bufferkey;
+#else
+static struct trace_buffer *mainbuffer = NULL;
+#endif
+
+/* trace_clock() {{{
+ * Returns the time in microseconds.
+ */
+static double trace_clock(void) {
+#ifdef HAVE_CLOCK_GETTIME
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+#else
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec * 1e6 + tv.tv_usec);
+#endif
+}
+/* }}} */
+
+/* new_buffer() {{{
+ * Creates the buffer of the calling thread. Returns NULL if there is
+ * no memory, in which case the events of the thread are dropped.
+ */
+static struct trace_buffer *new_buffer(const char *name) {
+	struct trace_buffer *buf;
+
+	if(NULL == (buf = malloc(sizeof(struct trace_buffer))))
+		return NULL;
+	buf->threadname = name;
+	buf->count = 0;
+#ifdef HAVE_PTHREAD_H
+	pthread_mutex_lock(&bufferlock);
+	buf->tid = ++numbuffers;
+	buf->next = buffers;
+	buffers = buf;
+	pthread_mutex_unlock(&bufferlock);
+	pthread_setspecific(bufferkey, buf);
+#else
+	buf->tid = ++numbuffers;
+	buf->next = buffers;
+	buffers = buf;
+	mainbuffer = buf;
+#endif
+	return(buf);
+}
+/* }}} */
+
+/* thread_buffer() {{{
+ */
+static struct trace_buffer *thread_buffer(void) {
+#ifdef HAVE_PTHREAD_H
+	struct trace_buffer *buf = pthread_getspecific(bufferkey);
+#else
+	struct trace_buffer *buf = mainbuffer;
+#endif
+
+	if(NULL == buf)
+		buf = new_buffer("thread");
+	return(buf);
+}
+/* }}} */
+
+/* trace_start() {{{
+ * Starts recording events, which are written into filename by
+ * trace_stop(). The calling thread is named main.
+ * Returns 0 on success and -1 on error.
+ */
+int trace_start(const char *filename) {
+	if(NULL == (tracefile = malloc(strlen(filename)+1))) {
+		fprintf(stderr, _("Could not allocate memory for trace."));
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	strcpy(tracefile, filename);
+#ifdef HAVE_PTHREAD_H
+	if(0 != pthread_key_create(&bufferkey, NULL)) {
+		free(tracefile);
+		tracefile = NULL;
+		return -1;
+	}
+#endif
+	tracestart = trace_clock();
+	pxview_tracing = 1;
+	trace_thread("main");
+	return 0;
+}
+/* }}} */
+
+/* trace_thread() {{{
+ * Names the calling thread in the trace.
+ */
+void trace_thread(const char *name) {
+	struct trace_buffer *buf;
+
+	if(!pxview_tracing)
+		return;
+	if(NULL != (buf = thread_buffer()))
+		buf->threadname = name;
+}
+/* }}} */
+
+/* trace_now() {{{
+ * Returns the time to be passed as start of a span to trace_span().
+ */
+double trace_now(void) {
+	return(trace_clock() - tracestart);
+}
+/* }}} */
+
+/* trace_span() {{{
+ * Records a span from start until now. arg is written as argument n
+ * unless it is negative.
+ */
+void trace_span(const char *name, const char *category, double start, long arg) {
+	struct trace_buffer *buf;
+	struct trace_event *ev;
+
+	if(NULL == (buf = thread_buffer()))
+		return;
+	ev = &(buf->events[buf->count % TRACE_EVENTS]);
+	ev->name = name;
+	ev->category = category;
+	ev->start = start;
+	ev->duration = trace_now() - start;
+	ev->arg = arg;
+	buf->count++;
+}
+/* }}} */
+
+/* trace_stop() {{{
+ * Writes the recorded events into the trace file and frees them.
+ * Returns 0 on success and -1 if the file could not be written.
+ */
+int trace_stop(void) {
+	struct trace_buffer *buf, *next;
+	struct trace_event *ev;
+	unsigned long i, first;
+	FILE *fp;
+	int ret = 0, sep = 0;
+
+	if(!pxview_tracing)
+		return 0;
+	pxview_tracing = 0;
+	if(NULL == (fp = fopen(tracefile, "w"))) {
+		fprintf(stderr, _("Could not open trace file '%s'."), tracefile);
+		fprintf(stderr, "\n");
+		ret = -1;
+	} else {
+		fprintf(fp, "{\"traceEvents\": [\n");
+		for(buf=buffers; buf; buf=buf->next) {
+			fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}", sep++ ? ",\n" : "", buf->tid, buf->threadname);
+			first = (buf->count > TRACE_EVENTS) ? buf->count - TRACE_EVENTS : 0;
+			for(i=first; i<buf->count; i++) {
+				ev = &(buf->events[i % TRACE_EVENTS]);
+				fprintf(fp, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d", ev->name, ev->category, ev->start, ev->duration, buf->tid);
+				if(ev->arg >= 0)
+					fprintf(fp, ", \"args\": {\"n\": %ld}", ev->arg);
+				fprintf(fp, "}");
+			}
+		}
+		fprintf(fp, "\n], \"displayTimeUnit\": \"ms\"}\n");
+		if(0 != fclose(fp)) {
+			fprintf(stderr, _("Could not write trace file '%s'."), tracefile);
+			fprintf(stderr, "\n");
+			ret = -1;
+		}
+	}
+	for(buf=buffers; buf; buf=next) {
+		next = buf->next;
+		free(buf);
+	}
+	buffers = NULL;
+	numbuffers = 0;
+#ifdef HAVE_PTHREAD_H
+	pthread_key_delete(bufferkey);
+#else
+	mainbuffer = NULL;
+#endif
+	free(tracefile);
+	tracefile = NULL;
+	return(ret);
+}
+/* }}} */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
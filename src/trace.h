@@ -0,0 +1,38 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+/* Number of events kept for each thread. Older events are overwritten
+ * by newer ones.
+ */
+#define TRACE_EVENTS 65536
+
+/* Span of time spent on something */
+struct trace_event {
+	const char *name;          /* must be a static string */
+	const char *category;
+	double start;              /* microseconds since the trace started */
+	double duration;
+	long arg;                  /* block number or size, -1 if none */
+};
+
+/* Events recorded by one thread. Only that thread writes into it, so
+ * no lock is needed while recording.
+ */
+struct trace_buffer {
+	int tid;
+	const char *threadname;
+	unsigned long count;       /* number of events recorded */
+	struct trace_event events[TRACE_EVENTS];
+	struct trace_buffer *next;
+};
+
+/* Set while events are recorded */
+extern int pxview_tracing;
+
+int trace_start(const char *filename);
+int trace_stop(void);
+void trace_thread(const char *name);
+double trace_now(void);
+void trace_span(const char *name, const char *category, double start, long arg);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef __TRANSCODE_H__
+#define __TRANSCODE_H__
+
+/* Characters 128 to 255 of a single byte codepage */
+struct codepage_table {
+	int codepage;
+	const unsigned short *chars;
+};
+
+/* Codepages which can be recoded by table, ended by codepage 0 */
+extern const struct codepage_table transcode_codepages[];
+
+/* Recoding of alpha fields from a single byte codepage into UTF-8 by
+ * table, attached to the document it is used for.
+ */
+struct transcoder {
+	pxdoc_t *pxdoc;
+	int codepage;
+	unsigned char utf8[256][4];  /* UTF-8 sequence of each byte */
+	unsigned char utf8len[256];
+	struct transcoder *next;
+};
+
+int transcode_set_targetencoding(pxdoc_t *pxdoc, const char *encoding);
+void transcode_release(pxdoc_t *pxdoc);
+int transcode_get_data_alpha(pxdoc_t *pxdoc, char *data, int len, char **value);
+
+#endif